@@ -153,6 +153,7 @@ PRODUCT_DESC=GCC xcompile
 # explicitly exclude platform headers
 SPARK_NO_PLATFORM=1
 DEFAULT_PRODUCT_ID=3
+PLATFORM_THREADING=1
 endif
 
 ifeq ("$(PLATFORM_ID)","4")
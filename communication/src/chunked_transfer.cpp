@@ -27,6 +27,7 @@ ProtocolError ChunkedTransfer::handle_update_begin(
         token_t token, Message& message, MessageChannel& channel)
 {
     uint8_t flags = 0;
+    uint32_t image_id = 0;
     chunk_count = 0;
     int actual_len = message.length();
     uint8_t* queue = message.buf();
@@ -49,6 +50,11 @@ ProtocolError ChunkedTransfer::handle_update_begin(
         file.store = FileTransfer::Store::Enum(decode_uint8(queue + 15));
         file.file_address = decode_uint32(queue + 16);
         file.chunk_address = file.file_address;
+        if (actual_len >= 24)
+        {
+            // servers supporting resumable transfers identify the image
+            image_id = decode_uint32(queue + 20);
+        }
     }
     else
     {
@@ -64,6 +70,8 @@ ProtocolError ChunkedTransfer::handle_update_begin(
     {
         success = file.chunk_count(file.chunk_size) < MAX_CHUNKS;
     }
+    // the staged data is verified before the acknowledgement since it reuses the message buffer
+    bool resume = success && can_resume(image_id, flags, channel);
     Message response;
     channel.response(message, response, 16);
     size_t size = Messages::coded_ack(response.buf(),
@@ -76,33 +84,57 @@ ProtocolError ChunkedTransfer::handle_update_begin(
 
     if (success)
     {
-        if (!callbacks->prepare_for_firmware_update(file, 0, NULL))
+        if (!callbacks->prepare_for_firmware_update(file, resume ? 2 : 0, resume ? checkpoint.bitmap : NULL))
         {
-            DEBUG("starting file length %d chunks %d chunk_size %d",
+            DEBUG("starting file length %d chunks %d chunk_size %d resume %d",
                     file.file_length, file.chunk_count(file.chunk_size),
-                    file.chunk_size);
+                    file.chunk_size, resume);
             last_chunk_millis = callbacks->millis();
             chunk_index = 0;
             chunk_size = file.chunk_size; // save chunk size since the descriptor size is overwritten
             updating = 1;
             Message updateReady;
             channel.create(updateReady);
-            // updateReady will have the maximum capacity
-            int offset = updateReady.capacity() - chunk_bitmap_size();
-            bitmap = queue+offset; // this relies on the fact that we know the channels use a static buffer
-
-            // when not in fast OTA mode, the chunk missing buffer is set to 1 since the protocol
-            // handles missing chunks one by one. Also we don't know the actual size of the file to
-            // know the correct size of the bitmap.
-            set_chunks_received(flags & 1 ? 0 : 0xFF);
+            if (resume)
+            {
+                bitmap = checkpoint.bitmap;
+            }
+            else if (image_id && (flags & 1) && file.chunk_count(chunk_size) <= MAX_RESUMABLE_CHUNKS)
+            {
+                // keep the received chunks in the checkpoint so that the transfer can be resumed
+                checkpoint = Checkpoint();
+                checkpoint.chunk_size = chunk_size;
+                checkpoint.image_id = image_id;
+                checkpoint.file = file;
+                bitmap = checkpoint.bitmap;
+                unsaved_chunks = 0;
+            }
+            else
+            {
+                // updateReady will have the maximum capacity
+                int offset = updateReady.capacity() - chunk_bitmap_size();
+                bitmap = queue+offset; // this relies on the fact that we know the channels use a static buffer
+
+                // when not in fast OTA mode, the chunk missing buffer is set to 1 since the protocol
+                // handles missing chunks one by one. Also we don't know the actual size of the file to
+                // know the correct size of the bitmap.
+                set_chunks_received(flags & 1 ? 0 : 0xFF);
+            }
 
-            // send update_reaady - use fast OTA if available
-            size_t size = Messages::update_ready(updateReady.buf(), 0, token, (flags & 0x1), channel.is_unreliable());
+            // send update_reaady - use fast OTA if available, and flag that the server should
+            // only send the chunks requested by the device when resuming
+            size_t size = Messages::update_ready(updateReady.buf(), 0, token, (flags & 0x1) | (resume ? 0x2 : 0),
+                    channel.is_unreliable());
             updateReady.set_length(size);
             updateReady.set_confirm_received(true);
             error = channel.send(updateReady);
             if (error)
                 DEBUG("error sending updateReady");
+            else if (resume)
+            {
+                updating = 2;       // flag that we are sending missing chunks.
+                error = send_missing_chunks(channel, MISSED_CHUNKS_TO_SEND);
+            }
         }
     }
     return error;
@@ -170,7 +202,7 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
         const uint8_t* chunk = queue + payload;
         file.chunk_size = message.length() - payload;
         file.chunk_address = file.file_address + (chunk_index * chunk_size);
-        if (chunk_index >= MAX_CHUNKS)
+        if (chunk_index >= MAX_CHUNKS || (is_resumable() && chunk_index >= file.chunk_count(chunk_size)))
         {
             WARN("invalid chunk index %d", chunk_index);
             return NO_ERROR;
@@ -188,8 +220,25 @@ ProtocolError ChunkedTransfer::handle_chunk(token_t token, Message& message,
                 // message is confirmable for regular OTA or when
                 response_size = Messages::chunk_received(response.buf(), 0, token, ChunkReceivedCode::OK, channel.is_unreliable());
             }
+            bool checkpoint_due = false;
+            if (is_resumable() && !is_chunk_received(chunk_index))
+            {
+                if (file.chunk_size == chunk_length(chunk_index))
+                {
+                    checkpoint.staged_crc ^= chunk_checksum(chunk_index, crc);
+                    checkpoint_due = ++unsaved_chunks >= CHUNKS_PER_CHECKPOINT;
+                }
+                else
+                {
+                    // the staged data couldn't be verified
+                    WARN("unexpected chunk size %d - transfer cannot be resumed", file.chunk_size);
+                    clear_checkpoint();
+                }
+            }
             flag_chunk_received(chunk_index);
             chunk_index++;
+            if (checkpoint_due)
+                save_checkpoint();
         }
         else
         {
@@ -274,6 +323,8 @@ ProtocolError ChunkedTransfer::handle_update_done(token_t token, Message& messag
     {
         DEBUG("update done - all done!");
         reset_updating();
+        if (is_resumable())
+            clear_checkpoint();
         callbacks->finish_firmware_update(file, UpdateFlag::SUCCESS, NULL);
     }
     else
@@ -342,12 +393,107 @@ void ChunkedTransfer::cancel()
 {
     if (is_updating())
     {
+        if (is_resumable())
+        {
+            // keep the received chunks so that the transfer can be resumed in a later session
+            WARN("handle received message failed - suspending transfer");
+            save_checkpoint();
+        }
+        else
+        {
+            WARN("handle received message failed - aborting transfer");
+        }
         // was updating but had an error, inform the client
-        WARN("handle received message failed - aborting transfer");
         callbacks->finish_firmware_update(file, 0, NULL);
     }
 }
 
+bool ChunkedTransfer::load_checkpoint()
+{
+    if (!checkpoint.image_id && !checkpoint_restored)
+    {
+        // the checkpoint is restored once, after a reboot
+        checkpoint_restored = true;
+        Checkpoint restored;
+        if (callbacks->restore_checkpoint(&restored, sizeof(restored)) == int(sizeof(restored)) &&
+                restored.size == sizeof(restored) && restored.image_id &&
+                restored.crc == callbacks->calculate_crc((const uint8_t*)&restored, sizeof(restored) - sizeof(restored.crc)))
+        {
+            checkpoint = restored;
+        }
+    }
+    return checkpoint.image_id;
+}
+
+void ChunkedTransfer::save_checkpoint()
+{
+    checkpoint.crc = callbacks->calculate_crc((const uint8_t*)&checkpoint, sizeof(checkpoint) - sizeof(checkpoint.crc));
+    if (callbacks->save_checkpoint(&checkpoint, sizeof(checkpoint)))
+        DEBUG("unable to save the transfer checkpoint");
+    unsaved_chunks = 0;
+}
+
+void ChunkedTransfer::clear_checkpoint()
+{
+    // the bitmap of the current transfer is still used, only the persisted checkpoint is invalidated
+    checkpoint.image_id = 0;
+    save_checkpoint();
+}
+
+bool ChunkedTransfer::can_resume(uint32_t image_id, uint8_t flags, MessageChannel& channel)
+{
+    if (!load_checkpoint())
+        return false;
+    const FileTransfer::Descriptor& saved = checkpoint.file;
+    bool resume = image_id == checkpoint.image_id && (flags & 1) &&
+            file.chunk_size == checkpoint.chunk_size && file.file_length == saved.file_length &&
+            file.file_address == saved.file_address && file.store == saved.store;
+    if (resume)
+    {
+        chunk_size = checkpoint.chunk_size;
+        bitmap = checkpoint.bitmap;
+        resume = verify_staged_chunks(channel);
+        file.chunk_size = chunk_size;
+        // the address is relative to the staging area again when the update is prepared
+        file.chunk_address = saved.chunk_address;
+    }
+    if (resume)
+    {
+        LOG(INFO, "Resuming transfer of image %x", image_id);
+        unsaved_chunks = 0;
+    }
+    else
+    {
+        // a different image is sent or the staged data was modified
+        LOG(INFO, "Discarding interrupted transfer of image %x", checkpoint.image_id);
+        bitmap = nullptr;
+        clear_checkpoint();
+    }
+    return resume;
+}
+
+bool ChunkedTransfer::verify_staged_chunks(MessageChannel& channel)
+{
+    Message message;
+    if (channel.create(message) || message.capacity() < chunk_size)
+        return false;
+    uint8_t* buf = message.buf();
+    uint32_t crc = 0;
+    chunk_index_t chunks = file.chunk_count(chunk_size);
+    for (chunk_index_t idx = 0; idx < chunks; idx++)
+    {
+        if (is_chunk_received(idx))
+        {
+            file.chunk_size = chunk_length(idx);
+            file.chunk_address = file.file_address + (idx * chunk_size);
+            if (callbacks->read_firmware_chunk(file, buf, NULL))
+                return false;
+            crc ^= chunk_checksum(idx, callbacks->calculate_crc(buf, file.chunk_size));
+        }
+    }
+    return crc == checkpoint.staged_crc;
+}
+
 
 chunk_index_t ChunkedTransfer::next_chunk_missing(chunk_index_t start)
 {
@@ -24,6 +24,7 @@
 #include "message_channel.h"
 #include "system_tick_hal.h"
 #include "messages.h"
+#include <algorithm>
 
 namespace particle
 {
@@ -43,7 +44,8 @@ public:
 	struct Callbacks
 	{
 		  /**
-		   * @param flags 1 dry run only.
+		   * @param flags 1 dry run only. 2 resume an interrupted transfer, keeping the staged data.
+		   * When resuming, the last argument is the bitmap of the staged chunks.
 		   * Return 0 on success.
 		   */
 		  virtual int prepare_for_firmware_update(FileTransfer::Descriptor& data, uint32_t flags, void*)=0;
@@ -64,6 +66,54 @@ public:
 		  virtual uint32_t calculate_crc(const unsigned char *buf, uint32_t buflen)=0;
 
 		  virtual system_tick_t millis()=0;
+
+		  /**
+		   * Reads back a chunk stored with save_firmware_chunk().
+		   * @return 0 on success
+		   */
+		  virtual int read_firmware_chunk(FileTransfer::Descriptor& descriptor, unsigned char* chunk, void*)=0;
+
+		  /**
+		   * Persists the transfer checkpoint.
+		   * @return 0 on success
+		   */
+		  virtual int save_checkpoint(const void* data, size_t length)=0;
+
+		  /**
+		   * Restores the transfer checkpoint.
+		   * @return the number of bytes restored
+		   */
+		  virtual int restore_checkpoint(void* data, size_t max_length)=0;
+	};
+
+	/**
+	 * State of a transfer that is kept across sessions and reboots so that an interrupted
+	 * transfer can be resumed. Only fast OTA transfers of images identified by the server
+	 * are checkpointed.
+	 */
+	struct Checkpoint
+	{
+		uint16_t size;
+		uint16_t chunk_size;
+		/**
+		 * The image ID given in UpdateBegin. 0 if there's no checkpoint.
+		 */
+		uint32_t image_id;
+		FileTransfer::Descriptor file;
+		/**
+		 * Combined checksum of the received chunks, used to verify the staged data.
+		 */
+		uint32_t staged_crc;
+		uint8_t bitmap[MAX_RESUMABLE_CHUNKS / 8];
+		/**
+		 * CRC of the preceding fields.
+		 */
+		uint32_t crc;
+
+		Checkpoint() :
+				size(sizeof(*this)), chunk_size(0), image_id(0), staged_crc(0), bitmap(), crc(0)
+		{
+		}
 	};
 
 private:
@@ -90,6 +140,13 @@ private:
 	bool fast_ota_override;
 	bool fast_ota_value;
 
+	Checkpoint checkpoint;
+	/**
+	 * Number of chunks received since the checkpoint was last saved.
+	 */
+	chunk_index_t unsaved_chunks;
+	bool checkpoint_restored;
+
 protected:
 
 	unsigned chunk_bitmap_size()
@@ -113,12 +170,41 @@ protected:
 		return (chunk_bitmap()[idx >> 3] & uint8_t(1 << (idx & 7)));
 	}
 
+	/**
+	 * Determines if the current transfer keeps its state in the checkpoint.
+	 */
+	bool is_resumable()
+	{
+		return checkpoint.image_id && bitmap == checkpoint.bitmap;
+	}
+
+	/**
+	 * Size of the given chunk, taking into account the last chunk of the file may be shorter.
+	 */
+	unsigned chunk_length(chunk_index_t idx)
+	{
+		return std::min<uint32_t>(chunk_size, file.file_length - idx * chunk_size);
+	}
+
+	static uint32_t chunk_checksum(chunk_index_t idx, uint32_t crc)
+	{
+		return crc ^ (idx * 2654435761u);
+	}
+
 	chunk_index_t next_chunk_missing(chunk_index_t start);
 	void set_chunks_received(uint8_t value);
+
+	bool load_checkpoint();
+	void save_checkpoint();
+	void clear_checkpoint();
+	bool can_resume(uint32_t image_id, uint8_t flags, MessageChannel& channel);
+	bool verify_staged_chunks(MessageChannel& channel);
+
 public:
 
 	ChunkedTransfer() :
-			updating(false), callbacks(nullptr), fast_ota_override(false), fast_ota_value(true)
+			updating(false), bitmap(nullptr), callbacks(nullptr), fast_ota_override(false), fast_ota_value(true),
+			unsaved_chunks(0), checkpoint_restored(false)
 	{
 	}
 
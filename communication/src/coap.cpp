@@ -88,5 +88,102 @@ size_t CoAP::option_decode(unsigned char **option) {
     return option_length;
 }
 
+namespace {
+
+// Decodes an option delta or length. Returns false if the value is reserved or exceeds the message
+bool decode_option_field(uint8_t nibble, const uint8_t** p, const uint8_t* end, size_t* value) {
+    if (nibble < 13) {
+        *value = nibble;
+    } else if (nibble == 13) {
+        if (*p + 1 > end) {
+            return false;
+        }
+        *value = **p + 13;
+        *p += 1;
+    } else if (nibble == 14) {
+        if (*p + 2 > end) {
+            return false;
+        }
+        *value = ((*p)[0] << 8 | (*p)[1]) + 269;
+        *p += 2;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+const uint8_t* CoAP::find_option(const uint8_t* buf, size_t length, CoAPOption::Enum option,
+        size_t* option_length, unsigned index) {
+    if (length < 4) {
+        return nullptr;
+    }
+    const uint8_t* const end = buf + length;
+    const uint8_t* p = buf + 4 + (buf[0] & 0x0F); // Skip header and token
+    unsigned number = 0;
+    while (p < end && *p != 0xFF) { // 0xFF is the payload marker
+        const uint8_t b = *p++;
+        size_t delta = 0, len = 0;
+        if (!decode_option_field(b >> 4, &p, end, &delta) || !decode_option_field(b & 0x0F, &p, end, &len) ||
+                p + len > end) {
+            return nullptr; // Malformed message
+        }
+        number += delta;
+        if (number == (unsigned)option) {
+            if (index == 0) {
+                *option_length = len;
+                return p;
+            }
+            --index;
+        } else if (number > (unsigned)option) {
+            break; // Options are sorted by their numbers
+        }
+        p += len;
+    }
+    return nullptr;
+}
+
+const uint8_t* CoAP::find_payload(const uint8_t* buf, size_t length, size_t* payload_length) {
+    if (length < 4) {
+        return nullptr;
+    }
+    const uint8_t* const end = buf + length;
+    const uint8_t* p = buf + 4 + (buf[0] & 0x0F); // Skip header and token
+    while (p < end && *p != 0xFF) {
+        const uint8_t b = *p++;
+        size_t delta = 0, len = 0;
+        if (!decode_option_field(b >> 4, &p, end, &delta) || !decode_option_field(b & 0x0F, &p, end, &len) ||
+                p + len > end) {
+            return nullptr; // Malformed message
+        }
+        p += len;
+    }
+    if (p + 1 >= end) {
+        return nullptr; // No payload
+    }
+    *payload_length = end - p - 1;
+    return p + 1;
+}
+
+uint32_t CoAP::option_uint(const uint8_t* value, size_t length) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < length && i < 4; ++i) {
+        v = (v << 8) | value[i];
+    }
+    return v;
+}
+
+size_t CoAP::encode_option_uint(uint8_t* buf, uint32_t value) {
+    size_t n = 0;
+    for (uint32_t v = value; v; v >>= 8) {
+        ++n;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        buf[i] = value >> ((n - i - 1) * 8);
+    }
+    return n;
+}
+
 }
 }
@@ -108,6 +108,7 @@ namespace CoAPCode {
 namespace CoAPOption {
 	enum Enum {
 		NONE = 0,
+		OBSERVE = 6,
 		LOCATION_PATH = 8,
 		URI_PATH = 11,
 		URI_QUERY = 15
@@ -188,6 +189,38 @@ public:
     static CoAPType::Enum type(const unsigned char *message);
     static size_t option_decode(unsigned char **option);
 
+    /**
+     * Finds an option in a CoAP message.
+     * @param buf The message.
+     * @param length The length of the message.
+     * @param option The option number.
+     * @param option_length Receives the length of the option value.
+     * @param index The occurrence of a repeatable option to find (0 for the first one).
+     * @return Pointer to the option value, or nullptr if the option is not present or the message is malformed.
+     */
+    static const uint8_t* find_option(const uint8_t* buf, size_t length, CoAPOption::Enum option,
+            size_t* option_length, unsigned index=0);
+
+    /**
+     * Finds the payload of a CoAP message.
+     * @param buf The message.
+     * @param length The length of the message.
+     * @param payload_length Receives the length of the payload.
+     * @return Pointer to the payload, or nullptr if the message has no payload or is malformed.
+     */
+    static const uint8_t* find_payload(const uint8_t* buf, size_t length, size_t* payload_length);
+
+    /**
+     * Decodes an unsigned integer option value.
+     */
+    static uint32_t option_uint(const uint8_t* value, size_t length);
+
+    /**
+     * Encodes an unsigned integer option value using the minimum number of bytes.
+     * Returns the length of the encoded value (0 to 4 bytes).
+     */
+    static size_t encode_option_uint(uint8_t* buf, uint32_t value);
+
     /**
      * Computes the length indicator for a value encoded in CoAP.
      * Values less than 13 are encoded directly. Values between 13 and 268 (inclusive) are encoded as 13 (and later as a single byte extended option)
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "protocol_defs.h"
+#include "spark_descriptor.h"
+#include "appender.h"
+
+#include <cstring>
+
+namespace particle
+{
+namespace protocol
+{
+
+/**
+ * Entry hashes are 32-bit FNV-1a hashes of a single character entry type followed by the entry
+ * data:
+ *
+ * - 'f' and the function name,
+ * - 'v', the variable name, ':' and the variable type as a decimal digit,
+ * - 'm' and the JSON text of a module entry of the system describe,
+ * - 's' and the remaining JSON text of the system describe with module entries and the
+ *   separators between them omitted.
+ */
+const uint32_t DESCRIBE_HASH_INIT = 2166136261u;
+
+inline uint32_t describe_hash(uint32_t hash, uint8_t c)
+{
+	return (hash ^ c) * 16777619u;
+}
+
+inline uint32_t describe_hash(uint32_t hash, const void* data, size_t size)
+{
+	const uint8_t* d = (const uint8_t*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = describe_hash(hash, d[i]);
+	}
+	return hash;
+}
+
+/**
+ * Entry hashes of a describe message.
+ */
+class DescribeSnapshot
+{
+public:
+	static const unsigned MAX_ENTRIES = 32;
+
+	DescribeSnapshot()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		count = 0;
+		module_begin = 0;
+		module_count = 0;
+		overflowed = false;
+	}
+
+	void add(uint32_t hash)
+	{
+		if (count < MAX_ENTRIES)
+		{
+			entries[count++] = hash;
+		}
+		else
+		{
+			overflowed = true;
+		}
+	}
+
+	bool contains(uint32_t hash) const
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			if (entries[i] == hash)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * Returns the checksum of the describe: the FNV-1a hash of the entry hashes sorted in
+	 * ascending order, each encoded as 4 big-endian bytes.
+	 */
+	uint32_t checksum() const
+	{
+		uint32_t sorted[MAX_ENTRIES];
+		memcpy(sorted, entries, count * sizeof(uint32_t));
+		for (unsigned i = 1; i < count; ++i)
+		{
+			const uint32_t h = sorted[i];
+			unsigned j = i;
+			for (; j > 0 && sorted[j - 1] > h; --j)
+			{
+				sorted[j] = sorted[j - 1];
+			}
+			sorted[j] = h;
+		}
+		uint32_t hash = DESCRIBE_HASH_INIT;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const uint8_t b[4] = { uint8_t(sorted[i] >> 24), uint8_t(sorted[i] >> 16), uint8_t(sorted[i] >> 8), uint8_t(sorted[i]) };
+			hash = describe_hash(hash, b, sizeof(b));
+		}
+		return hash;
+	}
+
+	/**
+	 * Module entries are stored in the order in which they appear in the system describe.
+	 */
+	uint32_t module_hash(unsigned index) const
+	{
+		return entries[module_begin + index];
+	}
+
+	uint32_t entries[MAX_ENTRIES];
+	uint8_t count;
+	uint8_t module_begin;
+	uint8_t module_count;
+	bool overflowed;
+};
+
+/**
+ * Splits the system describe into module entries and the remaining data as the describe is
+ * being generated, and optionally forwards the selected module entries to another appender.
+ *
+ * Module entries are the objects found directly in a top-level array of the system describe.
+ */
+class DescribeModuleScanner : public Appender
+{
+public:
+	DescribeModuleScanner(DescribeSnapshot* snapshot, Appender* out = nullptr, uint32_t module_mask = 0) :
+			snapshot(snapshot),
+			out(out),
+			module_mask(module_mask),
+			system_hash(describe_hash(DESCRIBE_HASH_INIT, 's')),
+			entry_hash(0),
+			depth(0),
+			entry_depth(0),
+			module_index(0),
+			in_array(false),
+			in_string(false),
+			escaped(false),
+			written(false)
+	{
+		if (snapshot)
+		{
+			snapshot->module_begin = snapshot->count;
+		}
+	}
+
+	bool append(const uint8_t* data, size_t size) override
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			process(data[i]);
+		}
+		return true;
+	}
+
+	/**
+	 * Adds the hash of the data outside the module entries to the snapshot.
+	 */
+	void finish()
+	{
+		if (snapshot)
+		{
+			snapshot->add(system_hash);
+		}
+	}
+
+private:
+	DescribeSnapshot* snapshot;
+	Appender* out;
+	uint32_t module_mask;
+	uint32_t system_hash;
+	uint32_t entry_hash;
+	unsigned depth;
+	unsigned entry_depth; // Nesting level within a module entry, 0 if outside of an entry
+	unsigned module_index;
+	bool in_array; // The top-level container is an array
+	bool in_string;
+	bool escaped;
+	bool written; // A module entry has been forwarded
+
+	bool selected() const
+	{
+		return out && module_index < 32 && (module_mask & (1u << module_index));
+	}
+
+	void process(uint8_t c)
+	{
+		if (!entry_depth && !in_string && depth == 1 && in_array)
+		{
+			if (c == '{')
+			{
+				// Beginning of a module entry
+				entry_depth = 1;
+				entry_hash = describe_hash(describe_hash(DESCRIBE_HASH_INIT, 'm'), c);
+				if (selected())
+				{
+					if (written)
+					{
+						out->append(',');
+					}
+					out->append(c);
+					written = true;
+				}
+				return;
+			}
+			if (c == ',')
+			{
+				return; // Separator between module entries
+			}
+		}
+		bool string_char = in_string;
+		if (in_string)
+		{
+			if (escaped)
+			{
+				escaped = false;
+			}
+			else if (c == '\\')
+			{
+				escaped = true;
+			}
+			else if (c == '"')
+			{
+				in_string = false;
+			}
+		}
+		else if (c == '"')
+		{
+			in_string = true;
+			string_char = true;
+		}
+		if (entry_depth)
+		{
+			entry_hash = describe_hash(entry_hash, c);
+			if (selected())
+			{
+				out->append(c);
+			}
+			if (!string_char)
+			{
+				if (c == '{' || c == '[')
+				{
+					++entry_depth;
+				}
+				else if ((c == '}' || c == ']') && !--entry_depth)
+				{
+					// End of the module entry
+					if (snapshot)
+					{
+						snapshot->add(entry_hash);
+						++snapshot->module_count;
+					}
+					++module_index;
+				}
+			}
+			return;
+		}
+		system_hash = describe_hash(system_hash, c);
+		if (!string_char)
+		{
+			if (c == '{' || c == '[')
+			{
+				if (depth++ == 0)
+				{
+					in_array = (c == '[');
+				}
+			}
+			else if ((c == '}' || c == ']') && depth)
+			{
+				--depth;
+			}
+		}
+	}
+};
+
+/**
+ * Tracks the describe state known to the server and produces delta describe messages.
+ *
+ * The server requests a delta describe by setting the {@code DESCRIBE_DELTA} flag and passing the
+ * checksum of the describe it currently has as the base. If the base matches the last describe
+ * sent by the device, or the one before it that the server has already confirmed, the device
+ * replies with the differences from that describe:
+ *
+ * <pre>
+ * {"b":base,"c":checksum,"f":[added functions],"v":{added variables},"m":[added modules],"r":[removed entry hashes]}
+ * </pre>
+ *
+ * Empty fields are omitted. A changed variable type or module entry is reported as a removed
+ * entry and an added one. Otherwise, the device replies with a full describe that additionally
+ * contains the checksum in the "c" field. The server requests a full describe if the checksum
+ * of the describe it reconstructs doesn't match the one reported by the device.
+ */
+class DescribeState
+{
+public:
+	DescribeState() :
+			sent_valid(false),
+			confirmed_valid(false)
+	{
+	}
+
+	/**
+	 * Computes the entry hashes of the current describe.
+	 */
+	static void snapshot(const SparkDescriptor& descriptor, DescribeSnapshot* snapshot)
+	{
+		snapshot->clear();
+		const int num_functions = descriptor.num_functions();
+		for (int i = 0; i < num_functions; ++i)
+		{
+			snapshot->add(function_hash(descriptor.get_function_key(i)));
+		}
+		const int num_variables = descriptor.num_variables();
+		for (int i = 0; i < num_variables; ++i)
+		{
+			const char* key = descriptor.get_variable_key(i);
+			snapshot->add(variable_hash(key, descriptor.variable_type(key)));
+		}
+		DescribeModuleScanner scanner(snapshot);
+		if (descriptor.append_system_info)
+		{
+			descriptor.append_system_info(append_instance, &scanner, nullptr);
+		}
+		scanner.finish();
+	}
+
+	/**
+	 * Writes a delta describe message.
+	 *
+	 * @param descriptor The descriptor.
+	 * @param current The entry hashes of the current describe.
+	 * @param base The checksum of the describe known to the server.
+	 * @param appender The destination appender.
+	 * @return {@code false} if the delta can't be produced, in which case a full describe needs
+	 *         to be sent instead.
+	 */
+	bool build_delta(const SparkDescriptor& descriptor, const DescribeSnapshot& current, uint32_t base, Appender& appender)
+	{
+		if (sent_valid && base == sent.checksum())
+		{
+			// The server has confirmed the last describe
+			confirmed = sent;
+			confirmed_valid = true;
+		}
+		if (!confirmed_valid || base != confirmed.checksum() || current.overflowed || current.module_count > 32)
+		{
+			return false;
+		}
+		const DescribeSnapshot& prev = confirmed;
+		if (!prev.contains(current.entries[current.count - 1]))
+		{
+			return false; // The system describe has changed outside of the module entries
+		}
+		appender.append("{\"b\":");
+		append_uint(appender, base);
+		appender.append(",\"c\":");
+		append_uint(appender, current.checksum());
+
+		bool first = true;
+		const int num_functions = descriptor.num_functions();
+		for (int i = 0; i < num_functions; ++i)
+		{
+			const char* key = descriptor.get_function_key(i);
+			if (!prev.contains(function_hash(key)))
+			{
+				appender.append(first ? ",\"f\":[\"" : ",\"");
+				appender.append((const uint8_t*)key, key_length(key, MAX_FUNCTION_KEY_LENGTH));
+				appender.append('"');
+				first = false;
+			}
+		}
+		if (!first)
+		{
+			appender.append(']');
+		}
+
+		first = true;
+		const int num_variables = descriptor.num_variables();
+		for (int i = 0; i < num_variables; ++i)
+		{
+			const char* key = descriptor.get_variable_key(i);
+			const SparkReturnType::Enum type = descriptor.variable_type(key);
+			if (!prev.contains(variable_hash(key, type)))
+			{
+				appender.append(first ? ",\"v\":{\"" : ",\"");
+				appender.append((const uint8_t*)key, key_length(key, MAX_VARIABLE_KEY_LENGTH));
+				appender.append("\":");
+				appender.append('0' + (char)type);
+				first = false;
+			}
+		}
+		if (!first)
+		{
+			appender.append('}');
+		}
+
+		uint32_t module_mask = 0;
+		for (unsigned i = 0; i < current.module_count; ++i)
+		{
+			if (!prev.contains(current.module_hash(i)))
+			{
+				module_mask |= (1u << i);
+			}
+		}
+		if (module_mask)
+		{
+			appender.append(",\"m\":[");
+			DescribeModuleScanner scanner(nullptr, &appender, module_mask);
+			descriptor.append_system_info(append_instance, &scanner, nullptr);
+			appender.append(']');
+		}
+
+		first = true;
+		for (unsigned i = 0; i < prev.count; ++i)
+		{
+			if (!current.contains(prev.entries[i]))
+			{
+				appender.append(first ? ",\"r\":[" : ",");
+				append_uint(appender, prev.entries[i]);
+				first = false;
+			}
+		}
+		if (!first)
+		{
+			appender.append(']');
+		}
+		appender.append('}');
+		return true;
+	}
+
+	/**
+	 * Records the describe that has been sent to the server.
+	 */
+	void sent_describe(const DescribeSnapshot& snapshot)
+	{
+		if (snapshot.overflowed)
+		{
+			sent_valid = false;
+			return;
+		}
+		sent = snapshot;
+		sent_valid = true;
+	}
+
+	void reset()
+	{
+		sent_valid = false;
+		confirmed_valid = false;
+	}
+
+	static void append_uint(Appender& appender, uint32_t val)
+	{
+		char buf[10];
+		size_t n = 0;
+		do
+		{
+			buf[sizeof(buf) - ++n] = '0' + val % 10;
+			val /= 10;
+		} while (val);
+		appender.append((const uint8_t*)buf + sizeof(buf) - n, n);
+	}
+
+	static uint32_t function_hash(const char* key)
+	{
+		return describe_hash(describe_hash(DESCRIBE_HASH_INIT, 'f'), key, key_length(key, MAX_FUNCTION_KEY_LENGTH));
+	}
+
+	static uint32_t variable_hash(const char* key, SparkReturnType::Enum type)
+	{
+		uint32_t hash = describe_hash(describe_hash(DESCRIBE_HASH_INIT, 'v'), key, key_length(key, MAX_VARIABLE_KEY_LENGTH));
+		hash = describe_hash(hash, ':');
+		return describe_hash(hash, '0' + (char)type);
+	}
+
+private:
+	DescribeSnapshot sent;
+	DescribeSnapshot confirmed;
+	bool sent_valid;
+	bool confirmed_valid;
+
+	static size_t key_length(const char* key, size_t max_length)
+	{
+		return strnlen(key, max_length);
+	}
+};
+
+} // namespace protocol
+} // namespace particle
@@ -4,6 +4,8 @@
 
 #include "eckeygen.h"
 
+#include <algorithm>
+
 namespace particle { namespace protocol {
 
 void DTLSProtocol::init(const char *id,
@@ -65,12 +67,17 @@ int DTLSProtocol::wait_confirmable(uint32_t timeout)
 			(millis() - start) <= 1000)
 	{
 		CoAPMessageType::Enum message;
-		err = event_loop(message);
+		bool received = false;
+		err = event_loop(message, received);
 		if (err)
 		{
 			LOG(WARN, "error receiving acknowledgements: %d", err);
 			break;
 		}
+		if (!received)
+		{
+			wait_readable(timeout - std::min<system_tick_t>(timeout, millis() - start));
+		}
 	}
 	LOG(INFO, "All Confirmed messages sent: client(%s) server(%s)",
 		channel.client_messages().has_messages() ? "no" : "yes",
@@ -79,17 +79,20 @@ public:
 		{
 		case ProtocolCommands::SLEEP:
 			result = wait_confirmable();
+			// Keep the events published until the device wakes up in the queue
+			publisher.set_online(false);
 			break;
 		case ProtocolCommands::DISCONNECT:
 			result = wait_confirmable();
 			ack_handlers.clear();
+			publisher.set_online(false);
 			break;
 		case ProtocolCommands::WAKE:
-			wake();
-			result = NO_ERROR;
+			result = wake();
 			break;
 		case ProtocolCommands::TERMINATE:
 			ack_handlers.clear();
+			publisher.set_online(false);
 			result = NO_ERROR;
 			break;
 		case ProtocolCommands::FORCE_PING: {
@@ -112,9 +115,9 @@ public:
 	 */
 	int wait_confirmable(uint32_t timeout=60000);
 
-	void wake()
+	int wake()
 	{
-		ping();
+		return resume_session();
 	}
 };
 
@@ -86,6 +86,58 @@ size_t subscription(uint8_t buf[], uint16_t message_id,
   return p - buf;
 }
 
+size_t bulk_subscription_header(uint8_t buf[], uint16_t message_id)
+{
+  uint8_t *p = buf;
+  *p++ = 0x40; // confirmable, no token
+  *p++ = 0x01; // code 0.01 GET request
+  *p++ = message_id >> 8;
+  *p++ = message_id & 0xff;
+  *p++ = 0xb1; // one-byte Uri-Path option
+  *p++ = 'e';
+  *p++ = 0x41; // one-byte Uri-Query option
+  *p++ = 'b';
+  *p++ = 0xff; // payload marker
+  return p - buf;
+}
+
+size_t bulk_subscription_entry(uint8_t buf[], const char *event_name,
+                               const char *device_id, SubscriptionScope::Enum scope)
+{
+  const size_t name_len = event_name ? strnlen(event_name, 63) : 0;
+  const size_t id_len = device_id ? strnlen(device_id, 63) : 0;
+  uint8_t flags = 0;
+  if (id_len)
+  {
+    flags |= BulkSubscriptionFlag::DEVICE_ID;
+  }
+  else if (scope == SubscriptionScope::MY_DEVICES)
+  {
+    flags |= BulkSubscriptionFlag::MY_DEVICES;
+  }
+  else if (0 == name_len)
+  {
+    // unfiltered firehose is not allowed
+    return 0;
+  }
+
+  uint8_t *p = buf;
+  *p++ = flags;
+  *p++ = name_len;
+  if (name_len)
+  {
+    memcpy(p, event_name, name_len);
+    p += name_len;
+  }
+  if (id_len)
+  {
+    *p++ = id_len;
+    memcpy(p, device_id, id_len);
+    p += id_len;
+  }
+  return p - buf;
+}
+
 size_t event_name_uri_path(uint8_t buf[], const char *name, size_t name_len)
 {
   if (0 == name_len)
@@ -96,4 +96,31 @@ size_t subscription(uint8_t buf[], uint16_t message_id,
 
 size_t event_name_uri_path(uint8_t buf[], const char *name, size_t name_len);
 
+/**
+ * Maximum size of an entry of a bulk subscription request.
+ */
+const size_t BULK_SUBSCRIPTION_MAX_ENTRY_SIZE = 1 + (1 + 63) + (1 + 63);
+
+/**
+ * Writes the header of a bulk subscription request (GET /e?b). The payload is a sequence
+ * of entries written with bulk_subscription_entry(). The response payload contains one
+ * result byte per entry, 0 indicating success.
+ */
+size_t bulk_subscription_header(uint8_t buf[], uint16_t message_id);
+
+/**
+ * Writes an entry of a bulk subscription request: a flags byte, followed by the length and
+ * contents of the filter and, if present, the length and contents of the device ID.
+ * Returns 0 if the subscription is not allowed.
+ */
+size_t bulk_subscription_entry(uint8_t buf[], const char *event_name,
+                               const char *device_id, SubscriptionScope::Enum scope);
+
+namespace BulkSubscriptionFlag {
+  enum Enum {
+    MY_DEVICES = 0x01,
+    DEVICE_ID = 0x02
+  };
+}
+
 #endif // __EVENTS_H
@@ -35,6 +35,19 @@ class Functions
 {
     char function_arg[MAX_FUNCTION_ARG_LENGTH];
 
+    /**
+     * The function call whose acknowledgement is deferred so that it can carry the result.
+     */
+    message_id_t pending_id;
+    token_t pending_token;
+    system_tick_t pending_time;
+    bool pending;
+
+    /**
+     * The maximum time in milliseconds the acknowledgement of a function call is deferred.
+     */
+    system_tick_t response_deadline;
+
     ProtocolError function_result(MessageChannel& channel, const void* result, SparkReturnType::Enum, token_t token)
     {
         Message message;
@@ -44,9 +57,96 @@ class Functions
         return channel.send(message);
     }
 
+    /**
+     * Sends the result of a function call in the acknowledgement of the request.
+     */
+    ProtocolError piggybacked_result(MessageChannel& channel, const void* result, token_t token, message_id_t message_id)
+    {
+        Message message;
+        channel.create(message, Messages::function_return_size);
+        const int value = long(result);
+        uint8_t data[4] = { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+        size_t length = Messages::coded_ack(message.buf(), token, CoAPCode::CHANGED, message_id >> 8, message_id & 0xff,
+                data, sizeof(data));
+        message.set_id(message_id);
+        message.set_length(length);
+        return channel.send(message);
+    }
+
+    ProtocolError send_pending_ack(MessageChannel& channel)
+    {
+        pending = false;
+        Message message;
+        channel.create(message, 4);
+        size_t length = Messages::empty_ack(message.buf(), pending_id >> 8, pending_id & 0xff);
+        message.set_id(pending_id);
+        message.set_length(length);
+        return channel.send(message);
+    }
+
 public:
+    static const system_tick_t DEFAULT_RESPONSE_DEADLINE = 50;
+    /**
+     * The maximum deadline. The server retransmits a request that isn't acknowledged within
+     * the CoAP ACK timeout (2 seconds), which would invoke the function again, so the deadline
+     * is kept well below it, leaving room for the network latency.
+     */
+    static const system_tick_t MAX_RESPONSE_DEADLINE = 500;
+
+    Functions() :
+            pending_id(0),
+            pending_token(0),
+            pending_time(0),
+            pending(false),
+            response_deadline(DEFAULT_RESPONSE_DEADLINE)
+    {
+    }
+
+    /**
+     * Sets the maximum time in milliseconds the acknowledgement of a function call is deferred
+     * waiting for the function to complete, so that the result can be sent in the acknowledgement.
+     * If the function takes longer, the result is sent in a separate response. 0 disables the
+     * deferral, in which case only the results that are available immediately are piggybacked.
+     * Values above `MAX_RESPONSE_DEADLINE` are clamped.
+     */
+    void set_response_deadline(system_tick_t deadline)
+    {
+        if (deadline > MAX_RESPONSE_DEADLINE)
+        {
+            deadline = MAX_RESPONSE_DEADLINE;
+        }
+        response_deadline = deadline;
+    }
+
+    system_tick_t get_response_deadline() const
+    {
+        return response_deadline;
+    }
+
+    /**
+     * Sends the deferred acknowledgement if the function hasn't completed in time.
+     */
+    ProtocolError process(MessageChannel& channel, system_tick_t now)
+    {
+        if (pending && now - pending_time >= response_deadline)
+        {
+            return send_pending_ack(channel);
+        }
+        return NO_ERROR;
+    }
+
+    /**
+     * Discards the deferred acknowledgement. The server retransmits the request if it was
+     * sent in a session that is no longer active.
+     */
+    void reset()
+    {
+        pending = false;
+    }
+
     ProtocolError handle_function_call(token_t token, message_id_t message_id, Message& message, MessageChannel& channel,
-            int (*call_function)(const char *function_key, const char *arg, SparkDescriptor::FunctionResultCallback callback, void* reserved))
+            int (*call_function)(const char *function_key, const char *arg, SparkDescriptor::FunctionResultCallback callback, void* reserved),
+            system_tick_t now)
     {
         // copy the function key
         char function_key[MAX_FUNCTION_KEY_LENGTH+1];
@@ -93,24 +193,54 @@ public:
             has_function = true;
         }
 
-        Message response;
-        channel.response(message, response, 16);
-        // send ACK
-        size_t response_length = Messages::coded_ack(response.buf(), has_function ? 0x00 : RESPONSE_CODE(4,00), 0, 0);
-        response.set_id(message_id);
-        response.set_length(response_length);
-        ProtocolError error = channel.send(response);
-        if (error) {
-            return error;
+        // Only one acknowledgement is deferred at a time
+        if (pending)
+        {
+            ProtocolError error = send_pending_ack(channel);
+            if (error) {
+                return error;
+            }
+        }
+
+        if (has_function)
+        {
+            // Defer the ACK, so that the result can be sent in it if the function completes quickly
+            pending = true;
+            pending_id = message_id;
+            pending_token = token;
+            pending_time = now;
+        }
+        else
+        {
+            Message response;
+            channel.response(message, response, 16);
+            // send ACK
+            size_t response_length = Messages::coded_ack(response.buf(), RESPONSE_CODE(4,00), 0, 0);
+            response.set_id(message_id);
+            response.set_length(response_length);
+            ProtocolError error = channel.send(response);
+            if (error) {
+                return error;
+            }
         }
 
         // call the given user function
         auto callback = [=,&channel] (const void* result, SparkReturnType::Enum resultType )
-            { return this->function_result(channel, result, resultType, token); };
+            {
+                if (this->pending && this->pending_id == message_id && this->pending_token == token)
+                {
+                    this->pending = false;
+                    return this->piggybacked_result(channel, result, token, message_id);
+                }
+                return this->function_result(channel, result, resultType, token);
+            };
         call_function(function_key, function_arg, callback, NULL);
+        if (pending && !response_deadline)
+        {
+            return send_pending_ack(channel);
+        }
         return NO_ERROR;
     }
 };
 
-
 }}
@@ -19,6 +19,17 @@ namespace particle
 namespace protocol
 {
 
+	namespace
+	{
+		// Maximum time to wait for the remaining data of a record or handshake message
+		const system_tick_t RECEIVE_TIMEOUT = 20000;
+
+		const size_t HANDSHAKE_NONCE_SIZE = 40;
+		const size_t HANDSHAKE_CIPHERTEXT_OFFSET = 52 + MAX_DEVICE_PUBLIC_KEY_LENGTH;
+		const size_t HANDSHAKE_CIPHERTEXT_SIZE = 256;
+		const size_t HANDSHAKE_KEY_SIZE = 384;
+	}
+
 	bool LightSSLMessageChannel::is_unreliable()
 	{
 		return false;
@@ -55,39 +66,104 @@ namespace protocol
 
 	ProtocolError LightSSLMessageChannel::receive(Message& message)
 	{
-		ProtocolError error = NO_ERROR;
-                // NB: use callbacks.receive() to return immediately, rather than blocking_receive()
-		int bytes_received = callbacks.receive(queue, 2, nullptr);
-		if (2 == bytes_received)
+		// NB: use callbacks.receive() to return immediately, rather than blocking_receive()
+		ProtocolError error = create(message, 0);
+		message.set_length(0);
+		if (error)
+			return error;
+
+		if (rx_header_length < sizeof(rx_header))
 		{
-			size_t packet_size = queue[0] << 8 | queue[1];
-			error = create(message, packet_size);
-			if (!error)
+			int bytes_received = callbacks.receive(rx_header + rx_header_length,
+					sizeof(rx_header) - rx_header_length, nullptr);
+			if (bytes_received < 0)
+			{
+				LOG(WARN,"receive error %d", bytes_received);
+				reset_receive();
+				return IO_ERROR_LIGHTSSL_RECEIVE;
+			}
+			rx_header_length += bytes_received;
+			if (rx_header_length < sizeof(rx_header))
+				return NO_ERROR;
+			rx_size = rx_header[0] << 8 | rx_header[1];
+			rx_offset = 0;
+			rx_time = callbacks.millis();
+			if (!rx_size || (rx_size & 15))
+			{
+				LOG(WARN,"invalid record size %u", (unsigned)rx_size);
+				reset_receive();
+				return MALFORMED_MESSAGE;
+			}
+			error = create(message, rx_size);
+			if (error)
 			{
-				uint8_t* buf = message.buf();
-				if (blocking_receive(buf, packet_size) < 0)
-					error = IO_ERROR_LIGHTSSL_BLOCKING_RECEIVE;
-				else
+				reset_receive();
+				return error;
+			}
+		}
+
+		int bytes_received = 0;
+		if (!rx_buffer)
+		{
+			// Try to receive the whole record directly into the message buffer
+			bytes_received = callbacks.receive(message.buf(), rx_size, nullptr);
+			if (bytes_received > 0 && (size_t)bytes_received < rx_size)
+			{
+				rx_buffer = (unsigned char*)malloc(rx_size);
+				if (!rx_buffer)
 				{
-					unsigned char next_iv[16];
-					memcpy(next_iv, buf, 16);
-					mbedtls_aes_setkey_dec(&aes, key, 128);
-					mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, packet_size, iv_receive, buf, buf);
-					memcpy(iv_receive, next_iv, 16);
-					message.set_length(packet_size-buf[packet_size-1]);
+					reset_receive();
+					return INSUFFICIENT_STORAGE;
 				}
+				memcpy(rx_buffer, message.buf(), bytes_received);
 			}
 		}
 		else
 		{
-			error = create(message, 0);
-			message.set_length(0);
-			if (bytes_received<0) {
-				LOG(WARN,"receive error %d", bytes_received);
-				error = IO_ERROR_LIGHTSSL_RECEIVE;
+			bytes_received = callbacks.receive(rx_buffer + rx_offset, rx_size - rx_offset, nullptr);
+		}
+		if (bytes_received < 0)
+		{
+			LOG(WARN,"receive error %d", bytes_received);
+			reset_receive();
+			return IO_ERROR_LIGHTSSL_BLOCKING_RECEIVE;
+		}
+		rx_offset += bytes_received;
+		if (rx_offset < rx_size)
+		{
+			if (callbacks.millis() - rx_time > RECEIVE_TIMEOUT)
+			{
+				LOG(WARN,"receive timeout");
+				reset_receive();
+				return IO_ERROR_LIGHTSSL_BLOCKING_RECEIVE;
 			}
+			return NO_ERROR;
 		}
-		return error;
+		if (rx_buffer)
+			memcpy(message.buf(), rx_buffer, rx_size);
+		decrypt_record(message, rx_size);
+		reset_receive();
+		return NO_ERROR;
+	}
+
+	void LightSSLMessageChannel::decrypt_record(Message& message, size_t size)
+	{
+		uint8_t* buf = message.buf();
+		unsigned char next_iv[16];
+		memcpy(next_iv, buf, 16);
+		mbedtls_aes_setkey_dec(&aes, key, 128);
+		mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, size, iv_receive, buf, buf);
+		memcpy(iv_receive, next_iv, 16);
+		message.set_length(size-buf[size-1]);
+	}
+
+	void LightSSLMessageChannel::reset_receive()
+	{
+		free(rx_buffer);
+		rx_buffer = nullptr;
+		rx_header_length = 0;
+		rx_size = 0;
+		rx_offset = 0;
 	}
 
 
@@ -151,89 +227,121 @@ namespace protocol
 	ProtocolError LightSSLMessageChannel::handshake()
 	{
 		LOG_CATEGORY("comm.lightssl.handshake");
-		LOG(INFO,"Started, receive nonce");
-		memcpy(queue + 40, device_id, 12);
-		int err = blocking_receive(queue, 40);
-		if (0 > err)
+		if (handshake_state == HANDSHAKE_IDLE)
 		{
-			LOG(ERROR,"Could not receive nonce: %d", err);
-			return IO_ERROR_LIGHTSSL_HANDSHAKE_NONCE;
+			LOG(INFO,"Started, receive nonce");
+			reset_receive();
+			set_handshake_state(HANDSHAKE_RECEIVE_NONCE);
 		}
-
-		LOG(INFO,"Encrypting nonce");
-		extract_public_rsa_key(queue + 52, core_private_key);
-
-		mbedtls_rsa_context rsa;
-		init_rsa_context_with_public_key(&rsa, server_public_key);
-		const int len = 52 + MAX_DEVICE_PUBLIC_KEY_LENGTH;
-		err = mbedtls_rsa_pkcs1_encrypt(&rsa, mbedtls_default_rng, nullptr, MBEDTLS_RSA_PUBLIC, len, queue, queue + len);
-		mbedtls_rsa_free(&rsa);
-
-		if (err)
-		{
-			LOG(ERROR,"RSA encrypt error %d", err);
-			return ENCRYPTION_ERROR;
-		}
-
-		LOG(INFO,"Sending encrypted nonce");
-		blocking_send(queue + len, 256);
-		LOG(INFO,"Receive key");
-		err = blocking_receive(queue, 384);
-		if (0 > err)
-		{
-			LOG(ERROR,"Unable to receive key %d", err);
-			return IO_ERROR_LIGHTSSL_HANDSHAKE_RECV_KEY;
-		}
-
-		LOG(INFO,"Setting key");
-		ProtocolError error = set_key(queue);
+		ProtocolError error = handshake_step();
 		if (error)
 		{
-			LOG(ERROR,"Could not set key, %d", error);
+			set_handshake_state(HANDSHAKE_IDLE);
 			return error;
 		}
-
+		if (handshake_state != HANDSHAKE_IDLE)
+			return HANDSHAKE_PENDING;
 		LOG(INFO,"Completed");
 		return NO_ERROR;
 	}
 
-	// Returns bytes sent or -1 on error
-	int LightSSLMessageChannel::blocking_send(const unsigned char *buf, int length)
+	ProtocolError LightSSLMessageChannel::handshake_step()
 	{
-		int bytes_or_error;
-		int byte_count = 0;
+		LOG_CATEGORY("comm.lightssl.handshake");
+		switch (handshake_state)
+		{
+		case HANDSHAKE_RECEIVE_NONCE:
+		{
+			int bytes_or_error = callbacks.receive(queue + handshake_offset,
+					HANDSHAKE_NONCE_SIZE - handshake_offset, nullptr);
+			if (bytes_or_error < 0 || (!bytes_or_error && callbacks.millis() - handshake_state_time > RECEIVE_TIMEOUT))
+			{
+				LOG(ERROR,"Could not receive nonce: %d", bytes_or_error);
+				return IO_ERROR_LIGHTSSL_HANDSHAKE_NONCE;
+			}
+			handshake_offset += bytes_or_error;
+			if (handshake_offset < HANDSHAKE_NONCE_SIZE)
+				return NO_ERROR;
 
-		system_tick_t _millis = callbacks.millis();
+			LOG(INFO,"Encrypting nonce");
+			memcpy(queue + HANDSHAKE_NONCE_SIZE, device_id, 12);
+			extract_public_rsa_key(queue + 52, core_private_key);
 
-		while (length > byte_count)
+			mbedtls_rsa_context rsa;
+			init_rsa_context_with_public_key(&rsa, server_public_key);
+			const int len = HANDSHAKE_CIPHERTEXT_OFFSET;
+			int err = mbedtls_rsa_pkcs1_encrypt(&rsa, mbedtls_default_rng, nullptr, MBEDTLS_RSA_PUBLIC, len, queue, queue + len);
+			mbedtls_rsa_free(&rsa);
+
+			if (err)
+			{
+				LOG(ERROR,"RSA encrypt error %d", err);
+				return ENCRYPTION_ERROR;
+			}
+
+			LOG(INFO,"Sending encrypted nonce");
+			set_handshake_state(HANDSHAKE_SEND_NONCE);
+			// The socket is normally writable, so don't wait for the next step to send
+			return handshake_step();
+		}
+
+		case HANDSHAKE_SEND_NONCE:
 		{
-			bytes_or_error = callbacks.send(buf + byte_count,
-					length - byte_count, nullptr);
-			if (0 > bytes_or_error)
+			int bytes_or_error = callbacks.send(queue + HANDSHAKE_CIPHERTEXT_OFFSET + handshake_offset,
+					HANDSHAKE_CIPHERTEXT_SIZE - handshake_offset, nullptr);
+			if (bytes_or_error < 0 || (!bytes_or_error && callbacks.millis() - handshake_state_time > RECEIVE_TIMEOUT))
 			{
-				// error, disconnected
-				LOG(WARN,"blocking send error %d", bytes_or_error);
-				return bytes_or_error;
+				LOG(ERROR,"Could not send encrypted nonce: %d", bytes_or_error);
+				return IO_ERROR_LIGHTSSL_BLOCKING_SEND;
 			}
-			else if (0 < bytes_or_error)
+			handshake_offset += bytes_or_error;
+			if (handshake_offset < HANDSHAKE_CIPHERTEXT_SIZE)
+				return NO_ERROR;
+
+			LOG(INFO,"Receive key");
+			set_handshake_state(HANDSHAKE_RECEIVE_KEY);
+			return NO_ERROR;
+		}
+
+		case HANDSHAKE_RECEIVE_KEY:
+		{
+			int bytes_or_error = callbacks.receive(queue + handshake_offset,
+					HANDSHAKE_KEY_SIZE - handshake_offset, nullptr);
+			if (bytes_or_error < 0 || (!bytes_or_error && callbacks.millis() - handshake_state_time > RECEIVE_TIMEOUT))
 			{
-				byte_count += bytes_or_error;
+				LOG(ERROR,"Unable to receive key %d", bytes_or_error);
+				return IO_ERROR_LIGHTSSL_HANDSHAKE_RECV_KEY;
 			}
-			else
+			handshake_offset += bytes_or_error;
+			if (handshake_offset < HANDSHAKE_KEY_SIZE)
+				return NO_ERROR;
+
+			LOG(INFO,"Setting key");
+			ProtocolError error = set_key(queue);
+			if (error)
 			{
-				if (20000 < (callbacks.millis() - _millis))
-				{
-					// timed out, disconnect
-					LOG(WARN,"blocking send timeout");
-					return -1;
-				}
+				LOG(ERROR,"Could not set key, %d", error);
+				return error;
 			}
+			set_handshake_state(HANDSHAKE_IDLE);
+			return NO_ERROR;
 		}
-		return byte_count;
+
+		case HANDSHAKE_IDLE:
+			break;
+		}
+		return NO_ERROR;
 	}
 
-	// Returns bytes received or -1 on error
-	int LightSSLMessageChannel::blocking_receive(unsigned char *buf, int length)
+	void LightSSLMessageChannel::set_handshake_state(HandshakeState state)
+	{
+		handshake_state = state;
+		handshake_offset = 0;
+		handshake_state_time = callbacks.millis();
+	}
+
+	// Returns bytes sent or -1 on error
+	int LightSSLMessageChannel::blocking_send(const unsigned char *buf, int length)
 	{
 		int bytes_or_error;
 		int byte_count = 0;
@@ -242,12 +350,12 @@ namespace protocol
 
 		while (length > byte_count)
 		{
-			bytes_or_error = callbacks.receive(buf + byte_count,
+			bytes_or_error = callbacks.send(buf + byte_count,
 					length - byte_count, nullptr);
 			if (0 > bytes_or_error)
 			{
 				// error, disconnected
-				LOG(WARN,"receive error %d", bytes_or_error);
+				LOG(WARN,"blocking send error %d", bytes_or_error);
 				return bytes_or_error;
 			}
 			else if (0 < bytes_or_error)
@@ -259,7 +367,7 @@ namespace protocol
 				if (20000 < (callbacks.millis() - _millis))
 				{
 					// timed out, disconnect
-					LOG(WARN,"receive timeout");
+					LOG(WARN,"blocking send timeout");
 					return -1;
 				}
 			}
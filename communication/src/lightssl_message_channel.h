@@ -67,15 +67,51 @@ private:
 	Callbacks callbacks;
 	message_id_t* counter;
 
+	/**
+	 * The handshake is performed as a sequence of non-blocking steps.
+	 */
+	enum HandshakeState
+	{
+		HANDSHAKE_IDLE,
+		HANDSHAKE_RECEIVE_NONCE,
+		HANDSHAKE_SEND_NONCE,
+		HANDSHAKE_RECEIVE_KEY
+	};
+
+	HandshakeState handshake_state;
+	size_t handshake_offset;
+	system_tick_t handshake_state_time;
+
+	/**
+	 * Receive state of the current record. The body of a record that arrives in
+	 * several fragments is accumulated in a separately allocated buffer, since the
+	 * message queue may be reused for outgoing messages in the meantime.
+	 */
+	unsigned char rx_header[2];
+	size_t rx_header_length;
+	unsigned char* rx_buffer;
+	size_t rx_size;
+	size_t rx_offset;
+	system_tick_t rx_time;
+
 public:
 
-	LightSSLMessageChannel()
+	LightSSLMessageChannel() :
+			handshake_state(HANDSHAKE_IDLE),
+			handshake_offset(0),
+			handshake_state_time(0),
+			rx_header_length(0),
+			rx_buffer(nullptr),
+			rx_size(0),
+			rx_offset(0),
+			rx_time(0)
 	{
 		mbedtls_aes_init(&aes);
 	}
 
 	~LightSSLMessageChannel()
 	{
+		reset_receive();
 		mbedtls_aes_free(&aes);
 	}
 
@@ -85,6 +121,11 @@ public:
 	void init(const uint8_t* core_private, const uint8_t* server_public,
 			const uint8_t* device_id, Callbacks& callbacks, message_id_t* counter);
 
+	/**
+	 * Performs the next step of the handshake without blocking. Returns HANDSHAKE_PENDING
+	 * until the handshake is complete, the caller should then call this method again once
+	 * the socket is readable.
+	 */
 	virtual ProtocolError establish(uint32_t& flags, uint32_t app_crc) override
 	{
 		return handshake();
@@ -105,7 +146,10 @@ public:
 	ProtocolError notify_established() override { return NO_ERROR; }
 
 	virtual ProtocolError command(Command cmd, void* arg=nullptr) override {
-		// not used presently
+		if (cmd == CLOSE) {
+			set_handshake_state(HANDSHAKE_IDLE);
+			reset_receive();
+		}
 		return NO_ERROR;
 	}
 
@@ -118,12 +162,22 @@ protected:
 
 	ProtocolError handshake();
 
+	/**
+	 * Performs a single non-blocking step of the handshake. The handshake is complete
+	 * when the state changes back to HANDSHAKE_IDLE.
+	 */
+	ProtocolError handshake_step();
+	void set_handshake_state(HandshakeState state);
+
+	/**
+	 * Decrypts a complete record stored in the message buffer.
+	 */
+	void decrypt_record(Message& message, size_t size);
+	void reset_receive();
+
 	// Returns bytes sent or -1 on error
 	int blocking_send(const unsigned char *buf, int length);
 
-	// Returns bytes received or -1 on error
-	int blocking_receive(unsigned char *buf, int length);
-
 };
 
 }
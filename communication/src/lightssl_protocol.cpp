@@ -21,6 +21,8 @@
 
 #if HAL_PLATFORM_CLOUD_TCP && PARTICLE_PROTOCOL
 
+#include <algorithm>
+
 namespace particle { namespace protocol {
 int LightSSLProtocol::command(ProtocolCommands::Enum command, uint32_t data)
 {
@@ -28,9 +30,15 @@ int LightSSLProtocol::command(ProtocolCommands::Enum command, uint32_t data)
   switch (command) {
   case ProtocolCommands::SLEEP:
   case ProtocolCommands::DISCONNECT:
-    result = this->wait_confirmable();
+    if (handshake_pending) {
+      cancel_handshake();
+      result = NO_ERROR;
+    } else {
+      result = this->wait_confirmable();
+    }
     break;
   case ProtocolCommands::TERMINATE:
+    cancel_handshake();
     ack_handlers.clear();
     result = NO_ERROR;
     break;
@@ -38,6 +46,14 @@ int LightSSLProtocol::command(ProtocolCommands::Enum command, uint32_t data)
   return result;
 }
 
+void LightSSLProtocol::cancel_handshake()
+{
+  if (handshake_pending) {
+    handshake_pending = false;
+    channel.command(MessageChannel::CLOSE);
+  }
+}
+
 int LightSSLProtocol::wait_confirmable(uint32_t timeout)
 {
   ProtocolError err = NO_ERROR;
@@ -49,12 +65,17 @@ int LightSSLProtocol::wait_confirmable(uint32_t timeout)
     while (((ack_handlers.size() != 0) && (millis()-start)<timeout))
     {
       CoAPMessageType::Enum message;
-      err = event_loop(message);
+      bool received = false;
+      err = event_loop(message, received);
       if (err)
       {
         LOG(WARN, "error receiving acknowledgements");
         break;
       }
+      if (!received)
+      {
+        wait_readable(timeout - std::min<system_tick_t>(timeout, millis() - start));
+      }
     }
     LOG(INFO, "All Confirmed messages sent: %s",
         (ack_handlers.size() != 0) ? "no" : "yes");
@@ -81,6 +81,13 @@ public:
 
 	int wait_confirmable(uint32_t timeout=5000);
 
+private:
+	/**
+	 * Discards the state of an incomplete handshake, so that the next call to begin()
+	 * starts a new one.
+	 */
+	void cancel_handshake();
+
 };
 
 
@@ -60,8 +60,16 @@ ProtocolError Protocol::handle_received_message(Message& message,
 		if (type==CoAPType::RESET) {		// RST is sent with an empty code. It's like an unspecified error
 			LOG(TRACE, "Reset received, setting error code to internal server error.");
 			code = CoAPCode::INTERNAL_SERVER_ERROR;
+			// A reset sent in reply to a notification cancels the observation
+			variables.handle_reset(msg_id);
+			subscriptions.handle_reset(msg_id);
 		}
 		notify_message_complete(msg_id, code);
+		const ProtocolError error = subscriptions.handle_response(msg_id, code, message, channel);
+		if (error)
+		{
+			return error;
+		}
 	}
 
 	ProtocolError error = NO_ERROR;
@@ -73,27 +81,34 @@ ProtocolError Protocol::handle_received_message(Message& message,
 	{
 		// 4 bytes header, 1 byte token, 2 bytes location path
 		// 2 bytes optional single character location path for describe flags
+		// 5 bytes optional payload with the base checksum for a delta describe
 		int descriptor_type = DESCRIBE_DEFAULT;
+		uint32_t base_checksum = 0;
 		if (message.length()>8 && queue[8] <= DESCRIBE_MAX) {
 			descriptor_type = queue[8];
 		} else if (message.length() > 8) {
 			LOG(WARN, "Invalid DESCRIBE flags %02x", queue[8]);
 		}
-		error = send_description(token, msg_id, descriptor_type);
+		if ((descriptor_type & DESCRIBE_DELTA) && message.length() >= 14 && queue[9] == 0xff) {
+			base_checksum = ((uint32_t)queue[10] << 24) | ((uint32_t)queue[11] << 16) | ((uint32_t)queue[12] << 8) | queue[13];
+		}
+		error = send_description(token, msg_id, descriptor_type, base_checksum);
 		break;
 	}
 
 	case CoAPMessageType::FUNCTION_CALL:
 		return functions.handle_function_call(token, msg_id, message, channel,
-				descriptor.call_function);
+				descriptor.call_function, callbacks.millis());
 
 	case CoAPMessageType::VARIABLE_REQUEST:
 	{
 		char variable_key[MAX_VARIABLE_KEY_LENGTH+1];
-		variables.decode_variable_request(variable_key, message);
+		int32_t observe = Variables::OBSERVE_NONE;
+		variables.decode_variable_request(variable_key, message, &observe);
 		return variables.handle_variable_request(variable_key, message,
 				channel, token, msg_id,
-				descriptor.variable_type, descriptor.get_variable);
+				descriptor.variable_type, descriptor.get_variable,
+				observe, callbacks.millis(), callbacks.calculate_crc);
 	}
 	case CoAPMessageType::SAVE_BEGIN:
 		// fall through
@@ -283,17 +298,33 @@ uint32_t Protocol::application_state_checksum()
 int Protocol::begin()
 {
 	LOG_CATEGORY("comm.protocol.handshake");
-	LOG(INFO,"Establish secure connection");
-	chunkedTransfer.reset();
-	pinger.reset();
-	timesync_.reset();
-
-	// FIXME: Pending completion handlers should be cancelled at the end of a previous session
-	ack_handlers.clear();
-	last_ack_handlers_update = callbacks.millis();
+	if (handshake_pending)
+	{
+		// Wait for the next part of the handshake for a bounded time, so that the system loop
+		// neither blocks for the whole handshake nor polls the channel continuously
+		wait_readable(MAX_WAIT_READABLE_TIME);
+	}
+	else
+	{
+		LOG(INFO,"Establish secure connection");
+		chunkedTransfer.reset();
+		pinger.reset();
+		timesync_.reset();
+		variables.reset();
+		functions.reset();
+		subscriptions.cancel_bulk_requests();
+
+		// FIXME: Pending completion handlers should be cancelled at the end of a previous session
+		ack_handlers.clear();
+		last_ack_handlers_update = callbacks.millis();
+	}
 
 	uint32_t channel_flags = 0;
 	ProtocolError error = channel.establish(channel_flags, application_state_checksum());
+	handshake_pending = (error == HANDSHAKE_PENDING);
+	if (handshake_pending) {
+		return error;
+	}
 	bool session_resumed = (error==SESSION_RESUMED);
 	if (error && !session_resumed) {
 		LOG(ERROR,"handshake failed with code %d", error);
@@ -313,7 +344,7 @@ int Protocol::begin()
 	if (session_resumed && channel.is_unreliable() && (flags & SKIP_SESSION_RESUME_HELLO))
 	{
 		LOG(INFO,"resumed session - not sending HELLO message");
-		return ping(true);
+		return resume_session();
 	}
 
 	// todo - this will return code 0 even when the session was resumed,
@@ -335,9 +366,31 @@ int Protocol::begin()
 	}
 	LOG(INFO,"Handshake completed");
 	channel.notify_established();
+	publisher.set_online(true);
 	return error;
 }
 
+ProtocolError Protocol::resume_session()
+{
+	publisher.set_online(true);
+	const unsigned queued = publisher.queued_events();
+	if (queued)
+	{
+		const ProtocolError error = publisher.process(channel, callbacks.millis());
+		if (error)
+		{
+			return error;
+		}
+		if (publisher.queued_events() < queued)
+		{
+			LOG(INFO,"sent %u deferred event(s) instead of a ping", queued - publisher.queued_events());
+			last_message_millis = callbacks.millis();
+			return NO_ERROR;
+		}
+	}
+	return ping(true);
+}
+
 /**
  * Send the hello message over the channel.
  * @param was_ota_upgrade_successful {@code true} if the previous OTA update was successful.
@@ -383,14 +436,19 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum message_type,
 	do
 	{
 		CoAPMessageType::Enum msgtype;
-		ProtocolError error = event_loop(msgtype);
+		bool received = false;
+		ProtocolError error = event_loop(msgtype, received);
 		if (error) {
 			LOG(ERROR,"message type=%d, error=%d", (int)msgtype, error);
 			return error;
 		}
 		if (msgtype == message_type)
 			return NO_ERROR;
-		// todo - ideally need a delay here
+		const system_tick_t elapsed = callbacks.millis() - start;
+		if (!received && elapsed < timeout)
+		{
+			wait_readable(timeout - elapsed);
+		}
 	}
 	while ((callbacks.millis() - start) < timeout);
 	return MESSAGE_TIMEOUT;
@@ -401,6 +459,37 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum message_type,
  * If an error occurs, the event type is undefined.
  */
 ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type)
+{
+	bool received = false;
+	return event_loop(message_type, received);
+}
+
+ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type, bool& received)
+{
+	if (handshake_pending)
+	{
+		// The channel is driven by begin() until the handshake is complete
+		message_type = CoAPMessageType::NONE;
+		received = false;
+		return NO_ERROR;
+	}
+	ProtocolError error = receive_message(message_type, received);
+	if (!error && !received)
+	{
+		error = event_loop_idle();
+	}
+
+	if (error)
+	{
+		// bail if and only if there was an error
+		chunkedTransfer.cancel();
+		LOG(ERROR,"Event loop error %d", error);
+		return error;
+	}
+	return error;
+}
+
+ProtocolError Protocol::receive_message(CoAPMessageType::Enum& message_type, bool& received)
 {
 	// Process expired completion handlers
 	const system_tick_t t = callbacks.millis();
@@ -409,31 +498,55 @@ ProtocolError Protocol::event_loop(CoAPMessageType::Enum& message_type)
 
 	Message message;
 	message_type = CoAPMessageType::NONE;
+	received = false;
 	ProtocolError error = channel.receive(message);
-	if (!error)
+	if (!error && message.length())
 	{
-		if (message.length())
-		{
-			error = handle_received_message(message, message_type);
-			LOG(INFO,"rcv'd message type=%d", (int)message_type);
-		}
-		else
+		received = true;
+		error = handle_received_message(message, message_type);
+		LOG(INFO,"rcv'd message type=%d", (int)message_type);
+	}
+	return error;
+}
+
+ProtocolError Protocol::drain_event_loop()
+{
+	// Handle the messages that are already buffered, so that bursts don't have to wait for
+	// subsequent iterations of the application loop
+	if (handshake_pending)
+	{
+		return NO_ERROR;
+	}
+	const system_tick_t start = callbacks.millis();
+	unsigned count = 0;
+	ProtocolError error = NO_ERROR;
+	for (;;)
+	{
+		CoAPMessageType::Enum message_type;
+		bool received = false;
+		error = receive_message(message_type, received);
+		if (error || !received || ++count >= event_loop_message_budget ||
+				(event_loop_time_budget && callbacks.millis() - start >= event_loop_time_budget))
 		{
-			error = event_loop_idle();
+			break;
 		}
 	}
+	// The background processing is performed even if the budget was exhausted, otherwise
+	// a steady stream of messages could delay keep-alives and retransmissions
+	if (!error)
+	{
+		error = event_loop_idle();
+	}
 
 	if (error)
 	{
-		// bail if and only if there was an error
 		chunkedTransfer.cancel();
 		LOG(ERROR,"Event loop error %d", error);
-		return error;
 	}
 	return error;
 }
 
-void Protocol::build_describe_message(Appender& appender, int desc_flags)
+void Protocol::build_describe_message(Appender& appender, int desc_flags, const DescribeSnapshot* snapshot)
 {
 	// diagnostics must be requested in isolation to be a binary packet
 	if (descriptor.append_metrics && (desc_flags == DESCRIBE_METRICS))
@@ -449,8 +562,17 @@ void Protocol::build_describe_message(Appender& appender, int desc_flags)
 		appender.append("{");
 		bool has_content = false;
 
+		if (snapshot)
+		{
+			has_content = true;
+			appender.append("\"c\":");
+			DescribeState::append_uint(appender, snapshot->checksum());
+		}
+
 		if (desc_flags & DESCRIBE_APPLICATION)
 		{
+			if (has_content)
+				appender.append(',');
 			has_content = true;
 			appender.append("\"f\":[");
 
@@ -513,7 +635,7 @@ void Protocol::build_describe_message(Appender& appender, int desc_flags)
  * Produces and transmits a describe message.
  * @param desc_flags Flags describing the information to provide. A combination of {@code DESCRIBE_APPLICATION) and {@code DESCRIBE_SYSTEM) flags.
  */
-ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int desc_flags)
+ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int desc_flags, uint32_t base_checksum)
 {
 	Message message;
 	channel.create(message);
@@ -523,7 +645,24 @@ ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int
 
 	BufferAppender appender(buf + desc, message.capacity());
 
-	build_describe_message(appender, desc_flags);
+	// Delta describe messages are only supported for the complete application and system describe
+	const bool delta = (desc_flags & DESCRIBE_DELTA) && (desc_flags & DESCRIBE_DEFAULT) == DESCRIBE_DEFAULT;
+	desc_flags &= ~DESCRIBE_DELTA;
+	DescribeSnapshot snapshot;
+	bool delta_sent = false;
+	if (delta)
+	{
+		DescribeState::snapshot(descriptor, &snapshot);
+		delta_sent = describe_state.build_delta(descriptor, snapshot, base_checksum, appender);
+		if (!delta_sent)
+		{
+			build_describe_message(appender, desc_flags, &snapshot);
+		}
+	}
+	else
+	{
+		build_describe_message(appender, desc_flags);
+	}
 
 	int msglen = appender.next() - (uint8_t*) buf;
 	message.set_length(msglen);
@@ -537,10 +676,15 @@ ProtocolError Protocol::send_description(token_t token, message_id_t msg_id, int
 		SPARK_ASSERT(!appender.overflowed());
 	}
 
-	LOG(INFO,"Sending '%s%s%s' describe message", desc_flags & DESCRIBE_SYSTEM ? "S" : "",
+	LOG(INFO,"Sending '%s%s%s%s' describe message", desc_flags & DESCRIBE_SYSTEM ? "S" : "",
 											  desc_flags & DESCRIBE_APPLICATION ? "A" : "",
-											  desc_flags & DESCRIBE_METRICS ? "M" : "");
+											  desc_flags & DESCRIBE_METRICS ? "M" : "",
+											  delta_sent ? "D" : "");
 	ProtocolError error = channel.send(message);
+	if (error==NO_ERROR && delta)
+	{
+		describe_state.sent_describe(snapshot);
+	}
 	if (error==NO_ERROR && descriptor.app_state_selector_info &&
             (desc_flags & DESCRIBE_APPLICATION || desc_flags & DESCRIBE_SYSTEM))
 	{
@@ -586,6 +730,27 @@ system_tick_t Protocol::ChunkedTransferCallbacks::millis()
 	return callbacks->millis();
 }
 
+int Protocol::ChunkedTransferCallbacks::read_firmware_chunk(FileTransfer::Descriptor& descriptor, unsigned char* chunk, void* reserved)
+{
+	if (!callbacks->read_firmware_chunk)
+		return -1;
+	return callbacks->read_firmware_chunk(descriptor, chunk, reserved);
+}
+
+int Protocol::ChunkedTransferCallbacks::save_checkpoint(const void* data, size_t length)
+{
+	if (!callbacks->save)
+		return -1;
+	return callbacks->save(data, length, SparkCallbacks::PERSIST_OTA, nullptr);
+}
+
+int Protocol::ChunkedTransferCallbacks::restore_checkpoint(void* data, size_t max_length)
+{
+	if (!callbacks->restore)
+		return 0;
+	return callbacks->restore(data, max_length, SparkCallbacks::PERSIST_OTA, nullptr);
+}
+
 int Protocol::get_describe_data(spark_protocol_describe_data* data, void* reserved)
 {
 	data->maximum_size = 768;  // a conservative guess based on dtls and lightssl encryption overhead and the CoAP data
@@ -12,6 +12,7 @@
 #include "publisher.h"
 #include "subscriptions.h"
 #include "variables.h"
+#include "describe.h"
 #include "hal_platform.h"
 #include "mesh.h"
 #include "timesyncmanager.h"
@@ -85,6 +86,12 @@ class Protocol
 
 		  virtual system_tick_t millis();
 
+		  virtual int read_firmware_chunk(FileTransfer::Descriptor& descriptor, unsigned char* chunk, void*);
+
+		  virtual int save_checkpoint(const void* data, size_t length);
+
+		  virtual int restore_checkpoint(void* data, size_t max_length);
+
 	} chunkedTransferCallbacks;
 
 	/**
@@ -112,6 +119,11 @@ class Protocol
 	 */
 	TimeSyncManager timesync_;
 
+	/**
+	 * Tracks the describe state known to the server for delta describe messages.
+	 */
+	DescribeState describe_state;
+
 #if HAL_PLATFORM_MESH
 	Mesh mesh;
 #endif
@@ -121,6 +133,13 @@ class Protocol
 	 */
 	system_tick_t last_ack_handlers_update;
 
+	/**
+	 * The maximum number of messages and the maximum time spent handling received
+	 * messages in a single call to event_loop().
+	 */
+	unsigned event_loop_message_budget;
+	system_tick_t event_loop_time_budget;
+
 	/**
 	 * The token ID for the next request made.
 	 * If we have a bone-fide CoAP layer this will eventually disappear into that layer, just like message-id has.
@@ -164,6 +183,10 @@ protected:
 	 */
 	CompletionHandlerMap<message_id_t> ack_handlers;
 
+	/**
+	 * Set while the channel is in the middle of a non-blocking handshake started by begin().
+	 */
+	bool handshake_pending;
 
 	void set_protocol_flags(int flags)
 	{
@@ -212,22 +235,60 @@ protected:
 		return channel.send(message);
 	}
 
+	/**
+	 * Resumes the cloud session without sending a hello message. The events published while
+	 * the session was inactive are sent as the first messages of the session, otherwise a ping
+	 * is sent. Either message lets the device detect if the server no longer has the session.
+	 */
+	ProtocolError resume_session();
+
+	/**
+	 * Processes one event, like event_loop(message_type). {@code received} is set to
+	 * {@code false} if no message was available.
+	 */
+	ProtocolError event_loop(CoAPMessageType::Enum& message_type, bool& received);
+
+	/**
+	 * Blocks until a message may be available for reading, for up to {@code timeout}
+	 * milliseconds. Returns immediately if the transport doesn't support waiting.
+	 */
+	void wait_readable(system_tick_t timeout)
+	{
+		if (callbacks.wait_readable)
+		{
+			const system_tick_t t = (timeout < MAX_WAIT_READABLE_TIME) ? timeout : MAX_WAIT_READABLE_TIME;
+			callbacks.wait_readable(t, callbacks.transport_context);
+		}
+	}
+
 	/**
 	 * Background processing when there are no messages to handle.
 	 */
 	ProtocolError event_loop_idle()
 	{
+		// The deferred ACK of a function call is sent even during an update, otherwise the
+		// server would retransmit the request
+		ProtocolError error = functions.process(channel, callbacks.millis());
+		if (error)
+			return error;
 		if (chunkedTransfer.is_updating())
 		{
 			return chunkedTransfer.idle(channel);
 		}
 		else
 		{
-			ProtocolError error = pinger.process(
+			error = pinger.process(
 					callbacks.millis() - last_message_millis, [this]
 					{	return ping();});
 			if (error)
 				return error;
+			error = variables.process(channel, callbacks.millis(), descriptor.variable_type,
+					descriptor.get_variable, callbacks.calculate_crc);
+			if (error)
+				return error;
+			error = publisher.process(channel, callbacks.millis());
+			if (error)
+				return error;
 		}
 		return NO_ERROR;
 	}
@@ -237,17 +298,42 @@ protected:
 	 */
 	const int MISSED_CHUNKS_TO_SEND = 50;
 
+	/**
+	 * Default budget for handling received messages in a single call to event_loop().
+	 */
+	static const unsigned DEFAULT_EVENT_LOOP_MESSAGE_BUDGET = 8;
+	static const system_tick_t DEFAULT_EVENT_LOOP_TIME_BUDGET = 20;
+
+	/**
+	 * The maximum time to block waiting for incoming data. Retransmissions and keep-alives are
+	 * handled between the waits.
+	 */
+	static const system_tick_t MAX_WAIT_READABLE_TIME = 100;
+
 	/**
 	 * Produces and transmits a describe message.
 	 * @param desc_flags Flags describing the information to provide. A combination of {@code DESCRIBE_APPLICATION) and {@code DESCRIBE_SYSTEM) flags.
+	 * @param base_checksum Checksum of the describe known to the server if {@code DESCRIBE_DELTA} is set.
 	 */
-	ProtocolError send_description(token_t token, message_id_t msg_id, int desc_flags);
+	ProtocolError send_description(token_t token, message_id_t msg_id, int desc_flags, uint32_t base_checksum = 0);
 
 	/**
 	 * Decodes and dispatches a received message to its handler.
 	 */
 	ProtocolError handle_received_message(Message& message, CoAPMessageType::Enum& message_type);
 
+	/**
+	 * Receives and handles a single message. {@code received} is set to {@code false}
+	 * if no message was available.
+	 */
+	ProtocolError receive_message(CoAPMessageType::Enum& message_type, bool& received);
+
+	/**
+	 * Handles the received messages up to the configured budget and performs the background
+	 * processing.
+	 */
+	ProtocolError drain_event_loop();
+
 	/**
 	 * Sends an empty acknoweldgement for the given message.
 	 */
@@ -285,7 +371,10 @@ public:
 			product_firmware_version(PRODUCT_FIRMWARE_VERSION),
 			publisher(this),
 			last_ack_handlers_update(0),
-			initialized(false)
+			event_loop_message_budget(DEFAULT_EVENT_LOOP_MESSAGE_BUDGET),
+			event_loop_time_budget(DEFAULT_EVENT_LOOP_TIME_BUDGET),
+			initialized(false),
+			handshake_pending(false)
 	{
 	}
 
@@ -309,6 +398,79 @@ public:
 		chunkedTransfer.set_fast_ota(data);
 	}
 
+	void set_variable_observe_min_interval(system_tick_t interval)
+	{
+		variables.set_min_interval(interval);
+	}
+
+	void set_variable_observe_max_interval(system_tick_t interval)
+	{
+		variables.set_max_interval(interval);
+	}
+
+	void set_variable_observe_confirmable_ratio(unsigned ratio)
+	{
+		variables.set_confirmable_ratio(ratio);
+	}
+
+	/**
+	 * Sets the maximum number of received messages handled in a single call to event_loop().
+	 */
+	void set_event_loop_message_budget(unsigned budget)
+	{
+		event_loop_message_budget = budget ? budget : 1;
+	}
+
+	/**
+	 * Sets the maximum time spent handling received messages in a single call to event_loop().
+	 * 0 disables the time limit.
+	 */
+	void set_event_loop_time_budget(system_tick_t budget)
+	{
+		event_loop_time_budget = budget;
+	}
+
+	/**
+	 * Sets the pacing of application events: one event per {@code interval} milliseconds on
+	 * average, with bursts of up to {@code burst} events.
+	 */
+	void set_publish_rate_interval(system_tick_t interval)
+	{
+		publisher.set_rate(interval, publisher.rate_burst());
+	}
+
+	void set_publish_rate_burst(unsigned burst)
+	{
+		publisher.set_rate(publisher.rate_interval(), burst);
+	}
+
+	/**
+	 * Sets the maximum number of application events deferred until the rate limit allows them
+	 * to be sent. 0 disables pacing, in which case the events exceeding the limit are rejected.
+	 */
+	void set_publish_queue_size(unsigned size)
+	{
+		publisher.set_queue_limit(size);
+	}
+
+	/**
+	 * Sets the maximum time the acknowledgement of a function call is deferred waiting for
+	 * the result, so that the result can be sent in the acknowledgement.
+	 */
+	void set_function_response_deadline(system_tick_t deadline)
+	{
+		functions.set_response_deadline(deadline);
+	}
+
+	/**
+	 * Notifies the observers of a variable that its value has changed.
+	 * @return {@code true} if the variable is being observed.
+	 */
+	bool notify_variable(const char* variable_key)
+	{
+		return variables.notify(variable_key);
+	}
+
 	void set_handlers(CommunicationsHandlers& handlers)
 	{
 		copy_and_init(&this->handlers, sizeof(this->handlers), &handlers, handlers.size);
@@ -330,6 +492,10 @@ public:
 
 	/**
 	 * Establish a secure connection and send and process the hello message.
+	 *
+	 * Returns HANDSHAKE_PENDING if the channel performs the handshake in non-blocking steps
+	 * and it is not complete yet. The caller should then call this method again, which waits
+	 * for a bounded time for the socket to become readable and continues the handshake.
 	 */
 	int begin();
 
@@ -351,12 +517,13 @@ public:
 	ProtocolError event_loop(CoAPMessageType::Enum& message_type);
 
 	/**
-	 * no-arg version of event loop for those callers that don't care about the message.
+	 * Handles the received messages, up to the configured message and time budget, and
+	 * performs the background processing.
+	 * @returns {@code true} on success, {@code false} if an error occurred.
 	 */
 	bool event_loop()
 	{
-		CoAPMessageType::Enum message;
-		return !event_loop(message);
+		return !drain_event_loop();
 	}
 
 	// Returns true on success, false on sending timeout or rate-limiting failure
@@ -395,7 +562,7 @@ public:
 		return success;
 	}
 
-	void build_describe_message(Appender& appender, int desc_flags);
+	void build_describe_message(Appender& appender, int desc_flags, const DescribeSnapshot* snapshot = nullptr);
 
 	inline bool add_event_handler(const char *event_name, EventHandler handler)
 	{
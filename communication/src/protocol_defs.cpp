@@ -47,6 +47,8 @@ system_error_t particle::protocol::toSystemError(ProtocolError error) {
         return SYSTEM_ERROR_LIMIT_EXCEEDED;
     case INSUFFICIENT_STORAGE:
         return SYSTEM_ERROR_TOO_LARGE;
+    case HANDSHAKE_PENDING:
+        return SYSTEM_ERROR_WOULD_BLOCK;
     default:
         return SYSTEM_ERROR_PROTOCOL; // Generic protocol error
     }
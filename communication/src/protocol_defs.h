@@ -1,6 +1,7 @@
 	#pragma once
 
 #include <functional>
+#include <cstddef>
 #include "system_tick_hal.h"
 
 #include "system_error.h"
@@ -47,6 +48,7 @@ enum ProtocolError
     /* 23 */ IO_ERROR_LIGHTSSL_RECEIVE,
     /* 24 */ IO_ERROR_LIGHTSSL_HANDSHAKE_NONCE,
     /* 25 */ IO_ERROR_LIGHTSSL_HANDSHAKE_RECV_KEY,
+    /* 27 */ HANDSHAKE_PENDING,  // the handshake continues on the next call to establish()
 
     /*
      * NOTE: when adding more ProtocolError codes, be sure to update toSystemError() in protocol_defs.cpp
@@ -63,6 +65,8 @@ const chunk_index_t NO_CHUNKS_MISSING = 65535;
 const chunk_index_t MAX_CHUNKS        = 65535;
 const size_t MISSED_CHUNKS_TO_SEND    = 40u;
 const size_t MINIMUM_CHUNK_INCREASE   = 2u;
+const chunk_index_t MAX_RESUMABLE_CHUNKS = 1024;
+const size_t CHUNKS_PER_CHECKPOINT    = 32u;
 const size_t MAX_EVENT_TTL_SECONDS    = 16777215;
 const size_t MAX_OPTION_DELTA_LENGTH  = 12;
 #if PLATFORM_ID<2
@@ -102,8 +106,9 @@ enum DescriptionType {
     DESCRIBE_SYSTEM = 1<<0,            	// modules
     DESCRIBE_APPLICATION = 1<<1,       	// functions and variables
 	DESCRIBE_METRICS = 1<<2,				// metrics/diagnostics
+	DESCRIBE_DELTA = 1<<3,					// changes since the describe with the given checksum
     DESCRIBE_DEFAULT = DESCRIBE_SYSTEM | DESCRIBE_APPLICATION,
-	DESCRIBE_MAX = (1<<3)-1
+	DESCRIBE_MAX = (1<<4)-1
 };
 
 namespace Connection
@@ -111,7 +116,16 @@ namespace Connection
 enum Enum
 {
     PING = 0,
-    FAST_OTA = 1
+    FAST_OTA = 1,
+    VARIABLE_OBSERVE_MIN_INTERVAL = 2,
+    VARIABLE_OBSERVE_MAX_INTERVAL = 3,
+    VARIABLE_OBSERVE_CONFIRMABLE_RATIO = 4,
+    EVENT_LOOP_MESSAGE_BUDGET = 5,
+    EVENT_LOOP_TIME_BUDGET = 6,
+    PUBLISH_RATE_INTERVAL = 7,
+    PUBLISH_RATE_BURST = 8,
+    PUBLISH_QUEUE_SIZE = 9,
+    FUNCTION_RESPONSE_DEADLINE = 10
 };
 }
 
@@ -24,9 +24,14 @@
 #include "message_channel.h"
 #include "messages.h"
 
+#include "token_bucket.h"
 #include "completion_handler.h"
 #include "communication_diagnostic.h"
 
+#include <memory>
+#include <new>
+#include <cstring>
+
 namespace particle
 {
 namespace protocol
@@ -37,9 +42,33 @@ class Protocol;
 class Publisher
 {
 public:
+	/**
+	 * Default pacing of application events: 4 events per second, with a burst of up to 4 events.
+	 */
+	static const system_tick_t DEFAULT_EVENT_INTERVAL = 250;
+	static const unsigned DEFAULT_EVENT_BURST = 4;
+
+	/**
+	 * Pacing of system events: 255 events per 65.5 seconds.
+	 */
+	static const system_tick_t SYSTEM_EVENT_INTERVAL = 257;
+	static const unsigned SYSTEM_EVENT_BURST = 255;
+
 	explicit Publisher(Protocol* protocol) :
-			protocol(protocol)
+			protocol(protocol),
+			user_events(DEFAULT_EVENT_INTERVAL, DEFAULT_EVENT_BURST),
+			system_events(SYSTEM_EVENT_INTERVAL, SYSTEM_EVENT_BURST),
+			queue_head(nullptr),
+			queue_tail(nullptr),
+			queue_size(0),
+			queue_limit(0),
+			online(false)
+	{
+	}
+
+	~Publisher()
 	{
+		clear_queue(SYSTEM_ERROR_ABORTED);
 	}
 
 	inline bool is_system(const char* event_name)
@@ -47,57 +76,209 @@ public:
 		return !strncmp(event_name, "spark", 5);
 	}
 
-	bool is_rate_limited(bool is_system_event, system_tick_t millis)
+	/**
+	 * Sets the pacing of application events. On average, one event is sent per {@code interval}
+	 * milliseconds, and up to {@code burst} events can be sent back to back.
+	 */
+	void set_rate(system_tick_t interval, unsigned burst)
+	{
+		user_events.configure(interval, burst);
+	}
+
+	system_tick_t rate_interval() const
+	{
+		return user_events.refill_interval();
+	}
+
+	unsigned rate_burst() const
+	{
+		return user_events.capacity();
+	}
+
+	/**
+	 * Sets the maximum number of application events that are kept in RAM when they exceed
+	 * the rate limit, instead of being rejected. 0 disables the pacing queue.
+	 */
+	void set_queue_limit(unsigned limit)
+	{
+		queue_limit = limit;
+	}
+
+	unsigned queued_events() const
+	{
+		return queue_size;
+	}
+
+	/**
+	 * Sets whether the cloud session is active. While the session is inactive, application
+	 * events are kept in the pacing queue, if it's enabled, so that they can be sent as soon
+	 * as the session is resumed.
+	 */
+	void set_online(bool online)
 	{
-		if (is_system_event)
+		this->online = online;
+	}
+
+	bool is_online() const
+	{
+		return online;
+	}
+
+	/**
+	 * Sends an event, or defers it until the rate limit allows it to be sent.
+	 *
+	 * The completion handler receives the tick count at which the event was sent. Events sent
+	 * with {@code EventType::WITH_ACK} complete when they are acknowledged.
+	 */
+	ProtocolError send_event(MessageChannel& channel, const char* event_name,
+			const char* data, int ttl, EventType::Enum event_type, int flags,
+			system_tick_t time, CompletionHandler handler)
+	{
+		if (is_system(event_name))
 		{
-			static uint16_t lastMinute = 0;
-			static uint8_t eventsThisMinute = 0;
-
-			uint16_t currentMinute = uint16_t(millis >> 16);
-			if (currentMinute == lastMinute)
-			{      // == handles millis() overflow
-				if (eventsThisMinute == 255)
-					return true;
+			if (!system_events.consume(time))
+			{
+				return rate_limited(handler);
 			}
-			else
+		}
+		// Deferred events are sent in the order in which they were published
+		else if (queue_head || (!online && queue_limit) || !user_events.consume(time))
+		{
+			if (queue_size >= queue_limit)
 			{
-				lastMinute = currentMinute;
-				eventsThisMinute = 0;
+				return rate_limited(handler);
 			}
-			eventsThisMinute++;
+			return defer_event(event_name, data, ttl, event_type, flags, std::move(handler));
 		}
-		else
+		return send(channel, event_name, data, ttl, event_type, flags, time, std::move(handler));
+	}
+
+	/**
+	 * Sends the deferred events for which the rate limit allows it.
+	 */
+	ProtocolError process(MessageChannel& channel, system_tick_t time)
+	{
+		while (online && queue_head && user_events.consume(time))
 		{
-			static system_tick_t recent_event_ticks[5] =
-			{ (system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000, (system_tick_t) -1000,
-					(system_tick_t) -1000 };
-			static int evt_tick_idx = 0;
-
-			system_tick_t now = recent_event_ticks[evt_tick_idx] = millis;
-			evt_tick_idx++;
-			evt_tick_idx %= 5;
-			if (now - recent_event_ticks[evt_tick_idx] < 1000)
+			DeferredEvent* const event = queue_head;
+			queue_head = event->next;
+			if (!queue_head)
+			{
+				queue_tail = nullptr;
+			}
+			--queue_size;
+			const char* const name = event->buf.get();
+			const ProtocolError error = send(channel, name, event->has_data ? name + event->data_offset : nullptr,
+					event->ttl, event->event_type, event->flags, time, std::move(event->handler));
+			delete event;
+			if (error)
 			{
-				// exceeded allowable burst of 4 events per second
-				return true;
+				return error;
 			}
 		}
-		return false;
+		return NO_ERROR;
 	}
 
-	ProtocolError send_event(MessageChannel& channel, const char* event_name,
-			const char* data, int ttl, EventType::Enum event_type, int flags,
-			system_tick_t time, CompletionHandler handler)
+	/**
+	 * Discards the deferred events.
+	 */
+	void clear_queue(int error)
+	{
+		while (queue_head)
+		{
+			DeferredEvent* const event = queue_head;
+			queue_head = event->next;
+			event->handler.setError(error);
+			delete event;
+		}
+		queue_tail = nullptr;
+		queue_size = 0;
+	}
+
+private:
+	struct DeferredEvent
+	{
+		DeferredEvent* next;
+		CompletionHandler handler;
+		std::unique_ptr<char[]> buf; // Event name and data
+		size_t data_offset;
+		int ttl;
+		EventType::Enum event_type;
+		int flags;
+		bool has_data;
+	};
+
+	// Context of a completion handler waiting for an acknowledgement
+	struct SentEvent
+	{
+		CompletionHandler handler;
+		system_tick_t time;
+	};
+
+	Protocol* protocol;
+	TokenBucket user_events;
+	TokenBucket system_events;
+	DeferredEvent* queue_head;
+	DeferredEvent* queue_tail;
+	unsigned queue_size;
+	unsigned queue_limit;
+	bool online;
+
+	ProtocolError rate_limited(CompletionHandler& handler)
+	{
+		g_rateLimitedEventsCounter++;
+		handler.setError(toSystemError(BANDWIDTH_EXCEEDED));
+		return BANDWIDTH_EXCEEDED;
+	}
+
+	ProtocolError defer_event(const char* event_name, const char* data, int ttl,
+			EventType::Enum event_type, int flags, CompletionHandler handler)
 	{
-		bool is_system_event = is_system(event_name);
-		bool rate_limited = is_rate_limited(is_system_event, time);
-		if (rate_limited) {
-			g_rateLimitedEventsCounter++;
-			return BANDWIDTH_EXCEEDED;
+		const size_t name_len = strnlen(event_name, MAX_EVENT_NAME_LENGTH);
+		const size_t data_len = data ? strnlen(data, MAX_EVENT_DATA_LENGTH) : 0;
+		std::unique_ptr<DeferredEvent> event(new(std::nothrow) DeferredEvent());
+		if (event)
+		{
+			event->buf.reset(new(std::nothrow) char[name_len + data_len + 2]);
+		}
+		if (!event || !event->buf)
+		{
+			handler.setError(toSystemError(INSUFFICIENT_STORAGE));
+			return INSUFFICIENT_STORAGE;
+		}
+		char* const buf = event->buf.get();
+		memcpy(buf, event_name, name_len);
+		buf[name_len] = '\0';
+		event->data_offset = name_len + 1;
+		if (data)
+		{
+			memcpy(buf + event->data_offset, data, data_len);
+		}
+		buf[event->data_offset + data_len] = '\0';
+		event->next = nullptr;
+		event->handler = std::move(handler);
+		event->ttl = ttl;
+		event->event_type = event_type;
+		event->flags = flags;
+		event->has_data = (data != nullptr);
+		DeferredEvent* const e = event.release();
+		if (queue_tail)
+		{
+			queue_tail->next = e;
+		}
+		else
+		{
+			queue_head = e;
 		}
+		queue_tail = e;
+		++queue_size;
+		return NO_ERROR;
+	}
 
+	ProtocolError send(MessageChannel& channel, const char* event_name,
+			const char* data, int ttl, EventType::Enum event_type, int flags,
+			system_tick_t time, CompletionHandler handler)
+	{
 		Message message;
 		channel.create(message);
 		bool confirmable = channel.is_unreliable();
@@ -110,19 +291,40 @@ public:
 				event_type, confirmable);
 		message.set_length(msglen);
 		const ProtocolError result = channel.send(message);
-		if (result == NO_ERROR) {
-			// Register completion handler only if acknowledgement was requested explicitly
-			if ((flags & EventType::WITH_ACK) && message.has_id()) {
-			    add_ack_handler(message.get_id(), std::move(handler));
-			} else {
-			    handler.setResult();
+		if (result != NO_ERROR) {
+			handler.setError(toSystemError(result));
+			return result;
+		}
+		// Register completion handler only if acknowledgement was requested explicitly
+		if ((flags & EventType::WITH_ACK) && message.has_id()) {
+			if (handler) {
+				add_ack_handler(message.get_id(), wrap_ack_handler(std::move(handler), time));
 			}
+		} else {
+			handler.setResult(time);
 		}
 		return result;
 	}
 
-private:
-	Protocol* protocol;
+	static CompletionHandler wrap_ack_handler(CompletionHandler handler, system_tick_t time)
+	{
+		const auto event = new(std::nothrow) SentEvent{ std::move(handler), time };
+		if (!event) {
+			return handler;
+		}
+		return CompletionHandler(sent_event_callback, event);
+	}
+
+	static void sent_event_callback(int error, const void* data, void* callback_data, void* reserved)
+	{
+		const auto event = static_cast<SentEvent*>(callback_data);
+		if (error != SYSTEM_ERROR_NONE) {
+			event->handler.setError(error, (const char*)data);
+		} else {
+			event->handler.setResult(event->time);
+		}
+		delete event;
+	}
 
 	void add_ack_handler(message_id_t msg_id, CompletionHandler handler);
 };
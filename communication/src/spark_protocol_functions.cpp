@@ -189,6 +189,33 @@ int spark_protocol_set_connection_property(ProtocolFacade* protocol, unsigned pr
     } else if (property_id == particle::protocol::Connection::FAST_OTA)
     {
         protocol->set_fast_ota(data);
+    } else if (property_id == particle::protocol::Connection::VARIABLE_OBSERVE_MIN_INTERVAL)
+    {
+        protocol->set_variable_observe_min_interval(data);
+    } else if (property_id == particle::protocol::Connection::VARIABLE_OBSERVE_MAX_INTERVAL)
+    {
+        protocol->set_variable_observe_max_interval(data);
+    } else if (property_id == particle::protocol::Connection::VARIABLE_OBSERVE_CONFIRMABLE_RATIO)
+    {
+        protocol->set_variable_observe_confirmable_ratio(data);
+    } else if (property_id == particle::protocol::Connection::EVENT_LOOP_MESSAGE_BUDGET)
+    {
+        protocol->set_event_loop_message_budget(data);
+    } else if (property_id == particle::protocol::Connection::EVENT_LOOP_TIME_BUDGET)
+    {
+        protocol->set_event_loop_time_budget(data);
+    } else if (property_id == particle::protocol::Connection::PUBLISH_RATE_INTERVAL)
+    {
+        protocol->set_publish_rate_interval(data);
+    } else if (property_id == particle::protocol::Connection::PUBLISH_RATE_BURST)
+    {
+        protocol->set_publish_rate_burst(data);
+    } else if (property_id == particle::protocol::Connection::PUBLISH_QUEUE_SIZE)
+    {
+        protocol->set_publish_queue_size(data);
+    } else if (property_id == particle::protocol::Connection::FUNCTION_RESPONSE_DEADLINE)
+    {
+        protocol->set_function_response_deadline(data);
     }
     return 0;
 }
@@ -214,6 +241,13 @@ int spark_protocol_get_describe_data(ProtocolFacade* protocol, spark_protocol_de
 	return protocol->get_describe_data(data, reserved);
 }
 
+bool spark_protocol_notify_variable(ProtocolFacade* protocol, const char* variable_key, void* reserved)
+{
+    ASSERT_ON_SYSTEM_THREAD();
+    (void)reserved;
+    return protocol->notify_variable(variable_key);
+}
+
 #if HAL_PLATFORM_MESH
 int spark_protocol_mesh_command(ProtocolFacade* protocol, MeshCommand::Enum cmd, uint32_t data, void* extraData, completion_handler_data* completion, void* reserved) {
 	(void)reserved;
@@ -352,5 +386,9 @@ int spark_protocol_get_describe_data(ProtocolFacade* protocol, spark_protocol_de
 	return -1;
 }
 
+bool spark_protocol_notify_variable(ProtocolFacade* protocol, const char* variable_key, void* reserved) {
+	return false;
+}
+
 
 #endif
@@ -68,7 +68,8 @@ struct SparkCallbacks
 	int (*receive)(unsigned char *buf, uint32_t buflen, void* handle);
 
 	/**
-	* @param flags 1 dry run only.
+	* @param flags 1 dry run only. 2 resume an interrupted transfer, keeping the staged data.
+	* When resuming, the last argument is the bitmap of the staged chunks.
 	* Return 0 on success.
 	*/
 	int (*prepare_for_firmware_update)(FileTransfer::Descriptor& data, uint32_t flags, void*);
@@ -107,7 +108,8 @@ struct SparkCallbacks
 
   	enum PersistType
 	{
-  		PERSIST_SESSION = 0
+  		PERSIST_SESSION = 0,
+  		PERSIST_OTA = 1
 	};
 	int (*save)(const void* data, size_t length, uint8_t type, void* reserved);
 	/**
@@ -116,9 +118,27 @@ struct SparkCallbacks
 	int (*restore)(void* data, size_t max_length, uint8_t type, void* reserved);
 
 	// size == 52
+
+	/**
+	 * Blocks until data is available for reading or the timeout expires. Optional.
+	 * Returns a positive value if data is available, 0 on timeout, or a negative error code.
+	 * A timeout of 0 checks for available data without blocking.
+	 */
+	int (*wait_readable)(system_tick_t timeout, void* handle);
+
+	// size == 56
+
+	/**
+	 * Reads back a chunk stored with save_firmware_chunk(). Optional. Interrupted
+	 * transfers are only resumed if the staged data can be verified.
+	 * @return 0 on success
+	 */
+	int (*read_firmware_chunk)(FileTransfer::Descriptor& descriptor, unsigned char* chunk, void*);
+
+	// size == 60
 };
 
-PARTICLE_STATIC_ASSERT(SparkCallbacks_size, sizeof(SparkCallbacks)==(sizeof(void*)*13));
+PARTICLE_STATIC_ASSERT(SparkCallbacks_size, sizeof(SparkCallbacks)==(sizeof(void*)*15));
 
 /**
  * Application-supplied callbacks. (Deliberately distinct from the system-supplied
@@ -193,6 +213,13 @@ typedef struct {
 
 int spark_protocol_get_describe_data(ProtocolFacade* protocol, spark_protocol_describe_data* limits, void* reserved);
 
+/**
+ * Notifies the cloud observers of a variable that its value has changed.
+ *
+ * @return `true` if the variable is being observed.
+ */
+bool spark_protocol_notify_variable(ProtocolFacade* protocol, const char* variable_key, void* reserved);
+
 namespace ProtocolCommands {
   enum Enum {
     SLEEP,
@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include "logging.h"
+
 namespace particle
 {
 namespace protocol
@@ -34,8 +36,122 @@ class Subscriptions
 public:
 	typedef uint32_t (*calculate_crc_fn)(const unsigned char *buf, uint32_t buflen);
 
+	/**
+	 * Maximum number of event handlers.
+	 */
+	static const size_t MAX_EVENT_HANDLERS = 5;
+
 private:
-	FilteringEventHandler event_handlers[5];
+	FilteringEventHandler event_handlers[MAX_EVENT_HANDLERS];
+
+	/**
+	 * A bulk subscription request waiting for a response.
+	 */
+	struct BulkRequest
+	{
+		int msg_id; // -1 if the slot is not used
+		uint8_t count;
+		uint8_t handlers[MAX_EVENT_HANDLERS]; // Indices of the handlers in the request
+	};
+
+	BulkRequest bulk_requests[MAX_EVENT_HANDLERS];
+
+	/**
+	 * Set if the server responded to a bulk subscription request with a client error or a reset,
+	 * in which case one message per subscription is sent from then on, in all later sessions.
+	 */
+	bool bulk_disabled;
+
+	static bool same_subscription(const FilteringEventHandler& h1, const FilteringEventHandler& h2)
+	{
+		return h1.scope == h2.scope && !strncmp(h1.filter, h2.filter, sizeof(h1.filter)) &&
+				!strncmp(h1.device_id, h2.device_id, sizeof(h1.device_id));
+	}
+
+	ProtocolError send_bulk_request(MessageChannel& channel, Message& message, BulkRequest& request)
+	{
+		const ProtocolError error = channel.send(message);
+		if (error)
+		{
+			return error;
+		}
+		if (message.has_id())
+		{
+			request.msg_id = message.get_id();
+		}
+		return NO_ERROR;
+	}
+
+	/**
+	 * Sends all subscriptions in as few messages as the channel's message size allows.
+	 */
+	ProtocolError send_bulk_subscriptions(MessageChannel& channel)
+	{
+		cancel_bulk_requests();
+		BulkRequest* request = bulk_requests;
+		Message message;
+		size_t header_len = 0;
+		size_t len = 0;
+		for (size_t i = 0; i < MAX_EVENT_HANDLERS && event_handlers[i].handler; i++)
+		{
+			const FilteringEventHandler& handler = event_handlers[i];
+			bool duplicate = false;
+			for (size_t j = 0; j < i; j++)
+			{
+				if (same_subscription(handler, event_handlers[j]))
+				{
+					duplicate = true;
+					break;
+				}
+			}
+			if (duplicate)
+			{
+				continue;
+			}
+			uint8_t entry[BULK_SUBSCRIPTION_MAX_ENTRY_SIZE];
+			const size_t entry_len = bulk_subscription_entry(entry, handler.filter,
+					handler.device_id[0] ? handler.device_id : nullptr, handler.scope);
+			if (!entry_len)
+			{
+				continue;
+			}
+			if (len && len + entry_len > message.capacity())
+			{
+				// Split the request
+				message.set_length(len);
+				const ProtocolError error = send_bulk_request(channel, message, *request);
+				if (error)
+				{
+					return error;
+				}
+				++request;
+				len = 0;
+			}
+			if (!len)
+			{
+				const ProtocolError error = channel.create(message);
+				if (error)
+				{
+					return error;
+				}
+				header_len = bulk_subscription_header(message.buf(), 0);
+				len = header_len;
+				if (len + entry_len > message.capacity())
+				{
+					return INSUFFICIENT_STORAGE;
+				}
+			}
+			memcpy(message.buf() + len, entry, entry_len);
+			len += entry_len;
+			request->handlers[request->count++] = i;
+		}
+		if (len > header_len)
+		{
+			message.set_length(len);
+			return send_bulk_request(channel, message, *request);
+		}
+		return NO_ERROR;
+	}
 
 protected:
 
@@ -60,9 +176,119 @@ protected:
 
 public:
 
-	Subscriptions()
+	Subscriptions() :
+			bulk_disabled(false)
 	{
 		memset(&event_handlers, 0, sizeof(event_handlers));
+		cancel_bulk_requests();
+	}
+
+	/**
+	 * Enables or disables bulk subscription requests.
+	 */
+	void set_bulk_enabled(bool enabled)
+	{
+		bulk_disabled = !enabled;
+	}
+
+	bool bulk_enabled() const
+	{
+		return !bulk_disabled;
+	}
+
+	/**
+	 * Forgets the bulk subscription requests waiting for a response.
+	 */
+	void cancel_bulk_requests()
+	{
+		for (BulkRequest& request: bulk_requests)
+		{
+			request.msg_id = -1;
+			request.count = 0;
+		}
+	}
+
+	/**
+	 * Handles a reset message. A server that doesn't support bulk subscription requests may reject
+	 * them with a reset, in which case bulk requests are disabled. The subscriptions of the request
+	 * are sent again by `handle_response()`.
+	 *
+	 * @param msg_id ID of the message the reset refers to.
+	 */
+	void handle_reset(message_id_t msg_id)
+	{
+		for (const BulkRequest& r: bulk_requests)
+		{
+			if (r.msg_id == (int)msg_id)
+			{
+				LOG(WARN, "Bulk subscriptions are not supported");
+				bulk_disabled = true;
+				break;
+			}
+		}
+	}
+
+	/**
+	 * Handles a response to a bulk subscription request. The subscriptions that were rejected as
+	 * a whole are sent again one per message.
+	 *
+	 * @param msg_id ID of the message the response refers to.
+	 * @param code Response code.
+	 * @param message The response message.
+	 */
+	ProtocolError handle_response(message_id_t msg_id, CoAPCode::Enum code, Message& message,
+			MessageChannel& channel)
+	{
+		BulkRequest* request = nullptr;
+		for (BulkRequest& r: bulk_requests)
+		{
+			if (r.msg_id == (int)msg_id)
+			{
+				request = &r;
+				break;
+			}
+		}
+		if (!request)
+		{
+			return NO_ERROR;
+		}
+		const BulkRequest req = *request;
+		request->msg_id = -1;
+		request->count = 0;
+		if (CoAPCode::is_success(code))
+		{
+			size_t payload_len = 0;
+			const uint8_t* payload = CoAP::find_payload(message.buf(), message.length(), &payload_len);
+			for (size_t i = 0; i < req.count && payload && i < payload_len; i++)
+			{
+				if (payload[i])
+				{
+					LOG(WARN, "Subscription \"%s\" rejected: %d", event_handlers[req.handlers[i]].filter,
+							(int)payload[i]);
+				}
+			}
+			return NO_ERROR;
+		}
+		if (((int)code >> 5) == 4)
+		{
+			LOG(WARN, "Bulk subscriptions are not supported");
+			bulk_disabled = true;
+		}
+		// The message buffer is reused by the channel, the response is not accessed from now on
+		for (size_t i = 0; i < req.count; i++)
+		{
+			const FilteringEventHandler& handler = event_handlers[req.handlers[i]];
+			if (!handler.handler)
+			{
+				continue;
+			}
+			const ProtocolError error = send_subscription(channel, handler);
+			if (error)
+			{
+				return error;
+			}
+		}
+		return NO_ERROR;
 	}
 
 	uint32_t compute_subscriptions_checksum(calculate_crc_fn calculate_crc)
@@ -219,6 +445,8 @@ public:
 
 	void remove_event_handlers(const char* event_name)
 	{
+		// The pending requests refer to the handlers by their indices
+		cancel_bulk_requests();
 		if (NULL == event_name)
 		{
 			memset(event_handlers, 0, sizeof(event_handlers));
@@ -314,6 +542,10 @@ public:
 
 	inline ProtocolError send_subscriptions(MessageChannel& channel)
 	{
+		if (!bulk_disabled)
+		{
+			return send_bulk_subscriptions(channel);
+		}
 		ProtocolError result = for_each([&](const FilteringEventHandler& handler){return send_subscription(channel, handler);});
 		if (result==NO_ERROR) {
 			//
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+namespace particle
+{
+namespace protocol
+{
+
+/**
+ * Token bucket rate limiter.
+ *
+ * A token is added to the bucket every `interval` milliseconds, up to `burst` tokens. Each
+ * operation consumes one token, so the sustained rate is limited to one operation per interval,
+ * while up to `burst` operations can be performed back to back after a period of inactivity.
+ *
+ * The bucket is initially full. All time values are tick counts, so the millisecond counter is
+ * allowed to overflow.
+ */
+class TokenBucket
+{
+public:
+    TokenBucket(system_tick_t interval, unsigned burst) :
+            interval(interval ? interval : 1),
+            burst(burst ? burst : 1),
+            tokens(this->burst),
+            last_refill(0),
+            started(false)
+    {
+    }
+
+    /**
+     * Changes the refill interval and the bucket capacity. The accumulated tokens exceeding
+     * the new capacity are discarded.
+     */
+    void configure(system_tick_t interval, unsigned burst)
+    {
+        this->interval = interval ? interval : 1;
+        this->burst = burst ? burst : 1;
+        if (tokens > this->burst)
+        {
+            tokens = this->burst;
+        }
+    }
+
+    /**
+     * Consumes a token if one is available.
+     *
+     * @return {@code true} if the operation is allowed.
+     */
+    bool consume(system_tick_t now)
+    {
+        refill(now);
+        if (!tokens)
+        {
+            return false;
+        }
+        if (tokens == burst)
+        {
+            // The bucket was full, so the refill period starts now
+            last_refill = now;
+        }
+        --tokens;
+        return true;
+    }
+
+    /**
+     * Returns the time in milliseconds until a token becomes available, or 0 if a token is
+     * available now.
+     */
+    system_tick_t wait_time(system_tick_t now)
+    {
+        refill(now);
+        if (tokens)
+        {
+            return 0;
+        }
+        return interval - (now - last_refill);
+    }
+
+    /**
+     * Returns the number of available tokens.
+     */
+    unsigned available(system_tick_t now)
+    {
+        refill(now);
+        return tokens;
+    }
+
+    /**
+     * Refills the bucket.
+     */
+    void reset()
+    {
+        tokens = burst;
+        started = false;
+    }
+
+    system_tick_t refill_interval() const
+    {
+        return interval;
+    }
+
+    unsigned capacity() const
+    {
+        return burst;
+    }
+
+private:
+    system_tick_t interval;
+    unsigned burst;
+    unsigned tokens;
+    system_tick_t last_refill;
+    bool started;
+
+    void refill(system_tick_t now)
+    {
+        if (!started)
+        {
+            last_refill = now;
+            started = true;
+            return;
+        }
+        if (tokens >= burst)
+        {
+            return;
+        }
+        const system_tick_t elapsed = now - last_refill;
+        const system_tick_t n = elapsed / interval;
+        if (n)
+        {
+            if (n >= burst - tokens)
+            {
+                tokens = burst;
+            }
+            else
+            {
+                tokens += n;
+                // Keep the fractional part of the refill period
+                last_refill += n * interval;
+            }
+        }
+    }
+};
+
+} // namespace protocol
+} // namespace particle
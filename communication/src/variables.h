@@ -24,6 +24,8 @@
 #include "message_channel.h"
 #include "messages.h"
 #include "spark_descriptor.h"
+#include "coap.h"
+#include "logging.h"
 
 
 namespace particle
@@ -33,38 +35,108 @@ namespace protocol
 
 class Variables
 {
+public:
+    /**
+     * Maximum number of variables that can be observed concurrently (RFC 7641).
+     */
+    static const unsigned MAX_VARIABLE_OBSERVERS = 4;
 
+    /**
+     * Default minimum interval between two notifications sent for the same variable.
+     */
+    static const system_tick_t DEFAULT_OBSERVE_MIN_INTERVAL = 1000;
 
-public:
+    /**
+     * Value of the Observe option that registers an observer.
+     */
+    static const uint32_t OBSERVE_REGISTER = 0;
+
+    /**
+     * Value of the Observe option that deregisters an observer.
+     */
+    static const uint32_t OBSERVE_DEREGISTER = 1;
+
+    /**
+     * Indicates that a request has no Observe option.
+     */
+    static const int32_t OBSERVE_NONE = -1;
 
-    ProtocolError decode_variable_request(char variable_key[MAX_VARIABLE_KEY_LENGTH+1], Message& message)
+    typedef SparkReturnType::Enum (*variable_type_fn)(const char *variable_key);
+    typedef const void *(*get_variable_fn)(const char *variable_key);
+    typedef uint32_t (*calculate_crc_fn)(const unsigned char *buf, uint32_t buflen);
+
+    Variables() :
+            min_interval(DEFAULT_OBSERVE_MIN_INTERVAL),
+            max_interval(0),
+            confirmable_ratio(0),
+            last_check(0)
     {
-        uint8_t* queue = message.buf();
-        uint8_t queue_offset = 8;
+        reset();
+    }
 
-        // copy the variable key
-        size_t variable_key_length;
-        if (queue[7] == 0x0d) {
-            variable_key_length = 0x0d + (queue[8] & 0xFF);
-            queue_offset++;
-        } else {
-            variable_key_length = queue[7] & 0x0F;
-        }
-        if (variable_key_length > MAX_VARIABLE_KEY_LENGTH) {
+    ProtocolError decode_variable_request(char variable_key[MAX_VARIABLE_KEY_LENGTH+1], Message& message,
+            int32_t* observe=nullptr)
+    {
+        // The variable key is the second Uri-Path option, following "v"
+        size_t variable_key_length = 0;
+        const uint8_t* key = CoAP::find_option(message.buf(), message.length(), CoAPOption::URI_PATH,
+                &variable_key_length, 1);
+        if (!key) {
+            variable_key_length = 0;
+        } else if (variable_key_length > MAX_VARIABLE_KEY_LENGTH) {
             variable_key_length = MAX_VARIABLE_KEY_LENGTH;
         }
-
-        memcpy(variable_key, queue + queue_offset, variable_key_length);
+        if (variable_key_length) {
+            memcpy(variable_key, key, variable_key_length);
+        }
         memset(variable_key + variable_key_length, 0, MAX_VARIABLE_KEY_LENGTH+1 - variable_key_length);
+        if (observe) {
+            size_t observe_length = 0;
+            const uint8_t* value = CoAP::find_option(message.buf(), message.length(), CoAPOption::OBSERVE,
+                    &observe_length);
+            *observe = value ? (int32_t)CoAP::option_uint(value, observe_length) : OBSERVE_NONE;
+        }
         return NO_ERROR;
     }
 
     ProtocolError handle_variable_request(char* variable_key, Message& message, MessageChannel& channel, token_t token, message_id_t message_id,
-        SparkReturnType::Enum (*variable_type)(const char *variable_key),
-        const void *(*get_variable)(const char *variable_key))
+        variable_type_fn variable_type, get_variable_fn get_variable, int32_t observe=OBSERVE_NONE,
+        system_tick_t now=0, calculate_crc_fn calculate_crc=nullptr)
     {
         uint8_t* queue = message.buf();
         message.set_id(message_id);
+        if (observe != OBSERVE_NONE)
+        {
+            Observer* observer = nullptr;
+            if (observe == (int32_t)OBSERVE_REGISTER)
+            {
+                observer = add_observer(variable_key, token);
+            }
+            else
+            {
+                remove_observer(variable_key);
+            }
+            if (observer)
+            {
+                // The response to the registration request is the first notification
+                size_t size = CoAP::header(queue, CoAPType::ACK, CoAPCode::CONTENT, sizeof(token), &token, message_id);
+                size_t payload = 0;
+                size += observe_option(queue + size, observer->sequence);
+                queue[size++] = 0xff; // payload marker
+                const ProtocolError error = encode_value(queue + size, message.capacity() - size, variable_key,
+                        variable_type, get_variable, &payload);
+                if (error)
+                {
+                    remove_observer(variable_key);
+                    return error;
+                }
+                observer->value_crc = calculate_crc ? calculate_crc(queue + size, payload) : 0;
+                observer->last_notified = now;
+                message.set_length(size + payload);
+                return channel.send(message);
+            }
+            // A variable that can't be observed is returned as a regular response
+        }
         // get variable value according to type using the descriptor
         SparkReturnType::Enum var_type = variable_type(variable_key);
         size_t response = 0;
@@ -100,7 +172,302 @@ public:
         message.set_length(response);
         return channel.send(message);
     }
-};
 
+    /**
+     * Marks an observed variable as changed. A notification is sent by the next call to
+     * `process()` once the minimum notification interval has elapsed.
+     *
+     * @return `true` if the variable is being observed.
+     */
+    bool notify(const char* variable_key)
+    {
+        Observer* observer = find_observer(variable_key);
+        if (observer)
+        {
+            observer->changed = true;
+        }
+        return observer != nullptr;
+    }
+
+    /**
+     * Sends notifications to the observers of the variables that have changed since the last
+     * notification. Values are polled for changes at most once per minimum interval, so that
+     * variables that are never explicitly notified are still reported.
+     */
+    ProtocolError process(MessageChannel& channel, system_tick_t now, variable_type_fn variable_type,
+            get_variable_fn get_variable, calculate_crc_fn calculate_crc)
+    {
+        if (!observer_count)
+        {
+            return NO_ERROR;
+        }
+        const bool check = (now - last_check >= min_interval);
+        if (check)
+        {
+            last_check = now;
+        }
+        for (Observer& observer: observers)
+        {
+            if (!observer.active)
+            {
+                continue;
+            }
+            const system_tick_t elapsed = now - observer.last_notified;
+            if (elapsed < min_interval)
+            {
+                continue;
+            }
+            const bool refresh = (max_interval && elapsed >= max_interval);
+            if (!observer.changed && !check && !refresh)
+            {
+                continue;
+            }
+            Message message;
+            channel.create(message);
+            uint8_t* buf = message.buf();
+            size_t payload = 0;
+            const ProtocolError error = encode_value(buf, message.capacity(), observer.key, variable_type,
+                    get_variable, &payload);
+            if (error)
+            {
+                // The variable is no longer available
+                remove_observer(observer.key);
+                continue;
+            }
+            const uint32_t crc = calculate_crc ? calculate_crc(buf, payload) : 0;
+            if (!observer.changed && !refresh && crc == observer.value_crc)
+            {
+                continue;
+            }
+            // Move the value past the header and the Observe option
+            const bool confirmable = (confirmable_ratio && (observer.notifications % confirmable_ratio) == 0);
+            uint8_t header[16];
+            observer.sequence = (observer.sequence + 1) & 0xffffff;
+            size_t size = CoAP::header(header, confirmable ? CoAPType::CON : CoAPType::NON, CoAPCode::CONTENT,
+                    sizeof(observer.token), &observer.token);
+            size += observe_option(header + size, observer.sequence);
+            header[size++] = 0xff; // payload marker
+            if (size + payload > message.capacity())
+            {
+                payload = message.capacity() - size;
+            }
+            memmove(buf + size, buf, payload);
+            memcpy(buf, header, size);
+            message.set_length(size + payload);
+            message.set_confirm_received(confirmable);
+            const ProtocolError result = channel.send(message);
+            if (result)
+            {
+                return result;
+            }
+            observer.last_id = message.get_id();
+            observer.value_crc = crc;
+            observer.last_notified = now;
+            observer.changed = false;
+            ++observer.notifications;
+        }
+        return NO_ERROR;
+    }
+
+    /**
+     * Handles a reset message sent by the server in reply to a notification, which cancels
+     * the observation (RFC 7641, 3.6).
+     *
+     * @return `true` if the message ID matched a notification.
+     */
+    bool handle_reset(message_id_t message_id)
+    {
+        for (Observer& observer: observers)
+        {
+            if (observer.active && observer.last_id == message_id)
+            {
+                remove_observer(observer.key);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Removes all observers. The server re-registers its observations at the start of each session.
+     */
+    void reset()
+    {
+        memset(observers, 0, sizeof(observers));
+        for (Observer& observer: observers)
+        {
+            observer.last_id = -1;
+        }
+        observer_count = 0;
+    }
+
+    void set_min_interval(system_tick_t interval)
+    {
+        min_interval = interval;
+    }
+
+    void set_max_interval(system_tick_t interval)
+    {
+        max_interval = interval;
+    }
+
+    /**
+     * Sets how often notifications are sent as confirmable messages: every Nth notification
+     * is confirmable, 0 means all notifications are non-confirmable.
+     */
+    void set_confirmable_ratio(unsigned ratio)
+    {
+        confirmable_ratio = ratio;
+    }
+
+    /**
+     * Returns the number of variables being observed.
+     */
+    unsigned observed_count() const
+    {
+        return observer_count;
+    }
+
+private:
+    struct Observer
+    {
+        char key[MAX_VARIABLE_KEY_LENGTH+1];
+        token_t token;
+        bool active;
+        bool changed;
+        uint32_t sequence;
+        uint32_t value_crc;
+        uint32_t notifications;
+        system_tick_t last_notified;
+        message_id_t last_id;
+    };
+
+    Observer observers[MAX_VARIABLE_OBSERVERS];
+    unsigned observer_count;
+    system_tick_t min_interval;
+    system_tick_t max_interval;
+    unsigned confirmable_ratio;
+    system_tick_t last_check;
+
+    Observer* find_observer(const char* variable_key)
+    {
+        for (Observer& observer: observers)
+        {
+            if (observer.active && !strncmp(observer.key, variable_key, MAX_VARIABLE_KEY_LENGTH))
+            {
+                return &observer;
+            }
+        }
+        return nullptr;
+    }
+
+    Observer* add_observer(const char* variable_key, token_t token)
+    {
+        Observer* observer = find_observer(variable_key);
+        if (!observer)
+        {
+            for (Observer& o: observers)
+            {
+                if (!o.active)
+                {
+                    observer = &o;
+                    break;
+                }
+            }
+            if (!observer)
+            {
+                LOG(WARN, "Too many variable observers");
+                return nullptr;
+            }
+            memset(observer, 0, sizeof(Observer));
+            strncpy(observer->key, variable_key, MAX_VARIABLE_KEY_LENGTH);
+            observer->active = true;
+            ++observer_count;
+        }
+        // A repeated registration replaces the token of the existing one
+        observer->token = token;
+        observer->last_id = -1;
+        observer->changed = false;
+        return observer;
+    }
+
+    void remove_observer(const char* variable_key)
+    {
+        Observer* observer = find_observer(variable_key);
+        if (observer)
+        {
+            observer->active = false;
+            observer->last_id = -1;
+            --observer_count;
+        }
+    }
+
+    static size_t observe_option(uint8_t* buf, uint32_t sequence)
+    {
+        uint8_t value[4];
+        const size_t length = CoAP::encode_option_uint(value, sequence);
+        return CoAP::add_option(buf, CoAPOption::NONE, CoAPOption::OBSERVE, value, length);
+    }
+
+    /**
+     * Encodes the value of a variable in the same format as `Messages::variable_value()`.
+     */
+    static ProtocolError encode_value(uint8_t* buf, size_t capacity, const char* variable_key,
+            variable_type_fn variable_type, get_variable_fn get_variable, size_t* size)
+    {
+        const void* value = get_variable(variable_key);
+        if (!value)
+        {
+            return INVALID_STATE;
+        }
+        switch (variable_type(variable_key))
+        {
+        case SparkReturnType::BOOLEAN:
+            if (capacity < 1)
+            {
+                return INSUFFICIENT_STORAGE;
+            }
+            buf[0] = *(const bool*)value ? 1 : 0;
+            *size = 1;
+            break;
+        case SparkReturnType::INT:
+        {
+            if (capacity < 4)
+            {
+                return INSUFFICIENT_STORAGE;
+            }
+            const int v = *(const int*)value;
+            buf[0] = v >> 24;
+            buf[1] = v >> 16 & 0xff;
+            buf[2] = v >> 8 & 0xff;
+            buf[3] = v & 0xff;
+            *size = 4;
+            break;
+        }
+        case SparkReturnType::DOUBLE:
+            if (capacity < sizeof(double))
+            {
+                return INSUFFICIENT_STORAGE;
+            }
+            memcpy(buf, value, sizeof(double));
+            *size = sizeof(double);
+            break;
+        case SparkReturnType::STRING:
+        {
+            size_t length = strlen((const char*)value);
+            if (length > capacity)
+            {
+                length = capacity;
+            }
+            memcpy(buf, value, length);
+            *size = length;
+            break;
+        }
+        default:
+            return INVALID_STATE;
+        }
+        return NO_ERROR;
+    }
+};
 
 }}
@@ -34,6 +34,45 @@ extern "C" {
 
 typedef struct MDM_BandSelect MDM_BandSelect;
 
+/**
+ * Priority of an asynchronous AT command.
+ */
+typedef enum cellular_command_priority {
+    CELLULAR_COMMAND_PRIORITY_LOW = 0,
+    CELLULAR_COMMAND_PRIORITY_NORMAL = 1,
+    CELLULAR_COMMAND_PRIORITY_HIGH = 2
+} cellular_command_priority;
+
+/**
+ * Final result code of an asynchronous AT command.
+ */
+typedef enum cellular_command_result {
+    CELLULAR_COMMAND_RESULT_OK = 0,
+    CELLULAR_COMMAND_RESULT_ERROR = 1,
+    CELLULAR_COMMAND_RESULT_BUSY = 2,
+    CELLULAR_COMMAND_RESULT_NO_ANSWER = 3,
+    CELLULAR_COMMAND_RESULT_NO_CARRIER = 4,
+    CELLULAR_COMMAND_RESULT_NO_DIALTONE = 5,
+    CELLULAR_COMMAND_RESULT_CME_ERROR = 6,
+    CELLULAR_COMMAND_RESULT_CMS_ERROR = 7
+} cellular_command_result;
+
+/**
+ * Callback invoked for each line of the response to an asynchronous AT command.
+ *
+ * The line is passed without the line terminator. Returning a negative result code cancels
+ * the command.
+ */
+typedef int (*cellular_command_line_fn)(const char* line, size_t size, void* data);
+
+/**
+ * Callback invoked when an asynchronous AT command completes.
+ *
+ * `result` is one of the values defined by `cellular_command_result`, or a negative result code
+ * in case of an error. `error_code` is the error code reported via "+CME ERROR" or "+CMS ERROR".
+ */
+typedef void (*cellular_command_done_fn)(int result, int error_code, void* data);
+
 typedef enum SimType {
     INVALID_SIM = 0,
     INTERNAL_SIM = 1,
@@ -130,12 +169,34 @@ void cellular_cancel(bool cancel, bool calledFromISR, void* reserved);
  */
 cellular_result_t cellular_signal(CellularSignalHal* signal, cellular_signal_t* reserved);
 
+/**
+ * Query the modem for the current signal strength info. Subsequent calls to `cellular_signal()`
+ * return the updated values.
+ */
+cellular_result_t cellular_signal_refresh(void* reserved);
+
 /**
  * Send an AT command and wait for response, optionally specify a callback function to parse the results
  */
 cellular_result_t cellular_command(_CALLBACKPTR_MDM cb, void* param,
                          system_tick_t timeout_ms, const char* format, ...);
 
+/**
+ * Queue an AT command without waiting for the response.
+ *
+ * The command is sent to the modem once the commands with a higher priority and the ones queued
+ * earlier have completed. The callbacks are invoked by the networking thread and should not block.
+ *
+ * @return Command ID, or a negative result code in case of an error.
+ */
+int cellular_command_async(int priority, cellular_command_line_fn line_fn, cellular_command_done_fn done_fn,
+        void* data, system_tick_t timeout_ms, const char* format, ...);
+
+/**
+ * Cancel a queued AT command. A command that has already been sent to the modem cannot be cancelled.
+ */
+int cellular_command_cancel(int id, void* reserved);
+
 /**
  * Set cellular data usage info
  */
@@ -128,6 +128,8 @@ typedef struct
     };
     // In % mapped to [0, 65535]
     int32_t quality;
+    // Time elapsed since the signal was measured, in milliseconds
+    uint32_t age;
 } cellular_signal_t;
 
 #ifdef __cplusplus
@@ -254,6 +254,16 @@ bool HAL_Feature_Get(HAL_Feature feature);
  */
 extern void module_user_init_hook(void);
 
+/**
+ * Offset of the OTA transfer checkpoint in the system backup memory. The cloud session is stored
+ * at offset 0.
+ */
+#define HAL_SYSTEM_BACKUP_OTA_OFFSET    (0x1000)
+/**
+ * Maximum size of the OTA transfer checkpoint.
+ */
+#define HAL_SYSTEM_BACKUP_OTA_SIZE      (176)
+
 int HAL_System_Backup_Save(size_t offset, const void* buffer, size_t length, void* reserved);
 int HAL_System_Backup_Restore(size_t offset, void* buffer, size_t max_length, size_t* length, void* reserved);
 
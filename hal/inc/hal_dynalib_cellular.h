@@ -76,10 +76,16 @@ DYNALIB_FN(33, hal_cellular, cellular_set_power_mode, void(int mode, void* reser
 #if !HAL_PLATFORM_MESH
 DYNALIB_FN(34, hal_cellular, cellular_connect, cellular_result_t(void*))
 DYNALIB_FN(35, hal_cellular, cellular_disconnect, cellular_result_t(void*))
+DYNALIB_FN(36, hal_cellular, cellular_command_async, int(int, cellular_command_line_fn, cellular_command_done_fn, void*, system_tick_t, const char*, ...))
+DYNALIB_FN(37, hal_cellular, cellular_command_cancel, int(int, void*))
+DYNALIB_FN(38, hal_cellular, cellular_signal_refresh, cellular_result_t(void*))
 #else // HAL_PLATFORM_MESH
 DYNALIB_FN(34, hal_cellular, cellular_set_active_sim, cellular_result_t(int, void*))
 DYNALIB_FN(35, hal_cellular, cellular_get_active_sim, cellular_result_t(int*, void*))
 DYNALIB_FN(36, hal_cellular, cellular_credentials_clear, int(void*))
+DYNALIB_FN(37, hal_cellular, cellular_command_async, int(int, cellular_command_line_fn, cellular_command_done_fn, void*, system_tick_t, const char*, ...))
+DYNALIB_FN(38, hal_cellular, cellular_command_cancel, int(int, void*))
+DYNALIB_FN(39, hal_cellular, cellular_signal_refresh, cellular_result_t(void*))
 #endif // !HAL_PLATFORM_MESH
 
 DYNALIB_END(hal_cellular)
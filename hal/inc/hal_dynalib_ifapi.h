@@ -65,6 +65,11 @@ DYNALIB_FN(28, hal_ifapi, if_event_handler_add_if, if_event_handler_cookie_t(if_
 DYNALIB_FN(29, hal_ifapi, if_event_handler_self, if_event_handler_cookie_t(if_t, if_event_handler_t, void*))
 DYNALIB_FN(30, hal_ifapi, if_event_handler_del, int(if_event_handler_cookie_t))
 DYNALIB_FN(31, hal_ifapi, if_request, int(if_t, int, void*, size_t, void*))
+DYNALIB_FN(32, hal_ifapi, if_get_mem_pool_stats, int(int, struct if_mem_pool_stats*, void*))
+DYNALIB_FN(33, hal_ifapi, if_set_mem_profile, int(const struct if_mem_profile*, void*))
+DYNALIB_FN(34, hal_ifapi, if_get_mem_profile, int(struct if_mem_profile*, void*))
+DYNALIB_FN(35, hal_ifapi, if_set_dhcp_cache_config, int(const struct if_dhcp_cache_config*, void*))
+DYNALIB_FN(36, hal_ifapi, if_get_dhcp_cache_config, int(struct if_dhcp_cache_config*, void*))
 
 DYNALIB_END(hal_ifapi)
 
@@ -38,6 +38,8 @@ DYNALIB_FN(1, hal_netdb, netdb_gethostbyname_r, int(const char*, struct hostent*
 DYNALIB_FN(2, hal_netdb, netdb_freeaddrinfo, void(struct addrinfo*))
 DYNALIB_FN(3, hal_netdb, netdb_getaddrinfo, int(const char*, const char*, const struct addrinfo*, struct addrinfo**))
 DYNALIB_FN(4, hal_netdb, netdb_getnameinfo, int(const struct sockaddr*, socklen_t, char*, socklen_t, char*, socklen_t, int))
+DYNALIB_FN(5, hal_netdb, netdb_getaddrinfo_async, int(const char*, const char*, const struct addrinfo*, netdb_getaddrinfo_callback_t, void*, netdb_getaddrinfo_request_t*))
+DYNALIB_FN(6, hal_netdb, netdb_getaddrinfo_cancel, int(netdb_getaddrinfo_request_t))
 
 DYNALIB_END(hal_netdb)
 
@@ -51,6 +51,9 @@ DYNALIB_FN(6, hal_ota, HAL_FLASH_Update, int(const uint8_t*, uint32_t, uint32_t,
 DYNALIB_FN(7, hal_ota, HAL_FLASH_End, hal_update_complete_t(hal_module_t*))
 DYNALIB_FN(8, hal_ota, HAL_FLASH_OTA_Validate, int(hal_module_t*, bool, module_validation_flags_t, void*))
 DYNALIB_FN(9, hal_ota, HAL_OTA_Add_System_Info, void(hal_system_info_t* info, bool create, void* reserved))
+DYNALIB_FN(10, hal_ota, HAL_FLASH_Erase_Ahead, int(uint32_t, void*))
+DYNALIB_FN(11, hal_ota, HAL_FLASH_Read, int(uint8_t*, uint32_t, uint32_t, void*))
+DYNALIB_FN(12, hal_ota, HAL_FLASH_Resume, bool(uint32_t, uint32_t, uint32_t, const uint8_t*, void*))
 DYNALIB_END(hal_ota)
 
 #endif	/* HAL_DYNALIB_OTA_H */
@@ -79,6 +79,13 @@ DYNALIB_FN(BASE_IDX2 + 1, hal_usart, HAL_USART_Write_NineBitData, uint32_t(HAL_U
 DYNALIB_FN(BASE_IDX2 + 2, hal_usart, HAL_USART_Send_Break, void(HAL_USART_Serial, void*))
 DYNALIB_FN(BASE_IDX2 + 3, hal_usart, HAL_USART_Break_Detected, uint8_t(HAL_USART_Serial))
 
+#if HAL_PLATFORM_USART_BULK
+DYNALIB_FN(BASE_IDX2 + 4, hal_usart, HAL_USART_Init_Ex, int(HAL_USART_Serial, const HAL_USART_Buffer_Config*, void*))
+DYNALIB_FN(BASE_IDX2 + 5, hal_usart, HAL_USART_Write, ssize_t(HAL_USART_Serial, const void*, size_t, size_t))
+DYNALIB_FN(BASE_IDX2 + 6, hal_usart, HAL_USART_Read, ssize_t(HAL_USART_Serial, void*, size_t, size_t))
+DYNALIB_FN(BASE_IDX2 + 7, hal_usart, HAL_USART_Peek, ssize_t(HAL_USART_Serial, void*, size_t, size_t))
+#endif // HAL_PLATFORM_USART_BULK
+
 
 DYNALIB_END(hal_usart)
 
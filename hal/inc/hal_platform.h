@@ -122,6 +122,10 @@
 #define HAL_PLATFORM_ETHERNET (0)
 #endif /* HAL_PLATFORM_ETHERNET */
 
+#ifndef HAL_PLATFORM_USART_BULK
+#define HAL_PLATFORM_USART_BULK (0)
+#endif /* HAL_PLATFORM_USART_BULK */
+
 #ifndef HAL_PLATFORM_I2C1
 #define HAL_PLATFORM_I2C1 (1)
 #endif /* HAL_PLATFORM_I2C1 */
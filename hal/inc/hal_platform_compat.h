@@ -64,6 +64,10 @@
 
 #define HAL_PLATFORM_USB_CDC (1)
 
+#if PLATFORM_ID == 3
+#define HAL_PLATFORM_USART_BULK (1)
+#endif // PLATFORM_ID == 3
+
 #if PLATFORM_ID >= PLATFORM_PHOTON_PRODUCTION && PLATFORM_ID != PLATFORM_NEWHAL
 #define HAL_PLATFORM_USB_HID (1)
 #define HAL_PLATFORM_USB_COMPOSITE (1)
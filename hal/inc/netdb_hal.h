@@ -107,6 +107,52 @@ int netdb_getaddrinfo(const char* hostname, const char* servname,
 int netdb_getnameinfo(const struct sockaddr* sa, socklen_t salen, char* host,
                       socklen_t hostlen, char* serv, socklen_t servlen, int flags);
 
+/**
+ * ID of an asynchronous address resolution request. Valid IDs are positive.
+ */
+typedef int netdb_getaddrinfo_request_t;
+
+/**
+ * Completion callback of an asynchronous address resolution request.
+ *
+ * @param[in]  error  0 on success or non-zero error code in case of failure
+ * @param[in]  res    linked list of addrinfo structures, should be freed with netdb_freeaddrinfo()
+ * @param[in]  ctx    user context
+ */
+typedef void (*netdb_getaddrinfo_callback_t)(int error, struct addrinfo* res, void* ctx);
+
+/**
+ * Asynchronous variant of netdb_getaddrinfo().
+ *
+ * When hints are not provided or hints->ai_family is AF_UNSPEC, the IPv6 and IPv4 lookups
+ * are performed concurrently. The callback is invoked exactly once, unless the request is
+ * cancelled, either from the calling thread (if the result is immediately available) or from
+ * the system thread. It is never invoked with the network stack locked, so it can use the
+ * socket and netdb functions.
+ *
+ * @param[in]  hostname  the hostname
+ * @param[in]  servname  the service name
+ * @param[in]  hints     the hints
+ * @param[in]  callback  completion callback
+ * @param[in]  ctx       user context passed to the callback
+ * @param[out] req       on success, set to the request ID or 0 if the request has already completed
+ *
+ * @returns    0 on success or non-zero error code in case of failure.
+ */
+int netdb_getaddrinfo_async(const char* hostname, const char* servname, const struct addrinfo* hints,
+                            netdb_getaddrinfo_callback_t callback, void* ctx, netdb_getaddrinfo_request_t* req);
+
+/**
+ * Cancels an asynchronous address resolution request. The completion callback of the request is
+ * not invoked after this function returns.
+ *
+ * @param[in]  req       the request ID
+ *
+ * @returns    0 on success or non-zero error code if the request has already completed, in which
+ *             case the callback may still be running.
+ */
+int netdb_getaddrinfo_cancel(netdb_getaddrinfo_request_t req);
+
 /**
  * @}
  *
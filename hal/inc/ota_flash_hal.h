@@ -129,12 +129,41 @@ int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_vali
  */
 bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved);
 
+/**
+ * Continues an update of the OTA region that was interrupted, keeping the data that has already
+ * been written. Platforms that erase the region lazily use the chunk bitmap to avoid erasing the
+ * sectors that hold the written chunks.
+ * @param address       The start address of the region passed to `HAL_FLASH_Begin()`.
+ * @param length
+ * @param chunk_size    Size of the chunks the image is written in.
+ * @param chunk_bitmap  Bitmap of the written chunks. Bit 0 of the first byte corresponds to the
+ *                      first chunk.
+ */
+bool HAL_FLASH_Resume(uint32_t address, uint32_t length, uint32_t chunk_size, const uint8_t* chunk_bitmap, void* reserved);
+
 /**
  * Updates part of the OTA image.
  * @result 0 on success. non-zero on error.
  */
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved);
 
+/**
+ * Erases part of the OTA region ahead of the current write position. Platforms that erase the
+ * region lazily in `HAL_FLASH_Update()` can use this function to move some of the erase work to
+ * the time when the device is idle.
+ * @param max_sectors   Maximum number of sectors to erase.
+ * @result Number of erased sectors, or a negative error code.
+ */
+int HAL_FLASH_Erase_Ahead(uint32_t max_sectors, void* reserved);
+
+/**
+ * Reads back part of the OTA image written with `HAL_FLASH_Update()`. This is used to verify the
+ * staged data before an interrupted update is resumed. Platforms that can't continue writing an
+ * update without erasing the region again return an error.
+ * @result 0 on success. non-zero on error.
+ */
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved);
+
 typedef enum {
     HAL_UPDATE_ERROR,
     HAL_UPDATE_APPLIED_PENDING_RESTART,
@@ -199,6 +199,55 @@ struct if_event {
 
 typedef void (*if_event_handler_t)(void* arg, if_t iface, const struct if_event* ev);
 
+/* Memory pools of the network stack */
+enum if_mem_pool_t {
+    IF_MEM_POOL_HEAP     = 0, /* Heap used for PBUF_RAM buffers and other variable-size allocations (bytes) */
+    IF_MEM_POOL_PBUF     = 1, /* Receive buffer pool */
+    IF_MEM_POOL_PBUF_REF = 2, /* Buffer headers referencing external data */
+    IF_MEM_POOL_TCP_PCB  = 3,
+    IF_MEM_POOL_TCP_SEG  = 4,
+    IF_MEM_POOL_UDP_PCB  = 5,
+    IF_MEM_POOL_COUNT
+};
+
+struct if_mem_pool_stats {
+    uint16_t size; /* Size of this structure */
+    uint16_t reserved;
+    uint32_t avail; /* Pool capacity, 0 if unlimited */
+    uint32_t used; /* Current usage */
+    uint32_t peak; /* High-water mark */
+    uint32_t failures; /* Number of failed allocations */
+};
+
+/* The memory pools are allocated from the heap on demand, so the profile can be applied at boot,
+ * before the network is used, to split the memory between the pools */
+struct if_mem_profile {
+    uint16_t size; /* Size of this structure */
+    uint16_t reserved;
+    /* Maximum amount of heap memory the network stack may allocate, including the memory pools,
+     * 0 - no limit */
+    uint32_t heap_limit;
+    /* Default receive buffer quota of new UDP and raw sockets in bytes, 0 - no limit.
+     * Can be overridden for individual sockets with SO_RCVBUF */
+    uint32_t socket_recv_quota;
+    /* Maximum number of buffers queued out of order on a TCP connection, 0 - no limit.
+     * Data received in order is limited by the TCP receive window, which is fixed at compile time */
+    uint32_t tcp_ooseq_quota;
+    /* Maximum number of elements of each memory pool, indexed by if_mem_pool_t, 0 - no limit.
+     * Defaults to the compile-time pool sizes. The entry for IF_MEM_POOL_HEAP is unused, see heap_limit */
+    uint16_t pool_limits[IF_MEM_POOL_COUNT];
+};
+
+/* DHCPv4 lease cache settings */
+struct if_dhcp_cache_config {
+    uint16_t size; /* Size of this structure */
+    uint8_t enabled; /* Request the cached address when rejoining a known network */
+    uint8_t reserved;
+    /* Time in milliseconds after which an unanswered request for the cached address falls back
+     * to DHCPDISCOVER, 0 - leave the retransmissions to the DHCP client */
+    uint32_t fallback_timeout;
+};
+
 typedef struct if_event_power_state if_req_power;
 
 enum if_req_t {
@@ -255,6 +304,13 @@ int if_event_handler_del(if_event_handler_cookie_t cookie);
 
 int if_request(if_t iface, int type, void* req, size_t reqsize, void* reserved);
 
+int if_get_mem_pool_stats(int pool, struct if_mem_pool_stats* stats, void* reserved);
+int if_set_mem_profile(const struct if_mem_profile* profile, void* reserved);
+int if_get_mem_profile(struct if_mem_profile* profile, void* reserved);
+
+int if_set_dhcp_cache_config(const struct if_dhcp_cache_config* conf, void* reserved);
+int if_get_dhcp_cache_config(struct if_dhcp_cache_config* conf, void* reserved);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -50,6 +50,14 @@ if_t BaseNetif::interface() {
     return (if_t)&netif_;
 }
 
+unsigned int BaseNetif::getMetric() const {
+    return metric_;
+}
+
+void BaseNetif::setMetric(unsigned int metric) {
+    metric_ = metric;
+}
+
 void BaseNetif::ifEventCb(void* arg, if_t iface, const if_event* ev) {
     BaseNetif* self = static_cast<BaseNetif*>(arg);
     if (self && self->interface() == iface) {
@@ -36,6 +36,10 @@ public:
     virtual int powerUp() = 0;
     virtual int powerDown() = 0;
 
+    /* Routing preference, lower values are preferred */
+    unsigned int getMetric() const;
+    void setMetric(unsigned int metric);
+
 protected:
     void registerHandlers();
 
@@ -51,6 +55,7 @@ protected:
 
 private:
     netif_ext_callback_t netifEventHandlerCookie_;
+    unsigned int metric_ = 0;
     if_event_handler_cookie_t eventHandlerCookie_ = nullptr;
     static uint8_t clientDataId_;
     static std::once_flag once_;
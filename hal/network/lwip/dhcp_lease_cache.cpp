@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "logging.h"
+LOG_SOURCE_CATEGORY("net.dhcp")
+
+#include "dhcp_lease_cache.h"
+
+#include "lwiplock.h"
+#include "rtc_hal.h"
+#include "timer_hal.h"
+#include "system_error.h"
+#include "check.h"
+
+#if HAL_PLATFORM_FILESYSTEM
+#include "filesystem.h"
+#include "file_util.h"
+#include "scope_guard.h"
+#endif // HAL_PLATFORM_FILESYSTEM
+
+#include <lwip/dhcp.h>
+#include <lwip/prot/dhcp.h>
+#include <lwip/timeouts.h>
+
+#include <algorithm>
+#include <cstring>
+
+// FIXME:
+#include "system_threading.h"
+
+#define LEASE_FILE "/sys/dhcp_leases.bin"
+
+namespace particle {
+
+namespace net {
+
+namespace {
+
+const system_tick_t SAVE_DELAY = 1000;
+
+bool isBound(const dhcp* d) {
+    switch (d->state) {
+        case DHCP_STATE_BOUND:
+        case DHCP_STATE_RENEWING:
+        case DHCP_STATE_REBINDING: {
+            return true;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+} // unnamed
+
+DhcpLeaseCache* DhcpLeaseCache::instance() {
+    static DhcpLeaseCache cache;
+    return &cache;
+}
+
+int DhcpLeaseCache::init() {
+    const int r = load();
+    if (r < 0) {
+        LOG(WARN, "Unable to load DHCP leases: %d", r);
+    }
+    LwipTcpIpCoreLock lk;
+    netif_add_ext_callback(&netifCallback_, &DhcpLeaseCache::netifEventCb);
+    return 0;
+}
+
+void DhcpLeaseCache::prepare(netif* iface, const void* key, size_t keySize) {
+    auto net = network(iface);
+    if (!net) {
+        return;
+    }
+    keySize = std::min(keySize, MAX_KEY_SIZE);
+    memcpy(net->key, key, keySize);
+    net->keySize = keySize;
+    auto d = netif_dhcp_data(iface);
+    if (!d || d->state == DHCP_STATE_OFF) {
+        return;
+    }
+    if (!apply(iface) && d->state != DHCP_STATE_INIT) {
+        /* The interface may have been bound to a different network, restart with DHCPDISCOVER
+         * once the link is up */
+        d->state = DHCP_STATE_INIT;
+    }
+}
+
+err_t DhcpLeaseCache::start(netif* iface) {
+    if (!netif_is_link_up(iface)) {
+        /* The cached lease is applied when the interface joins a network, see prepare() */
+        return dhcp_start(iface);
+    }
+    /* dhcp_start() sends DHCPDISCOVER right away if the link is up. Start the client in the INIT
+     * state instead and let dhcp_network_changed() send either a DHCPREQUEST for the cached
+     * address or DHCPDISCOVER */
+    iface->flags &= ~NETIF_FLAG_LINK_UP;
+    const err_t err = dhcp_start(iface);
+    iface->flags |= NETIF_FLAG_LINK_UP;
+    if (err != ERR_OK) {
+        return err;
+    }
+    apply(iface);
+    dhcp_network_changed(iface);
+    return ERR_OK;
+}
+
+bool DhcpLeaseCache::apply(netif* iface) {
+    auto d = netif_dhcp_data(iface);
+    auto net = network(iface);
+    if (!enabled_ || !d || !net || !net->keySize) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(mutex_);
+    const auto lease = store_.find(netif_get_index(iface), net->key, net->keySize);
+    if (!lease) {
+        return false;
+    }
+    /* Right after a reset, the RTC is usually not valid yet and the age of a lease obtained
+     * before the reset is unknown */
+    const bool rtcValid = HAL_RTC_Time_Is_Valid(nullptr);
+    if (store_.isExpired(lease, rtcValid, rtcValid ? (uint32_t)HAL_RTC_Get_UnixTime() : 0,
+            hal_timer_millis(nullptr))) {
+        LOG(TRACE, "Cached lease has expired or its age is unknown");
+        return false;
+    }
+    /* Make the DHCP client request the cached address (INIT-REBOOT) when the link comes up */
+    ip4_addr_set_u32(&d->offered_ip_addr, lease->addr);
+    ip4_addr_set_u32(&d->offered_sn_mask, lease->netmask);
+    ip4_addr_set_u32(&d->offered_gw_addr, lease->gateway);
+    ip_addr_set_ip4_u32(&d->server_ip_addr, lease->server);
+    d->offered_t0_lease = lease->leaseTime;
+    d->state = DHCP_STATE_REBOOTING;
+    d->tries = 0;
+    if (fallbackTimeout_) {
+        sys_untimeout(&DhcpLeaseCache::fallbackTimeoutCb, iface);
+        sys_timeout(fallbackTimeout_, &DhcpLeaseCache::fallbackTimeoutCb, iface);
+    }
+    char addr[IP4ADDR_STRLEN_MAX] = {};
+    ip4addr_ntoa_r(&d->offered_ip_addr, addr, sizeof(addr));
+    LOG(TRACE, "Requesting cached address %s", addr);
+    return true;
+}
+
+void DhcpLeaseCache::clear() {
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        store_.clear();
+    }
+    scheduleSave();
+}
+
+void DhcpLeaseCache::update(netif* iface) {
+    auto d = netif_dhcp_data(iface);
+    auto net = network(iface);
+    if (!d || !net || !net->keySize || !isBound(d) || !dhcp_supplied_address(iface)) {
+        return;
+    }
+    sys_untimeout(&DhcpLeaseCache::fallbackTimeoutCb, iface);
+    DhcpLeaseStore::Lease lease = {};
+    memcpy(lease.key, net->key, net->keySize);
+    lease.keySize = net->keySize;
+    lease.ifIndex = netif_get_index(iface);
+    lease.addr = ip4_addr_get_u32(netif_ip4_addr(iface));
+    lease.netmask = ip4_addr_get_u32(netif_ip4_netmask(iface));
+    lease.gateway = ip4_addr_get_u32(netif_ip4_gw(iface));
+    lease.server = ip4_addr_get_u32(ip_2_ip4(&d->server_ip_addr));
+    lease.leaseTime = d->offered_t0_lease;
+    lease.obtained = HAL_RTC_Time_Is_Valid(nullptr) ? (uint32_t)HAL_RTC_Get_UnixTime() : 0;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (!store_.update(lease, hal_timer_millis(nullptr))) {
+            return;
+        }
+    }
+    scheduleSave();
+}
+
+DhcpLeaseCache::Network* DhcpLeaseCache::network(netif* iface) {
+    const unsigned index = netif_get_index(iface);
+    if (index == 0 || index > MAX_INTERFACES) {
+        return nullptr;
+    }
+    return &networks_[index - 1];
+}
+
+void DhcpLeaseCache::scheduleSave() {
+    dirty_ = true;
+    if (!saveTimer_ && os_timer_create(&saveTimer_, SAVE_DELAY, &DhcpLeaseCache::saveTimerCb, this, true, nullptr)) {
+        saveTimer_ = nullptr;
+        return;
+    }
+    /* Files are written from the system thread, see saveTimerCb() */
+    os_timer_change(saveTimer_, OS_TIMER_CHANGE_START, false, 0, 0xffffffff, nullptr);
+}
+
+void DhcpLeaseCache::netifEventCb(netif* iface, netif_nsc_reason_t reason, const netif_ext_callback_args_t* args) {
+    if (reason & (LWIP_NSC_IPV4_ADDRESS_CHANGED | LWIP_NSC_IPV4_SETTINGS_CHANGED)) {
+        instance()->update(iface);
+    }
+}
+
+void DhcpLeaseCache::fallbackTimeoutCb(void* arg) {
+    const auto iface = static_cast<netif*>(arg);
+    auto d = netif_dhcp_data(iface);
+    if (d && d->state == DHCP_STATE_REBOOTING) {
+        LOG(TRACE, "No reply to INIT-REBOOT request, falling back to DHCPDISCOVER");
+        dhcp_start(iface);
+    }
+}
+
+void DhcpLeaseCache::saveTimerCb(os_timer_t timer) {
+    /* Neither the timer daemon task nor the LwIP thread is suitable for file operations, as they
+     * have small stacks and shouldn't block on the filesystem lock */
+    const auto self = instance();
+    if (!self->dirty_ || self->savePending_) {
+        return;
+    }
+    const auto task = new(std::nothrow) ISRTaskQueue::Task();
+    if (!task) {
+        /* Retry later */
+        os_timer_change(self->saveTimer_, OS_TIMER_CHANGE_START, false, 0, 0xffffffff, nullptr);
+        return;
+    }
+    self->savePending_ = true;
+    task->func = [](ISRTaskQueue::Task* task) {
+        delete task;
+        const auto self = instance();
+        self->savePending_ = false;
+        if (self->dirty_) {
+            self->dirty_ = false;
+            const int r = self->save();
+            if (r < 0) {
+                LOG(WARN, "Unable to save DHCP leases: %d", r);
+            }
+        }
+    };
+    SystemISRTaskQueue.enqueue(task);
+}
+
+#if HAL_PLATFORM_FILESYSTEM
+
+int DhcpLeaseCache::load() {
+    const auto fs = filesystem_get_instance(nullptr);
+    CHECK_TRUE(fs, SYSTEM_ERROR_FILE);
+    fs::FsLock lock(fs);
+    CHECK(filesystem_mount(fs));
+    lfs_file_t file = {};
+    CHECK(openFile(&file, LEASE_FILE, LFS_O_RDONLY));
+    SCOPE_GUARD({
+        lfs_file_close(&fs->instance, &file);
+    });
+    uint8_t data[DhcpLeaseStore::SERIALIZED_SIZE] = {};
+    const lfs_ssize_t size = lfs_file_read(&fs->instance, &file, data, sizeof(data));
+    CHECK_TRUE(size >= 0, SYSTEM_ERROR_FILE);
+    std::lock_guard<std::mutex> lk(mutex_);
+    return store_.deserialize(data, size);
+}
+
+int DhcpLeaseCache::save() {
+    uint8_t data[DhcpLeaseStore::SERIALIZED_SIZE] = {};
+    int size = 0;
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        size = CHECK(store_.serialize(data, sizeof(data)));
+    }
+    const auto fs = filesystem_get_instance(nullptr);
+    CHECK_TRUE(fs, SYSTEM_ERROR_FILE);
+    fs::FsLock lock(fs);
+    CHECK(filesystem_mount(fs));
+    lfs_file_t file = {};
+    CHECK(openFile(&file, LEASE_FILE, LFS_O_WRONLY));
+    SCOPE_GUARD({
+        lfs_file_close(&fs->instance, &file);
+    });
+    CHECK_TRUE(lfs_file_truncate(&fs->instance, &file, 0) == LFS_ERR_OK, SYSTEM_ERROR_FILE);
+    CHECK_TRUE(lfs_file_write(&fs->instance, &file, data, size) == size, SYSTEM_ERROR_FILE);
+    return 0;
+}
+
+#else
+
+int DhcpLeaseCache::load() {
+    return 0;
+}
+
+int DhcpLeaseCache::save() {
+    /* Leases are only cached in RAM */
+    return 0;
+}
+
+#endif // HAL_PLATFORM_FILESYSTEM
+
+} // particle::net
+
+} // particle
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "hal_platform.h"
+
+#include "concurrent_hal.h"
+#include "dhcp_lease_store.h"
+
+#include <lwip/netif.h>
+
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+namespace net {
+
+/**
+ * Persistent cache of DHCPv4 leases.
+ *
+ * Leases are keyed by the interface index and a network identifier, such as the SSID of a Wi-Fi
+ * network or the MAC address of an Ethernet interface. When an interface rejoins a known network,
+ * the DHCP client is put into the INIT-REBOOT state and requests the cached address directly,
+ * which takes a single round trip instead of the full DISCOVER/OFFER/REQUEST/ACK exchange.
+ * If the server doesn't reply within the fallback timeout, the full exchange is performed.
+ *
+ * All methods except `init()` are expected to be called with the LwIP core lock held.
+ */
+class DhcpLeaseCache {
+public:
+    static const size_t MAX_KEY_SIZE = DhcpLeaseStore::MAX_KEY_SIZE;
+    static const size_t MAX_INTERFACES = 8;
+    static const system_tick_t DEFAULT_FALLBACK_TIMEOUT = 3000;
+
+    /**
+     * Loads cached leases and starts tracking DHCP state changes.
+     */
+    int init();
+
+    /**
+     * Sets the network that the interface is about to join. This method should be called
+     * before the interface link is brought up.
+     */
+    void prepare(netif* iface, const void* key, size_t keySize);
+
+    /**
+     * Starts the DHCP client on the interface. If the link is already up and there's a cached
+     * lease for the current network of the interface, the client requests the cached address
+     * without sending DHCPDISCOVER first.
+     */
+    err_t start(netif* iface);
+
+    /**
+     * Removes all cached leases.
+     */
+    void clear();
+
+    void enabled(bool enabled);
+    bool enabled() const;
+
+    /**
+     * Sets the time after which an unanswered INIT-REBOOT request falls back to the full DHCP
+     * exchange. 0 leaves the retransmission policy to the DHCP client.
+     */
+    void fallbackTimeout(system_tick_t timeout);
+    system_tick_t fallbackTimeout() const;
+
+    static DhcpLeaseCache* instance();
+
+private:
+    struct Network {
+        uint8_t key[MAX_KEY_SIZE];
+        uint8_t keySize;
+    };
+
+    DhcpLeaseStore store_;
+    Network networks_[MAX_INTERFACES] = {};
+    system_tick_t fallbackTimeout_ = DEFAULT_FALLBACK_TIMEOUT;
+    bool enabled_ = true;
+    bool dirty_ = false;
+    bool savePending_ = false;
+    os_timer_t saveTimer_ = nullptr;
+    std::mutex mutex_;
+    netif_ext_callback_t netifCallback_ = {};
+
+    DhcpLeaseCache() = default;
+
+    Network* network(netif* iface);
+    bool apply(netif* iface);
+    void update(netif* iface);
+    void scheduleSave();
+    int load();
+    int save();
+
+    static void netifEventCb(netif* iface, netif_nsc_reason_t reason, const netif_ext_callback_args_t* args);
+    static void fallbackTimeoutCb(void* arg);
+    static void saveTimerCb(os_timer_t timer);
+};
+
+inline void DhcpLeaseCache::enabled(bool enabled) {
+    enabled_ = enabled;
+}
+
+inline bool DhcpLeaseCache::enabled() const {
+    return enabled_;
+}
+
+inline void DhcpLeaseCache::fallbackTimeout(system_tick_t timeout) {
+    fallbackTimeout_ = timeout;
+}
+
+inline system_tick_t DhcpLeaseCache::fallbackTimeout() const {
+    return fallbackTimeout_;
+}
+
+} // particle::net
+
+} // particle
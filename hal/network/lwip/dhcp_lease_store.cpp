@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dhcp_lease_store.h"
+
+#include "system_error.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace particle {
+
+namespace net {
+
+const uint16_t DhcpLeaseStore::VERSION;
+const size_t DhcpLeaseStore::SERIALIZED_SIZE;
+
+DhcpLeaseStore::DhcpLeaseStore() {
+    clear();
+}
+
+const DhcpLeaseStore::Lease* DhcpLeaseStore::find(uint8_t ifIndex, const uint8_t* key, size_t keySize) const {
+    const int index = indexOf(ifIndex, key, keySize);
+    return (index >= 0) ? &leases_[index] : nullptr;
+}
+
+bool DhcpLeaseStore::update(const Lease& lease, uint64_t millis) {
+    int index = indexOf(lease.ifIndex, lease.key, lease.keySize);
+    if (index >= 0) {
+        const Lease& l = leases_[index];
+        if (l.addr == lease.addr && l.netmask == lease.netmask && l.gateway == lease.gateway &&
+                l.server == lease.server && l.leaseTime == lease.leaseTime) {
+            /* Renewal of the same lease: only its age is updated, to avoid rewriting the file */
+            obtainedMillis_[index] = millis;
+            obtainedSinceReset_[index] = true;
+            return false;
+        }
+    } else {
+        /* Replace an empty or the least recently obtained lease */
+        index = std::min_element(leases_, leases_ + MAX_LEASES, [](const Lease& a, const Lease& b) {
+            return a.seq < b.seq;
+        }) - leases_;
+    }
+    leases_[index] = lease;
+    leases_[index].seq = ++seq_;
+    obtainedMillis_[index] = millis;
+    obtainedSinceReset_[index] = true;
+    return true;
+}
+
+bool DhcpLeaseStore::isExpired(const Lease* lease, bool rtcValid, uint32_t unixTime, uint64_t millis) const {
+    if (lease->leaseTime == INFINITE_LEASE_TIME) {
+        return false;
+    }
+    if (rtcValid && lease->obtained) {
+        return unixTime - lease->obtained >= lease->leaseTime;
+    }
+    const size_t index = lease - leases_;
+    if (index < MAX_LEASES && obtainedSinceReset_[index]) {
+        return (millis - obtainedMillis_[index]) / 1000 >= lease->leaseTime;
+    }
+    /* The lease was obtained before the last reset, and its age is unknown */
+    return true;
+}
+
+void DhcpLeaseStore::clear() {
+    memset(leases_, 0, sizeof(leases_));
+    memset(obtainedMillis_, 0, sizeof(obtainedMillis_));
+    memset(obtainedSinceReset_, 0, sizeof(obtainedSinceReset_));
+    seq_ = 0;
+}
+
+int DhcpLeaseStore::serialize(uint8_t* buf, size_t size) const {
+    if (size < SERIALIZED_SIZE) {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    const Header header = { VERSION, MAX_LEASES };
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), leases_, sizeof(leases_));
+    return SERIALIZED_SIZE;
+}
+
+int DhcpLeaseStore::deserialize(const uint8_t* data, size_t size) {
+    Header header = {};
+    if (size < sizeof(header)) {
+        /* Empty file */
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.version != VERSION || header.count > MAX_LEASES) {
+        /* Incompatible format */
+        return 0;
+    }
+    if (size < sizeof(header) + header.count * sizeof(Lease)) {
+        return SYSTEM_ERROR_BAD_DATA;
+    }
+    clear();
+    memcpy(leases_, data + sizeof(header), header.count * sizeof(Lease));
+    for (const auto& lease: leases_) {
+        seq_ = std::max(seq_, lease.seq);
+    }
+    return 0;
+}
+
+int DhcpLeaseStore::indexOf(uint8_t ifIndex, const uint8_t* key, size_t keySize) const {
+    for (size_t i = 0; i < MAX_LEASES; ++i) {
+        const Lease& lease = leases_[i];
+        if (lease.seq && lease.ifIndex == ifIndex && lease.keySize == keySize && !memcmp(lease.key, key, keySize)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // particle::net
+
+} // particle
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+namespace net {
+
+/**
+ * Set of cached DHCPv4 leases with LRU replacement, expiry checks and serialization.
+ *
+ * This class is not thread-safe.
+ */
+class DhcpLeaseStore {
+public:
+    static const size_t MAX_KEY_SIZE = 32;
+    static const size_t MAX_LEASES = 4;
+    /* Lease time of an infinite lease, RFC 2131 */
+    static const uint32_t INFINITE_LEASE_TIME = 0xffffffff;
+
+    struct Lease {
+        uint8_t key[MAX_KEY_SIZE];
+        uint8_t keySize;
+        uint8_t ifIndex;
+        uint16_t reserved;
+        uint32_t addr;
+        uint32_t netmask;
+        uint32_t gateway;
+        uint32_t server;
+        uint32_t leaseTime; // Seconds
+        uint32_t obtained; // Unix time, 0 if unknown
+        uint32_t seq; // For LRU replacement
+    };
+
+    struct Header {
+        uint16_t version;
+        uint16_t count;
+    };
+
+    static const uint16_t VERSION = 1;
+    /* Size of the serialized leases */
+    static const size_t SERIALIZED_SIZE = sizeof(Header) + MAX_LEASES * sizeof(Lease);
+
+    DhcpLeaseStore();
+
+    /**
+     * Finds the lease obtained on the interface with the index `ifIndex` in the network with
+     * the identifier `key`.
+     */
+    const Lease* find(uint8_t ifIndex, const uint8_t* key, size_t keySize) const;
+
+    /**
+     * Adds a lease, replacing the lease for the same interface and network, or the least
+     * recently obtained one. `millis` is the current system time.
+     *
+     * Returns `true` if the lease needs to be saved, or `false` if it is a renewal of the cached
+     * lease.
+     */
+    bool update(const Lease& lease, uint64_t millis);
+
+    /**
+     * Checks whether a lease has expired.
+     *
+     * The age of a lease is determined from the RTC if it is valid. Otherwise, only the age of
+     * a lease obtained since the last reset is known, based on the system time. Any other lease
+     * is considered expired.
+     */
+    bool isExpired(const Lease* lease, bool rtcValid, uint32_t unixTime, uint64_t millis) const;
+
+    void clear();
+
+    /**
+     * Serializes the leases. Returns the size of the data, or a negative error code.
+     */
+    int serialize(uint8_t* buf, size_t size) const;
+
+    /**
+     * Replaces the leases with serialized leases. Data in an incompatible format is ignored.
+     * Returns 0 or a negative error code.
+     */
+    int deserialize(const uint8_t* data, size_t size);
+
+private:
+    Lease leases_[MAX_LEASES];
+    uint64_t obtainedMillis_[MAX_LEASES]; // System time at which a lease was obtained or renewed
+    bool obtainedSinceReset_[MAX_LEASES];
+    uint32_t seq_;
+
+    int indexOf(uint8_t ifIndex, const uint8_t* key, size_t keySize) const;
+};
+
+} // particle::net
+
+} // particle
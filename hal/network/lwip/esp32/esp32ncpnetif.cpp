@@ -37,7 +37,9 @@ LOG_SOURCE_CATEGORY("net.esp32ncp")
 #include <lwip/dns.h>
 #include <algorithm>
 #include "lwiplock.h"
+#include "dhcp_lease_cache.h"
 #include "wifi_ncp_client.h"
+#include "wifi_network_manager.h"
 #include "concurrent_hal.h"
 #include "deviceid_hal.h"
 #include "bytes2hexbuf.h"
@@ -253,6 +255,10 @@ void Esp32NcpNetif::ncpEventHandlerCb(const NcpEvent& ev, void* ctx) {
         if (cev.state == NcpConnectionState::DISCONNECTED) {
             netif_set_link_down(self->interface());
         } else if (cev.state == NcpConnectionState::CONNECTED) {
+            if (self->wifiMan_) {
+                const auto ssid = self->wifiMan_->currentSsid();
+                DhcpLeaseCache::instance()->prepare(self->interface(), ssid, strlen(ssid));
+            }
             netif_set_link_up(self->interface());
         }
     }
@@ -33,6 +33,9 @@ extern "C" {
 #include "resolvapi.h"
 #include "basenetif.h"
 #include "check.h"
+#include "dhcp_lease_cache.h"
+#include <cstdlib>
+#include <cstring>
 
 using namespace particle::net;
 
@@ -323,6 +326,10 @@ int if_init(void) {
         LOG(TRACE, "LwIP started");
     }, /* &sem */ nullptr);
 
+#if LWIP_DHCP
+    DhcpLeaseCache::instance()->init();
+#endif /* LWIP_DHCP */
+
     LwipTcpIpCoreLock lk;
 
     NETIF_DECLARE_EXT_CALLBACK(handler);
@@ -686,7 +693,8 @@ int if_set_xflags(if_t iface, unsigned int xflags) {
 
 #if LWIP_DHCP
     if (changed & IFXF_DHCP) {
-        dhcp_start(netif);
+        /* Requests the previously leased address if the link is already up on a known network */
+        DhcpLeaseCache::instance()->start(netif);
     }
 #endif /* LWIP_DHCP */
 
@@ -812,14 +820,33 @@ int if_set_mtu(if_t iface, unsigned int mtu) {
 }
 
 int if_get_metric(if_t iface, unsigned int* metric) {
-    /* TODO */
-    *metric = 0;
+    LwipTcpIpCoreLock lk;
+
+    if (!netif_validate(iface) || metric == nullptr) {
+        return -1;
+    }
+
+    auto base = getBaseNetif(iface);
+    *metric = base ? base->getMetric() : 0;
+
     return 0;
 }
 
 int if_set_metric(if_t iface, unsigned int metric) {
-    /* TODO */
-    return -1;
+    LwipTcpIpCoreLock lk;
+
+    if (!netif_validate(iface)) {
+        return -1;
+    }
+
+    auto base = getBaseNetif(iface);
+    if (!base) {
+        return -1;
+    }
+
+    base->setMetric(metric);
+
+    return 0;
 }
 
 int if_get_if_addrs(struct if_addrs** addrs) {
@@ -1166,4 +1193,30 @@ int if_request(if_t iface, int type, void* req, size_t reqsize, void* reserved)
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int if_set_dhcp_cache_config(const struct if_dhcp_cache_config* conf, void* reserved) {
+    CHECK_TRUE(conf && conf->size >= sizeof(if_dhcp_cache_config), SYSTEM_ERROR_INVALID_ARGUMENT);
+#if LWIP_DHCP
+    LwipTcpIpCoreLock lk;
+    const auto cache = DhcpLeaseCache::instance();
+    cache->enabled(conf->enabled);
+    cache->fallbackTimeout(conf->fallback_timeout);
+    return 0;
+#else
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+#endif /* LWIP_DHCP */
+}
+
+int if_get_dhcp_cache_config(struct if_dhcp_cache_config* conf, void* reserved) {
+    CHECK_TRUE(conf && conf->size >= sizeof(if_dhcp_cache_config), SYSTEM_ERROR_INVALID_ARGUMENT);
+#if LWIP_DHCP
+    LwipTcpIpCoreLock lk;
+    const auto cache = DhcpLeaseCache::instance();
+    conf->enabled = cache->enabled();
+    conf->fallback_timeout = cache->fallbackTimeout();
+    return 0;
+#else
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+#endif /* LWIP_DHCP */
+}
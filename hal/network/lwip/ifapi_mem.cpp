@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ifapi.h"
+#include <lwip/stats.h>
+#include <lwip/memp.h>
+#include <lwip/sys.h>
+
+#include "lwiplock.h"
+#include "check.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+/* The pool limits are enforced by the heap hook when the pools are allocated from the C library heap */
+#define IF_MEM_POOL_LIMITS (MEMP_MEM_MALLOC && MEM_LIBC_MALLOC && MEMP_STATS)
+
+using namespace particle::net;
+
+namespace {
+
+/* Runtime memory profile, see if_set_mem_profile() */
+size_t s_heapLimit = 0;
+int s_socketRecvQuota = 0;
+uint16_t s_tcpOoseqQuota = 0;
+
+#if IF_MEM_POOL_LIMITS
+/* Maximum number of elements of each pool, the compile-time pool sizes by default */
+uint16_t s_memPoolLimits[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name, num, size, desc) num,
+#include <lwip/priv/memp_std.h>
+};
+
+#if MEM_STATS
+/* Size of the header that mem_malloc() prepends to every allocation, see mem.c */
+const size_t MEM_STATS_HEADER_SIZE = LWIP_MEM_ALIGN_SIZE(sizeof(mem_size_t));
+#else
+const size_t MEM_STATS_HEADER_SIZE = 0;
+#endif /* MEM_STATS */
+
+/* Size of the heap allocation made for an element of a pool, see memp.c */
+size_t memPoolAllocSize(int type) {
+    return MEMP_SIZE + MEMP_ALIGN_SIZE(memp_pools[type]->size) + MEM_STATS_HEADER_SIZE;
+}
+
+/* The heap hook only knows the size of an allocation, so the pools whose elements have the same size
+ * share the sum of their limits */
+bool checkMemPoolLimits(size_t size) {
+    unsigned limit = 0;
+    unsigned used = 0;
+    for (int i = 0; i < MEMP_MAX; ++i) {
+        if (memPoolAllocSize(i) == size) {
+            if (!s_memPoolLimits[i]) {
+                return true;
+            }
+            limit += s_memPoolLimits[i];
+            used += lwip_stats.memp[i]->used;
+        }
+    }
+    return !limit || used < limit;
+}
+#endif /* IF_MEM_POOL_LIMITS */
+
+int memPoolType(int pool) {
+    switch (pool) {
+        case IF_MEM_POOL_PBUF: {
+            return MEMP_PBUF_POOL;
+        }
+        case IF_MEM_POOL_PBUF_REF: {
+            return MEMP_PBUF;
+        }
+#if LWIP_TCP
+        case IF_MEM_POOL_TCP_PCB: {
+            return MEMP_TCP_PCB;
+        }
+        case IF_MEM_POOL_TCP_SEG: {
+            return MEMP_TCP_SEG;
+        }
+#endif /* LWIP_TCP */
+#if LWIP_UDP
+        case IF_MEM_POOL_UDP_PCB: {
+            return MEMP_UDP_PCB;
+        }
+#endif /* LWIP_UDP */
+        default: {
+            return -1;
+        }
+    }
+}
+
+const stats_mem* memPoolStats(int pool) {
+#if LWIP_STATS
+#if MEM_STATS
+    if (pool == IF_MEM_POOL_HEAP) {
+        return &lwip_stats.mem;
+    }
+#endif /* MEM_STATS */
+#if MEMP_STATS
+    const int type = memPoolType(pool);
+    if (type >= 0) {
+        return lwip_stats.memp[type];
+    }
+#endif /* MEMP_STATS */
+#endif /* LWIP_STATS */
+    return nullptr;
+}
+
+} /* anonymous */
+
+int if_get_mem_pool_stats(int pool, struct if_mem_pool_stats* stats, void* reserved) {
+    CHECK_TRUE(stats, SYSTEM_ERROR_INVALID_ARGUMENT);
+    LwipTcpIpCoreLock lk;
+    const auto st = memPoolStats(pool);
+    CHECK_TRUE(st, SYSTEM_ERROR_NOT_SUPPORTED);
+    if_mem_pool_stats s = {};
+    s.size = std::min<size_t>(stats->size, sizeof(s));
+    {
+        /* The counters are updated under this lock by the allocators, which don't take the core lock */
+        SYS_ARCH_DECL_PROTECT(lev);
+        SYS_ARCH_PROTECT(lev);
+        s.avail = st->avail;
+        s.used = st->used;
+        s.peak = st->max;
+        s.failures = st->err;
+        SYS_ARCH_UNPROTECT(lev);
+    }
+#if IF_MEM_POOL_LIMITS
+    if (pool != IF_MEM_POOL_HEAP) {
+        /* lwIP doesn't track the capacity of the pools allocated from the heap */
+        s.avail = s_memPoolLimits[memPoolType(pool)];
+    }
+#endif /* IF_MEM_POOL_LIMITS */
+    memcpy(stats, &s, s.size);
+    return 0;
+}
+
+int if_set_mem_profile(const struct if_mem_profile* profile, void* reserved) {
+    CHECK_TRUE(profile && profile->size >= sizeof(if_mem_profile), SYSTEM_ERROR_INVALID_ARGUMENT);
+#if !MEM_LIBC_MALLOC || !MEM_STATS
+    /* The heap has a fixed size */
+    CHECK_TRUE(profile->heap_limit == 0, SYSTEM_ERROR_NOT_SUPPORTED);
+#endif /* !MEM_LIBC_MALLOC || !MEM_STATS */
+#if !LWIP_SO_RCVBUF
+    CHECK_TRUE(profile->socket_recv_quota == 0, SYSTEM_ERROR_NOT_SUPPORTED);
+#endif /* !LWIP_SO_RCVBUF */
+#if !TCP_QUEUE_OOSEQ
+    CHECK_TRUE(profile->tcp_ooseq_quota == 0, SYSTEM_ERROR_NOT_SUPPORTED);
+#endif /* !TCP_QUEUE_OOSEQ */
+    CHECK_TRUE(profile->socket_recv_quota <= INT_MAX, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(profile->tcp_ooseq_quota < 0xffff, SYSTEM_ERROR_INVALID_ARGUMENT);
+    CHECK_TRUE(profile->pool_limits[IF_MEM_POOL_HEAP] == 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    for (int i = IF_MEM_POOL_HEAP + 1; i < IF_MEM_POOL_COUNT; ++i) {
+#if IF_MEM_POOL_LIMITS
+        CHECK_TRUE(profile->pool_limits[i] == 0 || memPoolType(i) >= 0, SYSTEM_ERROR_NOT_SUPPORTED);
+#else
+        /* The pools have a fixed size */
+        CHECK_TRUE(profile->pool_limits[i] == 0, SYSTEM_ERROR_NOT_SUPPORTED);
+#endif /* IF_MEM_POOL_LIMITS */
+    }
+    LwipTcpIpCoreLock lk;
+    s_heapLimit = profile->heap_limit;
+    s_socketRecvQuota = profile->socket_recv_quota;
+    s_tcpOoseqQuota = profile->tcp_ooseq_quota;
+#if MEM_LIBC_MALLOC && MEM_STATS
+    lwip_stats.mem.avail = s_heapLimit;
+#endif /* MEM_LIBC_MALLOC && MEM_STATS */
+#if IF_MEM_POOL_LIMITS
+    /* Pools that are already above their new limit are not shrunk, their elements are released as usual */
+    for (int i = IF_MEM_POOL_HEAP + 1; i < IF_MEM_POOL_COUNT; ++i) {
+        const int type = memPoolType(i);
+        if (type >= 0) {
+            s_memPoolLimits[type] = profile->pool_limits[i];
+        }
+    }
+#endif /* IF_MEM_POOL_LIMITS */
+    return 0;
+}
+
+int if_get_mem_profile(struct if_mem_profile* profile, void* reserved) {
+    CHECK_TRUE(profile && profile->size >= sizeof(if_mem_profile), SYSTEM_ERROR_INVALID_ARGUMENT);
+    LwipTcpIpCoreLock lk;
+    profile->heap_limit = s_heapLimit;
+    profile->socket_recv_quota = s_socketRecvQuota;
+    profile->tcp_ooseq_quota = s_tcpOoseqQuota;
+    for (int i = 0; i < IF_MEM_POOL_COUNT; ++i) {
+#if IF_MEM_POOL_LIMITS
+        const int type = memPoolType(i);
+        profile->pool_limits[i] = (type >= 0) ? s_memPoolLimits[type] : 0;
+#else
+        profile->pool_limits[i] = 0;
+#endif /* IF_MEM_POOL_LIMITS */
+    }
+    return 0;
+}
+
+#if MEM_LIBC_MALLOC
+void* lwip_hook_mem_malloc(size_t size) {
+#if MEM_STATS || IF_MEM_POOL_LIMITS
+    bool ok = true;
+    {
+        /* The counters are updated by the allocators under this lock */
+        SYS_ARCH_DECL_PROTECT(lev);
+        SYS_ARCH_PROTECT(lev);
+#if MEM_STATS
+        const size_t limit = s_heapLimit;
+        if (limit && lwip_stats.mem.used + size > limit) {
+            ok = false;
+        }
+#endif /* MEM_STATS */
+#if IF_MEM_POOL_LIMITS
+        /* memp_malloc() allocates the pool elements with mem_malloc(). A rejected element is
+         * counted as a failure of both its pool and the heap */
+        if (ok && !checkMemPoolLimits(size)) {
+            ok = false;
+        }
+#endif /* IF_MEM_POOL_LIMITS */
+        SYS_ARCH_UNPROTECT(lev);
+    }
+    if (!ok) {
+        return nullptr;
+    }
+#endif /* MEM_STATS || IF_MEM_POOL_LIMITS */
+    return malloc(size);
+}
+#endif /* MEM_LIBC_MALLOC */
+
+int lwip_hook_recv_bufsize_default(void) {
+    return s_socketRecvQuota ? s_socketRecvQuota : INT_MAX;
+}
+
+uint16_t lwip_hook_tcp_ooseq_pbufs_limit(struct tcp_pcb* pcb) {
+    /* Segments above the limit are dropped and retransmitted by the peer later */
+    return s_tcpOoseqQuota ? s_tcpOoseqQuota : 0xffff;
+}
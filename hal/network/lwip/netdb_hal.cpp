@@ -24,9 +24,248 @@
 /* netdb_hal_impl.h should get included from netdb_hal.h automagically */
 #include "netdb_hal.h"
 #include <lwip/sockets.h>
+#include <lwip/dns.h>
+#include "lwiplock.h"
+#include "concurrent_hal.h"
 #include <errno.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
 #include <algorithm>
 
+// FIXME:
+#include "system_threading.h"
+
+using namespace particle::net;
+
+namespace {
+
+struct AddrInfoRequest;
+
+struct DnsQuery {
+    AddrInfoRequest* req;
+    u8_t addrType;
+    ip_addr_t addr;
+    bool found;
+};
+
+struct AddrInfoRequest {
+    /* Used to invoke the completion callback in the system thread, should be the first field */
+    ISRTaskQueue::Task task;
+    AddrInfoRequest* next;
+    netdb_getaddrinfo_request_t id;
+    netdb_getaddrinfo_callback_t callback;
+    void* ctx;
+    char* hostname;
+    char* servname;
+    struct addrinfo hints;
+    /* IPv6 query goes first to keep the order of results of netdb_getaddrinfo() */
+    DnsQuery queries[2];
+    unsigned queryCount;
+    unsigned pending;
+    bool cancelled;
+    /* Set for the requests of netdb_getaddrinfo(), whose callback can be invoked in any context */
+    bool inPlace;
+};
+
+/* Protected by the TCP/IP core lock */
+AddrInfoRequest* s_requests = nullptr;
+netdb_getaddrinfo_request_t s_lastId = 0;
+
+void removeRequest(AddrInfoRequest* req) {
+    for (auto r = s_requests, prev = (AddrInfoRequest*)nullptr; r != nullptr; prev = r, r = r->next) {
+        if (r == req) {
+            if (prev) {
+                prev->next = r->next;
+            } else {
+                s_requests = r->next;
+            }
+            break;
+        }
+    }
+}
+
+void freeRequest(AddrInfoRequest* req) {
+    free(req->hostname);
+    free(req->servname);
+    free(req);
+}
+
+/* Builds the resulting addrinfo list out of the resolved addresses */
+int makeAddrInfo(AddrInfoRequest* req, struct addrinfo** res) {
+    struct addrinfo* first = nullptr;
+    struct addrinfo** last = &first;
+    int r = EAI_FAIL;
+    for (unsigned i = 0; i < req->queryCount; i++) {
+        const auto& q = req->queries[i];
+        if (!q.found) {
+            continue;
+        }
+        char host[IPADDR_STRLEN_MAX] = {};
+        if (!ipaddr_ntoa_r(&q.addr, host, sizeof(host))) {
+            continue;
+        }
+        struct addrinfo h = req->hints;
+        h.ai_family = IP_IS_V6(&q.addr) ? AF_INET6 : AF_INET;
+        h.ai_flags |= AI_NUMERICHOST;
+        struct addrinfo* ai = nullptr;
+        r = lwip_getaddrinfo(host, req->servname, &h, &ai);
+        if (r == 0 && ai) {
+            *last = ai;
+            while (ai->ai_next) {
+                ai = ai->ai_next;
+            }
+            last = &ai->ai_next;
+        }
+    }
+    *res = first;
+    return first ? 0 : r;
+}
+
+void invokeCallback(AddrInfoRequest* req) {
+    struct addrinfo* res = nullptr;
+    const int r = makeAddrInfo(req, &res);
+    req->callback(r, res, req->ctx);
+}
+
+/* Invoked in the system thread */
+void completeRequestTask(ISRTaskQueue::Task* task) {
+    const auto req = reinterpret_cast<AddrInfoRequest*>(task);
+    LwipTcpIpCoreLock lk;
+    removeRequest(req);
+    const bool cancelled = req->cancelled;
+    lk.unlock();
+    if (!cancelled) {
+        invokeCallback(req);
+    }
+    freeRequest(req);
+}
+
+/* Invoked with the TCP/IP core lock held once all queries of the request have completed */
+void completeRequest(AddrInfoRequest* req) {
+    if (req->cancelled || req->inPlace) {
+        removeRequest(req);
+        if (!req->cancelled) {
+            invokeCallback(req);
+        }
+        freeRequest(req);
+        return;
+    }
+    /* The callback may call into the network stack, so it is invoked in the system thread, without the lock held */
+    req->task.func = completeRequestTask;
+    SystemISRTaskQueue.enqueue(&req->task);
+}
+
+/* Invoked by lwIP in the TCP/IP thread */
+void dnsFoundCallback(const char* name, const ip_addr_t* addr, void* arg) {
+    auto q = static_cast<DnsQuery*>(arg);
+    auto req = q->req;
+    if (addr) {
+        ip_addr_copy(q->addr, *addr);
+        q->found = true;
+    }
+    if (--req->pending == 0) {
+        completeRequest(req);
+    }
+}
+
+int startRequest(const char* hostname, const char* servname, const struct addrinfo* hints,
+                 netdb_getaddrinfo_callback_t callback, void* ctx, bool inPlace, netdb_getaddrinfo_request_t* id) {
+    if (id) {
+        *id = 0;
+    }
+    if (!hostname || !callback) {
+        return EAI_NONAME;
+    }
+    const int family = hints ? hints->ai_family : AF_UNSPEC;
+    if (family != AF_UNSPEC && family != AF_INET && family != AF_INET6) {
+        return EAI_FAMILY;
+    }
+
+    if (hints && (hints->ai_flags & AI_NUMERICHOST)) {
+        /* Nothing to resolve */
+        struct addrinfo* res = nullptr;
+        int r = lwip_getaddrinfo(hostname, servname, hints, &res);
+        callback(r, res, ctx);
+        return 0;
+    }
+
+    auto r = (AddrInfoRequest*)calloc(1, sizeof(AddrInfoRequest));
+    if (!r) {
+        return EAI_MEMORY;
+    }
+    r->callback = callback;
+    r->ctx = ctx;
+    r->inPlace = inPlace;
+    r->hostname = strdup(hostname);
+    r->servname = servname ? strdup(servname) : nullptr;
+    if (!r->hostname || (servname && !r->servname)) {
+        freeRequest(r);
+        return EAI_MEMORY;
+    }
+    if (hints) {
+        r->hints.ai_flags = hints->ai_flags;
+        r->hints.ai_socktype = hints->ai_socktype;
+        r->hints.ai_protocol = hints->ai_protocol;
+    }
+    if (family != AF_INET) {
+        r->queries[r->queryCount++].addrType = LWIP_DNS_ADDRTYPE_IPV6;
+    }
+    if (family != AF_INET6) {
+        r->queries[r->queryCount++].addrType = LWIP_DNS_ADDRTYPE_IPV4;
+    }
+
+    LwipTcpIpCoreLock lk;
+    /* Requests are referred to by their IDs rather than addresses, which can be reused by a new request */
+    if (++s_lastId <= 0) {
+        s_lastId = 1;
+    }
+    r->id = s_lastId;
+    r->next = s_requests;
+    s_requests = r;
+    /* Extra reference held while the queries are being started */
+    r->pending = r->queryCount + 1;
+    for (unsigned i = 0; i < r->queryCount; i++) {
+        auto& q = r->queries[i];
+        q.req = r;
+        const err_t err = dns_gethostbyname_addrtype(r->hostname, &q.addr, dnsFoundCallback, &q, q.addrType);
+        if (err == ERR_OK) {
+            /* Cached or numeric address */
+            q.found = true;
+            --r->pending;
+        } else if (err != ERR_INPROGRESS) {
+            --r->pending;
+        }
+    }
+    if (--r->pending == 0) {
+        /* All queries have completed synchronously, the callback is invoked in the calling thread */
+        removeRequest(r);
+        lk.unlock();
+        invokeCallback(r);
+        freeRequest(r);
+        return 0;
+    }
+    if (id) {
+        *id = r->id;
+    }
+    return 0;
+}
+
+struct SyncRequest {
+    os_semaphore_t sem;
+    int error;
+    struct addrinfo* res;
+};
+
+void syncRequestCallback(int error, struct addrinfo* res, void* ctx) {
+    auto r = static_cast<SyncRequest*>(ctx);
+    r->error = error;
+    r->res = res;
+    os_semaphore_give(r->sem, false);
+}
+
+} /* anonymous */
+
 struct hostent* netdb_gethostbyname(const char *name) {
     return lwip_gethostbyname(name);
 }
@@ -42,26 +281,47 @@ void netdb_freeaddrinfo(struct addrinfo* ai) {
 
 int netdb_getaddrinfo(const char* hostname, const char* servname,
                       const struct addrinfo* hints, struct addrinfo** res) {
-    /* Change the behavior when AF_UNSPEC is used */
-    if (hints && hints->ai_family == AF_UNSPEC) {
-        struct addrinfo h = *hints;
-
-        /* First perform a lookup with AF_INET6 */
-        h.ai_family = AF_INET6;
-        int rinet6 = lwip_getaddrinfo(hostname, servname, &h, res);
+    /* Change the behavior when AF_UNSPEC is used: perform AF_INET6 and AF_INET lookups concurrently */
+    if (hints && hints->ai_family == AF_UNSPEC && !(hints->ai_flags & AI_NUMERICHOST)) {
+        if (!res) {
+            return EAI_FAIL;
+        }
+        SyncRequest r = {};
+        if (os_semaphore_create(&r.sem, 1, 0)) {
+            return EAI_MEMORY;
+        }
+        /* The callback doesn't block and is invoked in the TCP/IP thread, so that this function
+         * can be called in the system thread */
+        int err = startRequest(hostname, servname, hints, syncRequestCallback, &r, true /* inPlace */, nullptr);
+        if (!err) {
+            os_semaphore_take(r.sem, CONCURRENT_WAIT_FOREVER, false);
+            err = r.error;
+            *res = r.res;
+        }
+        os_semaphore_destroy(r.sem);
+        return err;
+    }
+    return lwip_getaddrinfo(hostname, servname, hints, res);
+}
 
-        /* Next perform a lookup with AF_INET */
-        h.ai_family = AF_INET;
-        /* FIXME: expects that there is either 1 or 0 results from the previous call */
-        int rinet = lwip_getaddrinfo(hostname, servname, &h, rinet6 == 0 && *res ? &((*res)->ai_next) : res);
+int netdb_getaddrinfo_async(const char* hostname, const char* servname, const struct addrinfo* hints,
+                            netdb_getaddrinfo_callback_t callback, void* ctx, netdb_getaddrinfo_request_t* req) {
+    return startRequest(hostname, servname, hints, callback, ctx, false /* inPlace */, req);
+}
 
-        if (rinet6 == 0 || rinet == 0) {
+int netdb_getaddrinfo_cancel(netdb_getaddrinfo_request_t req) {
+    if (req <= 0) {
+        return EAI_FAIL;
+    }
+    LwipTcpIpCoreLock lk;
+    for (auto r = s_requests; r != nullptr; r = r->next) {
+        if (r->id == req && !r->cancelled) {
+            /* lwIP doesn't allow cancelling a DNS query, the request is freed once all of its queries complete */
+            r->cancelled = true;
             return 0;
         }
-
-        return std::max(rinet, rinet6);
     }
-    return lwip_getaddrinfo(hostname, servname, hints, res);
+    return EAI_FAIL;
 }
 
 int netdb_getnameinfo(const struct sockaddr* sa, socklen_t salen, char* host,
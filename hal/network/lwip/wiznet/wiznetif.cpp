@@ -37,6 +37,7 @@ LOG_SOURCE_CATEGORY("net.en")
 #include <lwip/dns.h>
 #include <algorithm>
 #include "lwiplock.h"
+#include "dhcp_lease_cache.h"
 #include "interrupts_hal.h"
 #include "deviceid_hal.h"
 #include "bytes2hexbuf.h"
@@ -431,6 +432,9 @@ void WizNetif::pollState() {
     if (netif_is_link_up(&netif_) != linkState) {
         if (linkState) {
             LOG(INFO, "Link up");
+            /* The cable may have been moved to a different network, which can't be detected,
+             * so the cached lease is keyed by the interface's own MAC address */
+            DhcpLeaseCache::instance()->prepare(&netif_, netif_.hwaddr, netif_.hwaddr_len);
             netif_set_link_up(&netif_);
         } else {
             LOG(INFO, "Link down");
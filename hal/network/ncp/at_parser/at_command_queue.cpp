@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "at_command_queue.h"
+
+#include "at_parser.h"
+#include "at_command.h"
+#include "at_response.h"
+
+#include "check.h"
+
+#include <cstdio>
+
+namespace particle {
+
+AtCommandQueue::AtCommandQueue(AtParser* parser) :
+        cmds_(),
+        parser_(parser),
+        seq_(0),
+        lastId_(0) {
+}
+
+AtCommandQueue::~AtCommandQueue() {
+    clear(SYSTEM_ERROR_CANCELLED);
+}
+
+int AtCommandQueue::enqueue(int priority, unsigned timeout, LineHandler lineHandler, CompletionHandler complHandler,
+        void* data, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int ret = venqueue(priority, timeout, lineHandler, complHandler, data, fmt, args);
+    va_end(args);
+    return ret;
+}
+
+int AtCommandQueue::venqueue(int priority, unsigned timeout, LineHandler lineHandler, CompletionHandler complHandler,
+        void* data, const char* fmt, va_list args) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Command* cmd = nullptr;
+    for (auto& c: cmds_) {
+        if (c.state == State::FREE) {
+            cmd = &c;
+            break;
+        }
+    }
+    CHECK_TRUE(cmd, SYSTEM_ERROR_LIMIT_EXCEEDED);
+    va_list args2;
+    va_copy(args2, args);
+    int n = vsnprintf(cmd->buf.get(), cmd->bufSize, fmt, args);
+    if (n >= 0 && (size_t)n >= cmd->bufSize) {
+        // Grow the buffer. It's kept for subsequent commands
+        std::unique_ptr<char[]> buf(new(std::nothrow) char[n + 1]);
+        if (!buf) {
+            va_end(args2);
+            return SYSTEM_ERROR_NO_MEMORY;
+        }
+        cmd->buf = std::move(buf);
+        cmd->bufSize = n + 1;
+        n = vsnprintf(cmd->buf.get(), cmd->bufSize, fmt, args2);
+    }
+    va_end(args2);
+    CHECK_TRUE(n >= 0, SYSTEM_ERROR_INTERNAL);
+    // The parser sends the command line terminator
+    while (n > 0 && (cmd->buf[n - 1] == '\r' || cmd->buf[n - 1] == '\n')) {
+        --n;
+    }
+    CHECK_TRUE(n > 0, SYSTEM_ERROR_INVALID_ARGUMENT);
+    cmd->size = n;
+    cmd->timeout = timeout;
+    cmd->lineHandler = lineHandler;
+    cmd->complHandler = complHandler;
+    cmd->data = data;
+    cmd->priority = priority;
+    cmd->seq = ++seq_;
+    if (++lastId_ <= 0) {
+        lastId_ = 1;
+    }
+    cmd->id = lastId_;
+    cmd->state = State::QUEUED;
+    return cmd->id;
+}
+
+int AtCommandQueue::cancel(int id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto cmd = find(id);
+    CHECK_TRUE(cmd, SYSTEM_ERROR_NOT_FOUND);
+    CHECK_TRUE(cmd->state == State::QUEUED, SYSTEM_ERROR_BUSY);
+    const auto handler = cmd->complHandler;
+    const auto data = cmd->data;
+    release(cmd);
+    lock.unlock();
+    if (handler) {
+        handler(SYSTEM_ERROR_CANCELLED, 0, data);
+    }
+    return 0;
+}
+
+void AtCommandQueue::clear(int error) {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const auto cmd = next();
+        if (!cmd) {
+            break;
+        }
+        const auto handler = cmd->complHandler;
+        const auto data = cmd->data;
+        release(cmd);
+        lock.unlock();
+        if (handler) {
+            handler(error, 0, data);
+        }
+    }
+}
+
+int AtCommandQueue::process() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto cmd = next();
+    if (!cmd) {
+        return 0;
+    }
+    return execute(cmd, lock);
+}
+
+int AtCommandQueue::process(int id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto cmd = find(id);
+    if (!cmd || cmd->state != State::QUEUED) {
+        return 0;
+    }
+    return execute(cmd, lock);
+}
+
+int AtCommandQueue::execute(Command* cmd, std::unique_lock<std::mutex>& lock) {
+    cmd->state = State::RUNNING;
+    lock.unlock();
+    int errorCode = 0;
+    int ret = SYSTEM_ERROR_INVALID_STATE;
+    if (parser_) {
+        ret = run(cmd, &errorCode);
+    }
+    const auto handler = cmd->complHandler;
+    const auto data = cmd->data;
+    lock.lock();
+    release(cmd);
+    lock.unlock();
+    if (handler) {
+        handler(ret, errorCode, data);
+    }
+    return 1;
+}
+
+size_t AtCommandQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (const auto& cmd: cmds_) {
+        if (cmd.state == State::QUEUED) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+int AtCommandQueue::run(Command* cmd, int* errorCode) {
+    auto resp = parser_->command().write(cmd->buf.get(), cmd->size).timeout(cmd->timeout).send();
+    CHECK(resp.error());
+    if (cmd->lineHandler) {
+        if (!lineBuf_) {
+            lineBuf_.reset(new(std::nothrow) char[MAX_LINE_SIZE]);
+            CHECK_TRUE(lineBuf_, SYSTEM_ERROR_NO_MEMORY);
+        }
+        while (resp.hasNextLine()) {
+            const int n = CHECK(resp.readLine(lineBuf_.get(), MAX_LINE_SIZE));
+            if (n == 0) {
+                continue; // Skip the empty lines used for response framing
+            }
+            const int r = cmd->lineHandler(lineBuf_.get(), n, cmd->data);
+            if (r < 0) {
+                resp.reset();
+                return r;
+            }
+        }
+    }
+    const int ret = CHECK(resp.readResult());
+    *errorCode = resp.resultErrorCode();
+    return ret;
+}
+
+AtCommandQueue::Command* AtCommandQueue::next() {
+    Command* cmd = nullptr;
+    for (auto& c: cmds_) {
+        if (c.state == State::QUEUED && (!cmd || c.priority > cmd->priority ||
+                (c.priority == cmd->priority && (int32_t)(c.seq - cmd->seq) < 0))) {
+            cmd = &c;
+        }
+    }
+    return cmd;
+}
+
+AtCommandQueue::Command* AtCommandQueue::find(int id) {
+    for (auto& cmd: cmds_) {
+        if (cmd.state != State::FREE && cmd.id == id) {
+            return &cmd;
+        }
+    }
+    return nullptr;
+}
+
+void AtCommandQueue::release(Command* cmd) {
+    cmd->lineHandler = nullptr;
+    cmd->complHandler = nullptr;
+    cmd->data = nullptr;
+    cmd->state = State::FREE;
+}
+
+} // particle
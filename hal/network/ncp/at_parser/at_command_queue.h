@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+class AtParser;
+
+/**
+ * Queue of AT commands.
+ *
+ * Commands are formatted when they are enqueued and sent to the DCE later, by a thread that calls
+ * `process()`. This allows the caller to hold the parser lock only while a command is actually
+ * being executed, so that the commands submitted by different threads can interleave with the
+ * parser's other operations.
+ *
+ * Commands with a higher priority are executed first. Commands with the same priority are executed
+ * in the order in which they were enqueued. The buffers used for the command data are allocated
+ * on demand and reused for subsequent commands.
+ */
+class AtCommandQueue {
+public:
+    /**
+     * Command priority.
+     */
+    enum Priority {
+        LOW = 0,
+        NORMAL = 1,
+        HIGH = 2
+    };
+
+    /**
+     * The signature of a function invoked for each line of the response data.
+     *
+     * The line is passed as is, without the line terminator. Empty lines are skipped.
+     *
+     * @param line Line data (null-terminated).
+     * @param size Line size.
+     * @param data User data.
+     * @return `0` to continue reading the response, or a negative result code to cancel the command.
+     *         In the latter case, the result code is passed to the completion handler.
+     */
+    typedef int(*LineHandler)(const char* line, size_t size, void* data);
+
+    /**
+     * The signature of a function invoked when a command completes.
+     *
+     * @param result One of the values defined by `AtResponse::Result`, or a negative result code
+     *        in case of an error.
+     * @param errorCode Error code reported via the "+CME ERROR" or "+CMS ERROR" result code.
+     * @param data User data.
+     */
+    typedef void(*CompletionHandler)(int result, int errorCode, void* data);
+
+    /**
+     * Maximum number of pending commands.
+     */
+    static const size_t MAX_SIZE = 4;
+    /**
+     * Maximum size of a response line. Longer lines are truncated.
+     */
+    static const size_t MAX_LINE_SIZE = 1024;
+
+    explicit AtCommandQueue(AtParser* parser = nullptr);
+    ~AtCommandQueue();
+
+    /**
+     * Sets the parser used to execute the commands.
+     */
+    void parser(AtParser* parser);
+    AtParser* parser() const;
+
+    /**
+     * Formats and enqueues an AT command.
+     *
+     * Trailing line terminators are removed from the command line.
+     *
+     * @param priority Command priority.
+     * @param timeout Command timeout in milliseconds.
+     * @param lineHandler Response line handler (optional).
+     * @param complHandler Completion handler (optional).
+     * @param data User data passed to the handlers.
+     * @param fmt printf-style format string.
+     * @return Command ID, or a negative result code in case of an error.
+     */
+    int enqueue(int priority, unsigned timeout, LineHandler lineHandler, CompletionHandler complHandler, void* data,
+            const char* fmt, ...) __attribute__((format(printf, 7, 8)));
+    /**
+     * Formats and enqueues an AT command.
+     *
+     * @see `enqueue()`
+     */
+    int venqueue(int priority, unsigned timeout, LineHandler lineHandler, CompletionHandler complHandler, void* data,
+            const char* fmt, va_list args);
+    /**
+     * Cancels a pending command.
+     *
+     * The completion handler is invoked with `SYSTEM_ERROR_CANCELLED`. A command that is being
+     * executed cannot be cancelled.
+     *
+     * @param id Command ID.
+     * @return `0` on success, or a negative result code in case of an error.
+     */
+    int cancel(int id);
+    /**
+     * Cancels all pending commands.
+     *
+     * @param error Result code passed to the completion handlers.
+     */
+    void clear(int error);
+    /**
+     * Executes the next pending command.
+     *
+     * The calling code is responsible for synchronizing access to the parser.
+     *
+     * @return `1` if a command has been executed, `0` if there are no pending commands, or
+     *         a negative result code in case of an error.
+     */
+    int process();
+    /**
+     * Executes a specific pending command.
+     *
+     * Commands with a higher priority and the ones enqueued earlier are not executed. The calling
+     * code is responsible for synchronizing access to the parser.
+     *
+     * @param id Command ID.
+     * @return `1` if the command has been executed, `0` if the command is being executed by another
+     *         thread or has already completed.
+     */
+    int process(int id);
+    /**
+     * Returns the number of pending commands.
+     */
+    size_t size() const;
+
+    // Instances of this class are non-copyable
+    AtCommandQueue(const AtCommandQueue&) = delete;
+    AtCommandQueue& operator=(const AtCommandQueue&) = delete;
+
+private:
+    enum class State {
+        FREE,
+        QUEUED,
+        RUNNING
+    };
+
+    struct Command {
+        std::unique_ptr<char[]> buf;
+        size_t bufSize;
+        size_t size;
+        unsigned timeout;
+        LineHandler lineHandler;
+        CompletionHandler complHandler;
+        void* data;
+        uint32_t seq;
+        int id;
+        int priority;
+        State state;
+    };
+
+    Command cmds_[MAX_SIZE];
+    std::unique_ptr<char[]> lineBuf_;
+    AtParser* parser_;
+    uint32_t seq_;
+    int lastId_;
+    mutable std::mutex mutex_;
+
+    int run(Command* cmd, int* errorCode);
+    int execute(Command* cmd, std::unique_lock<std::mutex>& lock);
+    Command* next();
+    Command* find(int id);
+    void release(Command* cmd);
+};
+
+inline void AtCommandQueue::parser(AtParser* parser) {
+    parser_ = parser;
+}
+
+inline AtParser* AtCommandQueue::parser() const {
+    return parser_;
+}
+
+} // particle
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cellular_signal_cache.h"
+
+#include "at_parser.h"
+#include "at_response.h"
+
+#include "timer_hal.h"
+#include "check.h"
+
+#include <cstring>
+#include <cstdlib>
+
+namespace particle {
+
+namespace {
+
+// Maximum number of fields in a network registration status line that are of interest
+const size_t MAX_REG_STATUS_FIELDS = 5;
+
+// Highest access technology value defined by 3GPP TS 27.007 for +COPS
+const int MAX_ACT = 9;
+
+// Indicators reported via +CIEV that affect the signal quality (see u-blox AT commands manual, +CIND)
+const int CIEV_SIGNAL = 2;
+const int CIEV_SERVICE = 3;
+const int CIEV_ROAM = 7;
+const int CIEV_GPRS_COVERAGE = 9;
+
+} // unnamed
+
+CellularSignalCache::CellularSignalCache() :
+        parser_(nullptr),
+        useCesq_(false) {
+    reset();
+}
+
+int CellularSignalCache::init(AtParser* parser, bool useCesq) {
+    parser_ = parser;
+    useCesq_ = useCesq;
+    reset();
+    CHECK(parser_->addUrcHandler("+CIEV", cievUrcHandler, this));
+    return 0;
+}
+
+bool CellularSignalCache::get(Info* info, system_tick_t maxAge) const {
+    if (!valid_ || HAL_Timer_Get_Milli_Seconds() - info_.time >= maxAge) {
+        return false;
+    }
+    *info = info_;
+    return true;
+}
+
+int CellularSignalCache::refresh() {
+    CHECK_TRUE(parser_, SYSTEM_ERROR_INVALID_STATE);
+    Info info = info_;
+    {
+        int mode = 0;
+        auto resp = parser_->sendCommand("AT+COPS?");
+        int r = CHECK(resp.scanf("+COPS: %d,%*d,\"%*[^\"]\",%d", &mode, &info.act));
+        CHECK_TRUE(r == 2, SYSTEM_ERROR_UNKNOWN);
+        r = CHECK(resp.readResult());
+        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_UNKNOWN);
+        CHECK_TRUE(info.act >= 0 && info.act <= MAX_ACT, SYSTEM_ERROR_BAD_DATA);
+    }
+    if (useCesq_) {
+        auto resp = parser_->sendCommand("AT+CESQ");
+        int r = CHECK(resp.scanf("+CESQ: %d,%d,%d,%d,%d,%d", &info.rxlev, &info.rxqual, &info.rscp, &info.ecn0,
+                &info.rsrq, &info.rsrp));
+        CHECK_TRUE(r == 6, SYSTEM_ERROR_BAD_DATA);
+        r = CHECK(resp.readResult());
+        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_UNKNOWN);
+    } else {
+        auto resp = parser_->sendCommand("AT+CSQ");
+        int r = CHECK(resp.scanf("+CSQ: %d,%d", &info.rssi, &info.ber));
+        CHECK_TRUE(r == 2, SYSTEM_ERROR_BAD_DATA);
+        r = CHECK(resp.readResult());
+        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_UNKNOWN);
+    }
+    info.cesq = useCesq_;
+    info.time = HAL_Timer_Get_Milli_Seconds();
+    info_ = info;
+    valid_ = true;
+    return 0;
+}
+
+void CellularSignalCache::invalidate() {
+    valid_ = false;
+}
+
+void CellularSignalCache::reset() {
+    info_.act = -1;
+    info_.lac = -1;
+    info_.ci = -1;
+    info_.cesq = useCesq_;
+    info_.rssi = -1;
+    info_.ber = -1;
+    info_.rxlev = -1;
+    info_.rxqual = -1;
+    info_.rscp = -1;
+    info_.ecn0 = -1;
+    info_.rsrq = -1;
+    info_.rsrp = -1;
+    info_.time = 0;
+    valid_ = false;
+}
+
+bool CellularSignalCache::needsRefresh(system_tick_t interval) const {
+    return !valid_ || HAL_Timer_Get_Milli_Seconds() - info_.time >= interval;
+}
+
+int CellularSignalCache::parseRegistrationStatus(const char* line) {
+    const char* p = strchr(line, ':');
+    CHECK_TRUE(p, SYSTEM_ERROR_BAD_DATA);
+    ++p;
+    long vals[MAX_REG_STATUS_FIELDS] = {};
+    bool quoted[MAX_REG_STATUS_FIELDS] = {};
+    size_t n = 0;
+    while (n < MAX_REG_STATUS_FIELDS) {
+        while (*p == ' ') {
+            ++p;
+        }
+        const bool q = (*p == '"');
+        if (q) {
+            ++p;
+        }
+        // Location area codes and cell IDs are reported as quoted hex strings
+        char* end = nullptr;
+        const long v = strtol(p, &end, q ? 16 : 10);
+        vals[n] = (end != p) ? v : -1;
+        quoted[n] = q;
+        ++n;
+        p = end;
+        if (q) {
+            CHECK_TRUE(*p == '"', SYSTEM_ERROR_BAD_DATA);
+            ++p;
+        }
+        if (*p != ',') {
+            break;
+        }
+        ++p;
+    }
+    CHECK_TRUE(!quoted[0] && vals[0] >= 0, SYSTEM_ERROR_BAD_DATA);
+    // The information text response has an additional <n> field in front of <stat>
+    const size_t i = (n > 1 && !quoted[1]) ? 1 : 0;
+    const int stat = vals[i];
+    CHECK_TRUE(stat >= 0, SYSTEM_ERROR_BAD_DATA);
+    if (n >= i + 3) {
+        info_.lac = vals[i + 1];
+        info_.ci = vals[i + 2];
+    } else if (stat != 1 && stat != 5) {
+        // Not registered
+        info_.lac = -1;
+        info_.ci = -1;
+    }
+    if (n >= i + 4 && vals[i + 3] >= 0 && vals[i + 3] <= MAX_ACT && vals[i + 3] != info_.act) {
+        // The cached signal quality is reported in units specific to the previous access technology
+        info_.act = vals[i + 3];
+        invalidate();
+    }
+    return stat;
+}
+
+int CellularSignalCache::cievUrcHandler(AtResponseReader* reader, const char* prefix, void* data) {
+    const auto self = (CellularSignalCache*)data;
+    int descr = 0;
+    int val = 0;
+    const int r = CHECK(reader->scanf("+CIEV: %d,%d", &descr, &val));
+    CHECK_TRUE(r == 2, SYSTEM_ERROR_BAD_DATA);
+    if (descr == CIEV_SIGNAL || descr == CIEV_SERVICE || descr == CIEV_ROAM || descr == CIEV_GPRS_COVERAGE) {
+        self->invalidate();
+    }
+    return 0;
+}
+
+} // particle
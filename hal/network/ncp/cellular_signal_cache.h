@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+namespace particle {
+
+class AtParser;
+class AtResponseReader;
+
+/**
+ * Cache of the cellular signal quality and registration info.
+ *
+ * The cached values are updated by the network registration URCs (+CREG, +CGREG, +CEREG) and
+ * by explicit refreshes. Indicator events (+CIEV) reporting a change of the signal or service
+ * state mark the cached signal quality as stale, so that it's queried again on the next read.
+ *
+ * The calling code is responsible for synchronizing access to the cache and the parser.
+ */
+class CellularSignalCache {
+public:
+    /**
+     * Cached values.
+     *
+     * All values are reported as is by the DCE, or set to -1 if unknown.
+     */
+    struct Info {
+        int act; ///< Access technology (3GPP TS 27.007).
+        int lac; ///< Location or tracking area code.
+        int ci; ///< Cell ID.
+        bool cesq; ///< `true` if the signal quality was queried via +CESQ, or `false` if via +CSQ.
+        int rssi; ///< +CSQ: <rssi>.
+        int ber; ///< +CSQ: <ber>.
+        int rxlev; ///< +CESQ: <rxlev>.
+        int rxqual; ///< +CESQ: <rxqual>.
+        int rscp; ///< +CESQ: <rscp>.
+        int ecn0; ///< +CESQ: <ecn0>.
+        int rsrq; ///< +CESQ: <rsrq>.
+        int rsrp; ///< +CESQ: <rsrp>.
+        system_tick_t time; ///< Time when the signal quality was measured.
+    };
+
+    CellularSignalCache();
+
+    /**
+     * Initializes the cache.
+     *
+     * Registers a handler for the +CIEV URC. This method needs to be called every time the parser
+     * is reinitialized.
+     *
+     * @param parser AT parser.
+     * @param useCesq Use +CESQ instead of +CSQ to query the signal quality.
+     * @return `0` on success, or a negative result code in case of an error.
+     */
+    int init(AtParser* parser, bool useCesq);
+    /**
+     * Returns the cached values if they are not older than `maxAge`.
+     *
+     * @param info Cached values.
+     * @param maxAge Maximum age of the cached signal quality in milliseconds.
+     * @return `true` if the cached values are valid, or `false` otherwise.
+     */
+    bool get(Info* info, system_tick_t maxAge) const;
+    /**
+     * Queries the access technology and signal quality.
+     *
+     * @return `0` on success, or a negative result code in case of an error.
+     */
+    int refresh();
+    /**
+     * Marks the cached signal quality as stale.
+     */
+    void invalidate();
+    /**
+     * Discards all cached values.
+     */
+    void reset();
+    /**
+     * Returns `true` if the signal quality needs to be refreshed.
+     *
+     * @param interval Maximum age of the cached signal quality in milliseconds.
+     */
+    bool needsRefresh(system_tick_t interval) const;
+    /**
+     * Parses a network registration status line (+CREG, +CGREG or +CEREG) and updates the cached
+     * registration info.
+     *
+     * Both the unsolicited form (`<stat>[,<lac>,<ci>[,<AcT>]]`) and the information text response
+     * form (`<n>,<stat>[,<lac>,<ci>[,<AcT>]]`) are supported.
+     *
+     * @param line Line data (null-terminated).
+     * @return Registration status, or a negative result code in case of an error.
+     */
+    int parseRegistrationStatus(const char* line);
+
+private:
+    AtParser* parser_;
+    Info info_;
+    bool useCesq_;
+    bool valid_;
+
+    static int cievUrcHandler(AtResponseReader* reader, const char* prefix, void* data);
+};
+
+} // particle
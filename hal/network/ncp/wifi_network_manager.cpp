@@ -179,7 +179,8 @@ void sortByRssi(Vector<WifiScanResult>* scanResults) {
 } // unnamed
 
 WifiNetworkManager::WifiNetworkManager(WifiNcpClient* client) :
-        client_(client) {
+        client_(client),
+        ssid_() {
 }
 
 WifiNetworkManager::~WifiNetworkManager() {
@@ -204,7 +205,7 @@ int WifiNetworkManager::connect(const char* ssid) {
     // Connect to the network
     bool updateConfig = false;
     auto network = &networks.at(index);
-    int r = client_->connect(network->ssid(), network->bssid(), network->security(), network->credentials());
+    int r = connectToNetwork(*network, network->bssid());
     if (r < 0) {
         // Perform network scan
         Vector<WifiScanResult> scanResults;
@@ -233,7 +234,7 @@ int WifiNetworkManager::connect(const char* ssid) {
             } else if (strcmp(ssid, ap.ssid()) != 0) {
                 continue;
             }
-            r = client_->connect(network->ssid(), ap.bssid(), network->security(), network->credentials());
+            r = connectToNetwork(*network, ap.bssid());
             if (r == 0) {
                 if (network->bssid() != ap.bssid()) {
                     // Update BSSID
@@ -268,6 +269,14 @@ int WifiNetworkManager::connect(const char* ssid) {
     return 0;
 }
 
+int WifiNetworkManager::connectToNetwork(const WifiNetworkConfig& network, const MacAddress& bssid) {
+    // The connection state event may be generated before the NCP client returns
+    const size_t n = std::min(strlen(network.ssid()), MAX_SSID_SIZE);
+    memcpy(ssid_, network.ssid(), n);
+    ssid_[n] = '\0';
+    return client_->connect(network.ssid(), bssid, network.security(), network.credentials());
+}
+
 int WifiNetworkManager::setNetworkConfig(WifiNetworkConfig conf) {
     CHECK_TRUE(conf.ssid(), SYSTEM_ERROR_INVALID_ARGUMENT);
     Vector<WifiNetworkConfig> networks;
@@ -157,8 +157,14 @@ public:
 
     WifiNcpClient* ncpClient() const;
 
+    // SSID of the network that is being joined or has been joined most recently
+    const char* currentSsid() const;
+
 private:
     WifiNcpClient* client_;
+    char ssid_[MAX_SSID_SIZE + 1];
+
+    int connectToNetwork(const WifiNetworkConfig& network, const MacAddress& bssid);
 };
 
 inline WifiCredentials::WifiCredentials() :
@@ -326,4 +332,8 @@ inline WifiNcpClient* WifiNetworkManager::ncpClient() const {
     return client_;
 }
 
+inline const char* WifiNetworkManager::currentSsid() const {
+    return ssid_;
+}
+
 } // particle
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace particle {
+
+/**
+ * Cache of module integrity check results.
+ *
+ * Verifying the CRC of a module requires reading the entire module image. The result of the check
+ * is cached per module address and reused as long as the module's fingerprint (a hash of its
+ * header, suffix and stored CRC) stays the same and the cache hasn't been invalidated since the
+ * check was started. The cache needs to be invalidated whenever the flash memory occupied by any
+ * of the modules is modified.
+ *
+ * This class is not thread-safe.
+ */
+template<unsigned N>
+class ModuleIntegrityCache {
+public:
+    ModuleIntegrityCache() :
+            entries_(),
+            generation_(0),
+            next_(0) {
+    }
+
+    /**
+     * Looks up a cached check result.
+     *
+     * @param address Module address.
+     * @param length Module length.
+     * @param fingerprint Module fingerprint.
+     * @param[out] valid Cached result of the check.
+     * @return `true` if the result is cached, or `false` otherwise.
+     */
+    bool find(uint32_t address, uint32_t length, uint32_t fingerprint, bool* valid) const {
+        const Entry* const e = findEntry(address);
+        if (!e || e->generation != generation_ || e->length != length || e->fingerprint != fingerprint) {
+            return false;
+        }
+        *valid = e->valid;
+        return true;
+    }
+
+    /**
+     * Caches the result of a check.
+     *
+     * @param address Module address.
+     * @param length Module length.
+     * @param fingerprint Module fingerprint.
+     * @param valid Result of the check.
+     * @param generation Value returned by `generation()` before the check was started. The result
+     *        is discarded if the cache has been invalidated while the check was in progress.
+     */
+    void add(uint32_t address, uint32_t length, uint32_t fingerprint, bool valid, uint32_t generation) {
+        if (generation != generation_) {
+            return;
+        }
+        Entry* e = findEntry(address);
+        if (!e) {
+            e = &entries_[next_];
+            next_ = (next_ + 1) % N;
+        }
+        e->address = address;
+        e->length = length;
+        e->fingerprint = fingerprint;
+        e->generation = generation;
+        e->valid = valid;
+        e->used = true;
+    }
+
+    /**
+     * Discards all cached results.
+     */
+    void invalidate() {
+        ++generation_;
+    }
+
+    uint32_t generation() const {
+        return generation_;
+    }
+
+    /**
+     * Updates a fingerprint with a block of data (32-bit FNV-1a).
+     */
+    static uint32_t fingerprint(const void* data, size_t size, uint32_t hash = FINGERPRINT_INIT) {
+        const uint8_t* d = (const uint8_t*)data;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ d[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    static const uint32_t FINGERPRINT_INIT = 2166136261u;
+
+private:
+    struct Entry {
+        uint32_t address;
+        uint32_t length;
+        uint32_t fingerprint;
+        uint32_t generation;
+        bool valid;
+        bool used;
+    };
+
+    Entry entries_[N];
+    uint32_t generation_;
+    unsigned next_;
+
+    const Entry* findEntry(uint32_t address) const {
+        for (unsigned i = 0; i < N; ++i) {
+            if (entries_[i].used && entries_[i].address == address) {
+                return &entries_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    Entry* findEntry(uint32_t address) {
+        return const_cast<Entry*>(static_cast<const ModuleIntegrityCache*>(this)->findEntry(address));
+    }
+};
+
+template<unsigned N>
+const uint32_t ModuleIntegrityCache<N>::FINGERPRINT_INIT;
+
+} // namespace particle
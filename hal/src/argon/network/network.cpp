@@ -23,6 +23,7 @@
 #include "nat64.h"
 #include <mutex>
 #include <memory>
+#include <initializer_list>
 #include <nrf52840.h>
 #include "random.h"
 #include "check.h"
@@ -166,10 +167,16 @@ extern "C" {
 
 struct netif* lwip_hook_ip4_route_src(const ip4_addr_t* src, const ip4_addr_t* dst) {
     if (src == nullptr) {
-        if (en2 && netifCanForwardIpv4(en2->interface())) {
-            return en2->interface();
-        } else if (wl3 && netifCanForwardIpv4(wl3->interface())) {
-            return wl3->interface();
+        /* Use the interface with the lowest metric, preferring en2 if the metrics are equal */
+        BaseNetif* route = nullptr;
+        for (auto iface: {en2, wl3}) {
+            if (iface && netifCanForwardIpv4(iface->interface()) &&
+                    (!route || iface->getMetric() < route->getMetric())) {
+                route = iface;
+            }
+        }
+        if (route) {
+            return route->interface();
         }
     }
 
@@ -32,15 +32,51 @@
 #include "at_parser.h"
 #include "at_command.h"
 #include "at_response.h"
+#include "at_command_queue.h"
 #include "modem/enums_hal.h"
+#include "delay_hal.h"
+#include "timer_hal.h"
 
 #include <limits>
+#include <memory>
+#include <cstddef>
 
 namespace {
 
 using namespace particle;
 
-const size_t MAX_RESP_SIZE = 1024;
+// Size of the buffer used to add the "\r\n" framing to the lines passed to the legacy callbacks
+const size_t LEGACY_LINE_BUF_SIZE = AtCommandQueue::MAX_LINE_SIZE + 5;
+
+// Interval at which `cellular_command()` checks if its command has completed
+const system_tick_t COMMAND_POLL_INTERVAL = 10;
+
+static_assert(CELLULAR_COMMAND_RESULT_OK == (int)AtResponse::OK &&
+        CELLULAR_COMMAND_RESULT_ERROR == (int)AtResponse::ERROR &&
+        CELLULAR_COMMAND_RESULT_BUSY == (int)AtResponse::BUSY &&
+        CELLULAR_COMMAND_RESULT_NO_ANSWER == (int)AtResponse::NO_ANSWER &&
+        CELLULAR_COMMAND_RESULT_NO_CARRIER == (int)AtResponse::NO_CARRIER &&
+        CELLULAR_COMMAND_RESULT_NO_DIALTONE == (int)AtResponse::NO_DIALTONE &&
+        CELLULAR_COMMAND_RESULT_CME_ERROR == (int)AtResponse::CME_ERROR &&
+        CELLULAR_COMMAND_RESULT_CMS_ERROR == (int)AtResponse::CMS_ERROR,
+        "cellular_command_result doesn't match AtResponse::Result");
+
+static_assert(CELLULAR_COMMAND_PRIORITY_LOW == (int)AtCommandQueue::LOW &&
+        CELLULAR_COMMAND_PRIORITY_NORMAL == (int)AtCommandQueue::NORMAL &&
+        CELLULAR_COMMAND_PRIORITY_HIGH == (int)AtCommandQueue::HIGH,
+        "cellular_command_priority doesn't match AtCommandQueue::Priority");
+
+// State of a command submitted via `cellular_command()`
+struct LegacyCommand {
+    _CALLBACKPTR_MDM cb;
+    void* param;
+    std::unique_ptr<char[]> buf;
+    int result;
+    int errorCode;
+    int cbResult;
+    bool cbDone;
+    volatile bool done;
+};
 
 int parseMdmType(const char* buf, size_t size) {
     static const struct {
@@ -82,6 +118,43 @@ int mdmTypeToResult(int type) {
     }
 }
 
+int legacyLineHandler(const char* line, size_t size, void* data) {
+    const auto cmd = (LegacyCommand*)data;
+    char* const buf = cmd->buf.get();
+    // WORKAROUND: Add "\r\n" for compatibility
+    size_t n = 0;
+    buf[n++] = '\r';
+    buf[n++] = '\n';
+    memcpy(buf + n, line, size);
+    n += size;
+    buf[n++] = '\r';
+    buf[n++] = '\n';
+    buf[n] = '\0';
+    const int r = cmd->cb(parseMdmType(line, size), buf, n, cmd->param);
+    if (r != WAIT) {
+        // Stop reading the response and return the callback's result to the caller
+        cmd->cbResult = r;
+        cmd->cbDone = true;
+        return SYSTEM_ERROR_CANCELLED;
+    }
+    return 0;
+}
+
+void legacyDoneHandler(int result, int errorCode, void* data) {
+    const auto cmd = (LegacyCommand*)data;
+    cmd->result = result;
+    cmd->errorCode = errorCode;
+    cmd->done = true;
+}
+
+CellularNcpClient* cellularNcpClient() {
+    const auto mgr = cellularNetworkManager();
+    if (!mgr) {
+        return nullptr;
+    }
+    return mgr->ncpClient();
+}
+
 hal_net_access_tech_t fromCellularAccessTechnology(CellularAccessTechnology rat) {
     switch (rat) {
     case CellularAccessTechnology::GSM:
@@ -235,6 +308,9 @@ int cellular_signal(CellularSignalHal* signal, cellular_signal_t* signalExt) {
     CHECK_TRUE(client, SYSTEM_ERROR_UNKNOWN);
     CellularSignalQuality s;
     CHECK(client->getSignalQuality(&s));
+    if (signalExt && signalExt->size >= offsetof(cellular_signal_t, age) + sizeof(signalExt->age)) {
+        signalExt->age = HAL_Timer_Get_Milli_Seconds() - s.timestamp();
+    }
     const auto strn = s.strength();
     const auto qual = s.quality();
     if (signal) {
@@ -326,72 +402,54 @@ int cellular_signal(CellularSignalHal* signal, cellular_signal_t* signalExt) {
     return 0;
 }
 
-int cellular_command(_CALLBACKPTR_MDM cb, void* param, system_tick_t timeout_ms, const char* format, ...) {
-    auto mgr = cellularNetworkManager();
-    CHECK_TRUE(mgr, SYSTEM_ERROR_UNKNOWN);
-    auto client = mgr->ncpClient();
+int cellular_signal_refresh(void* reserved) {
+    const auto client = cellularNcpClient();
     CHECK_TRUE(client, SYSTEM_ERROR_UNKNOWN);
-    auto parser = client->atParser();
-    CHECK_TRUE(parser, SYSTEM_ERROR_UNKNOWN);
+    CHECK(client->refreshSignalQuality());
+    return 0;
+}
 
-    NcpClientLock lock(client);
+int cellular_command(_CALLBACKPTR_MDM cb, void* param, system_tick_t timeout_ms, const char* format, ...) {
+    const auto client = cellularNcpClient();
+    CHECK_TRUE(client, SYSTEM_ERROR_UNKNOWN);
+    const auto queue = client->atCommandQueue();
+    CHECK_TRUE(queue, SYSTEM_ERROR_UNKNOWN);
 
-    // WORKAROUND: cut "\r\n", it has been resolved in AT Parser
-    size_t n = strlen(format);
-    while (n > 0 && (format[n - 1] == '\r' || format[n - 1] == '\n')) {
-        --n;
+    LegacyCommand cmd = {};
+    cmd.cb = cb;
+    cmd.param = param;
+    if (cb) {
+        // WORKAROUND: The legacy callbacks expect the lines to be framed with "\r\n"
+        cmd.buf.reset(new(std::nothrow) char[LEGACY_LINE_BUF_SIZE]);
+        CHECK_TRUE(cmd.buf, SYSTEM_ERROR_NO_MEMORY);
     }
-    std::unique_ptr<char[]> fmt(new(std::nothrow) char[n + 1]);
-    CHECK_TRUE(fmt, SYSTEM_ERROR_NO_MEMORY);
-    memcpy(fmt.get(), format, n);
-    fmt[n] = '\0';
 
     va_list args;
     va_start(args, format);
-    auto resp = parser->command().vprintf(fmt.get(), args).timeout(timeout_ms).send();
+    const int id = queue->venqueue(AtCommandQueue::NORMAL, timeout_ms, cb ? legacyLineHandler : nullptr,
+            legacyDoneHandler, &cmd, format, args);
     va_end(args);
-    if (!resp) {
-        if (resp.error() == SYSTEM_ERROR_TIMEOUT) {
-            return WAIT;
+    CHECK(id);
+
+    // The command is executed either by this thread or by the networking thread, whichever gets
+    // to it first. This thread executes only its own command, so the callbacks of the other queued
+    // commands are always invoked by the networking thread. The client lock is not held while
+    // waiting for the command to complete
+    while (!cmd.done) {
+        const int r = client->processCommand(id);
+        if (r < 0 && queue->cancel(id) == 0) {
+            // The command hasn't been sent to the modem
+            return r;
         }
-        return resp.error();
-    }
-
-    fmt.reset();
-
-    const size_t bufSize = MAX_RESP_SIZE + 64; // add some more space for framing
-    std::unique_ptr<char[]> buf(new(std::nothrow) char[bufSize]);
-    CHECK_TRUE(buf, SYSTEM_ERROR_NO_MEMORY);
-    // WORKAROUND: Add "\r\n" for compatibility
-    buf[0] = '\r';
-    buf[1] = '\n';
-
-    int mdmType = TYPE_OK;
-    while (resp.hasNextLine()) {
-        int n = resp.readLine(buf.get() + 2, bufSize - 5);
-        if (n < 0) {
-            if (n == SYSTEM_ERROR_TIMEOUT) {
-                return WAIT;
-            }
-            return n;
+        if (r <= 0 && !cmd.done) {
+            HAL_Delay_Milliseconds(COMMAND_POLL_INTERVAL);
         }
-        if (cb) {
-            mdmType = parseMdmType(buf.get() + 2, n);
-            n += 2;
-            // WORKAROUND: Add "\r\n" for compatibility
-            buf[n++] = '\r';
-            buf[n++] = '\n';
-            buf[n] = '\0';
-            const int r = cb(mdmType, buf.get(), n, param);
-            if (r != WAIT) {
-                return r;
-            }
-        }
-    };
-
-    buf.reset();
+    }
 
-    const int result = resp.readResult();
+    if (cmd.cbDone) {
+        return cmd.cbResult;
+    }
+    const int result = cmd.result;
     if (result < 0) {
         if (result == SYSTEM_ERROR_TIMEOUT) {
             return WAIT;
@@ -399,6 +457,7 @@ int cellular_command(_CALLBACKPTR_MDM cb, void* param, system_tick_t timeout_ms,
         return result;
     }
 
+    int mdmType = TYPE_OK;
     const char* mdmStr = nullptr;
     switch (result) {
     case AtResponse::OK:
@@ -442,7 +501,7 @@ int cellular_command(_CALLBACKPTR_MDM cb, void* param, system_tick_t timeout_ms,
     if (cb) {
         if (result == AtResponse::CME_ERROR || result == AtResponse::CMS_ERROR) {
             char msg[32] = {};
-            snprintf(msg, sizeof(msg), "%s: %d\r\n", mdmStr, resp.resultErrorCode());
+            snprintf(msg, sizeof(msg), "%s: %d\r\n", mdmStr, cmd.errorCode);
             cb(mdmType, msg, strlen(msg), param);
         } else {
             cb(mdmType, mdmStr, strlen(mdmStr), param);
@@ -452,6 +511,27 @@ int cellular_command(_CALLBACKPTR_MDM cb, void* param, system_tick_t timeout_ms,
     return mdmTypeToResult(mdmType);
 }
 
+int cellular_command_async(int priority, cellular_command_line_fn line_fn, cellular_command_done_fn done_fn,
+        void* data, system_tick_t timeout_ms, const char* format, ...) {
+    const auto client = cellularNcpClient();
+    CHECK_TRUE(client, SYSTEM_ERROR_UNKNOWN);
+    const auto queue = client->atCommandQueue();
+    CHECK_TRUE(queue, SYSTEM_ERROR_UNKNOWN);
+    va_list args;
+    va_start(args, format);
+    const int ret = queue->venqueue(priority, timeout_ms, line_fn, done_fn, data, format, args);
+    va_end(args);
+    return ret;
+}
+
+int cellular_command_cancel(int id, void* reserved) {
+    const auto client = cellularNcpClient();
+    CHECK_TRUE(client, SYSTEM_ERROR_UNKNOWN);
+    const auto queue = client->atCommandQueue();
+    CHECK_TRUE(queue, SYSTEM_ERROR_UNKNOWN);
+    return queue->cancel(id);
+}
+
 int cellular_data_usage_set(CellularDataHal* data, void* reserved) {
     return SYSTEM_ERROR_NOT_SUPPORTED;
 }
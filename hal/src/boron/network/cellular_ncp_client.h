@@ -20,8 +20,12 @@
 #include "ncp_client.h"
 #include "cellular_network_manager.h"
 
+#include "system_tick_hal.h"
+
 namespace particle {
 
+class AtCommandQueue;
+
 struct CellularNcpEvent: NcpEvent {
     enum Type {
         AUTH = CUSTOM_EVENT_TYPE_BASE
@@ -95,11 +99,15 @@ public:
     CellularSignalQuality& qualityUnits(const CellularQualityUnits& units);
     CellularQualityUnits qualityUnits() const;
 
+    CellularSignalQuality& timestamp(system_tick_t time);
+    system_tick_t timestamp() const;
+
 private:
     CellularAccessTechnology act_ = CellularAccessTechnology::NONE;
     int strength_ = -1;
     int quality_ = -1;
     CellularQualityUnits qunits_ = CellularQualityUnits::NONE;
+    system_tick_t time_ = 0;
 };
 
 class CellularNcpClient: public NcpClient {
@@ -107,7 +115,17 @@ public:
     virtual int connect(const CellularNetworkConfig& conf) = 0;
     virtual int getIccid(char* buf, size_t size) = 0;
     virtual int getImei(char* buf, size_t size) = 0;
+    // Returns the cached signal quality, querying the modem only if the cache is stale
     virtual int getSignalQuality(CellularSignalQuality* qual) = 0;
+    // Queries the modem and updates the cached signal quality
+    virtual int refreshSignalQuality() = 0;
+    // Queue of AT commands submitted by the user code
+    virtual AtCommandQueue* atCommandQueue() = 0;
+    // Executes pending commands. The client lock is acquired for each command separately
+    virtual int processCommands() = 0;
+    // Executes the specified pending command only. Returns 0 if the command is being executed by
+    // another thread or has already completed
+    virtual int processCommand(int id) = 0;
 };
 
 inline CellularNcpClientConfig::CellularNcpClientConfig() :
@@ -219,4 +237,13 @@ inline CellularQualityUnits CellularSignalQuality::qualityUnits() const {
     }
 }
 
+inline CellularSignalQuality& CellularSignalQuality::timestamp(system_tick_t time) {
+    time_ = time;
+    return *this;
+}
+
+inline system_tick_t CellularSignalQuality::timestamp() const {
+    return time_;
+}
+
 } // particle
@@ -21,6 +21,7 @@
 #include "wiznet/wiznetif.h"
 #include "nat64.h"
 #include <mutex>
+#include <initializer_list>
 #include <nrf52840.h>
 #include "random.h"
 #include "border_router_manager.h"
@@ -164,10 +165,16 @@ extern "C" {
 
 struct netif* lwip_hook_ip4_route_src(const ip4_addr_t* src, const ip4_addr_t* dst) {
     if (src == nullptr) {
-        if (en2 && netifCanForwardIpv4(en2->interface())) {
-            return en2->interface();
-        } else if (pp3 && netifCanForwardIpv4(pp3->interface())) {
-            return pp3->interface();
+        /* Use the interface with the lowest metric, preferring en2 if the metrics are equal */
+        BaseNetif* route = nullptr;
+        for (auto iface: {en2, pp3}) {
+            if (iface && netifCanForwardIpv4(iface->interface()) &&
+                    (!route || iface->getMetric() < route->getMetric())) {
+                route = iface;
+            }
+        }
+        if (route) {
+            return route->interface();
         }
     }
 
@@ -97,9 +97,18 @@ const auto UBLOX_NCP_SIM_SELECT_PIN = 23;
 const unsigned REGISTRATION_CHECK_INTERVAL = 15 * 1000;
 const unsigned REGISTRATION_TIMEOUT = 5 * 60 * 1000;
 
+// Reads of the signal quality are served from the cache if it's not older than this
+const system_tick_t SIGNAL_QUALITY_MAX_AGE = 60 * 1000;
+// Interval at which the cached signal quality is refreshed in the background
+const system_tick_t SIGNAL_QUALITY_POLL_INTERVAL = 30 * 1000;
+
+// Maximum size of a network registration status line
+const size_t REG_STATUS_LINE_SIZE = 64;
+
 } // anonymous
 
-SaraNcpClient::SaraNcpClient() {
+SaraNcpClient::SaraNcpClient() :
+        cmdQueue_(&parser_) {
 }
 
 SaraNcpClient::~SaraNcpClient() {
@@ -143,6 +152,7 @@ void SaraNcpClient::destroy() {
         ncpState_ = NcpState::OFF;
         modemPowerOff();
     }
+    cmdQueue_.clear(SYSTEM_ERROR_CANCELLED);
     parser_.destroy();
     muxerAtStream_.reset();
     serial_.reset();
@@ -157,11 +167,11 @@ int SaraNcpClient::initParser(Stream* stream) {
     CHECK(parser_.init(std::move(parserConf)));
     CHECK(parser_.addUrcHandler("+CREG", [](AtResponseReader* reader, const char* prefix, void* data) -> int {
         const auto self = (SaraNcpClient*)data;
-        int val[2];
-        int r = CHECK_PARSER_URC(reader->scanf("+CREG: %d,%d", &val[0], &val[1]));
-        CHECK_TRUE(r >= 1, SYSTEM_ERROR_UNKNOWN);
+        char buf[REG_STATUS_LINE_SIZE];
+        CHECK_PARSER_URC(reader->readLine(buf, sizeof(buf)));
+        const int stat = CHECK(self->signalCache_.parseRegistrationStatus(buf));
         // Home network or roaming
-        if (val[r - 1] == 1 || val[r - 1] == 5) {
+        if (stat == 1 || stat == 5) {
             self->creg_ = RegistrationState::Registered;
         } else {
             self->creg_ = RegistrationState::NotRegistered;
@@ -171,11 +181,11 @@ int SaraNcpClient::initParser(Stream* stream) {
     }, this));
     CHECK(parser_.addUrcHandler("+CGREG", [](AtResponseReader* reader, const char* prefix, void* data) -> int {
         const auto self = (SaraNcpClient*)data;
-        int val[2];
-        int r = CHECK_PARSER_URC(reader->scanf("+CGREG: %d,%d", &val[0], &val[1]));
-        CHECK_TRUE(r >= 1, SYSTEM_ERROR_UNKNOWN);
+        char buf[REG_STATUS_LINE_SIZE];
+        CHECK_PARSER_URC(reader->readLine(buf, sizeof(buf)));
+        const int stat = CHECK(self->signalCache_.parseRegistrationStatus(buf));
         // Home network or roaming
-        if (val[r - 1] == 1 || val[r - 1] == 5) {
+        if (stat == 1 || stat == 5) {
             self->cgreg_ = RegistrationState::Registered;
         } else {
             self->cgreg_ = RegistrationState::NotRegistered;
@@ -185,11 +195,11 @@ int SaraNcpClient::initParser(Stream* stream) {
     }, this));
     CHECK(parser_.addUrcHandler("+CEREG", [](AtResponseReader* reader, const char* prefix, void* data) -> int {
         const auto self = (SaraNcpClient*)data;
-        int val[2];
-        int r = CHECK_PARSER_URC(reader->scanf("+CEREG: %d,%d", &val[0], &val[1]));
-        CHECK_TRUE(r >= 1, SYSTEM_ERROR_UNKNOWN);
+        char buf[REG_STATUS_LINE_SIZE];
+        CHECK_PARSER_URC(reader->readLine(buf, sizeof(buf)));
+        const int stat = CHECK(self->signalCache_.parseRegistrationStatus(buf));
         // Home network or roaming
-        if (val[r - 1] == 1 || val[r - 1] == 5) {
+        if (stat == 1 || stat == 5) {
             self->cereg_ = RegistrationState::Registered;
         } else {
             self->cereg_ = RegistrationState::NotRegistered;
@@ -197,6 +207,7 @@ int SaraNcpClient::initParser(Stream* stream) {
         self->checkRegistrationState();
         return 0;
     }, this));
+    CHECK(signalCache_.init(&parser_, conf_.ncpIdentifier() == MESH_NCP_SARA_R410));
     return 0;
 }
 
@@ -304,8 +315,11 @@ int SaraNcpClient::dataChannelWrite(int id, const uint8_t* data, size_t size) {
 }
 
 void SaraNcpClient::processEvents() {
-    const NcpClientLock lock(this);
-    processEventsImpl();
+    {
+        const NcpClientLock lock(this);
+        processEventsImpl();
+    }
+    processCommands();
 }
 
 int SaraNcpClient::ncpId() const {
@@ -359,46 +373,23 @@ int SaraNcpClient::getSignalQuality(CellularSignalQuality* qual) {
     const NcpClientLock lock(this);
     CHECK_TRUE(connState_ != NcpConnectionState::DISCONNECTED, SYSTEM_ERROR_INVALID_STATE);
     CHECK_TRUE(qual, SYSTEM_ERROR_INVALID_ARGUMENT);
-    CHECK(checkParser());
-
-    {
-        int act;
-        int v;
-        auto resp = parser_.sendCommand("AT+COPS?");
-        int r = CHECK_PARSER(resp.scanf("+COPS: %d,%*d,\"%*[^\"]\",%d", &v, &act));
-        CHECK_TRUE(r == 2, SYSTEM_ERROR_UNKNOWN);
-        r = CHECK_PARSER(resp.readResult());
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_UNKNOWN);
 
-        switch (static_cast<CellularAccessTechnology>(act)) {
-            case CellularAccessTechnology::NONE:
-            case CellularAccessTechnology::GSM:
-            case CellularAccessTechnology::GSM_COMPACT:
-            case CellularAccessTechnology::UTRAN:
-            case CellularAccessTechnology::GSM_EDGE:
-            case CellularAccessTechnology::UTRAN_HSDPA:
-            case CellularAccessTechnology::UTRAN_HSUPA:
-            case CellularAccessTechnology::UTRAN_HSDPA_HSUPA:
-            case CellularAccessTechnology::LTE:
-            case CellularAccessTechnology::EC_GSM_IOT:
-            case CellularAccessTechnology::E_UTRAN: {
-                break;
-            }
-            default: {
-                return SYSTEM_ERROR_BAD_DATA;
-            }
-        }
-        qual->accessTechnology(static_cast<CellularAccessTechnology>(act));
+    CellularSignalCache::Info info = {};
+    if (!signalCache_.get(&info, SIGNAL_QUALITY_MAX_AGE)) {
+        CHECK(checkParser());
+        CHECK_PARSER(signalCache_.refresh());
+        CHECK_TRUE(signalCache_.get(&info, SIGNAL_QUALITY_MAX_AGE), SYSTEM_ERROR_INVALID_STATE);
     }
+    qual->accessTechnology(static_cast<CellularAccessTechnology>(info.act));
+    qual->timestamp(info.time);
 
-    if (ncpId() == MESH_NCP_SARA_R410) {
-        int rxlev, rxqual, rscp, ecn0, rsrq, rsrp;
-        auto resp = parser_.sendCommand("AT+CESQ");
-        int r = CHECK_PARSER(resp.scanf("+CESQ: %d,%d,%d,%d,%d,%d", &rxlev, &rxqual,
-                &rscp, &ecn0, &rsrq, &rsrp));
-        CHECK_TRUE(r == 6, SYSTEM_ERROR_BAD_DATA);
-        r = CHECK_PARSER(resp.readResult());
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_UNKNOWN);
+    if (info.cesq) {
+        const int rxlev = info.rxlev;
+        const int rxqual = info.rxqual;
+        const int rscp = info.rscp;
+        const int ecn0 = info.ecn0;
+        const int rsrq = info.rsrq;
+        const int rsrp = info.rsrp;
 
         switch (qual->strengthUnits()) {
             case CellularStrengthUnits::RXLEV: {
@@ -438,12 +429,8 @@ int SaraNcpClient::getSignalQuality(CellularSignalQuality* qual) {
             }
         }
     } else {
-        int rxlev, rxqual;
-        auto resp = parser_.sendCommand("AT+CSQ");
-        int r = CHECK_PARSER(resp.scanf("+CSQ: %d,%d", &rxlev, &rxqual));
-        CHECK_TRUE(r == 2, SYSTEM_ERROR_BAD_DATA);
-        r = CHECK_PARSER(resp.readResult());
-        CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_UNKNOWN);
+        const int rxlev = info.rssi;
+        const int rxqual = info.ber;
 
         // Fixup values
         switch (qual->strengthUnits()) {
@@ -493,6 +480,42 @@ int SaraNcpClient::getSignalQuality(CellularSignalQuality* qual) {
     return 0;
 }
 
+int SaraNcpClient::refreshSignalQuality() {
+    const NcpClientLock lock(this);
+    CHECK_TRUE(connState_ != NcpConnectionState::DISCONNECTED, SYSTEM_ERROR_INVALID_STATE);
+    CHECK(checkParser());
+    CHECK_PARSER(signalCache_.refresh());
+    return 0;
+}
+
+int SaraNcpClient::processCommands() {
+    int count = 0;
+    for (size_t i = 0; i < AtCommandQueue::MAX_SIZE; ++i) {
+        // Release the lock between the commands so that the system's own modem operations
+        // can interleave with the queued ones
+        const NcpClientLock lock(this);
+        if (cmdQueue_.size() == 0) {
+            break;
+        }
+        const int r = checkParser();
+        if (r < 0) {
+            cmdQueue_.clear(r);
+            return r;
+        }
+        if (CHECK(cmdQueue_.process()) == 0) {
+            break;
+        }
+        ++count;
+    }
+    return count;
+}
+
+int SaraNcpClient::processCommand(int id) {
+    const NcpClientLock lock(this);
+    CHECK(checkParser());
+    return CHECK(cmdQueue_.process(id));
+}
+
 int SaraNcpClient::checkParser() {
     if (ncpState_ != NcpState::ON) {
         return SYSTEM_ERROR_INVALID_STATE;
@@ -835,6 +858,9 @@ int SaraNcpClient::registerNet() {
         r = CHECK_PARSER(parser_.execCommand("AT+CEREG=2"));
         CHECK_TRUE(r == AtResponse::OK, SYSTEM_ERROR_UNKNOWN);
     }
+    // Enable indicator events (+CIEV), so that the cached signal quality is invalidated when it changes.
+    // Ignore response code here, the cache is refreshed periodically anyway
+    r = CHECK_PARSER(parser_.execCommand("AT+CMER=1,0,0,2,1"));
 
     connectionState(NcpConnectionState::CONNECTING);
 
@@ -958,6 +984,8 @@ void SaraNcpClient::resetRegistrationState() {
     cereg_ = RegistrationState::NotRegistered;
     regStartTime_ = millis();
     regCheckTime_ = regStartTime_;
+    signalCache_.reset();
+    signalPollTime_ = regStartTime_;
 }
 
 void SaraNcpClient::checkRegistrationState() {
@@ -978,6 +1006,12 @@ int SaraNcpClient::processEventsImpl() {
     CHECK_TRUE(ncpState_ == NcpState::ON, SYSTEM_ERROR_INVALID_STATE);
     parser_.processUrc(); // Ignore errors
     checkRegistrationState();
+    if (connState_ == NcpConnectionState::CONNECTED && millis() - signalPollTime_ >= SIGNAL_QUALITY_POLL_INTERVAL) {
+        signalPollTime_ = millis();
+        if (signalCache_.needsRefresh(SIGNAL_QUALITY_POLL_INTERVAL)) {
+            CHECK_PARSER(signalCache_.refresh());
+        }
+    }
     if (connState_ != NcpConnectionState::CONNECTING ||
             millis() - regCheckTime_ < REGISTRATION_CHECK_INTERVAL) {
         return 0;
@@ -21,6 +21,8 @@
 #include "platform_ncp.h"
 
 #include "at_parser.h"
+#include "at_command_queue.h"
+#include "cellular_signal_cache.h"
 
 #include "spark_wiring_thread.h"
 #include "gsm0710muxer/channel_stream.h"
@@ -60,9 +62,14 @@ public:
     virtual int getIccid(char* buf, size_t size) override;
     virtual int getImei(char* buf, size_t size) override;
     virtual int getSignalQuality(CellularSignalQuality* qual) override;
+    virtual int refreshSignalQuality() override;
+    virtual AtCommandQueue* atCommandQueue() override;
+    virtual int processCommands() override;
+    virtual int processCommand(int id) override;
 
 private:
     AtParser parser_;
+    AtCommandQueue cmdQueue_;
     std::unique_ptr<SerialStream> serial_;
     RecursiveMutex mutex_;
     CellularNcpClientConfig conf_;
@@ -85,6 +92,8 @@ private:
     RegistrationState cereg_ = RegistrationState::NotRegistered;
     system_tick_t regStartTime_;
     system_tick_t regCheckTime_;
+    CellularSignalCache signalCache_;
+    system_tick_t signalPollTime_;
 
     int initParser(Stream* stream);
     int checkParser();
@@ -117,6 +126,10 @@ inline AtParser* SaraNcpClient::atParser() {
     return &parser_;
 }
 
+inline AtCommandQueue* SaraNcpClient::atCommandQueue() {
+    return &cmdQueue_;
+}
+
 inline void SaraNcpClient::lock() {
     mutex_.lock();
 }
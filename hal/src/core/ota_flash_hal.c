@@ -59,11 +59,28 @@ bool HAL_FLASH_Begin(uint32_t sFLASH_Address, uint32_t fileSize, void* reserved)
     return true;
 }
 
+bool HAL_FLASH_Resume(uint32_t sFLASH_Address, uint32_t fileSize, uint32_t chunk_size, const uint8_t* chunk_bitmap, void* reserved)
+{
+    // The region was erased in HAL_FLASH_Begin()
+    return true;
+}
+
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t bufferSize,  void* reserved)
 {
     return FLASH_Update(pBuffer, address, bufferSize);
 }
 
+int HAL_FLASH_Erase_Ahead(uint32_t max_sectors, void* reserved)
+{
+    return 0;
+}
+
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
+{
+    sFLASH_ReadBuffer(pBuffer, address, length);
+    return 0;
+}
+
 int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_validation_flags_t flags, void* reserved)
 {
   return 0;
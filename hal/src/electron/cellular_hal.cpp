@@ -236,6 +236,12 @@ cellular_result_t cellular_signal(CellularSignalHal* signal, cellular_signal_t*
     return detail::cellular_signal_impl(signal, signalext, r, status);
 }
 
+cellular_result_t cellular_signal_refresh(void* reserved)
+{
+    // The signal strength is not cached on this platform
+    return 0;
+}
+
 cellular_result_t cellular_command(_CALLBACKPTR_MDM cb, void* param,
                           system_tick_t timeout_ms, const char* format, ...)
 {
@@ -246,6 +252,17 @@ cellular_result_t cellular_command(_CALLBACKPTR_MDM cb, void* param,
     return ret;
 }
 
+int cellular_command_async(int priority, cellular_command_line_fn line_fn, cellular_command_done_fn done_fn,
+        void* data, system_tick_t timeout_ms, const char* format, ...)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
+int cellular_command_cancel(int id, void* reserved)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
 cellular_result_t _cellular_data_usage_set(CellularDataHal &data, const MDM_DataUsage &data_usage, bool ret)
 {
     if (!ret) {
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include "system_error.h"
 #include <limits>
+#include <cstddef>
 #include <cmath>
 #include "net_hal.h"
 
@@ -130,6 +131,9 @@ cellular_result_t cellular_signal_impl(CellularSignalHal* signal, cellular_signa
             signalext->quality = 0;
             break;
         }
+        if (signalext->size >= offsetof(cellular_signal_t, age) + sizeof(signalext->age)) {
+            signalext->age = 0; // Measured just now
+        }
     }
 
     return res;
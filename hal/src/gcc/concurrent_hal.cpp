@@ -0,0 +1,617 @@
+/**
+ ******************************************************************************
+  Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************
+ */
+
+/*
+ * Concurrency HAL for the virtual device, implemented on top of the C++ standard threading
+ * primitives (pthreads on Linux).
+ */
+
+#include "concurrent_hal.h"
+#include "timer_hal.h"
+#include "virtual_clock.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <pthread.h>
+
+using particle::VirtualClock;
+
+namespace {
+
+struct Thread {
+    std::thread thread;
+    std::thread::id id;
+    os_thread_fn_t fn;
+    void* param;
+};
+
+// The virtual device has no scheduler that can be suspended. Threads disabling the scheduling are
+// serialized with each other instead
+std::recursive_mutex s_schedulingMutex;
+thread_local unsigned s_schedulingDisabled = 0;
+
+template<typename PredT>
+bool waitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, system_tick_t timeout, PredT pred) {
+    return VirtualClock::instance()->waitFor(cv, lock, timeout, pred);
+}
+
+// Wakes up a thread blocked on the virtual clock
+void notifyOne(std::condition_variable& cv) {
+    VirtualClock::instance()->notify();
+    cv.notify_one();
+}
+
+class Queue {
+public:
+    Queue(size_t itemSize, size_t itemCount) :
+            data_(new(std::nothrow) char[itemSize * itemCount]),
+            itemSize_(itemSize),
+            itemCount_(itemCount),
+            head_(0),
+            count_(0) {
+    }
+
+    bool isValid() const {
+        return (bool)data_;
+    }
+
+    bool put(const void* item, system_tick_t timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!waitFor(notFull_, lock, timeout, [this]() { return count_ < itemCount_; })) {
+            return false;
+        }
+        const size_t tail = (head_ + count_) % itemCount_;
+        memcpy(data_.get() + tail * itemSize_, item, itemSize_);
+        ++count_;
+        notifyOne(notEmpty_);
+        return true;
+    }
+
+    bool take(void* item, system_tick_t timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!waitFor(notEmpty_, lock, timeout, [this]() { return count_ > 0; })) {
+            return false;
+        }
+        memcpy(item, data_.get() + head_ * itemSize_, itemSize_);
+        head_ = (head_ + 1) % itemCount_;
+        --count_;
+        notifyOne(notFull_);
+        return true;
+    }
+
+private:
+    std::unique_ptr<char[]> data_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    size_t itemSize_;
+    size_t itemCount_;
+    size_t head_;
+    size_t count_;
+};
+
+class Semaphore {
+public:
+    Semaphore(unsigned max, unsigned initial) :
+            max_(max),
+            count_(initial) {
+    }
+
+    bool take(system_tick_t timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!waitFor(cv_, lock, timeout, [this]() { return count_ > 0; })) {
+            return false;
+        }
+        --count_;
+        return true;
+    }
+
+    bool give() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ >= max_) {
+            return false;
+        }
+        ++count_;
+        notifyOne(cv_);
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    unsigned max_;
+    unsigned count_;
+};
+
+struct Timer {
+    void (*callback)(os_timer_t timer);
+    void* id;
+    unsigned period;
+    uint64_t expiry; // Virtual time in microseconds
+    bool oneShot;
+    bool active;
+    bool destroyed;
+};
+
+// Runs timer callbacks in a dedicated thread, similarly to the FreeRTOS timer daemon task
+class TimerService {
+public:
+    TimerService() :
+            running_(nullptr),
+            generation_(0) {
+        std::thread([this]() {
+            VirtualClock::instance()->registerThread();
+            run();
+        }).detach();
+    }
+
+    static TimerService* instance() {
+        // Intentionally leaked, the service thread runs until the process exits
+        static TimerService* service = new TimerService();
+        return service;
+    }
+
+    void add(Timer* t) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers_.push_back(t);
+    }
+
+    void remove(Timer* t) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers_.erase(std::remove(timers_.begin(), timers_.end(), t), timers_.end());
+        ++generation_;
+        notifyOne(cv_);
+        if (running_ == t) {
+            // Will be deleted once its callback returns
+            t->destroyed = true;
+        } else {
+            delete t;
+        }
+    }
+
+    void start(Timer* t) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        t->expiry = VirtualClock::instance()->micros() + (uint64_t)t->period * 1000;
+        t->active = true;
+        ++generation_;
+        notifyOne(cv_);
+    }
+
+    void stop(Timer* t) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        t->active = false;
+        ++generation_;
+        notifyOne(cv_);
+    }
+
+    void changePeriod(Timer* t, unsigned period) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        t->period = period;
+        t->expiry = VirtualClock::instance()->micros() + (uint64_t)t->period * 1000;
+        t->active = true;
+        ++generation_;
+        notifyOne(cv_);
+    }
+
+    bool isActive(Timer* t) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return t->active;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Timer*> timers_;
+    Timer* running_;
+    unsigned generation_; // Incremented when the set of active timers changes
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            Timer* next = nullptr;
+            for (Timer* t: timers_) {
+                if (t->active && (!next || t->expiry < next->expiry)) {
+                    next = t;
+                }
+            }
+            const uint64_t expiry = next ? next->expiry : VirtualClock::NO_DEADLINE;
+            const unsigned generation = generation_;
+            if (VirtualClock::instance()->waitUntil(cv_, lock, expiry, [this, generation]() {
+                    return generation_ != generation;
+                })) {
+                // The timers have changed
+                continue;
+            }
+            if (next->oneShot) {
+                next->active = false;
+            } else {
+                next->expiry += (uint64_t)next->period * 1000;
+            }
+            running_ = next;
+            lock.unlock();
+            next->callback(next);
+            lock.lock();
+            running_ = nullptr;
+            if (next->destroyed) {
+                delete next;
+            }
+        }
+    }
+};
+
+} // namespace
+
+/**
+ * Creates a new thread.
+ * @param thread            Receives the created thread handle. Will be set to NULL if the thread cannot be created.
+ * @param name              The name of the thread. Can be null.
+ * @param priority          The thread priority. Ignored on this platform.
+ * @param fun               The function to execute in a separate thread.
+ * @param thread_param      The parameter to pass to the thread function.
+ * @param stack_size        The size of the stack to create. Ignored on this platform.
+ * @return an error code. 0 if the thread was successfully created.
+ */
+os_result_t os_thread_create(os_thread_t* thread, const char* name, os_thread_prio_t priority, os_thread_fn_t fun, void* thread_param, size_t stack_size)
+{
+    *thread = NULL;
+    Thread* t = new(std::nothrow) Thread();
+    if (!t) {
+        return 1;
+    }
+    t->fn = fun;
+    t->param = thread_param;
+    try {
+        t->thread = std::thread([t]() {
+            VirtualClock::instance()->registerThread();
+            t->fn(t->param);
+        });
+    } catch (const std::system_error&) {
+        delete t;
+        return 1;
+    }
+    t->id = t->thread.get_id();
+#ifdef __linux__
+    if (name) {
+        char n[16] = {}; // Thread names are limited to 16 characters including the terminating null
+        strncpy(n, name, sizeof(n) - 1);
+        pthread_setname_np(t->thread.native_handle(), n);
+    }
+#endif
+    *thread = t;
+    return 0;
+}
+
+os_result_t os_thread_create_with_stack(os_thread_t* thread, const char* name, os_thread_prio_t priority, os_thread_fn_t fun, void* thread_param, size_t stack_size, void* stack)
+{
+    return os_thread_create(thread, name, priority, fun, thread_param, stack_size);
+}
+
+/**
+ * Determines if the given thread is the one executing.
+ * @param   The thread to test.
+ * @return {@code true} if the thread given is the one currently executing. {@code false} otherwise.
+ */
+bool os_thread_is_current(os_thread_t thread)
+{
+    return thread && ((Thread*)thread)->id == std::this_thread::get_id();
+}
+
+os_result_t os_thread_yield(void)
+{
+    std::this_thread::yield();
+    return 0;
+}
+
+bool os_thread_is_current_within_stack()
+{
+    return true;
+}
+
+/**
+ * Waits indefinitely for the given thread to finish.
+ * @param thread    The thread to wait for.
+ * @return 0 if the thread has successfully terminated. non-zero if the thread handle is not valid.
+ */
+os_result_t os_thread_join(os_thread_t thread)
+{
+    Thread* t = (Thread*)thread;
+    if (!t || os_thread_is_current(thread) || !t->thread.joinable()) {
+        return 1;
+    }
+    t->thread.join();
+    return 0;
+}
+
+/**
+ * Terminate thread.
+ * @param thread    The thread to terminate, or NULL to terminate current thread.
+ * @return 0 if the thread has successfully terminated. non-zero in case of an error.
+ */
+os_result_t os_thread_exit(os_thread_t thread)
+{
+    // Only the current thread can be terminated
+    if (thread && !os_thread_is_current(thread)) {
+        return 1;
+    }
+    pthread_exit(nullptr);
+    return 0;
+}
+
+/**
+ * Cleans up resources used by a terminated thread.
+ * @param thread    The thread to clean up.
+ * @return 0 on success.
+ */
+os_result_t os_thread_cleanup(os_thread_t thread)
+{
+    Thread* t = (Thread*)thread;
+    if (!t) {
+        return 1;
+    }
+    if (t->thread.joinable()) {
+        t->thread.detach();
+    }
+    delete t;
+    return 0;
+}
+
+/**
+ * Delays the current task until a specified time to set up periodic tasks
+ * @param previousWakeTime The time the thread last woke up.  May not be NULL.
+ *                         Set to the current time on first call. Will be updated
+ *                         when the task wakes up
+ * @param timeIncrement    The cycle time period
+ * @return 0 on success. 1 if previousWakeTime is NULL
+ */
+os_result_t os_thread_delay_until(system_tick_t *previousWakeTime, system_tick_t timeIncrement)
+{
+    if (previousWakeTime == NULL) {
+        return 1;
+    }
+    const system_tick_t wakeTime = *previousWakeTime + timeIncrement;
+    const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+    if ((int32_t)(wakeTime - now) > 0) {
+        VirtualClock::instance()->sleepFor((uint64_t)(wakeTime - now) * 1000);
+    }
+    *previousWakeTime = wakeTime;
+    return 0;
+}
+
+int os_condition_variable_create(condition_variable_t* cond)
+{
+    return (*cond = new(std::nothrow) std::condition_variable()) == NULL;
+}
+
+void os_condition_variable_destroy(condition_variable_t cond)
+{
+    delete (std::condition_variable*)cond;
+}
+
+void os_condition_variable_wait(condition_variable_t cond, void* lock)
+{
+    VirtualClock::instance()->waitUntil(*(std::condition_variable*)cond, *(std::unique_lock<std::mutex>*)lock,
+            VirtualClock::NO_DEADLINE);
+}
+
+void os_condition_variable_notify_one(condition_variable_t cond)
+{
+    notifyOne(*(std::condition_variable*)cond);
+}
+
+void os_condition_variable_notify_all(condition_variable_t cond)
+{
+    VirtualClock::instance()->notify();
+    ((std::condition_variable*)cond)->notify_all();
+}
+
+int os_queue_create(os_queue_t* queue, size_t item_size, size_t item_count, void*)
+{
+    *queue = NULL;
+    if (!item_size || !item_count) {
+        return 1;
+    }
+    Queue* q = new(std::nothrow) Queue(item_size, item_count);
+    if (!q || !q->isValid()) {
+        delete q;
+        return 1;
+    }
+    *queue = q;
+    return 0;
+}
+
+int os_queue_put(os_queue_t queue, const void* item, system_tick_t delay, void*)
+{
+    return !((Queue*)queue)->put(item, delay);
+}
+
+int os_queue_take(os_queue_t queue, void* item, system_tick_t delay, void*)
+{
+    return !((Queue*)queue)->take(item, delay);
+}
+
+int os_queue_destroy(os_queue_t queue, void*)
+{
+    delete (Queue*)queue;
+    return 0;
+}
+
+int os_mutex_create(os_mutex_t* mutex)
+{
+    return (*mutex = new(std::nothrow) std::mutex()) == NULL;
+}
+
+int os_mutex_destroy(os_mutex_t mutex)
+{
+    delete (std::mutex*)mutex;
+    return 0;
+}
+
+int os_mutex_lock(os_mutex_t mutex)
+{
+    ((std::mutex*)mutex)->lock();
+    return 0;
+}
+
+int os_mutex_trylock(os_mutex_t mutex)
+{
+    return !((std::mutex*)mutex)->try_lock();
+}
+
+int os_mutex_unlock(os_mutex_t mutex)
+{
+    ((std::mutex*)mutex)->unlock();
+    return 0;
+}
+
+int os_mutex_recursive_create(os_mutex_recursive_t* mutex)
+{
+    return (*mutex = new(std::nothrow) std::recursive_mutex()) == NULL;
+}
+
+int os_mutex_recursive_destroy(os_mutex_recursive_t mutex)
+{
+    delete (std::recursive_mutex*)mutex;
+    return 0;
+}
+
+int os_mutex_recursive_lock(os_mutex_recursive_t mutex)
+{
+    ((std::recursive_mutex*)mutex)->lock();
+    return 0;
+}
+
+int os_mutex_recursive_trylock(os_mutex_recursive_t mutex)
+{
+    return !((std::recursive_mutex*)mutex)->try_lock();
+}
+
+int os_mutex_recursive_unlock(os_mutex_recursive_t mutex)
+{
+    ((std::recursive_mutex*)mutex)->unlock();
+    return 0;
+}
+
+void os_thread_scheduling(bool enabled, void* reserved)
+{
+    if (enabled) {
+        if (s_schedulingDisabled > 0) {
+            --s_schedulingDisabled;
+            s_schedulingMutex.unlock();
+        }
+    } else {
+        s_schedulingMutex.lock();
+        ++s_schedulingDisabled;
+    }
+}
+
+os_scheduler_state_t os_scheduler_get_state(void* reserved)
+{
+    return s_schedulingDisabled ? OS_SCHEDULER_STATE_SUSPENDED : OS_SCHEDULER_STATE_RUNNING;
+}
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max, unsigned initial)
+{
+    return (*semaphore = new(std::nothrow) Semaphore(max, initial)) == NULL;
+}
+
+int os_semaphore_destroy(os_semaphore_t semaphore)
+{
+    delete (Semaphore*)semaphore;
+    return 0;
+}
+
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved)
+{
+    return !((Semaphore*)semaphore)->take(timeout);
+}
+
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved)
+{
+    return !((Semaphore*)semaphore)->give();
+}
+
+/**
+ * Create a new timer. Returns 0 on success.
+ */
+int os_timer_create(os_timer_t* timer, unsigned period, void (*callback)(os_timer_t timer), void* const timer_id, bool one_shot, void* reserved)
+{
+    Timer* t = new(std::nothrow) Timer();
+    if (!t) {
+        *timer = NULL;
+        return 1;
+    }
+    t->callback = callback;
+    t->id = timer_id;
+    t->period = period;
+    t->oneShot = one_shot;
+    TimerService::instance()->add(t);
+    *timer = t;
+    return 0;
+}
+
+int os_timer_get_id(os_timer_t timer, void** timer_id)
+{
+    *timer_id = ((Timer*)timer)->id;
+    return 0;
+}
+
+int os_timer_set_id(os_timer_t timer, void* timer_id)
+{
+    ((Timer*)timer)->id = timer_id;
+    return 0;
+}
+
+int os_timer_change(os_timer_t timer, os_timer_change_t change, bool fromISR, unsigned period, unsigned block, void* reserved)
+{
+    Timer* t = (Timer*)timer;
+    switch (change)
+    {
+    case OS_TIMER_CHANGE_START:
+    case OS_TIMER_CHANGE_RESET:
+        TimerService::instance()->start(t);
+        return 0;
+
+    case OS_TIMER_CHANGE_STOP:
+        TimerService::instance()->stop(t);
+        return 0;
+
+    case OS_TIMER_CHANGE_PERIOD:
+        TimerService::instance()->changePeriod(t, period);
+        return 0;
+    }
+    return -1;
+}
+
+int os_timer_destroy(os_timer_t timer, void* reserved)
+{
+    TimerService::instance()->remove((Timer*)timer);
+    return 0;
+}
+
+int os_timer_is_active(os_timer_t timer, void* reserved)
+{
+    return TimerService::instance()->isActive((Timer*)timer);
+}
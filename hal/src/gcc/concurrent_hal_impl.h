@@ -30,5 +30,13 @@ typedef void* os_semaphore_t;
 typedef void* os_mutex_recursive_t;
 typedef uintptr_t os_unique_id_t;
 
-#define OS_THREAD_PRIORITY_DEFAULT (0)
+#define OS_TIMER_INVALID_HANDLE NULL
+
+// Priorities and stack sizes are ignored by the pthread-based implementation
+#define OS_THREAD_PRIORITY_DEFAULT       (2)
+#define OS_THREAD_PRIORITY_CRITICAL      (9)
+#define OS_THREAD_PRIORITY_NETWORK       (7)
+#define OS_THREAD_PRIORITY_NETWORK_HIGH  (8)
 #define OS_THREAD_STACK_SIZE_DEFAULT (0)
+#define OS_THREAD_STACK_SIZE_DEFAULT_HIGH (0)
+#define OS_THREAD_STACK_SIZE_DEFAULT_NETWORK (0)
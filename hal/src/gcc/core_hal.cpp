@@ -402,6 +402,14 @@ bool HAL_Feature_Get(HAL_Feature feature)
 #include "dtls_session_persist.h"
 SessionPersistDataOpaque session;
 
+typedef struct ota_checkpoint_t
+{
+    uint16_t size;
+    uint8_t data[HAL_SYSTEM_BACKUP_OTA_SIZE];
+} ota_checkpoint_t;
+
+ota_checkpoint_t ota_checkpoint;
+
 int HAL_System_Backup_Save(size_t offset, const void* buffer, size_t length, void* reserved)
 {
     if (offset==0 && length==sizeof(SessionPersistDataOpaque))
@@ -409,6 +417,12 @@ int HAL_System_Backup_Save(size_t offset, const void* buffer, size_t length, voi
         memcpy(&session, buffer, length);
         return 0;
     }
+    if (offset==HAL_SYSTEM_BACKUP_OTA_OFFSET && length<=sizeof(ota_checkpoint.data))
+    {
+        memcpy(ota_checkpoint.data, buffer, length);
+        ota_checkpoint.size = length;
+        return 0;
+    }
     return -1;
 }
 
@@ -420,6 +434,12 @@ int HAL_System_Backup_Restore(size_t offset, void* buffer, size_t max_length, si
         memcpy(buffer, &session, sizeof(session));
         return 0;
     }
+    if (offset==HAL_SYSTEM_BACKUP_OTA_OFFSET && ota_checkpoint.size<=sizeof(ota_checkpoint.data) && max_length>=ota_checkpoint.size)
+    {
+        *length = ota_checkpoint.size;
+        memcpy(buffer, ota_checkpoint.data, ota_checkpoint.size);
+        return 0;
+    }
     return -1;
 }
 
@@ -18,22 +18,16 @@
 
 #include "delay_hal.h"
 #include "timer_hal.h"
+#include "virtual_clock.h"
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-variable"
-
-#include <boost/date_time/posix_time/posix_time.hpp>
-#include "boost_thread_wrap.h"
-
-#pragma GCC diagnostic pop
+using particle::VirtualClock;
 
 void HAL_Delay_Milliseconds(uint32_t millis)
 {
-    boost::this_thread::sleep(boost::posix_time::milliseconds(millis));
+    VirtualClock::instance()->sleepFor((uint64_t)millis * 1000);
 }
 
 void HAL_Delay_Microseconds(uint32_t micros)
 {
-    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    VirtualClock::instance()->sleepFor(micros);
 }
-
@@ -52,6 +52,25 @@ std::istream& operator>>(std::istream& in, ProtocolFactory& pf)
 	return in;
 }
 
+namespace particle {
+
+std::istream& operator>>(std::istream& in, VirtualClock::Mode& mode)
+{
+    string value;
+    in >> value;
+    if (value=="real")
+        mode = VirtualClock::REAL_TIME;
+    else if (value=="accelerated")
+        mode = VirtualClock::ACCELERATED;
+    else if (value=="discrete")
+        mode = VirtualClock::DISCRETE;
+    else
+        throw boost::program_options::invalid_option_value(value);
+    return in;
+}
+
+} // namespace particle
+
 class ConfigParser
 {
 
@@ -95,6 +114,8 @@ public:
             ("server_key,sk", po::value<string>(&config.server_key)->default_value("server_key.der"), "the filename containing the server public key")
             ("state,s", po::value<string>(&config.periph_directory)->default_value("state"), "the directory where device state and peripherals is stored")
 			("protocol,p", po::value<ProtocolFactory>(&config.protocol)->default_value(PROTOCOL_LIGHTSSL), "the cloud communication protocol to use")
+            ("clock", po::value<particle::VirtualClock::Mode>(&config.clock_mode)->default_value(particle::VirtualClock::REAL_TIME, "real"), "the clock mode (real, accelerated or discrete)")
+            ("clock_scale", po::value<double>(&config.clock_scale)->default_value(1.0), "the ratio of the virtual time to the real time in the accelerated clock mode")
 			;
 
         command_line_options.add(program_options).add(device_options);
@@ -203,5 +224,7 @@ void DeviceConfig::read(Configuration& configuration)
     setLoggerLevel(LoggerOutputLevel(NO_LOG_LEVEL-configuration.log_level));
 
     this->protocol = configuration.protocol;
+
+    particle::VirtualClock::instance()->mode(configuration.clock_mode, configuration.clock_scale);
 }
 
@@ -23,6 +23,7 @@
 #include <cstring>
 #include "filesystem.h"
 #include "spark_protocol_functions.h"
+#include "virtual_clock.h"
 
 extern const char* DEVICE_ID;
 extern const char* DEVICE_PRIVATE_KEY;
@@ -53,6 +54,8 @@ struct Configuration
     std::string periph_directory;
     uint16_t log_level = 0;
     ProtocolFactory protocol = PROTOCOL_LIGHTSSL;
+    particle::VirtualClock::Mode clock_mode = particle::VirtualClock::REAL_TIME;
+    double clock_scale = 1.0;
 };
 
 
@@ -33,11 +33,19 @@ FILE* output_file;
 
 bool HAL_FLASH_Begin(uint32_t sFLASH_Address, uint32_t fileSize, void* reserved)
 {
-    output_file = fopen("output.bin", "wb");
+    output_file = fopen("output.bin", "w+b");
     DEBUG("flash started");
     return output_file;
 }
 
+bool HAL_FLASH_Resume(uint32_t sFLASH_Address, uint32_t fileSize, uint32_t chunk_size, const uint8_t* chunk_bitmap, void* reserved)
+{
+    if (!output_file)
+        output_file = fopen("output.bin", "r+b");
+    DEBUG("flash resumed");
+    return output_file;
+}
+
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
 {
 	DEBUG("flash write %d %d", address, length);
@@ -46,6 +54,22 @@ int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length,
     return 0;
 }
 
+int HAL_FLASH_Erase_Ahead(uint32_t max_sectors, void* reserved)
+{
+    // No modules are reported on this platform (see HAL_System_Info()), so there are no cached
+    // module integrity results that would need to be invalidated
+    return 0;
+}
+
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
+{
+    if (!output_file)
+        return -1;
+    fflush(output_file);
+    fseek(output_file, address, SEEK_SET);
+    return fread(pBuffer, length, 1, output_file)==1 ? 0 : -1;
+}
+
 int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_validation_flags_t flags, void* reserved)
 {
   return 0;
@@ -1,105 +1,147 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usart_hal.h"
 #include "socket_hal.h"
+#include "ringbuffer.h"
+#include "check.h"
+#include <algorithm>
+
+using particle::services::RingBuffer;
 
 struct Usart {
-    virtual void init(Ring_Buffer *rx_buffer, Ring_Buffer *tx_buffer)=0;
+    virtual int init(const HAL_USART_Buffer_Config& conf)=0;
     virtual void begin(uint32_t baud)=0;
     virtual void end()=0;
-    virtual int32_t available()=0;
-    virtual int32_t availableForWrite()=0;
-    virtual int32_t read()=0;
-    virtual int32_t peek()=0;
-    virtual uint32_t write(uint8_t byte)=0;
+    virtual ssize_t data()=0;
+    virtual ssize_t space()=0;
+    virtual ssize_t read(uint8_t* buffer, size_t size)=0;
+    virtual ssize_t peek(uint8_t* buffer, size_t size)=0;
+    virtual ssize_t write(const uint8_t* buffer, size_t size)=0;
     virtual void flush()=0;
-
-    bool enabled() { return true; }
+    virtual bool enabled()=0;
 };
 
 const sock_handle_t SOCKET_INVALID = sock_handle_t(-1);
 
+/**
+ * Byte-packed RX and TX buffers that are filled from and drained to a socket.
+ */
 class SocketUsartBase : public Usart
 {
     private:
-        Ring_Buffer* rx;
-        Ring_Buffer* tx;
+        RingBuffer<uint8_t> rxBuffer_;
+        RingBuffer<uint8_t> txBuffer_;
+        bool configured_;
+        bool enabled_;
 
     protected:
         sock_handle_t socket;
 
 
-        SocketUsartBase() : socket(SOCKET_INVALID) {}
+        SocketUsartBase() : configured_(false), enabled_(false), socket(SOCKET_INVALID) {}
 
         virtual bool initSocket()=0;
 
-        inline int32_t read_char(bool peek=false)
-        {
-            if (rx->tail==rx->head)
-                return -1;
-
-            int32_t c = rx->buffer[rx->tail];
-            if (!peek)
-                rx->tail = (rx->tail+1) % SERIAL_BUFFER_SIZE;
-            return c;
-        }
-
-        inline void write_char(unsigned char c)
-        {
-            unsigned i = (unsigned int)(tx->head + 1) % SERIAL_BUFFER_SIZE;
-            if (i != tx->tail)
-            {
-                tx->buffer[tx->head] = c;
-                tx->head = i;
+        void fillFromSocket() {
+            uint8_t buf[SERIAL_BUFFER_SIZE];
+            ssize_t space;
+            while ((space = rxBuffer_.space()) > 0 && initSocket()) {
+                const sock_result_t r = socket_receive(socket, buf, std::min((size_t)space, sizeof(buf)), 0);
+                if (r <= 0) {
+                    break;
+                }
+                rxBuffer_.put(buf, r);
             }
         }
 
-        void fillFromSocketIfNeeded() {
-            int space;
-            if (rx->head>rx->tail) {    // head after tail, so can fill up to end of buffer
-                space = SERIAL_BUFFER_SIZE-rx->tail;
-            }
-            else {
-                space = rx->tail-rx->head;  // may be 0
-            }
-            if (socket!=SOCKET_INVALID && space>0) {
-                socket_receive(socket, rx->buffer+rx->head, space, 0);
+        void drainToSocket() {
+            uint8_t buf[SERIAL_BUFFER_SIZE];
+            ssize_t size;
+            while ((size = txBuffer_.peek(buf, std::min((size_t)txBuffer_.data(), sizeof(buf)))) > 0) {
+                if (initSocket()) {
+                    const sock_result_t r = socket_send(socket, buf, size);
+                    if (r <= 0) {
+                        break;
+                    }
+                    size = r;
+                }
+                // Data written with no peer connected is lost, as on an unconnected TX line
+                txBuffer_.get(buf, size);
             }
         }
 
+        void pump() {
+            drainToSocket();
+            fillFromSocket();
+        }
 
     public:
-        virtual void init(Ring_Buffer *rx_buffer, Ring_Buffer *tx_buffer) override
+        virtual int init(const HAL_USART_Buffer_Config& conf) override
         {
-            this->rx = rx_buffer;
-            this->tx = tx_buffer;
+            CHECK_TRUE(conf.rx_buffer, SYSTEM_ERROR_INVALID_ARGUMENT);
+            CHECK_TRUE(conf.rx_buffer_size, SYSTEM_ERROR_INVALID_ARGUMENT);
+            CHECK_TRUE(conf.tx_buffer, SYSTEM_ERROR_INVALID_ARGUMENT);
+            CHECK_TRUE(conf.tx_buffer_size, SYSTEM_ERROR_INVALID_ARGUMENT);
+            if (enabled_) {
+                end();
+            }
+            rxBuffer_.init((uint8_t*)conf.rx_buffer, conf.rx_buffer_size);
+            txBuffer_.init((uint8_t*)conf.tx_buffer, conf.tx_buffer_size);
+            configured_ = true;
+            return 0;
+        }
+
+        virtual void begin(uint32_t baud) override {
+            if (configured_) {
+                txBuffer_.reset();
+                enabled_ = true;
+            }
         }
 
         virtual void end() override {
-            socket_close(socket);
+            if (enabled_) {
+                flush();
+                enabled_ = false;
+            }
         }
+
         virtual void flush() override {
-            // todo
+            drainToSocket();
         }
 
-        virtual int32_t available() override {
-            fillFromSocketIfNeeded();
-            return (rx->head-rx->tail) % SERIAL_BUFFER_SIZE;
+        virtual bool enabled() override {
+            return enabled_;
         }
-        virtual int32_t availableForWrite() override {
-            return (SERIAL_BUFFER_SIZE + tx->head - tx->tail) % SERIAL_BUFFER_SIZE;
+
+        virtual ssize_t data() override {
+            CHECK_TRUE(enabled_, SYSTEM_ERROR_INVALID_STATE);
+            fillFromSocket();
+            return rxBuffer_.data();
         }
-        virtual int32_t read() override {
-            fillFromSocketIfNeeded();
-            return read_char();
+
+        virtual ssize_t space() override {
+            CHECK_TRUE(enabled_, SYSTEM_ERROR_INVALID_STATE);
+            drainToSocket();
+            return txBuffer_.space();
+        }
+
+        virtual ssize_t read(uint8_t* buffer, size_t size) override {
+            const size_t readSize = std::min((size_t)CHECK(data()), size);
+            CHECK_TRUE(readSize > 0, SYSTEM_ERROR_NO_MEMORY);
+            return rxBuffer_.get(buffer, readSize);
         }
-        virtual int32_t peek() override {
-            fillFromSocketIfNeeded();
-            return read_char(true);
+
+        virtual ssize_t peek(uint8_t* buffer, size_t size) override {
+            const size_t peekSize = std::min((size_t)CHECK(data()), size);
+            CHECK_TRUE(peekSize > 0, SYSTEM_ERROR_NO_MEMORY);
+            return rxBuffer_.peek(buffer, peekSize);
         }
-        virtual uint32_t write(uint8_t byte) override {
-            if (!initSocket())
-                return 0;
-            return socket_send(socket, &byte, 1);
+
+        virtual ssize_t write(const uint8_t* buffer, size_t size) override {
+            const size_t writeSize = std::min((size_t)CHECK(space()), size);
+            CHECK_TRUE(writeSize > 0, SYSTEM_ERROR_NO_MEMORY);
+            const ssize_t r = CHECK(txBuffer_.put(buffer, writeSize));
+            pump();
+            return r;
         }
 };
 
@@ -137,11 +179,6 @@ class SocketUsartClient : public SocketUsartBase {
         }
         return socket!=SOCKET_INVALID;
     }
-
-    public:
-
-        virtual void begin(uint32_t baud) {}
-
 };
 
 /**
@@ -154,10 +191,6 @@ class SocketUsartServer : public SocketUsartBase {
         virtual bool initSocket() {
             return socket!=SOCKET_INVALID;
         }
-
-    public:
-
-        virtual void begin(uint32_t baud) {}
 };
 
 
@@ -178,44 +211,60 @@ static SocketUsartClient usart2 = SocketUsartClient();
 
 }
 
+int HAL_USART_Init_Ex(HAL_USART_Serial serial, const HAL_USART_Buffer_Config* config, void*)
+{
+    CHECK_TRUE(config, SYSTEM_ERROR_INVALID_ARGUMENT);
+    return usartMap(serial).init(*config);
+}
+
 void HAL_USART_Init(HAL_USART_Serial serial, Ring_Buffer *rx_buffer, Ring_Buffer *tx_buffer)
 {
-    usartMap(serial).init(rx_buffer, tx_buffer);
+    HAL_USART_Buffer_Config conf = {};
+    conf.size = sizeof(HAL_USART_Buffer_Config);
+    conf.rx_buffer = rx_buffer->buffer;
+    conf.rx_buffer_size = sizeof(rx_buffer->buffer);
+    conf.tx_buffer = tx_buffer->buffer;
+    conf.tx_buffer_size = sizeof(tx_buffer->buffer);
+    HAL_USART_Init_Ex(serial, &conf, nullptr);
 }
 
 void HAL_USART_Begin(HAL_USART_Serial serial, uint32_t baud)
 {
-    //usartMap(serial).begin(baud);
+    usartMap(serial).begin(baud);
 }
 
 void HAL_USART_End(HAL_USART_Serial serial)
 {
-    //usartMap(serial).end();
+    usartMap(serial).end();
 }
 
 int32_t HAL_USART_Available_Data_For_Write(HAL_USART_Serial serial)
 {
-    return usartMap(serial).availableForWrite();
+    return usartMap(serial).space();
 }
 
 uint32_t HAL_USART_Write_Data(HAL_USART_Serial serial, uint8_t data)
 {
-    return usartMap(serial).write(data);
+    return std::max(usartMap(serial).write(&data, sizeof(data)), (ssize_t)0);
 }
 
 int32_t HAL_USART_Available_Data(HAL_USART_Serial serial)
 {
-    return usartMap(serial).available();
+    return usartMap(serial).data();
 }
 
 int32_t HAL_USART_Read_Data(HAL_USART_Serial serial)
 {
-    return usartMap(serial).read();
+    uint8_t c;
+    CHECK(usartMap(serial).read(&c, sizeof(c)));
+    return c;
 }
 
 int32_t HAL_USART_Peek_Data(HAL_USART_Serial serial)
 {
-    return usartMap(serial).peek();
+    uint8_t c;
+    CHECK(usartMap(serial).peek(&c, sizeof(c)));
+    return c;
 }
 
 void HAL_USART_Flush_Data(HAL_USART_Serial serial)
@@ -234,11 +283,12 @@ void HAL_USART_Half_Duplex(HAL_USART_Serial serial, bool Enable)
 
 void HAL_USART_BeginConfig(HAL_USART_Serial serial, uint32_t baud, uint32_t config, void *ptr)
 {
+    usartMap(serial).begin(baud);
 }
 
 uint32_t HAL_USART_Write_NineBitData(HAL_USART_Serial serial, uint16_t data)
 {
-    return usartMap(serial).write((uint8_t) data);
+    return HAL_USART_Write_Data(serial, (uint8_t)data);
 }
 
 void HAL_USART_Send_Break(HAL_USART_Serial serial, void* reserved)
@@ -248,4 +298,22 @@ void HAL_USART_Send_Break(HAL_USART_Serial serial, void* reserved)
 uint8_t HAL_USART_Break_Detected(HAL_USART_Serial serial)
 {
   return 0;
-}
\ No newline at end of file
+}
+
+ssize_t HAL_USART_Write(HAL_USART_Serial serial, const void* buffer, size_t size, size_t elementSize)
+{
+    CHECK_TRUE(elementSize == sizeof(uint8_t), SYSTEM_ERROR_INVALID_ARGUMENT);
+    return usartMap(serial).write((const uint8_t*)buffer, size);
+}
+
+ssize_t HAL_USART_Read(HAL_USART_Serial serial, void* buffer, size_t size, size_t elementSize)
+{
+    CHECK_TRUE(elementSize == sizeof(uint8_t), SYSTEM_ERROR_INVALID_ARGUMENT);
+    return usartMap(serial).read((uint8_t*)buffer, size);
+}
+
+ssize_t HAL_USART_Peek(HAL_USART_Serial serial, void* buffer, size_t size, size_t elementSize)
+{
+    CHECK_TRUE(elementSize == sizeof(uint8_t), SYSTEM_ERROR_INVALID_ARGUMENT);
+    return usartMap(serial).peek((uint8_t*)buffer, size);
+}
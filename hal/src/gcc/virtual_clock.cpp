@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "virtual_clock.h"
+
+#include <thread>
+#include <algorithm>
+
+namespace particle {
+
+const uint64_t VirtualClock::NO_DEADLINE;
+const unsigned VirtualClock::MAX_REAL_WAIT_MICROS;
+const unsigned VirtualClock::MAX_DISCRETE_WAIT_MICROS;
+const unsigned VirtualClock::IDLE_CHECK_INTERVAL_MICROS;
+
+class VirtualClock::ThreadState {
+public:
+    ThreadState() :
+            registered(false) {
+    }
+
+    ~ThreadState() {
+        if (registered) {
+            VirtualClock* const clock = VirtualClock::instance();
+            std::lock_guard<std::mutex> lock(clock->mutex_);
+            --clock->threads_;
+        }
+    }
+
+    bool registered;
+};
+
+VirtualClock::VirtualClock() :
+        realBase_(RealClock::now()),
+        virtualBase_(0),
+        unixOffset_(std::time(nullptr)),
+        scale_(1.0),
+        mode_(REAL_TIME),
+        threads_(0),
+        blocked_(0),
+        activity_(0),
+        autoAdvance_(true) {
+    std::thread([this]() { run(); }).detach();
+}
+
+VirtualClock* VirtualClock::instance() {
+    // Intentionally leaked, the clock is used by other threads until the process exits
+    static VirtualClock* clock = new VirtualClock();
+    return clock;
+}
+
+void VirtualClock::mode(Mode mode, double scale) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Rebase the clock so that the virtual time doesn't jump
+    virtualBase_ = microsImpl();
+    realBase_ = RealClock::now();
+    mode_ = mode;
+    scale_ = (mode == ACCELERATED && scale > 0) ? scale : 1.0;
+    // Let the blocked threads recalculate their wait times
+    for (const auto& w: waiters_) {
+        w.second->notify_all();
+    }
+}
+
+VirtualClock::Mode VirtualClock::mode() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mode_;
+}
+
+double VirtualClock::scale() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return scale_;
+}
+
+bool VirtualClock::advance(uint64_t micros) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode_ != DISCRETE) {
+        return false;
+    }
+    advanceImpl(virtualBase_ + micros);
+    return true;
+}
+
+bool VirtualClock::advanceToNextDeadline() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (mode_ != DISCRETE || waiters_.empty()) {
+        return false;
+    }
+    const uint64_t next = waiters_.begin()->first;
+    if (next == NO_DEADLINE || next <= virtualBase_) {
+        return false;
+    }
+    advanceImpl(next);
+    return true;
+}
+
+void VirtualClock::autoAdvance(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    autoAdvance_ = enabled;
+}
+
+uint64_t VirtualClock::micros() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return microsImpl();
+}
+
+time_t VirtualClock::unixTime() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return unixOffset_ + microsImpl() / 1000000;
+}
+
+void VirtualClock::unixTime(time_t time) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unixOffset_ = (int64_t)time - microsImpl() / 1000000;
+}
+
+void VirtualClock::sleepUntil(uint64_t deadline) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unique_lock<std::mutex> lock(mutex);
+    waitUntil(cv, lock, deadline, []() {
+        return false;
+    });
+}
+
+void VirtualClock::waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, uint64_t deadline) {
+    const auto it = block(deadline, &cv);
+    if (deadline == NO_DEADLINE) {
+        // The clock mode doesn't affect waits without a timeout
+        cv.wait(lock);
+    } else {
+        const auto t = realWaitTime(deadline);
+        if (t.count() > 0) {
+            cv.wait_for(lock, t);
+        }
+    }
+    unblock(it);
+}
+
+void VirtualClock::registerThread() {
+    static thread_local ThreadState state;
+    if (state.registered) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++threads_;
+    state.registered = true;
+}
+
+uint64_t VirtualClock::microsImpl() const {
+    if (mode_ == DISCRETE) {
+        return virtualBase_;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(RealClock::now() - realBase_).count();
+    return virtualBase_ + (uint64_t)(elapsed * scale_);
+}
+
+void VirtualClock::advanceImpl(uint64_t time) {
+    virtualBase_ = time;
+    // Wake up the threads whose deadlines have been reached. The waiters are removed from the
+    // list while holding the clock's mutex, so the condition variables are still valid here
+    for (auto it = waiters_.begin(); it != waiters_.end() && it->first <= time; ++it) {
+        it->second->notify_all();
+    }
+}
+
+std::chrono::microseconds VirtualClock::realWaitTime(uint64_t deadline) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t now = microsImpl();
+    if (deadline <= now) {
+        return std::chrono::microseconds(0);
+    }
+    if (mode_ == DISCRETE) {
+        return std::chrono::microseconds(MAX_DISCRETE_WAIT_MICROS);
+    }
+    const uint64_t t = (deadline - now) / scale_;
+    return std::chrono::microseconds(std::max<uint64_t>(std::min<uint64_t>(t, MAX_REAL_WAIT_MICROS), 1));
+}
+
+VirtualClock::Waiters::iterator VirtualClock::block(uint64_t deadline, std::condition_variable* cv) {
+    registerThread();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++blocked_;
+    return waiters_.insert(std::make_pair(deadline, cv));
+}
+
+void VirtualClock::unblock(Waiters::iterator it) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    waiters_.erase(it);
+    --blocked_;
+    ++activity_;
+}
+
+void VirtualClock::run() {
+    unsigned lastActivity = activity_;
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::microseconds(IDLE_CHECK_INTERVAL_MICROS));
+        const unsigned activity = activity_;
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Advance the time only if all participating threads have stayed blocked since the
+        // previous check
+        const bool idle = (activity == lastActivity);
+        lastActivity = activity;
+        if (mode_ != DISCRETE || !autoAdvance_ || !idle || !threads_ || blocked_ < threads_ || waiters_.empty()) {
+            continue;
+        }
+        const uint64_t next = waiters_.begin()->first;
+        if (next == NO_DEADLINE || next <= virtualBase_) {
+            // The threads with expired deadlines haven't resumed yet
+            continue;
+        }
+        advanceImpl(next);
+    }
+}
+
+} // particle
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "concurrent_hal.h"
+#include "system_tick_hal.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <map>
+#include <limits>
+#include <ctime>
+#include <cstdint>
+
+namespace particle {
+
+/**
+ * Time source of the virtual device.
+ *
+ * All time readings (millis, micros, RTC), delays, timed waits and software timers of the gcc
+ * platform are based on this clock. The clock supports the following modes:
+ *
+ * - `REAL_TIME`: the virtual time follows the host's monotonic clock (default).
+ * - `ACCELERATED`: the virtual time runs freely, `scale` times faster than the real time.
+ * - `DISCRETE`: the virtual time only changes when it's advanced explicitly via `advance()`, or
+ *   when all threads participating in the time keeping are blocked, in which case the clock jumps
+ *   to the nearest deadline of the blocked threads. A thread participates in the time keeping
+ *   once it has been created via `os_thread_create()` or has blocked on the clock for the first
+ *   time. Code polling the time in a busy loop never lets the clock advance in this mode.
+ *
+ * Switching between the modes doesn't make the virtual time jump.
+ */
+class VirtualClock {
+public:
+    enum Mode {
+        REAL_TIME = 0,
+        ACCELERATED = 1,
+        DISCRETE = 2
+    };
+
+    /**
+     * Deadline value indicating that a wait has no timeout.
+     */
+    static const uint64_t NO_DEADLINE = std::numeric_limits<uint64_t>::max();
+
+    static VirtualClock* instance();
+
+    /**
+     * Sets the clock mode.
+     *
+     * @param mode Clock mode.
+     * @param scale Ratio of the virtual time to the real time in the accelerated mode.
+     */
+    void mode(Mode mode, double scale = 1.0);
+    Mode mode() const;
+    double scale() const;
+
+    /**
+     * Advances the virtual time in the discrete-event mode.
+     *
+     * @return `true` on success, or `false` if the clock is not in the discrete-event mode.
+     */
+    bool advance(uint64_t micros);
+    /**
+     * Advances the virtual time to the nearest deadline of the blocked threads in the
+     * discrete-event mode.
+     *
+     * @return `true` if the time has been advanced.
+     */
+    bool advanceToNextDeadline();
+    /**
+     * Enables or disables advancing the time automatically when all threads are blocked in the
+     * discrete-event mode. Enabled by default.
+     */
+    void autoAdvance(bool enabled);
+
+    /**
+     * Returns the virtual time in microseconds since the clock was created.
+     */
+    uint64_t micros() const;
+    uint64_t millis() const;
+
+    /**
+     * Returns or sets the virtual Unix time in seconds.
+     */
+    time_t unixTime() const;
+    void unixTime(time_t time);
+
+    /**
+     * Blocks the calling thread until the virtual time reaches `deadline`.
+     */
+    void sleepUntil(uint64_t deadline);
+    void sleepFor(uint64_t micros);
+
+    /**
+     * Blocks the calling thread until `pred` returns `true` or the virtual time reaches
+     * `deadline`.
+     *
+     * @return Result of the last evaluation of `pred`.
+     */
+    template<typename PredT>
+    bool waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, uint64_t deadline, PredT pred);
+    /**
+     * Blocks the calling thread until `pred` returns `true` or `timeout` milliseconds pass.
+     * A timeout of `CONCURRENT_WAIT_FOREVER` disables the timeout.
+     */
+    template<typename PredT>
+    bool waitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, system_tick_t timeout, PredT pred);
+    /**
+     * Blocks the calling thread until `cv` is notified, spuriously woken up or the virtual time
+     * reaches `deadline`.
+     */
+    void waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, uint64_t deadline);
+
+    /**
+     * Needs to be called when a thread blocked on the clock is about to be woken up by another
+     * thread, so that the clock doesn't advance before the woken thread resumes.
+     */
+    void notify();
+
+    /**
+     * Registers the calling thread as a participant in the time keeping. The thread is
+     * unregistered when it exits.
+     */
+    void registerThread();
+
+    VirtualClock(const VirtualClock&) = delete;
+    VirtualClock& operator=(const VirtualClock&) = delete;
+
+private:
+    typedef std::chrono::steady_clock RealClock;
+
+    class ThreadState;
+
+    // Maximum real time a thread blocks without reevaluating the virtual time
+    static const unsigned MAX_REAL_WAIT_MICROS = 20000;
+    // Maximum real time a thread blocks in the discrete-event mode. The blocked threads are woken
+    // up when the time advances, this only limits the latency in case of a race
+    static const unsigned MAX_DISCRETE_WAIT_MICROS = 10000;
+    // Real time the threads need to stay blocked before the clock advances automatically
+    static const unsigned IDLE_CHECK_INTERVAL_MICROS = 500;
+
+    typedef std::multimap<uint64_t, std::condition_variable*> Waiters;
+
+    mutable std::mutex mutex_;
+    Waiters waiters_; // Blocked threads by their deadlines
+    RealClock::time_point realBase_;
+    uint64_t virtualBase_;
+    int64_t unixOffset_;
+    double scale_;
+    Mode mode_;
+    unsigned threads_;
+    unsigned blocked_;
+    std::atomic<unsigned> activity_;
+    bool autoAdvance_;
+
+    VirtualClock();
+
+    uint64_t microsImpl() const;
+    void advanceImpl(uint64_t time);
+    std::chrono::microseconds realWaitTime(uint64_t deadline) const;
+    Waiters::iterator block(uint64_t deadline, std::condition_variable* cv);
+    void unblock(Waiters::iterator it);
+    void run();
+};
+
+template<typename PredT>
+inline bool VirtualClock::waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, uint64_t deadline,
+        PredT pred) {
+    while (!pred()) {
+        if (micros() >= deadline) {
+            return pred();
+        }
+        waitUntil(cv, lock, deadline);
+    }
+    return true;
+}
+
+template<typename PredT>
+inline bool VirtualClock::waitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, system_tick_t timeout,
+        PredT pred) {
+    const uint64_t deadline = (timeout == CONCURRENT_WAIT_FOREVER) ? NO_DEADLINE : micros() + (uint64_t)timeout * 1000;
+    return waitUntil(cv, lock, deadline, pred);
+}
+
+inline uint64_t VirtualClock::millis() const {
+    return micros() / 1000;
+}
+
+inline void VirtualClock::sleepFor(uint64_t micros) {
+    sleepUntil(this->micros() + micros);
+}
+
+inline void VirtualClock::notify() {
+    ++activity_;
+}
+
+} // particle
@@ -43,6 +43,25 @@ int netdb_getaddrinfo(const char* hostname, const char* servname,
   return lwip_getaddrinfo(hostname, servname, hints, res);
 }
 
+int netdb_getaddrinfo_async(const char* hostname, const char* servname, const struct addrinfo* hints,
+                            netdb_getaddrinfo_callback_t callback, void* ctx, netdb_getaddrinfo_request_t* req) {
+  /* Resolve synchronously */
+  if (req) {
+    *req = 0;
+  }
+  if (!callback) {
+    return EAI_FAIL;
+  }
+  struct addrinfo* res = NULL;
+  int r = lwip_getaddrinfo(hostname, servname, hints, &res);
+  callback(r, res, ctx);
+  return 0;
+}
+
+int netdb_getaddrinfo_cancel(netdb_getaddrinfo_request_t req) {
+  return EAI_FAIL;
+}
+
 int netdb_getnameinfo(const struct sockaddr* sa, socklen_t salen, char* host,
                       socklen_t hostlen, char* serv, socklen_t servlen, int flags) {
   /* Not implemented */
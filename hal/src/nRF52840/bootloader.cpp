@@ -5,6 +5,7 @@
 #include "bootloader.h"
 #include "module_info.h"
 #include "bootloader_hal.h"
+#include "ota_module.h"
 #include "ota_flash_hal_impl.h"
 #include "miniz.h"
 #include "stream.h"
@@ -157,6 +158,7 @@ int bootloader_update(const void* bootloader_image, unsigned length)
     int result = (FLASH_CopyMemory(FLASH_INTERNAL, (uint32_t)bootloader_image,
         FLASH_INTERNAL, BOOTLOADER_ADDR, length, MODULE_FUNCTION_BOOTLOADER,
         MODULE_VERIFY_DESTINATION_IS_START_ADDRESS|MODULE_VERIFY_CRC|MODULE_VERIFY_FUNCTION));
+    invalidate_module_integrity_cache();
     HAL_Bootloader_Lock(true);
     return result;
 }
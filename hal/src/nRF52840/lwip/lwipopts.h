@@ -20,6 +20,7 @@
 
 #include <limits.h>
 #include <stdint.h>
+#include <stddef.h>
 
 //#include <lwip/debug.h>
 
@@ -136,6 +137,19 @@ void sys_unlock_tcpip_core(void);
  */
 #define MEM_LIBC_MALLOC                (1)
 
+/**
+ * Allocations are checked against the heap limit set with if_set_mem_profile()
+ */
+void* lwip_hook_mem_malloc(size_t size);
+#define mem_clib_malloc                lwip_hook_mem_malloc
+
+/**
+ * MEMP_MEM_MALLOC==1: Allocate the pool elements from the heap on demand.
+ * The MEMP_NUM_xxx and PBUF_POOL_SIZE options below are the default pool
+ * limits, which can be changed at boot with if_set_mem_profile()
+ */
+#define MEMP_MEM_MALLOC                (1)
+
 
 /**
  * MEM_SIZE: the size of the heap memory. If the application will send
@@ -297,8 +311,10 @@ void sys_unlock_tcpip_core(void);
  * MEMP_NUM_SYS_TIMEOUT: the number of simultaneously active timeouts.
  * The default number of timeouts is calculated here for all enabled modules.
  * The formula expects settings to be either '0' or '1'.
+ * Additional timeouts: NAT64 session cleanup, DHCP INIT-REBOOT fallback for
+ * the Wi-Fi and Ethernet interfaces.
  */
-#define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 2)
+#define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 4)
 
 /**
  * MEMP_NUM_NETBUF: the number of struct netbufs.
@@ -896,6 +912,10 @@ void sys_unlock_tcpip_core(void);
 // #define TCP_OOSEQ_PBUFS_LIMIT(pcb)
 // #endif
 // #endif
+/* Configured at runtime with if_set_mem_profile() */
+struct tcp_pcb;
+uint16_t lwip_hook_tcp_ooseq_pbufs_limit(struct tcp_pcb* pcb);
+#define TCP_OOSEQ_PBUFS_LIMIT(pcb)      lwip_hook_tcp_ooseq_pbufs_limit(pcb)
 
 /**
  * TCP_LISTEN_BACKLOG: Enable the backlog option for tcp listen pcb.
@@ -1362,7 +1382,7 @@ void sys_unlock_tcpip_core(void);
 /**
  * LWIP_SO_RCVBUF==1: Enable SO_RCVBUF processing.
  */
-#define LWIP_SO_RCVBUF                  0
+#define LWIP_SO_RCVBUF                  1
 
 /**
  * LWIP_SO_LINGER==1: Enable SO_LINGER processing.
@@ -1371,8 +1391,10 @@ void sys_unlock_tcpip_core(void);
 
 /**
  * If LWIP_SO_RCVBUF is used, this is the default value for recv_bufsize.
+ * Configured at runtime with if_set_mem_profile().
  */
-#define RECV_BUFSIZE_DEFAULT            INT_MAX
+int lwip_hook_recv_bufsize_default(void);
+#define RECV_BUFSIZE_DEFAULT            lwip_hook_recv_bufsize_default()
 
 /**
  * By default, TCP socket/netconn close waits 20 seconds max to send the FIN
@@ -1478,13 +1500,16 @@ void sys_unlock_tcpip_core(void);
 
 /**
  * MEM_STATS==1: Enable mem.c stats.
+ * With MEM_LIBC_MALLOC, each allocation is prefixed with its size, which is
+ * needed to enforce the heap limit.
  */
-#define MEM_STATS                       ((MEM_LIBC_MALLOC == 0) && (MEM_USE_POOLS == 0))
+#define MEM_STATS                       (MEM_USE_POOLS == 0)
 
 /**
  * MEMP_STATS==1: Enable memp.c pool stats.
+ * With MEMP_MEM_MALLOC, the stats are needed to enforce the pool limits.
  */
-#define MEMP_STATS                      (MEMP_MEM_MALLOC == 0)
+#define MEMP_STATS                      1
 
 /**
  * SYS_STATS==1: Enable system stats (sem and mbox counts, etc).
@@ -335,12 +335,35 @@ uint16_t HAL_OTA_ChunkSize()
 bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved)
 {
     FLASH_Begin(address, length);
+    invalidate_module_integrity_cache();
+    return true;
+}
+
+bool HAL_FLASH_Resume(uint32_t address, uint32_t length, uint32_t chunk_size, const uint8_t* chunk_bitmap, void* reserved)
+{
+    FLASH_Resume(address, length, chunk_size, chunk_bitmap);
+    invalidate_module_integrity_cache();
     return true;
 }
 
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
 {
-    return FLASH_Update(pBuffer, address, length);
+    const int result = FLASH_Update(pBuffer, address, length);
+    invalidate_module_integrity_cache();
+    return result;
+}
+
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
+{
+    // The sectors holding the staged chunks are marked as erased in HAL_FLASH_Resume()
+    return FLASH_Read(pBuffer, address, length);
+}
+
+int HAL_FLASH_Erase_Ahead(uint32_t max_sectors, void* reserved)
+{
+    const int result = FLASH_EraseAhead(max_sectors);
+    invalidate_module_integrity_cache();
+    return result;
 }
 
 static hal_update_complete_t flash_bootloader(hal_module_t* mod, uint32_t moduleLength)
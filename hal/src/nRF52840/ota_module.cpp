@@ -20,6 +20,41 @@
 #include <string.h>
 #include "flash_mal.h"
 #include "ota_module.h"
+#include "module_integrity_cache.h"
+#include "hal_irq_flag.h"
+
+namespace {
+
+typedef particle::ModuleIntegrityCache<8> IntegrityCache;
+
+// Integrity check results of the modules stored in flash
+IntegrityCache g_integrityCache;
+
+/**
+ * Verifies the CRC of a module, or returns the cached result of a previous check.
+ */
+bool verify_module_integrity(const module_bounds_t* bounds, const module_info_t* info)
+{
+    const uint32_t length = module_length(info);
+    // The suffix contains the SHA-256 of the module image and is followed by the stored CRC
+    const uint8_t* const suffix = (const uint8_t*)info->module_end_address - sizeof(module_info_suffix_t);
+    uint32_t fingerprint = IntegrityCache::fingerprint(info, sizeof(module_info_t));
+    fingerprint = IntegrityCache::fingerprint(suffix, sizeof(module_info_suffix_t) + sizeof(module_info_crc_t), fingerprint);
+    bool valid = false;
+    int irq = HAL_disable_irq();
+    const bool cached = g_integrityCache.find(bounds->start_address, length, fingerprint, &valid);
+    const uint32_t generation = g_integrityCache.generation();
+    HAL_enable_irq(irq);
+    if (!cached) {
+        valid = FLASH_VerifyCRC32(FLASH_INTERNAL, bounds->start_address, length);
+        irq = HAL_disable_irq();
+        g_integrityCache.add(bounds->start_address, length, fingerprint, valid, generation);
+        HAL_enable_irq(irq);
+    }
+    return valid;
+}
+
+} // namespace
 
 // NB: Modules in external flash are made to appears as if they are located in Internal flash by means of
 // XiP - the external flash is mapped to a region of addressable memory, and can be access transparently via
@@ -75,7 +110,7 @@ bool fetch_module(hal_module_t* target, const module_bounds_t* bounds, bool user
             target->suffix = (module_info_suffix_t*)(module_end-sizeof(module_info_suffix_t));
             if (validate_module_dependencies(bounds, userDepsOptional, target->validity_checked & MODULE_VALIDATION_DEPENDENCIES_FULL))
                 target->validity_result |= MODULE_VALIDATION_DEPENDENCIES | (target->validity_checked & MODULE_VALIDATION_DEPENDENCIES_FULL);
-            if ((target->validity_checked & MODULE_VALIDATION_INTEGRITY) && FLASH_VerifyCRC32(FLASH_INTERNAL, bounds->start_address, module_length(target->info)))
+            if ((target->validity_checked & MODULE_VALIDATION_INTEGRITY) && verify_module_integrity(bounds, target->info))
                 target->validity_result |= MODULE_VALIDATION_INTEGRITY;
         }
         else
@@ -84,3 +119,9 @@ bool fetch_module(hal_module_t* target, const module_bounds_t* bounds, bool user
     return target->info!=NULL;
 }
 
+void invalidate_module_integrity_cache()
+{
+    const int irq = HAL_disable_irq();
+    g_integrityCache.invalidate();
+    HAL_enable_irq(irq);
+}
@@ -22,6 +22,7 @@
 #include "module_info.h"
 #include "user_hal.h"
 #include "ota_flash_hal_impl.h"
+#include "ota_module.h"
 #include "system_error.h"
 
 #define USER_ADDR (module_user.start_address)
@@ -49,6 +50,7 @@ int user_update_if_needed(void)
         updated = FLASH_CopyMemory(FLASH_INTERNAL, (uint32_t)user_image,
                 FLASH_INTERNAL, USER_ADDR, user_image_size, MODULE_FUNCTION_USER_PART,
                 MODULE_VERIFY_DESTINATION_IS_START_ADDRESS|MODULE_VERIFY_CRC|MODULE_VERIFY_FUNCTION);
+        invalidate_module_integrity_cache();
         if (updated == FLASH_ACCESS_RESULT_OK) {
             updated = SYSTEM_ERROR_NONE;
         } else {
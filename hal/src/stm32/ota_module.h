@@ -34,6 +34,11 @@ bool validate_module_dependencies(const module_bounds_t* bounds, bool userPartOp
 const module_bounds_t* find_module_bounds(uint8_t module_function, uint8_t module_index);
 bool fetch_module(hal_module_t* target, const module_bounds_t* bounds, bool userDepsOptional, uint16_t check_flags);
 const module_info_t* locate_module(const module_bounds_t* bounds);
+/**
+ * Discards the cached results of the module integrity checks. Needs to be called whenever the
+ * flash memory occupied by a module is modified.
+ */
+void invalidate_module_integrity_cache();
 
 #ifdef __cplusplus
 }
@@ -5,6 +5,7 @@
 #include "bootloader.h"
 #include "module_info.h"
 #include "bootloader_hal.h"
+#include "ota_module.h"
 
 #ifdef HAL_REPLACE_BOOTLOADER_OTA
 int bootloader_update(const void* bootloader_image, unsigned length)
@@ -13,6 +14,7 @@ int bootloader_update(const void* bootloader_image, unsigned length)
     int result = (FLASH_CopyMemory(FLASH_INTERNAL, (uint32_t)bootloader_image,
         FLASH_INTERNAL, 0x8000000, length, MODULE_FUNCTION_BOOTLOADER,
         MODULE_VERIFY_DESTINATION_IS_START_ADDRESS|MODULE_VERIFY_CRC|MODULE_VERIFY_FUNCTION));
+    invalidate_module_integrity_cache();
     HAL_Bootloader_Lock(true);
     return result;
 }
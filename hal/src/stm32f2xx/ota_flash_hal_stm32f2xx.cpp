@@ -241,12 +241,40 @@ uint16_t HAL_OTA_ChunkSize()
 bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved)
 {
     FLASH_Begin(address, length);
+    invalidate_module_integrity_cache();
+    return true;
+}
+
+bool HAL_FLASH_Resume(uint32_t address, uint32_t length, uint32_t chunk_size, const uint8_t* chunk_bitmap, void* reserved)
+{
+    // The region was erased in HAL_FLASH_Begin()
+    invalidate_module_integrity_cache();
     return true;
 }
 
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
 {
-    return FLASH_Update(pBuffer, address, length);
+    const int result = FLASH_Update(pBuffer, address, length);
+    invalidate_module_integrity_cache();
+    return result;
+}
+
+int HAL_FLASH_Erase_Ahead(uint32_t max_sectors, void* reserved)
+{
+    // The OTA region is erased in HAL_FLASH_Begin()
+    invalidate_module_integrity_cache();
+    return 0;
+}
+
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
+{
+#ifdef USE_SERIAL_FLASH
+    return -1;
+#else
+    // The OTA region is in the internal flash, which is memory mapped
+    memcpy(pBuffer, (const void*)address, length);
+    return 0;
+#endif
 }
 
 static hal_update_complete_t flash_bootloader(hal_module_t* mod, uint32_t moduleLength)
@@ -53,11 +53,26 @@ bool HAL_FLASH_Begin(uint32_t address, uint32_t length, void* reserved)
     return false;
 }
 
+bool HAL_FLASH_Resume(uint32_t address, uint32_t length, uint32_t chunk_size, const uint8_t* chunk_bitmap, void* reserved)
+{
+    return false;
+}
+
 int HAL_FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
 {
     return 0;
 }
 
+int HAL_FLASH_Erase_Ahead(uint32_t max_sectors, void* reserved)
+{
+    return 0;
+}
+
+int HAL_FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t length, void* reserved)
+{
+    return -1;
+}
+
 int HAL_FLASH_OTA_Validate(hal_module_t* mod, bool userDepsOptional, module_validation_flags_t flags, void* reserved)
 {
   return 0;
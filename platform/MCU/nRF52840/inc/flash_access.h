@@ -71,7 +71,10 @@ void FLASH_Erase(void);
 void FLASH_Backup(uint32_t FLASH_Address);
 void FLASH_Restore(uint32_t FLASH_Address);
 void FLASH_Begin(uint32_t FLASH_Address, uint32_t imageSize);
+void FLASH_Resume(uint32_t FLASH_Address, uint32_t imageSize, uint32_t chunkSize, const uint8_t* chunkBitmap);
 int FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t bufferSize);
+int FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t bufferSize);
+int FLASH_EraseAhead(uint32_t maxSectors);
 void FLASH_End(void);
 
 
@@ -32,12 +32,26 @@
 #include "flash_mal.h"
 #include "flash_hal.h"
 #include "exflash_hal.h"
+#include "flash_erase_map.h"
 
 
 #define CEIL_DIV(A, B)        (((A) + (B) - 1) / (B))
 
 #define MAX_COPY_LENGTH     256
 
+#ifdef USE_SERIAL_FLASH
+#define OTA_ERASE_SECTOR_SIZE   sFLASH_PAGESIZE
+#define OTA_ERASE_MAX_SECTORS   CEIL_DIV(EXTERNAL_FLASH_OTA_LENGTH, sFLASH_PAGESIZE)
+#else
+#define OTA_ERASE_SECTOR_SIZE   INTERNAL_FLASH_PAGE_SIZE
+#define OTA_ERASE_MAX_SECTORS   CEIL_DIV(FIRMWARE_IMAGE_SIZE, INTERNAL_FLASH_PAGE_SIZE)
+#endif
+
+/* Sectors of the OTA staging region are erased lazily, right before they are first written */
+static uint32_t ota_erase_bits[FLASH_ERASE_MAP_WORDS(OTA_ERASE_MAX_SECTORS)];
+static flash_erase_map ota_erase_map;
+static bool ota_erase_map_active = false;
+
 
 /* Private functions ---------------------------------------------------------*/
 
@@ -638,21 +652,72 @@ void FLASH_Restore(uint32_t FLASH_Address)
 #endif
 }
 
-void FLASH_Begin(uint32_t FLASH_Address, uint32_t imageSize)
+static int ota_erase_sector(uint32_t address, void* ctx)
+{
+#ifdef USE_SERIAL_FLASH
+    return hal_exflash_erase_sector(address, 1);
+#else
+    return hal_flash_erase_sector(address, 1);
+#endif
+}
+
+static void ota_erase_map_begin(uint32_t FLASH_Address, uint32_t imageSize, bool resume)
 {
     system_flags.OTA_FLASHED_Status_SysFlag = 0x0000;
     Save_SystemFlags();
 
+    if (!ota_erase_map.bits)
+    {
+        flash_erase_map_init(&ota_erase_map, ota_erase_bits, OTA_ERASE_MAX_SECTORS, OTA_ERASE_SECTOR_SIZE,
+                ota_erase_sector, NULL);
+    }
+    ota_erase_map_active = (flash_erase_map_begin(&ota_erase_map, FLASH_Address, imageSize, resume) == 0);
+    if (!ota_erase_map_active && !resume)
+    {
+        // The region is not tracked, erase it up front
 #ifdef USE_SERIAL_FLASH
-    FLASH_EraseMemory(FLASH_SERIAL, FLASH_Address, imageSize);
+        FLASH_EraseMemory(FLASH_SERIAL, FLASH_Address, imageSize);
 #else
-    FLASH_EraseMemory(FLASH_INTERNAL, FLASH_Address, imageSize);
+        FLASH_EraseMemory(FLASH_INTERNAL, FLASH_Address, imageSize);
 #endif
+    }
+}
+
+void FLASH_Begin(uint32_t FLASH_Address, uint32_t imageSize)
+{
+    ota_erase_map_begin(FLASH_Address, imageSize, false);
+}
+
+void FLASH_Resume(uint32_t FLASH_Address, uint32_t imageSize, uint32_t chunkSize, const uint8_t* chunkBitmap)
+{
+    ota_erase_map_begin(FLASH_Address, imageSize, true);
+    if (!ota_erase_map_active || !chunkSize || !chunkBitmap)
+    {
+        // An untracked region was erased up front when the update was started
+        return;
+    }
+    // The erase map doesn't survive a reset, but the sectors holding the written chunks were
+    // erased before the chunks were written, and the rest of those sectors is written with the
+    // same data when the missing chunks are received
+    const uint32_t chunks = CEIL_DIV(imageSize, chunkSize);
+    for (uint32_t i = 0; i < chunks; i++)
+    {
+        if (chunkBitmap[i / 8] & (1 << (i % 8)))
+        {
+            const uint32_t offset = i * chunkSize;
+            const uint32_t length = (imageSize - offset < chunkSize) ? imageSize - offset : chunkSize;
+            flash_erase_map_set_erased(&ota_erase_map, FLASH_Address + offset, length);
+        }
+    }
 }
 
 int FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t bufferSize)
 {
     int ret = -1;
+    if (ota_erase_map_active && flash_erase_map_prepare(&ota_erase_map, address, bufferSize) != 0)
+    {
+        return ret;
+    }
 #ifdef USE_SERIAL_FLASH
     ret = hal_exflash_write(address, pBuffer, bufferSize);
 #else
@@ -661,7 +726,27 @@ int FLASH_Update(const uint8_t *pBuffer, uint32_t address, uint32_t bufferSize)
     return ret;
 }
 
+int FLASH_Read(uint8_t *pBuffer, uint32_t address, uint32_t bufferSize)
+{
+#ifdef USE_SERIAL_FLASH
+    return hal_exflash_read(address, pBuffer, bufferSize);
+#else
+    return hal_flash_read(address, pBuffer, bufferSize);
+#endif
+}
+
+int FLASH_EraseAhead(uint32_t maxSectors)
+{
+    if (!ota_erase_map_active)
+    {
+        return 0;
+    }
+    return flash_erase_map_erase_ahead(&ota_erase_map, maxSectors);
+}
+
 void FLASH_End(void)
 {
     //FLASH_AddToNextAvailableModulesSlot() should be called in system_update.cpp
+    ota_erase_map_active = false;
+    flash_erase_map_reset(&ota_erase_map);
 }
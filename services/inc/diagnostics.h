@@ -44,6 +44,18 @@
 #define DIAG_NAME_NETWORK_SIGNAL_QUALITY "net:sigqual"
 #define DIAG_NAME_NETWORK_SIGNAL_QUALITY_VALUE "net:sigqualv"
 #define DIAG_NAME_NETWORK_ACCESS_TECNHOLOGY "net:at"
+#define DIAG_NAME_NETWORK_MEM_HEAP_PEAK "net:mem:heap:max"
+#define DIAG_NAME_NETWORK_MEM_HEAP_FAILURES "net:mem:heap:err"
+#define DIAG_NAME_NETWORK_MEM_PBUF_PEAK "net:mem:pbuf:max"
+#define DIAG_NAME_NETWORK_MEM_PBUF_FAILURES "net:mem:pbuf:err"
+#define DIAG_NAME_NETWORK_MEM_PBUF_REF_PEAK "net:mem:pbufref:max"
+#define DIAG_NAME_NETWORK_MEM_PBUF_REF_FAILURES "net:mem:pbufref:err"
+#define DIAG_NAME_NETWORK_MEM_TCP_PCB_PEAK "net:mem:tcppcb:max"
+#define DIAG_NAME_NETWORK_MEM_TCP_PCB_FAILURES "net:mem:tcppcb:err"
+#define DIAG_NAME_NETWORK_MEM_TCP_SEG_PEAK "net:mem:tcpseg:max"
+#define DIAG_NAME_NETWORK_MEM_TCP_SEG_FAILURES "net:mem:tcpseg:err"
+#define DIAG_NAME_NETWORK_MEM_UDP_PCB_PEAK "net:mem:udppcb:max"
+#define DIAG_NAME_NETWORK_MEM_UDP_PCB_FAILURES "net:mem:udppcb:err"
 #define DIAG_NAME_CLOUD_CONNECTION_STATUS "cloud:stat"
 #define DIAG_NAME_CLOUD_CONNECTION_ERROR_CODE "cloud:err"
 #define DIAG_NAME_CLOUD_DISCONNECTS "cloud:dconn"
@@ -85,6 +97,18 @@ typedef enum diag_id {
     DIAG_ID_NETWORK_SIGNAL_QUALITY = 34, // net:sigqual
     DIAG_ID_NETWORK_SIGNAL_QUALITY_VALUE = 35, // net:sigqualv
     DIAG_ID_NETWORK_ACCESS_TECNHOLOGY = 36, // net:at
+    DIAG_ID_NETWORK_MEM_HEAP_PEAK = 38, // net:mem:heap:max
+    DIAG_ID_NETWORK_MEM_HEAP_FAILURES = 39, // net:mem:heap:err
+    DIAG_ID_NETWORK_MEM_PBUF_PEAK = 40, // net:mem:pbuf:max
+    DIAG_ID_NETWORK_MEM_PBUF_FAILURES = 41, // net:mem:pbuf:err
+    DIAG_ID_NETWORK_MEM_PBUF_REF_PEAK = 42, // net:mem:pbufref:max
+    DIAG_ID_NETWORK_MEM_PBUF_REF_FAILURES = 43, // net:mem:pbufref:err
+    DIAG_ID_NETWORK_MEM_TCP_PCB_PEAK = 44, // net:mem:tcppcb:max
+    DIAG_ID_NETWORK_MEM_TCP_PCB_FAILURES = 45, // net:mem:tcppcb:err
+    DIAG_ID_NETWORK_MEM_TCP_SEG_PEAK = 46, // net:mem:tcpseg:max
+    DIAG_ID_NETWORK_MEM_TCP_SEG_FAILURES = 47, // net:mem:tcpseg:err
+    DIAG_ID_NETWORK_MEM_UDP_PCB_PEAK = 48, // net:mem:udppcb:max
+    DIAG_ID_NETWORK_MEM_UDP_PCB_FAILURES = 49, // net:mem:udppcb:err
     DIAG_ID_CLOUD_CONNECTION_STATUS = 10, // cloud:stat
     DIAG_ID_CLOUD_CONNECTION_ERROR_CODE = 13, // cloud:err
     DIAG_ID_CLOUD_DISCONNECTS = 14, // cloud:dconn
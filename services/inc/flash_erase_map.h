@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERVICES_FLASH_ERASE_MAP_H
+#define SERVICES_FLASH_ERASE_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of 32-bit words needed to track the given number of sectors.
+ */
+#define FLASH_ERASE_MAP_WORDS(sectors) (((sectors) + 31) / 32)
+
+/**
+ * Erases a single sector at the given address. Returns 0 on success.
+ */
+typedef int (*flash_erase_map_erase_fn)(uint32_t address, void* ctx);
+
+/**
+ * Tracks erased sectors of a flash region that is written sequentially, such as an OTA staging
+ * area. Instead of erasing the whole region up front, each sector is erased just before the first
+ * write into it, and a few sectors past the write position can be erased ahead when the caller
+ * is idle.
+ *
+ * The bitmap storage is provided by the caller. The map doesn't synchronize access.
+ */
+typedef struct flash_erase_map {
+    uint32_t* bits;
+    uint32_t max_sectors;
+    uint32_t sector_size;
+    uint32_t start; // Start address of the region, sector aligned
+    uint32_t sectors; // Number of sectors in the region
+    uint32_t next; // Index of the sector following the last written one
+    flash_erase_map_erase_fn erase;
+    void* ctx;
+} flash_erase_map;
+
+void flash_erase_map_init(flash_erase_map* map, uint32_t* bits, uint32_t max_sectors, uint32_t sector_size,
+        flash_erase_map_erase_fn erase, void* ctx);
+
+/**
+ * Starts tracking a region. No sectors are erased.
+ *
+ * If `resume` is true and the region is the same as the one being tracked, the sectors that
+ * have already been erased are not erased again.
+ */
+int flash_erase_map_begin(flash_erase_map* map, uint32_t address, uint32_t length, bool resume);
+
+/**
+ * Erases the sectors covering the given range that haven't been erased yet. This function should
+ * be called before writing to the range.
+ */
+int flash_erase_map_prepare(flash_erase_map* map, uint32_t address, uint32_t length);
+
+/**
+ * Erases at most `count` sectors following the last written sector.
+ *
+ * @return Number of erased sectors or an error code.
+ */
+int flash_erase_map_erase_ahead(flash_erase_map* map, uint32_t count);
+
+/**
+ * Marks the sectors covering the given range as erased without erasing them. This is used when
+ * resuming an interrupted write of the region: the sectors holding data written before the
+ * interruption were erased before that data was written.
+ */
+int flash_erase_map_set_erased(flash_erase_map* map, uint32_t address, uint32_t length);
+
+bool flash_erase_map_is_erased(const flash_erase_map* map, uint32_t address);
+
+/**
+ * Stops tracking the current region. A subsequent call to `flash_erase_map_begin()` will erase
+ * all sectors again.
+ */
+void flash_erase_map_reset(flash_erase_map* map);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // SERVICES_FLASH_ERASE_MAP_H
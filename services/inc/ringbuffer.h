@@ -19,6 +19,7 @@
 #define SERVICES_RINGBUFFER_H
 
 #include <cstddef>
+#include <algorithm>
 #include "system_error.h"
 #include "check.h"
 
@@ -70,6 +71,7 @@ public:
     ssize_t consumeCommit(size_t size, size_t cancel = 0);
 
 private:
+    void copyOut(T* v, size_t tail, size_t size) const;
     size_t curData() const;
     size_t curSpace() const;
     void updateCurSize();
@@ -158,13 +160,12 @@ inline ssize_t RingBuffer<T>::put(const T* v, size_t size) {
     size_t head = head_;
 
     if (v != nullptr) {
-        for (size_t i = 0; i < size; i++) {
-            buffer_[head] = v[i];
-            head = wrap(head + 1, curSize_);
-        }
-    } else {
-        head = wrap(head + size, curSize_);
+        // Copy in at most two contiguous blocks
+        const size_t n = std::min(size, curSize_ - head);
+        std::copy(v, v + n, buffer_ + head);
+        std::copy(v + n, v + size, buffer_);
     }
+    head = wrap(head + size, curSize_);
 
     head_ = head;
     full_ = (head_ == tail_);
@@ -187,13 +188,9 @@ inline ssize_t RingBuffer<T>::get(T* v, size_t size) {
     size_t tail = tail_;
 
     if (v != nullptr) {
-        for (size_t i = 0; i < size; i++) {
-            v[i] = buffer_[tail];
-            tail = wrap((tail + 1), curSize_);
-        }
-    } else {
-        tail = wrap(tail + size, curSize_);
+        copyOut(v, tail, size);
     }
+    tail = wrap(tail + size, curSize_);
 
     tail_ = tail;
     full_ = false;
@@ -214,9 +211,7 @@ inline ssize_t RingBuffer<T>::peek(T* v, size_t size) {
     CHECK_TRUE(data() >= (ssize_t)size, SYSTEM_ERROR_TOO_LARGE);
     CHECK_TRUE(v, SYSTEM_ERROR_INVALID_ARGUMENT);
 
-    for (size_t i = 0; i < size; i++) {
-        v[i] = buffer_[wrap((tail_ + i), curSize_)];
-    }
+    copyOut(v, tail_, size);
 
     return size;
 }
@@ -340,6 +335,14 @@ inline ssize_t RingBuffer<T>::consumeCommit(size_t size, size_t cancel) {
     return (size);
 }
 
+template <typename T>
+inline void RingBuffer<T>::copyOut(T* v, size_t tail, size_t size) const {
+    // Copy in at most two contiguous blocks
+    const size_t n = std::min(size, curSize_ - tail);
+    std::copy(buffer_ + tail, buffer_ + tail + n, v);
+    std::copy(buffer_, buffer_ + (size - n), v + n);
+}
+
 template <typename T>
 inline size_t RingBuffer<T>::curSpace() const {
     return curSize_ - curData();
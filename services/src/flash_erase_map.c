@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flash_erase_map.h"
+
+#include "system_error.h"
+
+#include <string.h>
+
+static bool is_erased(const flash_erase_map* map, uint32_t sector) {
+    return map->bits[sector / 32] & ((uint32_t)1 << (sector % 32));
+}
+
+static int erase_sector(flash_erase_map* map, uint32_t sector) {
+    if (map->erase(map->start + sector * map->sector_size, map->ctx) != 0) {
+        return SYSTEM_ERROR_IO;
+    }
+    map->bits[sector / 32] |= (uint32_t)1 << (sector % 32);
+    return 0;
+}
+
+void flash_erase_map_init(flash_erase_map* map, uint32_t* bits, uint32_t max_sectors, uint32_t sector_size,
+        flash_erase_map_erase_fn erase, void* ctx) {
+    memset(map, 0, sizeof(flash_erase_map));
+    map->bits = bits;
+    map->max_sectors = max_sectors;
+    map->sector_size = sector_size;
+    map->erase = erase;
+    map->ctx = ctx;
+    memset(map->bits, 0, FLASH_ERASE_MAP_WORDS(max_sectors) * sizeof(uint32_t));
+}
+
+int flash_erase_map_begin(flash_erase_map* map, uint32_t address, uint32_t length, bool resume) {
+    if (!length) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    const uint32_t start = address - address % map->sector_size;
+    const uint32_t sectors = (address + length - start + map->sector_size - 1) / map->sector_size;
+    if (sectors > map->max_sectors) {
+        return SYSTEM_ERROR_TOO_LARGE;
+    }
+    if (resume && map->sectors && start == map->start && sectors == map->sectors) {
+        return 0;
+    }
+    flash_erase_map_reset(map);
+    map->start = start;
+    map->sectors = sectors;
+    return 0;
+}
+
+int flash_erase_map_prepare(flash_erase_map* map, uint32_t address, uint32_t length) {
+    if (!length) {
+        return 0;
+    }
+    if (address < map->start || address + length > map->start + map->sectors * map->sector_size) {
+        return SYSTEM_ERROR_OUT_OF_RANGE;
+    }
+    const uint32_t first = (address - map->start) / map->sector_size;
+    const uint32_t last = (address + length - 1 - map->start) / map->sector_size;
+    for (uint32_t i = first; i <= last; ++i) {
+        if (!is_erased(map, i)) {
+            const int ret = erase_sector(map, i);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    if (last + 1 > map->next) {
+        map->next = last + 1;
+    }
+    return 0;
+}
+
+int flash_erase_map_erase_ahead(flash_erase_map* map, uint32_t count) {
+    int erased = 0;
+    for (uint32_t i = map->next; i < map->sectors && i - map->next < count; ++i) {
+        if (!is_erased(map, i)) {
+            const int ret = erase_sector(map, i);
+            if (ret < 0) {
+                return ret;
+            }
+            ++erased;
+        }
+    }
+    return erased;
+}
+
+int flash_erase_map_set_erased(flash_erase_map* map, uint32_t address, uint32_t length) {
+    if (!length) {
+        return 0;
+    }
+    if (address < map->start || address + length > map->start + map->sectors * map->sector_size) {
+        return SYSTEM_ERROR_OUT_OF_RANGE;
+    }
+    const uint32_t first = (address - map->start) / map->sector_size;
+    const uint32_t last = (address + length - 1 - map->start) / map->sector_size;
+    for (uint32_t i = first; i <= last; ++i) {
+        map->bits[i / 32] |= (uint32_t)1 << (i % 32);
+    }
+    if (last + 1 > map->next) {
+        map->next = last + 1;
+    }
+    return 0;
+}
+
+bool flash_erase_map_is_erased(const flash_erase_map* map, uint32_t address) {
+    if (address < map->start || address >= map->start + map->sectors * map->sector_size) {
+        return false;
+    }
+    return is_erased(map, (address - map->start) / map->sector_size);
+}
+
+void flash_erase_map_reset(flash_erase_map* map) {
+    memset(map->bits, 0, FLASH_ERASE_MAP_WORDS(map->max_sectors) * sizeof(uint32_t));
+    map->start = 0;
+    map->sectors = 0;
+    map->next = 0;
+}
@@ -210,6 +210,15 @@ int spark_set_connection_property(unsigned property_id, unsigned data, particle:
 
 int spark_set_random_seed_from_cloud_handler(void (*handler)(unsigned int), void* reserved);
 
+/**
+ * Notifies the cloud observers of a variable that its value has changed.
+ *
+ * @param varKey Variable name.
+ * @param reserved Reserved argument (should be set to `nullptr`).
+ * @return `true` if the variable is being observed.
+ */
+bool spark_notify_variable(const char* varKey, void* reserved);
+
 extern const unsigned char backup_udp_public_server_key[];
 extern const size_t backup_udp_public_server_key_size;
 
@@ -30,7 +30,8 @@ extern ISRTaskQueue SystemISRTaskQueue;
 #include <mutex>
 #include <future>
 
-#if !defined(PARTICLE_GTHREAD_INCLUDED) && PLATFORM_ID != 20
+// The virtual platforms use the host's native gthreads
+#if !defined(PARTICLE_GTHREAD_INCLUDED) && PLATFORM_ID != 20 && PLATFORM_ID != 3
 #error "GTHREAD header not included. This is required for correct mutex implementation on embedded platforms."
 #endif
 
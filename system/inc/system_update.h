@@ -59,7 +59,8 @@ typedef enum {
  *
  * @param file
  * @param flags bit 0 set (1) means it's a dry run to check parameters. bit 0 cleared means it's the real thing.
- * @param reserved NULL
+ *      bit 1 set (2) means an interrupted update is resumed and the staged data is kept.
+ * @param reserved NULL, or the bitmap of the staged chunks when an update is resumed.
  * @return 0 on success.
  */
 int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t flags, void* reserved);
@@ -82,6 +83,15 @@ int Spark_Finish_Firmware_Update(FileTransfer::Descriptor& file, uint32_t flags,
  */
 int Spark_Save_Firmware_Chunk(FileTransfer::Descriptor& file, const uint8_t* chunk, void* reserved);
 
+/**
+ * Reads back a chunk of the file data stored with Spark_Save_Firmware_Chunk().
+ * @param file
+ * @param chunk     Buffer for the chunk data
+ * @param reserved
+ * @return 0 on success.
+ */
+int Spark_Read_Firmware_Chunk(FileTransfer::Descriptor& file, uint8_t* chunk, void* reserved);
+
 typedef enum
 {
     /**
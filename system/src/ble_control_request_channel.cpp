@@ -107,8 +107,8 @@ struct __attribute__((packed)) HandshakeHeader {
 // Particle's company ID
 const unsigned COMPANY_ID = 0x0662;
 
-// Device setup protocol version
-const unsigned PROTOCOL_VERSION = 0x02;
+// Device setup protocol version. Version 3 adds session resumption
+const unsigned PROTOCOL_VERSION = 0x03;
 
 // Vendor-specific base UUID: 6FA9xxxx-5C4E-48A8-94F4-8030546F36FC
 const uint8_t BASE_UUID[16] = { 0xfc, 0x36, 0x6f, 0x54, 0x30, 0x80, 0xf4, 0x94, 0xa8, 0x48, 0x4e, 0x5c, 0x00, 0x00, 0xa9, 0x6f };
@@ -158,6 +158,25 @@ const char* const JPAKE_CLIENT_ID = "client";
 // Server identity string
 const char* const JPAKE_SERVER_ID = "server";
 
+// Size of the client and server nonces used for session resumption
+const size_t RESUME_NONCE_SIZE = 16;
+
+// Size of the MAC used for session resumption (HMAC-SHA256)
+const size_t RESUME_MAC_SIZE = 32;
+
+// Size of the session resumption request: type, session ID, client nonce, MAC
+const size_t RESUME_REQUEST_SIZE = 1 + BleControlSessionCache::ID_SIZE + RESUME_NONCE_SIZE + RESUME_MAC_SIZE;
+
+// Size of the reply to an accepted session resumption request: status, server nonce, MAC
+const size_t RESUME_ACCEPTED_REPLY_SIZE = 1 + RESUME_NONCE_SIZE + RESUME_MAC_SIZE;
+
+// Type of the session resumption request. A J-PAKE round 1 message never starts with this byte
+const uint8_t RESUME_REQUEST_TYPE = 0x00;
+
+// Status codes sent in reply to a session resumption request
+const uint8_t RESUME_ACCEPTED = 0x00;
+const uint8_t RESUME_REJECTED = 0x01;
+
 // Size of the cipher's key in bytes
 const size_t AES_CCM_KEY_SIZE = 16;
 
@@ -180,6 +199,9 @@ static_assert(AES_CCM_NONCE_SIZE >= AES_CCM_FIXED_NONCE_SIZE + 4, // 4 bytes of
 static_assert(JPAKE_SHARED_SECRET_SIZE >= AES_CCM_KEY_SIZE + AES_CCM_FIXED_NONCE_SIZE * 2, // See BleControlRequestChannel::initAesCcm()
         "Invalid size of the shared secret");
 
+static_assert(JPAKE_SHARED_SECRET_SIZE == RESUME_MAC_SIZE && BleControlSessionCache::KEY_SIZE == RESUME_MAC_SIZE,
+        "Invalid size of the session resumption keys"); // Both are derived via HMAC-SHA256
+
 #if BLE_CHANNEL_SECURITY_ENABLED
 const size_t MESSAGE_FOOTER_SIZE = AES_CCM_TAG_SIZE;
 #else
@@ -407,12 +429,16 @@ private:
     size_t offs_;
 };
 
+// Performs the J-PAKE handshake. If the client's first message is a session resumption request
+// for a known session, the session secret is derived from the cached resumption key instead
 class BleControlRequestChannel::JpakeHandler: public HandshakeHandler {
 public:
     explicit JpakeHandler(BleControlRequestChannel* channel) :
             HandshakeHandler(channel),
             ctx_(),
-            state_(State::NEW) {
+            sessions_(nullptr),
+            state_(State::NEW),
+            resumed_(false) {
     }
 
     ~JpakeHandler() {
@@ -421,8 +447,9 @@ public:
         memset(confirmKey_, 0, sizeof(confirmKey_));
     }
 
-    int init(const char* key, size_t keySize) {
+    int init(const char* key, size_t keySize, BleControlSessionCache* sessions) {
         CHECK(HandshakeHandler::init());
+        sessions_ = sessions;
         CHECK(hash_.init());
         mbedtls_ecjpake_init(&ctx_);
         CHECK_MBEDTLS(mbedtls_ecjpake_setup(&ctx_, MBEDTLS_ECJPAKE_SERVER, MBEDTLS_MD_SHA256, MBEDTLS_ECP_DP_SECP256R1,
@@ -470,6 +497,10 @@ public:
         return secret_;
     }
 
+    bool resumed() const {
+        return resumed_;
+    }
+
 private:
     enum class State {
         NEW,
@@ -487,7 +518,9 @@ private:
     mbedtls_ecjpake_context ctx_;
     char secret_[JPAKE_SHARED_SECRET_SIZE];
     char confirmKey_[Sha256::SIZE];
+    BleControlSessionCache* sessions_;
     State state_;
+    bool resumed_;
 
     int readRound1() {
         const char* data = nullptr;
@@ -496,6 +529,9 @@ private:
         if (ret != Result::DONE) {
             return ret;
         }
+        if (sessions_ && size == RESUME_REQUEST_SIZE && (uint8_t)data[0] == RESUME_REQUEST_TYPE) {
+            return resumeSession(data);
+        }
         CHECK_MBEDTLS(mbedtls_ecjpake_read_round_one(&ctx_, (const uint8_t*)data, size));
         CHECK(hash_.update(data, size));
         state_ = State::WRITE_ROUND1;
@@ -578,7 +614,7 @@ private:
         CHECK(hmac.update(JPAKE_SERVER_ID));
         CHECK(hmac.update(hashVal, sizeof(hashVal)));
         CHECK(hmac.finish(hashVal));
-        if (memcmp(data, hashVal, Sha256::SIZE) != 0) {
+        if (!constantTimeEqual(data, hashVal, Sha256::SIZE)) {
             LOG_DEBUG(ERROR, "Invalid confirmation message");
             return SYSTEM_ERROR_BAD_DATA;
         }
@@ -601,9 +637,85 @@ private:
         CHECK(hmac.update(buf->data, buf->size));
         CHECK(hmac.finish(buf->data));
         writePacket();
+        CHECK(saveSession());
+        state_ = State::DONE;
+        return Result::DONE;
+    }
+
+    int resumeSession(const char* data) {
+        const char* const id = data + 1;
+        const char* const clientNonce = id + BleControlSessionCache::ID_SIZE;
+        const char* const mac = clientNonce + RESUME_NONCE_SIZE;
+        char key[BleControlSessionCache::KEY_SIZE] = {};
+        SCOPE_GUARD({
+            memset(key, 0, sizeof(key));
+        });
+        // Validate the client's MAC
+        const int ok = sessions_->checkResume(id, mac, RESUME_MAC_SIZE, key, HAL_Timer_Get_Milli_Seconds(),
+                [id, clientNonce](const char* key, char* macVal) -> int {
+            HmacSha256 hmac;
+            CHECK(hmac.init(key, BleControlSessionCache::KEY_SIZE));
+            CHECK(hmac.update("RESUME_C"));
+            CHECK(hmac.update(id, BleControlSessionCache::ID_SIZE));
+            CHECK(hmac.update(clientNonce, RESUME_NONCE_SIZE));
+            return hmac.finish(macVal);
+        });
+        CHECK(ok);
+        Buffer* buf = nullptr;
+        if (!ok) {
+            // The client is expected to start the J-PAKE handshake after receiving this reply
+            LOG(TRACE, "Unknown or expired session, performing full handshake");
+            CHECK(initPacket(&buf, 1));
+            buf->data[0] = RESUME_REJECTED;
+            writePacket();
+            return Result::RUNNING;
+        }
+        CHECK(initPacket(&buf, RESUME_ACCEPTED_REPLY_SIZE));
+        buf->data[0] = RESUME_ACCEPTED;
+        char* const serverNonce = buf->data + 1;
+        CHECK_MBEDTLS(mbedtls_default_rng(nullptr, (uint8_t*)serverNonce, RESUME_NONCE_SIZE));
+        HmacSha256 hmac;
+        CHECK(hmac.init(key, sizeof(key)));
+        CHECK(hmac.update("RESUME_S"));
+        CHECK(hmac.update(id, BleControlSessionCache::ID_SIZE));
+        CHECK(hmac.update(clientNonce, RESUME_NONCE_SIZE));
+        CHECK(hmac.update(serverNonce, RESUME_NONCE_SIZE));
+        CHECK(hmac.finish(serverNonce + RESUME_NONCE_SIZE));
+        // Derive a new session secret from the resumption key and the fresh nonces
+        CHECK(hmac.start());
+        CHECK(hmac.update("RESUME_SECRET"));
+        CHECK(hmac.update(clientNonce, RESUME_NONCE_SIZE));
+        CHECK(hmac.update(serverNonce, RESUME_NONCE_SIZE));
+        CHECK(hmac.finish(secret_));
+        writePacket();
+        sessions_->resumed(id);
+        mbedtls_ecjpake_free(&ctx_);
+        hash_.destroy();
+        resumed_ = true;
         state_ = State::DONE;
         return Result::DONE;
     }
+
+    int saveSession() {
+        if (!sessions_) {
+            return 0;
+        }
+        // Both parties derive the session ID and resumption key from the J-PAKE's shared secret
+        char id[RESUME_MAC_SIZE] = {};
+        char key[BleControlSessionCache::KEY_SIZE] = {};
+        SCOPE_GUARD({
+            memset(key, 0, sizeof(key));
+        });
+        HmacSha256 hmac;
+        CHECK(hmac.init(secret_, sizeof(secret_)));
+        CHECK(hmac.update("SESSION_ID"));
+        CHECK(hmac.finish(id));
+        CHECK(hmac.start());
+        CHECK(hmac.update("SESSION_KEY"));
+        CHECK(hmac.finish(key));
+        sessions_->add(id, key, HAL_Timer_Get_Milli_Seconds());
+        return 0;
+    }
 };
 
 class BleControlRequestChannel::AesCcmCipher {
@@ -759,8 +871,12 @@ void BleControlRequestChannel::run() {
                 if (ret != 0) {
                     goto error;
                 }
+                if (jpake_->resumed()) {
+                    LOG(TRACE, "Session resumed");
+                } else {
+                    LOG(TRACE, "Handshake done");
+                }
                 jpake_.reset();
-                LOG(TRACE, "Handshake done");
             }
         } else {
 #endif
@@ -1202,7 +1318,7 @@ int BleControlRequestChannel::initJpake() {
     if (!jpake_) {
         return SYSTEM_ERROR_NO_MEMORY;
     }
-    CHECK(jpake_->init(secret, sizeof(secret)));
+    CHECK(jpake_->init(secret, sizeof(secret), &sessions_));
     return 0;
 }
 #endif // BLE_CHANNEL_SECURITY_ENABLED
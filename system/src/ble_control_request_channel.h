@@ -22,6 +22,7 @@
 #if SYSTEM_CONTROL_ENABLED && HAL_PLATFORM_BLE
 
 #include "control_request_handler.h"
+#include "ble_control_session_cache.h"
 #include "simple_pool_allocator.h"
 
 #include "intrusive_queue.h"
@@ -111,6 +112,7 @@ private:
 #if BLE_CHANNEL_SECURITY_ENABLED
     std::unique_ptr<AesCcmCipher> aesCcm_; // AES cipher
     std::unique_ptr<JpakeHandler> jpake_; // J-PAKE handshake handler
+    BleControlSessionCache sessions_; // Sessions that can be resumed without J-PAKE
 #endif
     AtomicAllocedPool pool_; // Pool allocator
 
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "system_tick_hal.h"
+
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+namespace particle {
+
+namespace system {
+
+// Compares two buffers in a time that doesn't depend on their contents
+inline bool constantTimeEqual(const char* a, const char* b, size_t size) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < size; ++i) {
+        diff |= (uint8_t)a[i] ^ (uint8_t)b[i];
+    }
+    return diff == 0;
+}
+
+// Cache of session tickets that allow a client of the BLE control request channel to resume
+// a previously established session without running the full J-PAKE handshake
+class BleControlSessionCache {
+public:
+    // Size of the session ID in bytes
+    static const size_t ID_SIZE = 8;
+    // Size of the resumption key in bytes
+    static const size_t KEY_SIZE = 32;
+    // Maximum number of cached sessions
+    static const size_t MAX_SESSIONS = 2;
+    // Default lifetime of a session in milliseconds
+    static const system_tick_t DEFAULT_MAX_AGE = 60 * 60 * 1000;
+    // Default number of times a session can be resumed
+    static const unsigned DEFAULT_MAX_RESUME_COUNT = 8;
+
+    explicit BleControlSessionCache(system_tick_t maxAge = DEFAULT_MAX_AGE, unsigned maxResumeCount = DEFAULT_MAX_RESUME_COUNT) :
+            sessions_(),
+            maxAge_(maxAge),
+            maxResumeCount_(maxResumeCount) {
+    }
+
+    ~BleControlSessionCache() {
+        clear();
+    }
+
+    // Adds a session. The least recently established session is evicted if the cache is full
+    void add(const char* id, const char* key, system_tick_t now) {
+        Session* s = find(id);
+        if (!s) {
+            s = &sessions_[0];
+            for (auto& session: sessions_) {
+                if (!session.valid) {
+                    s = &session;
+                    break;
+                }
+                if (now - session.timeCreated > now - s->timeCreated) { // Older session
+                    s = &session;
+                }
+            }
+        }
+        memcpy(s->id, id, ID_SIZE);
+        memcpy(s->key, key, KEY_SIZE);
+        s->timeCreated = now;
+        s->resumeCount = 0;
+        s->valid = true;
+    }
+
+    // Looks up a session and copies its resumption key to `key`. Expired sessions are removed
+    bool get(const char* id, char* key, system_tick_t now) {
+        Session* s = find(id);
+        if (!s) {
+            return false;
+        }
+        if (now - s->timeCreated >= maxAge_ || s->resumeCount >= maxResumeCount_) {
+            erase(s);
+            return false;
+        }
+        memcpy(key, s->key, KEY_SIZE);
+        return true;
+    }
+
+    // Validates a request to resume a session. `macFn(key, macVal)` computes the expected MAC of
+    // the request with the session's resumption key. Returns 1 and copies the key to `key` if
+    // the session is known and the MAC is valid, 0 if the request is rejected, or an error code
+    template<typename MacFn>
+    int checkResume(const char* id, const char* mac, size_t macSize, char* key, system_tick_t now, MacFn macFn) {
+        if (!get(id, key, now)) {
+            return 0;
+        }
+        char macVal[KEY_SIZE] = {}; // The MAC is at most as long as the key
+        if (macSize > sizeof(macVal)) {
+            memset(key, 0, KEY_SIZE);
+            return 0;
+        }
+        const int ret = macFn((const char*)key, macVal);
+        if (ret < 0 || !constantTimeEqual(mac, macVal, macSize)) {
+            memset(key, 0, KEY_SIZE);
+            return (ret < 0) ? ret : 0;
+        }
+        return 1;
+    }
+
+    // Records a successful resumption of a session
+    void resumed(const char* id) {
+        Session* s = find(id);
+        if (s) {
+            ++s->resumeCount;
+        }
+    }
+
+    void remove(const char* id) {
+        Session* s = find(id);
+        if (s) {
+            erase(s);
+        }
+    }
+
+    void clear() {
+        for (auto& session: sessions_) {
+            erase(&session);
+        }
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& session: sessions_) {
+            if (session.valid) {
+                ++n;
+            }
+        }
+        return n;
+    }
+
+private:
+    struct Session {
+        char id[ID_SIZE];
+        char key[KEY_SIZE];
+        system_tick_t timeCreated;
+        unsigned resumeCount;
+        bool valid;
+    };
+
+    Session sessions_[MAX_SESSIONS];
+    system_tick_t maxAge_;
+    unsigned maxResumeCount_;
+
+    Session* find(const char* id) {
+        for (auto& session: sessions_) {
+            if (session.valid && memcmp(session.id, id, ID_SIZE) == 0) {
+                return &session;
+            }
+        }
+        return nullptr;
+    }
+
+    static void erase(Session* s) {
+        memset(s, 0, sizeof(Session));
+    }
+};
+
+} // particle::system
+
+} // particle
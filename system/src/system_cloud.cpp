@@ -199,6 +199,12 @@ int spark_set_connection_property(unsigned property_id, unsigned data, particle:
     return spark_protocol_set_connection_property(sp, property_id, data, conn_prop, reserved);
 }
 
+bool spark_notify_variable(const char* varKey, void* reserved)
+{
+    SYSTEM_THREAD_CONTEXT_SYNC(spark_notify_variable(varKey, reserved));
+    return spark_protocol_notify_variable(sp, varKey, nullptr);
+}
+
 int spark_set_random_seed_from_cloud_handler(void (*handler)(unsigned int), void* reserved)
 {
 #ifndef SPARK_NO_CLOUD
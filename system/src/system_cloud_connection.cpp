@@ -253,6 +253,17 @@ int Spark_Receive(unsigned char *buf, uint32_t buflen, void* reserved)
     return system_cloud_recv(buf, buflen, 0);
 }
 
+// Returns a positive value if data is available, 0 on timeout, or a negative error code
+int Spark_Wait_Readable(system_tick_t timeout, void* reserved)
+{
+    if (SPARK_WLAN_RESET || SPARK_WLAN_SLEEP || spark_cloud_socket_closed() || cloud_socket_aborted)
+    {
+        return -1;
+    }
+
+    return system_cloud_wait_readable(timeout, 0);
+}
+
 int Internet_Test(void)
 {
     int r = system_internet_test(nullptr);
@@ -23,6 +23,7 @@
 #include "hal_platform.h"
 #include "ota_flash_hal.h"
 #include "socket_hal.h"
+#include "system_tick_hal.h"
 #include <type_traits>
 
 #ifdef __cplusplus
@@ -37,6 +38,7 @@ int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* s
 int system_cloud_disconnect(int flags);
 int system_cloud_send(const uint8_t* buf, size_t buflen, int flags);
 int system_cloud_recv(uint8_t* buf, size_t buflen, int flags);
+int system_cloud_wait_readable(system_tick_t timeout, int flags);
 int system_cloud_is_connected(void* reserved);
 int system_internet_test(void* reserved);
 int system_multicast_announce_presence(void* reserved);
@@ -58,6 +60,7 @@ uint8_t spark_cloud_socket_closed();
 
 int Spark_Send(const unsigned char *buf, uint32_t buflen, void* reserved);
 int Spark_Receive(unsigned char *buf, uint32_t buflen, void* reserved);
+int Spark_Wait_Readable(system_tick_t timeout, void* reserved);
 #if HAL_PLATFORM_CLOUD_UDP
 int Spark_Send_UDP(const unsigned char* buf, uint32_t buflen, void* reserved);
 int Spark_Receive_UDP(unsigned char *buf, uint32_t buflen, void* reserved);
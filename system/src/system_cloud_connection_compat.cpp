@@ -252,6 +252,11 @@ int system_cloud_recv(uint8_t* buf, size_t buflen, int flags)
     return SYSTEM_ERROR_UNKNOWN;
 }
 
+int system_cloud_wait_readable(system_tick_t timeout, int flags)
+{
+    return SYSTEM_ERROR_NOT_SUPPORTED;
+}
+
 int system_internet_test(void* reserved)
 {
     LOG_DEBUG(TRACE, "Internet test socket");
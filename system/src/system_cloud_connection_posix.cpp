@@ -26,7 +26,11 @@
 #include "system_string_interpolate.h"
 #include "spark_wiring_ticks.h"
 #include <arpa/inet.h>
+#include <climits>
 #include "spark_wiring_cloud.h"
+#if HAL_PLATFORM_IFAPI
+#include "system_network_manager.h"
+#endif // HAL_PLATFORM_IFAPI
 
 namespace {
 
@@ -41,12 +45,54 @@ struct SystemCloudState {
     int socket = -1;
     struct addrinfo* addr = nullptr;
     struct addrinfo* next = nullptr;
+    /* Addresses of the server resolved in background while connecting to a cached address */
+    struct addrinfo* resolved = nullptr;
+    netdb_getaddrinfo_request_t resolveReq = 0;
 };
 
 SystemCloudState s_state;
 
 const unsigned CLOUD_SOCKET_HALF_CLOSED_WAIT_TIMEOUT = 5000;
 
+void formatServerHostname(const ServerAddress* address, char* host, size_t hostSize, char* serv, size_t servSize)
+{
+    /* FIXME: this should probably be moved into system_cloud_internal */
+    system_string_interpolate(address->domain, host, hostSize, system_interpolate_cloud_server_hostname);
+    snprintf(serv, servSize, "%u", address->port);
+}
+
+void serverAddressResolved(int error, struct addrinfo* info, void* ctx)
+{
+    /* Invoked in the system thread */
+    s_state.resolveReq = 0;
+    if (error) {
+        LOG(TRACE, "Failed to resolve server address in background: %d", error);
+        return;
+    }
+    netdb_freeaddrinfo(s_state.resolved);
+    s_state.resolved = info;
+}
+
+void resolveServerAddressAsync(int protocol, const ServerAddress* address)
+{
+    if (s_state.resolveReq) {
+        return;
+    }
+    struct addrinfo hints = {};
+    hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+    hints.ai_protocol = protocol;
+    /* FIXME: */
+    hints.ai_socktype = hints.ai_protocol == IPPROTO_UDP ? SOCK_DGRAM : SOCK_STREAM;
+
+    char tmphost[sizeof(address->domain) + 32] = {};
+    char tmpserv[8] = {};
+    formatServerHostname(address, tmphost, sizeof(tmphost), tmpserv, sizeof(tmpserv));
+    netdb_getaddrinfo_request_t req = 0;
+    if (!netdb_getaddrinfo_async(tmphost, tmpserv, &hints, serverAddressResolved, nullptr, &req)) {
+        s_state.resolveReq = req;
+    }
+}
+
 } /* anonymous */
 
 int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* saddrCache)
@@ -70,6 +116,11 @@ int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* s
 
             if (!netdb_getaddrinfo(tmphost, tmpserv, &hints, &info)) {
                 type = CLOUD_SERVER_ADDRESS_TYPE_CACHED;
+                /* Refresh the server addresses in case the cached one no longer works, without
+                 * delaying the connection to the cached address */
+                if (address && address->addr_type == DOMAIN_NAME) {
+                    resolveServerAddressAsync(protocol, address);
+                }
             }
         }
     }
@@ -109,6 +160,17 @@ int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* s
             }
 
             case DOMAIN_NAME: {
+                if (s_state.resolveReq) {
+                    netdb_getaddrinfo_cancel(s_state.resolveReq);
+                    s_state.resolveReq = 0;
+                }
+                if (s_state.resolved) {
+                    LOG(TRACE, "Using server address resolved in background");
+                    info = s_state.resolved;
+                    s_state.resolved = nullptr;
+                    type = CLOUD_SERVER_ADDRESS_TYPE_NEW_ADDRINFO;
+                    break;
+                }
                 struct addrinfo hints = {};
                 hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
                 hints.ai_protocol = protocol;
@@ -117,9 +179,7 @@ int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* s
 
                 char tmphost[sizeof(address->domain) + 32] = {};
                 char tmpserv[8] = {};
-                /* FIXME: this should probably be moved into system_cloud_internal */
-                system_string_interpolate(address->domain, tmphost, sizeof(tmphost), system_interpolate_cloud_server_hostname);
-                snprintf(tmpserv, sizeof(tmpserv), "%u", address->port);
+                formatServerHostname(address, tmphost, sizeof(tmphost), tmpserv, sizeof(tmpserv));
                 LOG(TRACE, "Resolving %s#%s", tmphost, tmpserv);
                 netdb_getaddrinfo(tmphost, tmpserv, &hints, &info);
                 type = CLOUD_SERVER_ADDRESS_TYPE_NEW_ADDRINFO;
@@ -188,6 +248,14 @@ int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* s
                 continue;
             }
 
+#if HAL_PLATFORM_IFAPI
+            /* The cloud session is not subject to the default receive quota of UDP sockets */
+            const int rcvbuf = INT_MAX;
+            if (sock_setsockopt(s, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf))) {
+                LOG(WARN, "Cloud socket=%d, failed to set SO_RCVBUF, errno=%d", s, errno);
+            }
+#endif // HAL_PLATFORM_IFAPI
+
             /* Bind socket */
             if (sock_bind(s, (const struct sockaddr*)&saddr, sizeof(saddr))) {
                 LOG(ERROR, "Cloud socket=%d, failed to bind, errno=%d");
@@ -233,6 +301,9 @@ int system_cloud_connect(int protocol, const ServerAddress* address, sockaddr* s
         }
 
         s_state.socket = s;
+#if HAL_PLATFORM_IFAPI
+        particle::system::NetworkManager::instance()->setCloudEndpoint(a->ai_addr, a->ai_addrlen, a->ai_protocol, s);
+#endif // HAL_PLATFORM_IFAPI
         if (saddrCache) {
             memcpy(saddrCache, a->ai_addr, a->ai_addrlen);
         }
@@ -287,6 +358,9 @@ int system_cloud_disconnect(int flags)
     }
 
     s_state.socket = -1;
+#if HAL_PLATFORM_IFAPI
+    particle::system::NetworkManager::instance()->clearCloudEndpoint();
+#endif // HAL_PLATFORM_IFAPI
 
     return ret;
 }
@@ -311,6 +385,36 @@ int system_cloud_recv(uint8_t* buf, size_t buflen, int flags)
     return recvd;
 }
 
+int system_cloud_wait_readable(system_tick_t timeout, int flags)
+{
+    (void)flags;
+    if (s_state.socket < 0) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    /* Block on a peek with a receive timeout, the data is consumed later by system_cloud_recv() */
+    int recvFlags = MSG_PEEK;
+    if (timeout == 0) {
+        /* A zero SO_RCVTIMEO would block indefinitely */
+        recvFlags |= MSG_DONTWAIT;
+    } else {
+        timeval tv = {};
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
+        if (sock_setsockopt(s_state.socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) {
+            return SYSTEM_ERROR_NOT_SUPPORTED;
+        }
+    }
+    uint8_t b;
+    const int r = sock_recv(s_state.socket, &b, sizeof(b), recvFlags);
+    if (r < 0) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN || errno == ETIMEDOUT) {
+            return 0;
+        }
+        return SYSTEM_ERROR_IO;
+    }
+    return 1;
+}
+
 int system_internet_test(void* reserved)
 {
     return SYSTEM_ERROR_NOT_SUPPORTED;
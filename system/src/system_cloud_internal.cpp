@@ -45,6 +45,7 @@
 #include "hal_platform.h"
 #include "system_string_interpolate.h"
 #include "dtls_session_persist.h"
+#include "chunked_transfer.h"
 #include "bytes2hexbuf.h"
 #include "system_event.h"
 #include "system_cloud_connection.h"
@@ -411,13 +412,19 @@ int Spark_Save(const void* buffer, size_t length, uint8_t type, void* reserved)
 		}
 		return HAL_System_Backup_Save(0, buffer, length, nullptr);
 	}
+	if (type==SparkCallbacks::PERSIST_OTA)
+	{
+		static_assert(sizeof(particle::protocol::ChunkedTransfer::Checkpoint)<=HAL_SYSTEM_BACKUP_OTA_SIZE,"OTA backup space is not large enough for the transfer checkpoint");
+		return HAL_System_Backup_Save(HAL_SYSTEM_BACKUP_OTA_OFFSET, buffer, length, nullptr);
+	}
 	return -1;	// eek. define a constant for this error - Unknown Type.
 }
 
 int Spark_Restore(void* buffer, size_t max_length, uint8_t type, void* reserved)
 {
 	size_t length = 0;
-	int error = HAL_System_Backup_Restore(0, buffer, max_length, &length, nullptr);
+	const size_t offset = (type==SparkCallbacks::PERSIST_OTA) ? HAL_SYSTEM_BACKUP_OTA_OFFSET : 0;
+	int error = HAL_System_Backup_Restore(offset, buffer, max_length, &length, nullptr);
 	if (error)
 		length = 0;
 	return length;
@@ -784,9 +791,11 @@ void Spark_Protocol_Init(void)
         callbacks.finish_firmware_update = finish_ota_firmware_update;
         callbacks.calculate_crc = HAL_Core_Compute_CRC32;
         callbacks.save_firmware_chunk = Spark_Save_Firmware_Chunk;
+        callbacks.read_firmware_chunk = Spark_Read_Firmware_Chunk;
         callbacks.signal = Spark_Signal;
         callbacks.millis = HAL_Timer_Get_Milli_Seconds;
         callbacks.set_time = system_set_time;
+        callbacks.wait_readable = Spark_Wait_Readable;
 
         SparkDescriptor descriptor;
         memset(&descriptor, 0, sizeof(descriptor));
@@ -855,9 +864,19 @@ void Spark_Protocol_Init(void)
 
 int Spark_Handshake(bool presence_announce)
 {
+    // Set while the protocol performs the handshake in several calls
+    static bool handshake_pending = false;
     cloud_socket_aborted = false; // Clear cancellation flag for socket operations
-    LOG(INFO,"Starting handshake: presense_announce=%d", presence_announce);
+    if (!handshake_pending)
+    {
+        LOG(INFO,"Starting handshake: presense_announce=%d", presence_announce);
+    }
     int err = spark_protocol_handshake(sp);
+    handshake_pending = (err == particle::protocol::HANDSHAKE_PENDING);
+    if (handshake_pending)
+    {
+        return err;
+    }
     if (!err)
     {
         char buf[CLAIM_CODE_SIZE + 1];
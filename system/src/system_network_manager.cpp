@@ -28,6 +28,7 @@ LOG_SOURCE_CATEGORY("system.nm")
 #include "system_led_signal.h"
 #include "enumclass.h"
 #include "system_commands.h"
+#include "spark_wiring_diagnostics.h"
 #if HAL_PLATFORM_WIFI && HAL_PLATFORM_NCP
 #include "network/ncp.h"
 #include "wifi_network_manager.h"
@@ -75,6 +76,57 @@ namespace particle { namespace system {
 
 namespace {
 
+class NetworkMemoryDiagnosticData: public AbstractIntegerDiagnosticData {
+public:
+    enum Field {
+        PEAK,
+        FAILURES
+    };
+
+    NetworkMemoryDiagnosticData(uint16_t id, const char* name, int pool, Field field) :
+            AbstractIntegerDiagnosticData(id, name),
+            pool_(pool),
+            field_(field) {
+    }
+
+    virtual int get(IntType& val) override {
+        if_mem_pool_stats stats = {};
+        stats.size = sizeof(stats);
+        CHECK(if_get_mem_pool_stats(pool_, &stats, nullptr));
+        val = (field_ == PEAK) ? stats.peak : stats.failures;
+        return 0;
+    }
+
+private:
+    int pool_;
+    Field field_;
+};
+
+NetworkMemoryDiagnosticData g_netMemHeapPeakDiagData(DIAG_ID_NETWORK_MEM_HEAP_PEAK,
+        DIAG_NAME_NETWORK_MEM_HEAP_PEAK, IF_MEM_POOL_HEAP, NetworkMemoryDiagnosticData::PEAK);
+NetworkMemoryDiagnosticData g_netMemHeapFailuresDiagData(DIAG_ID_NETWORK_MEM_HEAP_FAILURES,
+        DIAG_NAME_NETWORK_MEM_HEAP_FAILURES, IF_MEM_POOL_HEAP, NetworkMemoryDiagnosticData::FAILURES);
+NetworkMemoryDiagnosticData g_netMemPbufPeakDiagData(DIAG_ID_NETWORK_MEM_PBUF_PEAK,
+        DIAG_NAME_NETWORK_MEM_PBUF_PEAK, IF_MEM_POOL_PBUF, NetworkMemoryDiagnosticData::PEAK);
+NetworkMemoryDiagnosticData g_netMemPbufFailuresDiagData(DIAG_ID_NETWORK_MEM_PBUF_FAILURES,
+        DIAG_NAME_NETWORK_MEM_PBUF_FAILURES, IF_MEM_POOL_PBUF, NetworkMemoryDiagnosticData::FAILURES);
+NetworkMemoryDiagnosticData g_netMemPbufRefPeakDiagData(DIAG_ID_NETWORK_MEM_PBUF_REF_PEAK,
+        DIAG_NAME_NETWORK_MEM_PBUF_REF_PEAK, IF_MEM_POOL_PBUF_REF, NetworkMemoryDiagnosticData::PEAK);
+NetworkMemoryDiagnosticData g_netMemPbufRefFailuresDiagData(DIAG_ID_NETWORK_MEM_PBUF_REF_FAILURES,
+        DIAG_NAME_NETWORK_MEM_PBUF_REF_FAILURES, IF_MEM_POOL_PBUF_REF, NetworkMemoryDiagnosticData::FAILURES);
+NetworkMemoryDiagnosticData g_netMemTcpPcbPeakDiagData(DIAG_ID_NETWORK_MEM_TCP_PCB_PEAK,
+        DIAG_NAME_NETWORK_MEM_TCP_PCB_PEAK, IF_MEM_POOL_TCP_PCB, NetworkMemoryDiagnosticData::PEAK);
+NetworkMemoryDiagnosticData g_netMemTcpPcbFailuresDiagData(DIAG_ID_NETWORK_MEM_TCP_PCB_FAILURES,
+        DIAG_NAME_NETWORK_MEM_TCP_PCB_FAILURES, IF_MEM_POOL_TCP_PCB, NetworkMemoryDiagnosticData::FAILURES);
+NetworkMemoryDiagnosticData g_netMemTcpSegPeakDiagData(DIAG_ID_NETWORK_MEM_TCP_SEG_PEAK,
+        DIAG_NAME_NETWORK_MEM_TCP_SEG_PEAK, IF_MEM_POOL_TCP_SEG, NetworkMemoryDiagnosticData::PEAK);
+NetworkMemoryDiagnosticData g_netMemTcpSegFailuresDiagData(DIAG_ID_NETWORK_MEM_TCP_SEG_FAILURES,
+        DIAG_NAME_NETWORK_MEM_TCP_SEG_FAILURES, IF_MEM_POOL_TCP_SEG, NetworkMemoryDiagnosticData::FAILURES);
+NetworkMemoryDiagnosticData g_netMemUdpPcbPeakDiagData(DIAG_ID_NETWORK_MEM_UDP_PCB_PEAK,
+        DIAG_NAME_NETWORK_MEM_UDP_PCB_PEAK, IF_MEM_POOL_UDP_PCB, NetworkMemoryDiagnosticData::PEAK);
+NetworkMemoryDiagnosticData g_netMemUdpPcbFailuresDiagData(DIAG_ID_NETWORK_MEM_UDP_PCB_FAILURES,
+        DIAG_NAME_NETWORK_MEM_UDP_PCB_FAILURES, IF_MEM_POOL_UDP_PCB, NetworkMemoryDiagnosticData::FAILURES);
+
 template <typename F>
 int for_each_iface(F&& f) {
     if_list* ifs = nullptr;
@@ -95,6 +147,17 @@ int for_each_iface(F&& f) {
     return 0;
 }
 
+/* Path health monitoring */
+const system_tick_t PATH_MONITOR_TICK = 1000;
+/* Probe interval for healthy interfaces */
+const system_tick_t PATH_PROBE_INTERVAL = 15000;
+/* Probe interval for interfaces that failed a probe or are recovering */
+const system_tick_t PATH_PROBE_FAST_INTERVAL = 2000;
+/* Time a preferred interface needs to stay healthy before the cloud session fails back to it */
+const system_tick_t PATH_FAILBACK_HOLD_TIME = 30000;
+const unsigned int PATH_METRIC_STEP = 10;
+const unsigned int PATH_UNHEALTHY_METRIC_PENALTY = 1000;
+
 void forceCloudPingIfConnected() {
     const auto task = new(std::nothrow) ISRTaskQueue::Task();
     if (!task) {
@@ -231,6 +294,8 @@ void setBorderRouterState(bool start) {
 #endif // HAL_PLATFORM_MESH
 
 NetworkManager::NetworkManager() {
+    cloudIface_ = nullptr;
+    pathTaskPending_ = false;
     state_ = State::NONE;
     ip4State_ = ProtocolState::UNCONFIGURED;
     ip6State_ = ProtocolState::UNCONFIGURED;
@@ -260,6 +325,12 @@ void NetworkManager::init() {
 }
 
 void NetworkManager::destroy() {
+    stopPathMonitor();
+    if (pathTimer_) {
+        os_timer_destroy(pathTimer_, nullptr);
+        pathTimer_ = nullptr;
+    }
+
     if (ifEventHandlerCookie_) {
         if_event_handler_del(ifEventHandlerCookie_);
         ifEventHandlerCookie_ = nullptr;
@@ -500,6 +571,7 @@ void NetworkManager::transition(State state) {
         /* Ensure that IPv4/IPv6 protocol state is reset */
         case State::IP_CONFIGURED: {
             if (state != State::IP_CONFIGURED) {
+                stopPathMonitor();
                 ip4State_ = ProtocolState::UNCONFIGURED;
                 ip6State_ = ProtocolState::UNCONFIGURED;
                 dns4State_ = DnsState::UNCONFIGURED;
@@ -553,6 +625,7 @@ void NetworkManager::transition(State state) {
             LED_SIGNAL_START(NETWORK_CONNECTED, BACKGROUND);
             if (state_ != State::IP_CONFIGURED) {
                 system_notify_event(network_status, network_status_connected);
+                startPathMonitor();
             }
             break;
         }
@@ -983,6 +1056,243 @@ void NetworkManager::resetInterfaceProtocolState(if_t iface) {
     }
 }
 
+void NetworkManager::setCloudEndpoint(const sockaddr* addr, socklen_t addrLen, int protocol, int cloudSocket) {
+    if (!addr || addrLen > sizeof(probeTarget_)) {
+        return;
+    }
+    memcpy(&probeTarget_, addr, addrLen);
+    probeTargetLen_ = addrLen;
+    probeProtocol_ = protocol;
+
+    /* Find the interface that owns the local address of the cloud socket */
+    cloudIface_ = nullptr;
+    sockaddr_storage local = {};
+    socklen_t localLen = sizeof(local);
+    CHECKV(sock_getsockname(cloudSocket, (sockaddr*)&local, &localLen));
+
+    if_addrs* addrs = nullptr;
+    CHECKV(if_get_if_addrs(&addrs));
+    for (auto a = addrs; a != nullptr; a = a->next) {
+        if (!a->if_addr || !a->if_addr->addr || a->if_addr->addr->sa_family != local.ss_family) {
+            continue;
+        }
+        bool match = false;
+        if (local.ss_family == AF_INET) {
+            match = ((sockaddr_in*)a->if_addr->addr)->sin_addr.s_addr == ((sockaddr_in*)&local)->sin_addr.s_addr;
+        } else if (local.ss_family == AF_INET6) {
+            match = !memcmp(&((sockaddr_in6*)a->if_addr->addr)->sin6_addr, &((sockaddr_in6*)&local)->sin6_addr,
+                    sizeof(in6_addr));
+        }
+        if (match) {
+            if_t iface = nullptr;
+            if (!if_get_by_index(a->ifindex, &iface)) {
+                cloudIface_ = iface;
+            }
+            break;
+        }
+    }
+    if_free_if_addrs(addrs);
+
+    if (cloudIface_.load()) {
+        char name[IF_NAMESIZE] = {};
+        if_get_name(cloudIface_, name);
+        LOG(INFO, "Cloud session is using %s", name);
+    }
+}
+
+void NetworkManager::clearCloudEndpoint() {
+    cloudIface_ = nullptr;
+}
+
+if_t NetworkManager::getCloudInterface() const {
+    return cloudIface_;
+}
+
+bool NetworkManager::isInterfaceHealthy(if_t iface) const {
+    auto state = getInterfaceRuntimeState(iface);
+    return state && state->health.isHealthy();
+}
+
+void NetworkManager::pathMonitorTimerCb(os_timer_t timer) {
+    auto self = instance();
+    /* Only one processing task is queued at a time */
+    if (self->pathTaskPending_.exchange(true)) {
+        return;
+    }
+    const auto task = new(std::nothrow) ISRTaskQueue::Task();
+    if (!task) {
+        self->pathTaskPending_ = false;
+        return;
+    }
+    task->func = [](ISRTaskQueue::Task* task) {
+        delete task;
+        auto self = instance();
+        self->pathTaskPending_ = false;
+        self->processPathHealth();
+    };
+    SystemISRTaskQueue.enqueue(task);
+}
+
+void NetworkManager::startPathMonitor() {
+    if (!pathTimer_) {
+        if (os_timer_create(&pathTimer_, PATH_MONITOR_TICK, pathMonitorTimerCb, nullptr, false, nullptr)) {
+            pathTimer_ = nullptr;
+            return;
+        }
+    }
+    os_timer_change(pathTimer_, OS_TIMER_CHANGE_START, false, 0, 0xffffffff, nullptr);
+}
+
+void NetworkManager::stopPathMonitor() {
+    if (pathTimer_) {
+        os_timer_change(pathTimer_, OS_TIMER_CHANGE_STOP, false, 0, 0xffffffff, nullptr);
+    }
+    for (auto item = runState_.front(); item != nullptr; item = item->next) {
+        cancelProbe(item);
+    }
+}
+
+bool NetworkManager::canProbe(InterfaceRuntimeState* state) const {
+    if (!state->enabled || !probeTargetLen_) {
+        return false;
+    }
+    unsigned int flags = 0;
+    if (if_get_flags(state->iface, &flags) || (flags & (IFF_UP | IFF_LOWER_UP)) != (IFF_UP | IFF_LOWER_UP)) {
+        return false;
+    }
+    if (probeTarget_.ss_family == AF_INET) {
+        return state->ip4State == ProtocolState::CONFIGURED;
+    }
+    return state->ip6State == ProtocolState::CONFIGURED;
+}
+
+int NetworkManager::startProbe(InterfaceRuntimeState* state, system_tick_t now) {
+    char name[IF_NAMESIZE] = {};
+    CHECK(if_get_name(state->iface, name));
+    state->lastProbe = now;
+    /* The probe uses the transport of the cloud connection, so that an interface is not considered
+     * unhealthy because of a network that only filters the other transport */
+    return state->probe.start((const sockaddr*)&probeTarget_, probeTargetLen_, probeProtocol_, name, now);
+}
+
+void NetworkManager::cancelProbe(InterfaceRuntimeState* state) {
+    state->probe.cancel();
+}
+
+void NetworkManager::handleProbeResult(InterfaceRuntimeState* state, bool reachable, system_tick_t now) {
+    cancelProbe(state);
+    char name[IF_NAMESIZE] = {};
+    if_get_name(state->iface, name);
+    if (!reachable) {
+        LOG(TRACE, "Upstream probe via %s failed", name);
+    }
+    if (state->health.update(reachable, now)) {
+        if (state->health.isHealthy()) {
+            LOG(INFO, "Upstream path via %s recovered", name);
+        } else {
+            LOG(WARN, "Upstream path via %s is down", name);
+        }
+        updateMetric(state);
+    }
+}
+
+unsigned int NetworkManager::baseMetric(if_t iface) const {
+    /* Interfaces are preferred in the order of their indices, e.g. en2 over wl3 or pp3 */
+    uint8_t index = 0;
+    if_get_index(iface, &index);
+    return index * PATH_METRIC_STEP;
+}
+
+void NetworkManager::updateMetric(InterfaceRuntimeState* state) {
+    const unsigned int metric = baseMetric(state->iface) + (state->health.isHealthy() ? 0 : PATH_UNHEALTHY_METRIC_PENALTY);
+    if (metric != state->metric && !if_set_metric(state->iface, metric)) {
+        state->metric = metric;
+    }
+}
+
+NetworkManager::InterfaceRuntimeState* NetworkManager::selectPath(system_tick_t now) const {
+    InterfaceRuntimeState* best = nullptr;
+    for (auto item = runState_.front(); item != nullptr; item = item->next) {
+        if (!item->health.isHealthy() || !canProbe(item)) {
+            continue;
+        }
+        /* Hysteresis: a recovered interface is only used after it has been healthy for a while,
+         * unless the current path is unusable */
+        const system_tick_t healthySince = item->health.healthySince();
+        if (item->iface != cloudIface_.load() && healthySince &&
+                now - healthySince < PATH_FAILBACK_HOLD_TIME && isInterfaceHealthy(cloudIface_)) {
+            continue;
+        }
+        if (!best || baseMetric(item->iface) < baseMetric(best->iface)) {
+            best = item;
+        }
+    }
+    return best;
+}
+
+void NetworkManager::processPathHealth() {
+    if (state_ != State::IP_CONFIGURED) {
+        return;
+    }
+    const system_tick_t now = HAL_Timer_Get_Milli_Seconds();
+    /* Probing is only needed when there is an alternative path */
+    unsigned count = 0;
+    for (auto item = runState_.front(); item != nullptr; item = item->next) {
+        if (canProbe(item)) {
+            ++count;
+        } else {
+            cancelProbe(item);
+        }
+    }
+    if (count < 2) {
+        for (auto item = runState_.front(); item != nullptr; item = item->next) {
+            cancelProbe(item);
+        }
+        return;
+    }
+    for (auto item = runState_.front(); item != nullptr; item = item->next) {
+        if (!canProbe(item)) {
+            continue;
+        }
+        if (item->probe.isActive()) {
+            const int r = item->probe.poll(now);
+            if (r != 0) {
+                handleProbeResult(item, r > 0, now);
+            }
+            continue;
+        }
+        const bool suspect = item->health.isSuspect();
+        if (now - item->lastProbe >= (suspect ? PATH_PROBE_FAST_INTERVAL : PATH_PROBE_INTERVAL) ||
+                !item->lastProbe) {
+            const int r = startProbe(item, now);
+            if (r != 0) {
+                handleProbeResult(item, r > 0, now);
+            }
+        }
+    }
+
+    const if_t cloudIface = cloudIface_;
+    if (!cloudIface || !spark_cloud_flag_connected()) {
+        return;
+    }
+    const auto best = selectPath(now);
+    if (!best || best->iface == cloudIface) {
+        return;
+    }
+    const bool failover = !isInterfaceHealthy(cloudIface);
+    const bool failback = baseMetric(best->iface) < baseMetric(cloudIface);
+    if (failover || failback) {
+        char from[IF_NAMESIZE] = {};
+        char to[IF_NAMESIZE] = {};
+        if_get_name(cloudIface, from);
+        if_get_name(best->iface, to);
+        LOG(WARN, "Moving cloud session from %s to %s (%s)", from, to, failover ? "failover" : "failback");
+        /* Route metrics already prefer the new interface, reconnecting moves the session */
+        cloudIface_ = nullptr;
+        cloud_disconnect(true, false, CLOUD_DISCONNECT_REASON_ERROR);
+    }
+}
+
 }} /* namespace particle::system */
 
 #endif /* HAL_PLATFORM_IFAPI */
@@ -24,6 +24,10 @@
 
 #include "ifapi.h"
 #include "resolvapi.h"
+#include "socket_hal.h"
+#include "concurrent_hal.h"
+#include "timer_hal.h"
+#include "system_path_probe.h"
 #include <atomic>
 #include "intrusive_list.h"
 
@@ -90,6 +94,25 @@ public:
 
     State getState() const;
 
+    /* Path health monitoring and failover between interfaces */
+
+    /**
+     * Sets the cloud server address and transport protocol that are used to probe the upstream
+     * reachability of each interface, and the socket of the current cloud connection, which is
+     * used to determine the interface carrying the cloud session.
+     */
+    void setCloudEndpoint(const sockaddr* addr, socklen_t addrLen, int protocol, int cloudSocket);
+    void clearCloudEndpoint();
+
+    if_t getCloudInterface() const;
+    bool isInterfaceHealthy(if_t iface) const;
+
+    /**
+     * Runs one iteration of path health monitoring. This method is called periodically
+     * from the system thread while IP connectivity is available.
+     */
+    void processPathHealth();
+
 protected:
     NetworkManager();
 
@@ -112,6 +135,12 @@ private:
         if_t iface = nullptr;
         std::atomic<ProtocolState> ip4State;
         std::atomic<ProtocolState> ip6State;
+
+        /* Path health */
+        PathProbe probe;
+        PathHealth health;
+        system_tick_t lastProbe = 0;
+        unsigned int metric = 0;
     };
 
     void transition(State state);
@@ -139,6 +168,17 @@ private:
     bool isDisabled(if_t iface);
     void resetInterfaceProtocolState(if_t iface = nullptr);
 
+    bool canProbe(InterfaceRuntimeState* state) const;
+    int startProbe(InterfaceRuntimeState* state, system_tick_t now);
+    void cancelProbe(InterfaceRuntimeState* state);
+    void handleProbeResult(InterfaceRuntimeState* state, bool reachable, system_tick_t now);
+    unsigned int baseMetric(if_t iface) const;
+    void updateMetric(InterfaceRuntimeState* state);
+    InterfaceRuntimeState* selectPath(system_tick_t now) const;
+    void startPathMonitor();
+    void stopPathMonitor();
+    static void pathMonitorTimerCb(os_timer_t timer);
+
 private:
     if_event_handler_cookie_t ifEventHandlerCookie_ = {};
     resolv_event_handler_cookie_t resolvEventHandlerCookie_ = {};
@@ -150,6 +190,13 @@ private:
     std::atomic<DnsState> dns6State_;
 
     IntrusiveList<InterfaceRuntimeState> runState_;
+
+    sockaddr_storage probeTarget_ = {};
+    socklen_t probeTargetLen_ = 0;
+    int probeProtocol_ = 0;
+    std::atomic<if_t> cloudIface_;
+    os_timer_t pathTimer_ = nullptr;
+    std::atomic_bool pathTaskPending_;
 };
 
 #if HAL_PLATFORM_MESH
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system_path_probe.h"
+
+#if HAL_USE_SOCKET_HAL_POSIX
+
+#include "system_error.h"
+#include "rng_hal.h"
+#include <cstring>
+#include <cerrno>
+
+namespace particle { namespace system {
+
+namespace {
+
+/* Large enough for the interface name option of both lwIP and POSIX systems */
+const size_t IF_NAME_OPTION_SIZE = 16;
+
+/* DTLS 1.2 record and handshake protocol */
+const uint8_t DTLS_CONTENT_TYPE_HANDSHAKE = 22;
+const uint8_t DTLS_HANDSHAKE_CLIENT_HELLO = 1;
+const uint8_t DTLS_VERSION_MAJOR = 0xfe;
+const uint8_t DTLS_VERSION_MINOR = 0xfd;
+const size_t DTLS_RECORD_HEADER_SIZE = 13;
+const size_t DTLS_HANDSHAKE_HEADER_SIZE = 12;
+const size_t DTLS_RANDOM_SIZE = 32;
+
+/* ClientHello body: version, random, empty session ID and cookie, the cipher suite used by the
+ * device (TLS_ECDHE_ECDSA_WITH_AES_128_CCM_8), no compression, and the supported_groups (secp256r1)
+ * and ec_point_formats (uncompressed) extensions that the cipher suite requires */
+const uint8_t CLIENT_HELLO_CIPHER_SUITES[] = { 0x00, 0x02, 0xc0, 0xae };
+const uint8_t CLIENT_HELLO_COMPRESSION_METHODS[] = { 0x01, 0x00 };
+const uint8_t CLIENT_HELLO_EXTENSIONS[] = {
+    0x00, 0x0e,
+    0x00, 0x0a, 0x00, 0x04, 0x00, 0x02, 0x00, 0x17,
+    0x00, 0x0b, 0x00, 0x02, 0x01, 0x00
+};
+
+const size_t CLIENT_HELLO_BODY_SIZE = 2 /* version */ + DTLS_RANDOM_SIZE + 1 /* session ID */ + 1 /* cookie */ +
+        sizeof(CLIENT_HELLO_CIPHER_SUITES) + sizeof(CLIENT_HELLO_COMPRESSION_METHODS) + sizeof(CLIENT_HELLO_EXTENSIONS);
+const size_t CLIENT_HELLO_SIZE = DTLS_RECORD_HEADER_SIZE + DTLS_HANDSHAKE_HEADER_SIZE + CLIENT_HELLO_BODY_SIZE;
+
+uint8_t* writeUint16(uint8_t* p, size_t val) {
+    *p++ = (val >> 8) & 0xff;
+    *p++ = val & 0xff;
+    return p;
+}
+
+uint8_t* writeUint24(uint8_t* p, size_t val) {
+    *p++ = (val >> 16) & 0xff;
+    return writeUint16(p, val);
+}
+
+uint8_t* writeBytes(uint8_t* p, const uint8_t* data, size_t size) {
+    memcpy(p, data, size);
+    return p + size;
+}
+
+bool isReachableError(int error) {
+    /* A refused connection or an ICMP port unreachable message still proves that the server's
+     * host can be reached via the interface */
+    return error == ECONNREFUSED || error == ECONNRESET;
+}
+
+} // unnamed
+
+const system_tick_t PathProbe::TIMEOUT;
+
+PathProbe::PathProbe() :
+        addr_(),
+        addrLen_(0),
+        protocol_(0),
+        sock_(-1),
+        started_(0) {
+}
+
+PathProbe::~PathProbe() {
+    cancel();
+}
+
+int PathProbe::start(const sockaddr* addr, socklen_t addrLen, int protocol, const char* ifName, system_tick_t now) {
+    cancel();
+    if (!addr || addrLen > sizeof(addr_) || !ifName || strlen(ifName) >= IF_NAME_OPTION_SIZE ||
+            (protocol != IPPROTO_UDP && protocol != IPPROTO_TCP)) {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    memcpy(&addr_, addr, addrLen);
+    addrLen_ = addrLen;
+    protocol_ = protocol;
+    started_ = now;
+    const int s = sock_socket(addr->sa_family, (protocol == IPPROTO_UDP) ? SOCK_DGRAM : SOCK_STREAM, protocol);
+    if (s < 0) {
+        return SYSTEM_ERROR_NO_MEMORY;
+    }
+    sock_ = s;
+    char name[IF_NAME_OPTION_SIZE] = {};
+    strcpy(name, ifName);
+    if (sock_setsockopt(s, SOL_SOCKET, SO_BINDTODEVICE, name, sizeof(name)) ||
+            sock_fcntl(s, F_SETFL, O_NONBLOCK)) {
+        cancel();
+        return SYSTEM_ERROR_UNKNOWN;
+    }
+    if (protocol == IPPROTO_UDP) {
+        /* Connecting the UDP socket filters out datagrams from other sources */
+        uint8_t hello[CLIENT_HELLO_SIZE] = {};
+        const size_t size = formatDtlsClientHello(hello, sizeof(hello));
+        if (sock_connect(s, (const sockaddr*)&addr_, addrLen_) || sock_send(s, hello, size, 0) != (ssize_t)size) {
+            const int error = errno;
+            cancel();
+            return isReachableError(error) ? 1 : SYSTEM_ERROR_NETWORK;
+        }
+        return 0;
+    }
+    if (sock_connect(s, (const sockaddr*)&addr_, addrLen_) && errno != EINPROGRESS) {
+        const int error = errno;
+        cancel();
+        return isReachableError(error) ? 1 : SYSTEM_ERROR_NETWORK;
+    }
+    return 0;
+}
+
+int PathProbe::poll(system_tick_t now) {
+    if (sock_ < 0) {
+        return SYSTEM_ERROR_INVALID_STATE;
+    }
+    int r = (protocol_ == IPPROTO_UDP) ? pollUdp() : pollTcp();
+    if (r == 0 && now - started_ >= TIMEOUT) {
+        r = SYSTEM_ERROR_TIMEOUT;
+    }
+    if (r != 0) {
+        cancel();
+    }
+    return r;
+}
+
+int PathProbe::pollUdp() {
+    /* Any response from the server, normally a HelloVerifyRequest, means that it is reachable */
+    uint8_t buf[64];
+    if (sock_recv(sock_, buf, sizeof(buf), 0) >= 0) {
+        return 1;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+    }
+    return isReachableError(errno) ? 1 : SYSTEM_ERROR_NETWORK;
+}
+
+int PathProbe::pollTcp() {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (!sock_getsockopt(sock_, SOL_SOCKET, SO_ERROR, &error, &len) && error) {
+        return isReachableError(error) ? 1 : SYSTEM_ERROR_NETWORK;
+    }
+    /* A repeated connect() reports whether the connection has been established */
+    if (!sock_connect(sock_, (const sockaddr*)&addr_, addrLen_) || errno == EISCONN || isReachableError(errno)) {
+        return 1;
+    }
+    if (errno != EALREADY && errno != EINPROGRESS) {
+        return SYSTEM_ERROR_NETWORK;
+    }
+    return 0;
+}
+
+void PathProbe::cancel() {
+    if (sock_ >= 0) {
+        sock_close(sock_);
+        sock_ = -1;
+    }
+}
+
+size_t PathProbe::formatDtlsClientHello(uint8_t* buf, size_t size) {
+    if (size < CLIENT_HELLO_SIZE) {
+        return 0;
+    }
+    uint8_t* p = buf;
+    /* Record header: epoch and sequence number are 0 */
+    *p++ = DTLS_CONTENT_TYPE_HANDSHAKE;
+    *p++ = DTLS_VERSION_MAJOR;
+    *p++ = DTLS_VERSION_MINOR;
+    memset(p, 0, 8);
+    p += 8;
+    p = writeUint16(p, DTLS_HANDSHAKE_HEADER_SIZE + CLIENT_HELLO_BODY_SIZE);
+    /* Handshake header: a single unfragmented message with sequence number 0 */
+    *p++ = DTLS_HANDSHAKE_CLIENT_HELLO;
+    p = writeUint24(p, CLIENT_HELLO_BODY_SIZE);
+    p = writeUint16(p, 0);
+    p = writeUint24(p, 0);
+    p = writeUint24(p, CLIENT_HELLO_BODY_SIZE);
+    /* ClientHello */
+    *p++ = DTLS_VERSION_MAJOR;
+    *p++ = DTLS_VERSION_MINOR;
+    for (size_t i = 0; i < DTLS_RANDOM_SIZE; i += sizeof(uint32_t)) {
+        const uint32_t r = HAL_RNG_GetRandomNumber();
+        memcpy(p + i, &r, sizeof(r));
+    }
+    p += DTLS_RANDOM_SIZE;
+    *p++ = 0; /* Session ID */
+    *p++ = 0; /* Cookie */
+    p = writeBytes(p, CLIENT_HELLO_CIPHER_SUITES, sizeof(CLIENT_HELLO_CIPHER_SUITES));
+    p = writeBytes(p, CLIENT_HELLO_COMPRESSION_METHODS, sizeof(CLIENT_HELLO_COMPRESSION_METHODS));
+    p = writeBytes(p, CLIENT_HELLO_EXTENSIONS, sizeof(CLIENT_HELLO_EXTENSIONS));
+    return p - buf;
+}
+
+PathHealth::PathHealth() {
+    reset();
+}
+
+bool PathHealth::update(bool reachable, system_tick_t now) {
+    if (reachable) {
+        failures_ = 0;
+        if (successes_ < RECOVERY_THRESHOLD) {
+            ++successes_;
+        }
+        if (!healthy_ && successes_ >= RECOVERY_THRESHOLD) {
+            healthy_ = true;
+            healthySince_ = now;
+            return true;
+        }
+    } else {
+        successes_ = 0;
+        if (failures_ < FAILURE_THRESHOLD) {
+            ++failures_;
+        }
+        if (healthy_ && failures_ >= FAILURE_THRESHOLD) {
+            healthy_ = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PathHealth::reset() {
+    healthySince_ = 0;
+    failures_ = 0;
+    successes_ = 0;
+    healthy_ = true;
+}
+
+}} /* namespace particle::system */
+
+#endif /* HAL_USE_SOCKET_HAL_POSIX */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2018 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYSTEM_PATH_PROBE_H
+#define SYSTEM_PATH_PROBE_H
+
+#include "hal_platform.h"
+
+#if HAL_USE_SOCKET_HAL_POSIX
+
+#include "socket_hal_posix.h"
+#include "system_tick_hal.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace particle { namespace system {
+
+/**
+ * Checks whether a server can be reached via a specific network interface, using the same
+ * transport as the cloud connection.
+ *
+ * For UDP, the probe is a DTLS ClientHello. The server answers it with a HelloVerifyRequest
+ * without creating any session state. For TCP, the probe is a non-blocking connection attempt.
+ */
+class PathProbe {
+public:
+    /* Time to wait for the server's response */
+    static const system_tick_t TIMEOUT = 3000;
+
+    PathProbe();
+    ~PathProbe();
+
+    /**
+     * Starts a probe. The probe socket is bound to the interface with the name `ifName`.
+     *
+     * Returns 0 if the probe has been started, 1 if the server is already known to be reachable,
+     * or a negative error code.
+     */
+    int start(const sockaddr* addr, socklen_t addrLen, int protocol, const char* ifName, system_tick_t now);
+    /**
+     * Returns 1 if the server has responded, 0 if the probe is still pending, or a negative error code.
+     */
+    int poll(system_tick_t now);
+    void cancel();
+
+    bool isActive() const {
+        return sock_ >= 0;
+    }
+
+    /**
+     * Formats a DTLS 1.2 ClientHello message. Returns the size of the message.
+     */
+    static size_t formatDtlsClientHello(uint8_t* buf, size_t size);
+
+private:
+    sockaddr_storage addr_;
+    socklen_t addrLen_;
+    int protocol_;
+    int sock_;
+    system_tick_t started_;
+
+    int pollUdp();
+    int pollTcp();
+
+    PathProbe(const PathProbe&) = delete;
+    PathProbe& operator=(const PathProbe&) = delete;
+};
+
+/**
+ * Health of the path to the cloud via a specific network interface, based on the results of
+ * consecutive probes.
+ */
+class PathHealth {
+public:
+    /* Consecutive failed probes after which an interface is considered unhealthy */
+    static const unsigned FAILURE_THRESHOLD = 2;
+    /* Consecutive successful probes after which an unhealthy interface is considered healthy again */
+    static const unsigned RECOVERY_THRESHOLD = 3;
+
+    PathHealth();
+
+    /**
+     * Updates the health with the result of a probe. Returns `true` if the interface became
+     * healthy or unhealthy.
+     */
+    bool update(bool reachable, system_tick_t now);
+    void reset();
+
+    bool isHealthy() const {
+        return healthy_;
+    }
+
+    /* Returns `true` if the last probe failed or the interface is unhealthy */
+    bool isSuspect() const {
+        return !healthy_ || failures_ > 0;
+    }
+
+    unsigned failures() const {
+        return failures_;
+    }
+
+    /* Time at which the interface recovered, or 0 if it has never been unhealthy */
+    system_tick_t healthySince() const {
+        return healthySince_;
+    }
+
+private:
+    system_tick_t healthySince_;
+    uint8_t failures_;
+    uint8_t successes_;
+    bool healthy_;
+};
+
+}} /* namespace particle::system */
+
+#endif /* HAL_USE_SOCKET_HAL_POSIX */
+
+#endif /* SYSTEM_PATH_PROBE_H */
@@ -27,6 +27,7 @@
 #include "system_network.h"
 #include "system_network_internal.h"
 #include "system_update.h"
+#include "ota_flash_hal.h"
 #include "spark_macros.h"
 #include "string.h"
 #include "core_hal.h"
@@ -72,6 +73,9 @@ volatile uint8_t Spark_Error_Count;
 volatile uint8_t SYSTEM_POWEROFF;
 uint8_t feature_cloud_udp = 0;
 
+// Number of OTA region sectors erased ahead of the write position when the system is idle
+static const uint32_t OTA_ERASE_AHEAD_SECTORS = 1;
+
 static struct SetThreadCurrentFunctionPointers {
     SetThreadCurrentFunctionPointers() {
         set_thread_current_function_pointers((void*)&main_thread_current,
@@ -355,6 +359,11 @@ void handle_cloud_connection(bool force_events)
         {
             LED_SIGNAL_START(CLOUD_HANDSHAKE, NORMAL);
             int err = cloud_handshake();
+            if (err == particle::protocol::HANDSHAKE_PENDING)
+            {
+                // The handshake is continued on the next iteration of the system loop
+                return;
+            }
             if (err)
             {
                 if (!SPARK_WLAN_RESET && !network_listening(0, 0, 0))
@@ -410,6 +419,11 @@ void handle_cloud_connection(bool force_events)
         {
             Spark_Process_Events();
         }
+        if (SPARK_FLASH_UPDATE)
+        {
+            // Erase the next sector of the OTA region while waiting for the next chunk
+            HAL_FLASH_Erase_Ahead(OTA_ERASE_AHEAD_SECTORS, nullptr);
+        }
     }
 }
 
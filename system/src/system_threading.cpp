@@ -5,7 +5,7 @@
 
 #if PLATFORM_THREADING
 
-#if PLATFORM_ID != 20
+#if PLATFORM_ID != 20 && PLATFORM_ID != 3
 #define THREAD_STACK_SIZE (5 * 1024)
 #else
 #define THREAD_STACK_SIZE (8 * 1024 * 1024)
@@ -24,8 +24,9 @@ ActiveObjectThreadQueue SystemThread(ActiveObjectConfiguration(system_thread_idl
 
 /**
  * Implementation to support gthread's concurrency primitives.
+ * The virtual platforms use the host's native implementation.
  */
-#if PLATFORM_ID != 20
+#if PLATFORM_ID != 20 && PLATFORM_ID != 3
 namespace std {
 
 #if 0
@@ -118,7 +119,7 @@ namespace std {
         __get_once_functor_lock_ptr() = __ptr;
     }
 }
-#endif /* PLATFORM_ID != 20 */
+#endif /* PLATFORM_ID != 20 && PLATFORM_ID != 3 */
 
 static os_mutex_recursive_t usb_serial_mutex;
 
@@ -249,7 +249,12 @@ int Spark_Prepare_For_Firmware_Update(FileTransfer::Descriptor& file, uint32_t f
             SPARK_FLASH_UPDATE = 1;
             TimingFlashUpdateTimeout = 0;
             system_notify_event(firmware_update, firmware_update_begin, &file);
-            HAL_FLASH_Begin(file.file_address, file.file_length, NULL);
+            if (flags & 2) {
+                // the staged data is kept when an interrupted update is resumed
+                HAL_FLASH_Resume(file.file_address, file.file_length, file.chunk_size, (const uint8_t*)reserved, NULL);
+            } else {
+                HAL_FLASH_Begin(file.file_address, file.file_length, NULL);
+            }
         }
         else
         {
@@ -364,6 +369,16 @@ int Spark_Save_Firmware_Chunk(FileTransfer::Descriptor& file, const uint8_t* chu
     return result;
 }
 
+int Spark_Read_Firmware_Chunk(FileTransfer::Descriptor& file, uint8_t* chunk, void* reserved)
+{
+    int result = -1;
+    if (file.store==FileTransfer::Store::FIRMWARE)
+    {
+        result = HAL_FLASH_Read(chunk, file.chunk_address, file.chunk_size, NULL);
+    }
+    return result;
+}
+
 
 class AppendBase {
 
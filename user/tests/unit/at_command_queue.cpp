@@ -0,0 +1,208 @@
+#include "at_command_queue.h"
+#include "at_parser.h"
+#include "at_response.h"
+#include "system_error.h"
+
+#include "tools/at_modem.h"
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace particle;
+
+using test::ScriptedModem;
+
+struct Completion {
+    int result = 1000;
+    int errorCode = 0;
+    std::vector<std::string> lines;
+    std::vector<std::string>* order = nullptr;
+    std::string name;
+    int cancelAfter = 0;
+
+    static int onLine(const char* line, size_t size, void* data) {
+        const auto c = static_cast<Completion*>(data);
+        c->lines.push_back(std::string(line, size));
+        if (c->cancelAfter && (int)c->lines.size() >= c->cancelAfter) {
+            return SYSTEM_ERROR_CANCELLED;
+        }
+        return 0;
+    }
+
+    static void onDone(int result, int errorCode, void* data) {
+        const auto c = static_cast<Completion*>(data);
+        c->result = result;
+        c->errorCode = errorCode;
+        if (c->order) {
+            c->order->push_back(c->name);
+        }
+    }
+};
+
+class QueueTest {
+public:
+    QueueTest() {
+        AtParserConfig conf;
+        conf.stream(&modem).commandTimeout(100).streamTimeout(100);
+        REQUIRE(parser.init(std::move(conf)) == 0);
+        queue.parser(&parser);
+    }
+
+    int runAll() {
+        int n = 0;
+        while (queue.process() > 0) {
+            ++n;
+        }
+        return n;
+    }
+
+    ScriptedModem modem;
+    AtParser parser;
+    AtCommandQueue queue;
+};
+
+} // namespace
+
+TEST_CASE("AtCommandQueue") {
+    QueueTest t;
+
+    SECTION("a command is not sent until the queue is processed") {
+        Completion c;
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c, "AT+CSQ") > 0);
+        CHECK(t.modem.commands().empty());
+        CHECK(t.queue.size() == 1);
+        t.modem.reply("\r\n+CSQ: 12,3\r\n\r\nOK\r\n");
+        CHECK(t.runAll() == 1);
+        CHECK(t.modem.commands() == std::vector<std::string>{ "AT+CSQ" });
+        CHECK(c.result == AtResponse::OK);
+        CHECK(t.queue.size() == 0);
+    }
+
+    SECTION("response lines are passed to the line handler as is") {
+        Completion c;
+        t.modem.reply("\r\n+COPS: 0,0,\"Carrier\",7\r\nsecond line\r\n\r\nOK\r\n");
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, Completion::onLine, Completion::onDone, &c, "AT+COPS?\r\n") > 0);
+        t.runAll();
+        CHECK(t.modem.commands() == std::vector<std::string>{ "AT+COPS?" });
+        const std::vector<std::string> lines = { "+COPS: 0,0,\"Carrier\",7", "second line" };
+        CHECK(c.lines == lines);
+        CHECK(c.result == AtResponse::OK);
+    }
+
+    SECTION("error result codes are reported with their error code") {
+        Completion c;
+        t.modem.reply("\r\n+CME ERROR: 10\r\n");
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, Completion::onLine, Completion::onDone, &c, "AT+CCID") > 0);
+        t.runAll();
+        CHECK(c.result == AtResponse::CME_ERROR);
+        CHECK(c.errorCode == 10);
+        CHECK(c.lines.empty());
+    }
+
+    SECTION("commands are executed in priority order, then in FIFO order") {
+        std::vector<std::string> order;
+        Completion c[4];
+        const char* names[] = { "low", "normal1", "high", "normal2" };
+        const int prio[] = { AtCommandQueue::LOW, AtCommandQueue::NORMAL, AtCommandQueue::HIGH, AtCommandQueue::NORMAL };
+        for (int i = 0; i < 4; ++i) {
+            c[i].order = &order;
+            c[i].name = names[i];
+            t.modem.reply("\r\nOK\r\n");
+            REQUIRE(t.queue.enqueue(prio[i], 1000, nullptr, Completion::onDone, &c[i], "AT+%s", names[i]) > 0);
+        }
+        CHECK(t.runAll() == 4);
+        const std::vector<std::string> expected = { "high", "normal1", "normal2", "low" };
+        CHECK(order == expected);
+        const std::vector<std::string> cmds = { "AT+high", "AT+normal1", "AT+normal2", "AT+low" };
+        CHECK(t.modem.commands() == cmds);
+    }
+
+    SECTION("a specific command can be executed without executing the other ones") {
+        Completion c1, c2;
+        REQUIRE(t.queue.enqueue(AtCommandQueue::HIGH, 1000, nullptr, Completion::onDone, &c1, "AT+A") > 0);
+        const int id2 = t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c2, "AT+B");
+        REQUIRE(id2 > 0);
+        t.modem.reply("\r\nOK\r\n");
+        CHECK(t.queue.process(id2) == 1);
+        CHECK(c2.result == AtResponse::OK);
+        CHECK(c1.result == 1000);
+        CHECK(t.modem.commands() == std::vector<std::string>{ "AT+B" });
+        CHECK(t.queue.size() == 1);
+        // The command has already completed
+        CHECK(t.queue.process(id2) == 0);
+        CHECK(t.queue.size() == 1);
+    }
+
+    SECTION("the queue has a limited size") {
+        for (size_t i = 0; i < AtCommandQueue::MAX_SIZE; ++i) {
+            REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, nullptr, nullptr, "AT") > 0);
+        }
+        CHECK(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, nullptr, nullptr, "AT") == SYSTEM_ERROR_LIMIT_EXCEEDED);
+        t.modem.reply("\r\nOK\r\n");
+        CHECK(t.queue.process() == 1);
+        CHECK(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, nullptr, nullptr, "AT") > 0);
+    }
+
+    SECTION("pending commands can be cancelled") {
+        Completion c1, c2, c3;
+        const int id1 = t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c1, "AT+A");
+        REQUIRE(id1 > 0);
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c2, "AT+B") > 0);
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c3, "AT+C") > 0);
+        CHECK(t.queue.cancel(id1) == 0);
+        CHECK(c1.result == SYSTEM_ERROR_CANCELLED);
+        CHECK(t.queue.cancel(id1) == SYSTEM_ERROR_NOT_FOUND);
+        t.queue.clear(SYSTEM_ERROR_ABORTED);
+        CHECK(c2.result == SYSTEM_ERROR_ABORTED);
+        CHECK(c3.result == SYSTEM_ERROR_ABORTED);
+        CHECK(t.runAll() == 0);
+        CHECK(t.modem.commands().empty());
+    }
+
+    SECTION("the line handler can cancel a running command") {
+        Completion c1, c2;
+        c1.cancelAfter = 1;
+        t.modem.reply("\r\nline 1\r\nline 2\r\n\r\nOK\r\n");
+        t.modem.reply("\r\nOK\r\n");
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, Completion::onLine, Completion::onDone, &c1, "AT+A") > 0);
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c2, "AT+B") > 0);
+        CHECK(t.runAll() == 2);
+        CHECK(c1.result == SYSTEM_ERROR_CANCELLED);
+        CHECK(c1.lines == std::vector<std::string>{ "line 1" });
+        // The remaining response data of the cancelled command is skipped
+        CHECK(c2.result == AtResponse::OK);
+    }
+
+    SECTION("a command times out if the DCE doesn't respond") {
+        Completion c;
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 10, nullptr, Completion::onDone, &c, "AT") > 0);
+        t.runAll();
+        CHECK(c.result == SYSTEM_ERROR_TIMEOUT);
+    }
+
+    SECTION("long commands don't fit the initial buffer") {
+        Completion c;
+        const std::string arg(300, 'x');
+        t.modem.reply("\r\nOK\r\n");
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c, "AT+USECMNG=%s", arg.c_str()) > 0);
+        t.runAll();
+        CHECK(t.modem.commands() == std::vector<std::string>{ "AT+USECMNG=" + arg });
+        CHECK(c.result == AtResponse::OK);
+    }
+
+    SECTION("empty commands are rejected") {
+        CHECK(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, nullptr, nullptr, "\r\n") == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(t.queue.size() == 0);
+    }
+
+    SECTION("commands fail if the parser is not set") {
+        Completion c;
+        t.queue.parser(nullptr);
+        REQUIRE(t.queue.enqueue(AtCommandQueue::NORMAL, 1000, nullptr, Completion::onDone, &c, "AT") > 0);
+        CHECK(t.queue.process() == 1);
+        CHECK(c.result == SYSTEM_ERROR_INVALID_STATE);
+    }
+}
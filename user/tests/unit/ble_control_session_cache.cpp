@@ -0,0 +1,147 @@
+#include "ble_control_session_cache.h"
+
+#include "tools/catch.h"
+
+#include <string>
+
+using particle::system::BleControlSessionCache;
+using particle::system::constantTimeEqual;
+
+namespace {
+
+std::string sessionId(char c) {
+    return std::string(BleControlSessionCache::ID_SIZE, c);
+}
+
+std::string sessionKey(char c) {
+    return std::string(BleControlSessionCache::KEY_SIZE, c);
+}
+
+const size_t MAC_SIZE = 16;
+
+// Stands in for the HMAC computed by the channel
+int testMac(const char* key, char* mac) {
+    for (size_t i = 0; i < BleControlSessionCache::KEY_SIZE; ++i) {
+        mac[i] = key[i] ^ 0x5a;
+    }
+    return 0;
+}
+
+std::string sessionMac(char keyChar) {
+    char mac[BleControlSessionCache::KEY_SIZE] = {};
+    testMac(sessionKey(keyChar).data(), mac);
+    return std::string(mac, MAC_SIZE);
+}
+
+} // namespace
+
+TEST_CASE("BleControlSessionCache") {
+    BleControlSessionCache cache(1000 /* maxAge */, 3 /* maxResumeCount */);
+    char key[BleControlSessionCache::KEY_SIZE] = {};
+
+    SECTION("get() returns the key of a known session") {
+        cache.add(sessionId('a').data(), sessionKey('A').data(), 0);
+        REQUIRE(cache.get(sessionId('a').data(), key, 10));
+        CHECK(std::string(key, sizeof(key)) == sessionKey('A'));
+        CHECK_FALSE(cache.get(sessionId('b').data(), key, 10));
+    }
+
+    SECTION("sessions expire") {
+        cache.add(sessionId('a').data(), sessionKey('A').data(), 0xfffffe00); // Expires after the tick counter wraps around
+        CHECK(cache.get(sessionId('a').data(), key, 0x100));
+        CHECK_FALSE(cache.get(sessionId('a').data(), key, 0x200));
+        CHECK(cache.size() == 0);
+    }
+
+    SECTION("a session can be resumed a limited number of times") {
+        cache.add(sessionId('a').data(), sessionKey('A').data(), 0);
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(cache.get(sessionId('a').data(), key, 0));
+            cache.resumed(sessionId('a').data());
+        }
+        CHECK_FALSE(cache.get(sessionId('a').data(), key, 0));
+        // A new handshake makes the session resumable again
+        cache.add(sessionId('a').data(), sessionKey('B').data(), 0);
+        REQUIRE(cache.get(sessionId('a').data(), key, 0));
+        CHECK(std::string(key, sizeof(key)) == sessionKey('B'));
+    }
+
+    SECTION("the oldest session is evicted when the cache is full") {
+        static_assert(BleControlSessionCache::MAX_SESSIONS == 2, "");
+        cache.add(sessionId('a').data(), sessionKey('A').data(), 100);
+        cache.add(sessionId('b').data(), sessionKey('B').data(), 200);
+        cache.add(sessionId('c').data(), sessionKey('C').data(), 300);
+        CHECK(cache.size() == 2);
+        CHECK_FALSE(cache.get(sessionId('a').data(), key, 300));
+        CHECK(cache.get(sessionId('b').data(), key, 300));
+        CHECK(cache.get(sessionId('c').data(), key, 300));
+    }
+
+    SECTION("remove() and clear() forget sessions") {
+        cache.add(sessionId('a').data(), sessionKey('A').data(), 0);
+        cache.add(sessionId('b').data(), sessionKey('B').data(), 0);
+        cache.remove(sessionId('a').data());
+        CHECK_FALSE(cache.get(sessionId('a').data(), key, 0));
+        CHECK(cache.size() == 1);
+        cache.clear();
+        CHECK(cache.size() == 0);
+    }
+}
+
+TEST_CASE("BleControlSessionCache::checkResume()") {
+    BleControlSessionCache cache(1000 /* maxAge */, 3 /* maxResumeCount */);
+    char key[BleControlSessionCache::KEY_SIZE] = {};
+    cache.add(sessionId('a').data(), sessionKey('A').data(), 0);
+
+    SECTION("a request with a valid MAC is accepted") {
+        CHECK(cache.checkResume(sessionId('a').data(), sessionMac('A').data(), MAC_SIZE, key, 10, testMac) == 1);
+        CHECK(std::string(key, sizeof(key)) == sessionKey('A'));
+    }
+
+    SECTION("a request with an invalid MAC is rejected") {
+        std::string mac = sessionMac('A');
+        mac[0] ^= 1;
+        CHECK(cache.checkResume(sessionId('a').data(), mac.data(), MAC_SIZE, key, 10, testMac) == 0);
+        mac = sessionMac('A');
+        mac[MAC_SIZE - 1] ^= 1;
+        CHECK(cache.checkResume(sessionId('a').data(), mac.data(), MAC_SIZE, key, 10, testMac) == 0);
+        // The key of the session is not disclosed
+        CHECK(std::string(key, sizeof(key)) == std::string(sizeof(key), '\0'));
+        CHECK(cache.checkResume(sessionId('a').data(), sessionMac('B').data(), MAC_SIZE, key, 10, testMac) == 0);
+    }
+
+    SECTION("a request for an unknown or expired session is rejected without computing the MAC") {
+        unsigned calls = 0;
+        const auto macFn = [&calls](const char* key, char* mac) {
+            ++calls;
+            return testMac(key, mac);
+        };
+        CHECK(cache.checkResume(sessionId('b').data(), sessionMac('A').data(), MAC_SIZE, key, 10, macFn) == 0);
+        CHECK(cache.checkResume(sessionId('a').data(), sessionMac('A').data(), MAC_SIZE, key, 1000, macFn) == 0);
+        CHECK(calls == 0);
+    }
+
+    SECTION("a session can't be resumed more times than allowed") {
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(cache.checkResume(sessionId('a').data(), sessionMac('A').data(), MAC_SIZE, key, 10, testMac) == 1);
+            cache.resumed(sessionId('a').data());
+        }
+        CHECK(cache.checkResume(sessionId('a').data(), sessionMac('A').data(), MAC_SIZE, key, 10, testMac) == 0);
+    }
+
+    SECTION("errors computing the MAC are returned to the caller") {
+        const auto macFn = [](const char* key, char* mac) {
+            return -100;
+        };
+        CHECK(cache.checkResume(sessionId('a').data(), sessionMac('A').data(), MAC_SIZE, key, 10, macFn) == -100);
+        CHECK(std::string(key, sizeof(key)) == std::string(sizeof(key), '\0'));
+    }
+}
+
+TEST_CASE("constantTimeEqual()") {
+    CHECK(constantTimeEqual("abcd", "abcd", 4));
+    CHECK(constantTimeEqual("abcd", "abce", 3));
+    CHECK_FALSE(constantTimeEqual("abcd", "abce", 4));
+    CHECK_FALSE(constantTimeEqual("\x80" "bcd", "abcd", 4));
+    CHECK(constantTimeEqual("", "", 0));
+}
@@ -0,0 +1,560 @@
+#include "spark_wiring_cbor.h"
+#include "spark_wiring_json.h"
+
+#include "tools/stream.h"
+#include "tools/catch.h"
+
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <cmath>
+
+namespace {
+
+using namespace spark;
+
+std::string fromHex(const std::string& hex) {
+    std::string s;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        s.push_back((char)std::stoul(hex.substr(i, 2), nullptr, 16));
+    }
+    return s;
+}
+
+std::string toHex(const std::string& data) {
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+    for (char c: data) {
+        s.push_back(digits[(uint8_t)c >> 4]);
+        s.push_back(digits[(uint8_t)c & 0x0f]);
+    }
+    return s;
+}
+
+class Writer: public CBORWriter {
+public:
+    std::string hex() const {
+        return toHex(data_);
+    }
+
+    const std::string& data() const {
+        return data_;
+    }
+
+protected:
+    virtual void write(const char* data, size_t size) override {
+        data_.append(data, size);
+    }
+
+private:
+    std::string data_;
+};
+
+// Storage for the parsed data, since CBORValue doesn't copy it
+std::string g_data;
+
+CBORValue parseHex(const std::string& hex) {
+    g_data = fromHex(hex);
+    return CBORValue::parse(g_data.data(), g_data.size());
+}
+
+const unsigned TELEMETRY_SAMPLES = 16;
+
+template<typename WriterT>
+void writeTelemetry(WriterT& w) {
+    w.beginObject();
+    w.name("dev").value(12345);
+    w.name("ts").value(1546300800u);
+    w.name("bat").value(87.5);
+    w.name("temp").beginArray();
+    for (unsigned i = 0; i < TELEMETRY_SAMPLES; ++i) {
+        w.value(20.0 + i * 0.25);
+    }
+    w.endArray();
+    w.name("rssi").beginArray();
+    for (unsigned i = 0; i < TELEMETRY_SAMPLES; ++i) {
+        w.value(-60 - (int)i);
+    }
+    w.endArray();
+    w.endObject();
+}
+
+double sumJson(const JSONValue& v) {
+    double sum = 0;
+    JSONObjectIterator it(v);
+    while (it.next()) {
+        if (it.value().isArray()) {
+            JSONArrayIterator it2(it.value());
+            while (it2.next()) {
+                sum += it2.value().toDouble();
+            }
+        } else {
+            sum += it.value().toDouble();
+        }
+    }
+    return sum;
+}
+
+double sumCbor(const CBORValue& v) {
+    double sum = 0;
+    CBORObjectIterator it(v);
+    while (it.next()) {
+        if (it.value().isArray()) {
+            CBORArrayIterator it2(it.value());
+            while (it2.next()) {
+                sum += it2.value().toDouble();
+            }
+        } else {
+            sum += it.value().toDouble();
+        }
+    }
+    return sum;
+}
+
+template<typename F>
+double measure(unsigned iterations, F fn) {
+    const auto t1 = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        fn();
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(t2 - t1).count() / iterations;
+}
+
+} // namespace
+
+TEST_CASE("Writing CBOR") {
+    Writer w;
+
+    SECTION("null") {
+        w.nullValue();
+        CHECK(w.hex() == "f6");
+    }
+
+    SECTION("bool") {
+        w.value(false).value(true);
+        CHECK(w.hex() == "f4f5");
+    }
+
+    SECTION("int") {
+        // Test vectors from RFC 8949, Appendix A
+        SECTION("0") {
+            w.value(0);
+            CHECK(w.hex() == "00");
+        }
+        SECTION("23") {
+            w.value(23);
+            CHECK(w.hex() == "17");
+        }
+        SECTION("24") {
+            w.value(24);
+            CHECK(w.hex() == "1818");
+        }
+        SECTION("1000") {
+            w.value(1000);
+            CHECK(w.hex() == "1903e8");
+        }
+        SECTION("1000000") {
+            w.value(1000000);
+            CHECK(w.hex() == "1a000f4240");
+        }
+        SECTION("4294967295") {
+            w.value(4294967295u);
+            CHECK(w.hex() == "1affffffff");
+        }
+        SECTION("-1") {
+            w.value(-1);
+            CHECK(w.hex() == "20");
+        }
+        SECTION("-100") {
+            w.value(-100);
+            CHECK(w.hex() == "3863");
+        }
+        SECTION("-1000") {
+            w.value(-1000);
+            CHECK(w.hex() == "3903e7");
+        }
+        SECTION("-2147483648") {
+            w.value((int)-2147483648LL);
+            CHECK(w.hex() == "3a7fffffff");
+        }
+    }
+
+    SECTION("float") {
+        SECTION("0.0") {
+            w.value(0.0);
+            CHECK(w.hex() == "f90000");
+        }
+        SECTION("-0.0") {
+            w.value(-0.0);
+            CHECK(w.hex() == "f98000");
+        }
+        SECTION("1.5") {
+            w.value(1.5);
+            CHECK(w.hex() == "f93e00");
+        }
+        SECTION("65504.0") {
+            w.value(65504.0);
+            CHECK(w.hex() == "f97bff");
+        }
+        SECTION("5.960464477539063e-8") {
+            w.value(5.960464477539063e-8);
+            CHECK(w.hex() == "f90001");
+        }
+        SECTION("0.00006103515625") {
+            w.value(0.00006103515625);
+            CHECK(w.hex() == "f90400");
+        }
+        SECTION("100000.0") {
+            w.value(100000.0);
+            CHECK(w.hex() == "fa47c35000");
+        }
+        SECTION("3.4028234663852886e+38") {
+            w.value(3.4028234663852886e+38);
+            CHECK(w.hex() == "fa7f7fffff");
+        }
+        SECTION("1.1") {
+            w.value(1.1);
+            CHECK(w.hex() == "fb3ff199999999999a");
+        }
+        SECTION("1.0e+300") {
+            w.value(1.0e+300);
+            CHECK(w.hex() == "fb7e37e43c8800759c");
+        }
+        SECTION("Infinity") {
+            w.value(INFINITY).value(-INFINITY);
+            CHECK(w.hex() == "f97c00f9fc00");
+        }
+        SECTION("NaN") {
+            w.value(NAN);
+            CHECK(w.hex() == "f97e00");
+        }
+    }
+
+    SECTION("string") {
+        SECTION("empty") {
+            w.value("");
+            CHECK(w.hex() == "60");
+        }
+        SECTION("ASCII") {
+            w.value("IETF");
+            CHECK(w.hex() == "6449455446");
+        }
+        SECTION("UTF-8") {
+            w.value("\xc3\xbc");
+            CHECK(w.hex() == "62c3bc");
+        }
+        SECTION("with null characters") {
+            w.value("a\0b", 3);
+            CHECK(w.hex() == "63610062");
+        }
+        SECTION("bytes") {
+            w.bytes("\x01\x02\x03\x04", 4);
+            CHECK(w.hex() == "4401020304");
+        }
+    }
+
+    SECTION("array") {
+        SECTION("definite length") {
+            w.beginArray(3).value(1).beginArray(2).value(2).value(3).endArray().beginArray(2).value(4).value(5).endArray().endArray();
+            CHECK(w.hex() == "8301820203820405");
+        }
+        SECTION("indefinite length") {
+            w.beginArray().value(1).beginArray(2).value(2).value(3).endArray().beginArray().value(4).value(5).endArray().endArray();
+            CHECK(w.hex() == "9f018202039f0405ffff");
+        }
+    }
+
+    SECTION("object") {
+        SECTION("definite length") {
+            w.beginObject(2).name("a").value(1).name("b").beginArray(2).value(2).value(3).endArray().endObject();
+            CHECK(w.hex() == "a26161016162820203");
+        }
+        SECTION("indefinite length") {
+            w.beginObject().name("Fun").value(true).name("Amt").value(-2).endObject();
+            CHECK(w.hex() == "bf6346756ef563416d7421ff");
+        }
+    }
+
+    SECTION("stream writer") {
+        test::OutputStream strm;
+        CBORStreamWriter sw(strm);
+        sw.beginArray(2).value(1).value("a");
+        CHECK(toHex(std::string(strm.data(), strm.size())) == "82016161");
+        CHECK(sw.stream() == &strm);
+    }
+
+    SECTION("buffer writer") {
+        SECTION("enough space") {
+            char buf[16];
+            CBORBufferWriter bw(buf, sizeof(buf));
+            bw.beginArray(2).value(1000).value("a");
+            CHECK(bw.buffer() == buf);
+            CHECK(bw.bufferSize() == sizeof(buf));
+            CHECK(bw.dataSize() == 6);
+            CHECK(toHex(std::string(buf, bw.dataSize())) == "821903e86161");
+        }
+        SECTION("not enough space") {
+            char buf[3] = {};
+            CBORBufferWriter bw(buf, sizeof(buf));
+            bw.beginArray(2).value(1000).value("a");
+            CHECK(bw.dataSize() == 6); // Required buffer size
+            CHECK(toHex(std::string(buf, sizeof(buf))) == "821903");
+        }
+    }
+}
+
+TEST_CASE("Parsing CBOR") {
+    SECTION("null") {
+        const CBORValue v = parseHex("f6");
+        CHECK(v.type() == CBOR_TYPE_NULL);
+        CHECK(v.isNull());
+        CHECK(parseHex("f7").isNull()); // undefined
+    }
+
+    SECTION("bool") {
+        const CBORValue v1 = parseHex("f5");
+        CHECK(v1.isBool());
+        CHECK(v1.toBool() == true);
+        CHECK(v1.toInt() == 1);
+        const CBORValue v2 = parseHex("f4");
+        CHECK(v2.isBool());
+        CHECK(v2.toBool() == false);
+    }
+
+    SECTION("int") {
+        CHECK(parseHex("00").toInt() == 0);
+        CHECK(parseHex("17").toInt() == 23);
+        CHECK(parseHex("1818").toInt() == 24);
+        CHECK(parseHex("1903e8").toInt() == 1000);
+        CHECK(parseHex("1a000f4240").toInt() == 1000000);
+        CHECK(parseHex("20").toInt() == -1);
+        CHECK(parseHex("3903e7").toInt() == -1000);
+        const CBORValue v = parseHex("1b000000e8d4a51000"); // 1000000000000
+        CHECK(v.isInt());
+        CHECK(v.isNumber());
+        CHECK(v.toInt() == INT_MAX); // Saturated
+        CHECK(v.toDouble() == 1000000000000.0);
+        CHECK(parseHex("3bffffffffffffffff").toInt() == INT_MIN);
+    }
+
+    SECTION("float") {
+        CHECK(parseHex("f90000").toDouble() == 0.0);
+        CHECK(parseHex("f93c00").toDouble() == 1.0);
+        CHECK(parseHex("f93e00").toDouble() == 1.5);
+        CHECK(parseHex("f97bff").toDouble() == 65504.0);
+        CHECK(parseHex("f90001").toDouble() == 5.960464477539063e-8);
+        CHECK(parseHex("f9c400").toDouble() == -4.0);
+        CHECK(parseHex("fa47c35000").toDouble() == 100000.0);
+        CHECK(parseHex("fb3ff199999999999a").toDouble() == 1.1);
+        CHECK(parseHex("f97c00").toDouble() == INFINITY);
+        CHECK(std::isnan(parseHex("f97e00").toDouble()));
+        const CBORValue v = parseHex("fbc010666666666666"); // -4.1
+        CHECK(v.isFloat());
+        CHECK(v.isNumber());
+        CHECK(v.toInt() == -4);
+        CHECK(v.toBool() == true);
+    }
+
+    SECTION("string") {
+        const CBORValue v1 = parseHex("6449455446");
+        CHECK(v1.isString());
+        CHECK(v1.toString() == "IETF");
+        const CBORValue v2 = parseHex("4401020304");
+        CHECK(v2.isBytes());
+        CHECK(v2.toString().size() == 4);
+        CHECK(memcmp(v2.toString().data(), "\x01\x02\x03\x04", 4) == 0);
+        CHECK(parseHex("60").toString().isEmpty());
+    }
+
+    SECTION("zero-copy access") {
+        std::string data = fromHex("6449455446");
+        const CBORValue v = CBORValue::parse(data.data(), data.size());
+        CHECK(v.toString().data() == data.data() + 1);
+        data[2] = 'e';
+        CHECK(v.toString() == "IeTF");
+    }
+
+    SECTION("tags are skipped") {
+        const CBORValue v = parseHex("c11a514b67b0"); // 1(1363896240)
+        CHECK(v.isInt());
+        CHECK(v.toInt() == 1363896240);
+    }
+
+    SECTION("array") {
+        SECTION("empty") {
+            const CBORValue v = parseHex("80");
+            CHECK(v.isArray());
+            CBORArrayIterator it(v);
+            CHECK(it.count() == 0);
+            CHECK_FALSE(it.next());
+        }
+        SECTION("nested") {
+            const CBORValue v = parseHex("8301820203820405");
+            CBORArrayIterator it(v);
+            CHECK(it.count() == 3);
+            REQUIRE(it.next());
+            CHECK(it.value().toInt() == 1);
+            REQUIRE(it.next());
+            CBORArrayIterator it2(it.value());
+            CHECK(it2.count() == 2);
+            REQUIRE(it2.next());
+            CHECK(it2.value().toInt() == 2);
+            REQUIRE(it2.next());
+            CHECK(it2.value().toInt() == 3);
+            CHECK_FALSE(it2.next());
+            REQUIRE(it.next());
+            CBORArrayIterator it3(it.value());
+            REQUIRE(it3.next());
+            CHECK(it3.value().toInt() == 4);
+            CHECK(it.count() == 0);
+            CHECK_FALSE(it.next());
+        }
+        SECTION("indefinite length") {
+            const CBORValue v = parseHex("9f018202039f0405ffff");
+            CBORArrayIterator it(v);
+            CHECK(it.count() == 3);
+            REQUIRE(it.next());
+            CHECK(it.value().toInt() == 1);
+            REQUIRE(it.next());
+            CHECK(it.value().isArray());
+            REQUIRE(it.next());
+            CBORArrayIterator it2(it.value());
+            CHECK(it2.count() == 2);
+            CHECK_FALSE(it.next());
+        }
+        SECTION("iterating over a non-array value") {
+            CBORArrayIterator it(parseHex("01"));
+            CHECK(it.count() == 0);
+            CHECK_FALSE(it.next());
+        }
+    }
+
+    SECTION("object") {
+        SECTION("definite length") {
+            const CBORValue v = parseHex("a26161016162820203");
+            CHECK(v.isObject());
+            CBORObjectIterator it(v);
+            CHECK(it.count() == 2);
+            REQUIRE(it.next());
+            CHECK(it.name() == "a");
+            CHECK(it.value().toInt() == 1);
+            REQUIRE(it.next());
+            CHECK(it.name() == "b");
+            CHECK(it.value().isArray());
+            CHECK_FALSE(it.next());
+        }
+        SECTION("indefinite length") {
+            const CBORValue v = parseHex("bf6346756ef563416d7421ff");
+            CBORObjectIterator it(v);
+            CHECK(it.count() == 2);
+            REQUIRE(it.next());
+            CHECK(it.name() == "Fun");
+            CHECK(it.value().toBool() == true);
+            REQUIRE(it.next());
+            CHECK(it.name() == "Amt");
+            CHECK(it.value().toInt() == -2);
+            CHECK_FALSE(it.next());
+        }
+        SECTION("non-string keys") {
+            const CBORValue v = parseHex("a201020304");
+            CBORObjectIterator it(v);
+            REQUIRE(it.next());
+            CHECK(it.name().isEmpty());
+            CHECK(it.key().toInt() == 1);
+            CHECK(it.value().toInt() == 2);
+        }
+    }
+
+    SECTION("parsing errors") {
+        CHECK_FALSE(CBORValue::parse(nullptr, 0).isValid());
+        CHECK_FALSE(parseHex("").isValid());
+        CHECK_FALSE(parseHex("19").isValid()); // Truncated argument
+        CHECK_FALSE(parseHex("1c").isValid()); // Reserved value
+        CHECK_FALSE(parseHex("6449").isValid()); // Truncated string
+        CHECK_FALSE(parseHex("820102ff").isValid()); // Trailing bytes
+        CHECK_FALSE(parseHex("830102").isValid()); // Missing element
+        CHECK_FALSE(parseHex("9f0102").isValid()); // Missing break
+        CHECK_FALSE(parseHex("bf01ff").isValid()); // Missing value
+        CHECK_FALSE(parseHex("ff").isValid()); // Unexpected break
+        CHECK_FALSE(parseHex("5f4101ff").isValid()); // Indefinite-length strings are not supported
+        CHECK_FALSE(parseHex("9bffffffffffffffff").isValid()); // Huge array
+        std::string deep;
+        for (unsigned i = 0; i < 40; ++i) {
+            deep += "81";
+        }
+        deep += "01";
+        CHECK_FALSE(parseHex(deep).isValid()); // Nested too deeply
+    }
+}
+
+TEST_CASE("CBOR round trip") {
+    Writer w;
+    writeTelemetry(w);
+    const CBORValue v = CBORValue::parse(w.data().data(), w.data().size());
+    REQUIRE(v.isObject());
+    CBORObjectIterator it(v);
+    REQUIRE(it.next());
+    CHECK(it.name() == "dev");
+    CHECK(it.value().toInt() == 12345);
+    REQUIRE(it.next());
+    CHECK(it.name() == "ts");
+    CHECK(it.value().toDouble() == 1546300800.0);
+    REQUIRE(it.next());
+    CHECK(it.name() == "bat");
+    CHECK(it.value().toDouble() == 87.5);
+    REQUIRE(it.next());
+    CHECK(it.name() == "temp");
+    CBORArrayIterator temp(it.value());
+    CHECK(temp.count() == TELEMETRY_SAMPLES);
+    for (unsigned i = 0; temp.next(); ++i) {
+        CHECK(temp.value().toDouble() == 20.0 + i * 0.25);
+    }
+    REQUIRE(it.next());
+    CHECK(it.name() == "rssi");
+    CBORArrayIterator rssi(it.value());
+    for (int i = 0; rssi.next(); ++i) {
+        CHECK(rssi.value().toInt() == -60 - i);
+    }
+    CHECK_FALSE(it.next());
+}
+
+TEST_CASE("CBOR vs JSON payload size") {
+    char jsonBuf[1024];
+    JSONBufferWriter jw(jsonBuf, sizeof(jsonBuf));
+    writeTelemetry(jw);
+    Writer cw;
+    writeTelemetry(cw);
+    // Numeric data should be at least 30% smaller
+    const size_t maxCborSize = jw.dataSize() * 7 / 10;
+    CHECK(cw.data().size() <= maxCborSize);
+}
+
+TEST_CASE("CBOR vs JSON benchmark", "[hide][benchmark]") {
+    const unsigned ITERATIONS = 20000;
+    char jsonBuf[1024];
+    char cborBuf[1024];
+    size_t jsonSize = 0;
+    size_t cborSize = 0;
+    const double jsonWrite = measure(ITERATIONS, [&]() {
+        JSONBufferWriter w(jsonBuf, sizeof(jsonBuf));
+        writeTelemetry(w);
+        jsonSize = w.dataSize();
+    });
+    const double cborWrite = measure(ITERATIONS, [&]() {
+        CBORBufferWriter w(cborBuf, sizeof(cborBuf));
+        writeTelemetry(w);
+        cborSize = w.dataSize();
+    });
+    double sum1 = 0, sum2 = 0;
+    const double jsonRead = measure(ITERATIONS, [&]() {
+        sum1 += sumJson(JSONValue::parseCopy(jsonBuf, jsonSize));
+    });
+    const double cborRead = measure(ITERATIONS, [&]() {
+        sum2 += sumCbor(CBORValue::parse(cborBuf, cborSize));
+    });
+    CHECK(sum1 == sum2);
+    std::cout << "Payload size: JSON " << jsonSize << " bytes, CBOR " << cborSize << " bytes" << std::endl;
+    std::cout << "Encoding: JSON " << jsonWrite << " us, CBOR " << cborWrite << " us" << std::endl;
+    std::cout << "Decoding: JSON " << jsonRead << " us, CBOR " << cborRead << " us" << std::endl;
+}
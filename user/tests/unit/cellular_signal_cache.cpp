@@ -0,0 +1,140 @@
+#include "cellular_signal_cache.h"
+#include "at_parser.h"
+#include "system_error.h"
+
+#include "tools/at_modem.h"
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace particle;
+
+using test::ScriptedModem;
+
+class CacheTest {
+public:
+    explicit CacheTest(bool useCesq = false) {
+        AtParserConfig conf;
+        conf.stream(&modem).commandTimeout(100).streamTimeout(100);
+        REQUIRE(parser.init(std::move(conf)) == 0);
+        REQUIRE(cache.init(&parser, useCesq) == 0);
+    }
+
+    ScriptedModem modem;
+    AtParser parser;
+    CellularSignalCache cache;
+};
+
+const system_tick_t MAX_AGE = 60000;
+
+} // namespace
+
+TEST_CASE("CellularSignalCache") {
+    CellularSignalCache::Info info = {};
+
+    SECTION("the cache is empty initially") {
+        CacheTest t;
+        CHECK_FALSE(t.cache.get(&info, MAX_AGE));
+        CHECK(t.cache.needsRefresh(MAX_AGE));
+        CHECK(t.modem.commands().empty());
+    }
+
+    SECTION("reads are served from the cache after a refresh") {
+        CacheTest t;
+        t.modem.reply("\r\n+COPS: 0,0,\"Carrier\",2\r\n\r\nOK\r\n");
+        t.modem.reply("\r\n+CSQ: 17,3\r\n\r\nOK\r\n");
+        REQUIRE(t.cache.refresh() == 0);
+        const std::vector<std::string> cmds = { "AT+COPS?", "AT+CSQ" };
+        CHECK(t.modem.commands() == cmds);
+        t.modem.clearCommands();
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(t.cache.get(&info, MAX_AGE));
+            CHECK(info.act == 2);
+            CHECK_FALSE(info.cesq);
+            CHECK(info.rssi == 17);
+            CHECK(info.ber == 3);
+        }
+        CHECK(t.modem.commands().empty());
+        CHECK_FALSE(t.cache.needsRefresh(MAX_AGE));
+        // A zero maximum age forces the caller to refresh the cache
+        CHECK_FALSE(t.cache.get(&info, 0));
+    }
+
+    SECTION("the signal quality can be queried via +CESQ") {
+        CacheTest t(true /* useCesq */);
+        t.modem.reply("\r\n+COPS: 0,0,\"Carrier\",7\r\n\r\nOK\r\n");
+        t.modem.reply("\r\n+CESQ: 99,99,255,255,20,45\r\n\r\nOK\r\n");
+        REQUIRE(t.cache.refresh() == 0);
+        const std::vector<std::string> cmds = { "AT+COPS?", "AT+CESQ" };
+        CHECK(t.modem.commands() == cmds);
+        REQUIRE(t.cache.get(&info, MAX_AGE));
+        CHECK(info.act == 7);
+        CHECK(info.cesq);
+        CHECK(info.rxlev == 99);
+        CHECK(info.rsrq == 20);
+        CHECK(info.rsrp == 45);
+    }
+
+    SECTION("+CIEV reporting a signal or service change invalidates the signal quality") {
+        CacheTest t;
+        t.modem.reply("\r\n+COPS: 0,0,\"Carrier\",0\r\n\r\nOK\r\n");
+        t.modem.reply("\r\n+CSQ: 17,3\r\n\r\nOK\r\n");
+        REQUIRE(t.cache.refresh() == 0);
+        t.modem.push("\r\n+CIEV: 1,5\r\n"); // Battery charge level
+        REQUIRE(t.parser.processUrc() == 1);
+        CHECK(t.cache.get(&info, MAX_AGE));
+        t.modem.push("\r\n+CIEV: 2,3\r\n"); // Signal quality
+        REQUIRE(t.parser.processUrc() == 1);
+        CHECK_FALSE(t.cache.get(&info, MAX_AGE));
+        CHECK(t.cache.needsRefresh(MAX_AGE));
+    }
+
+    SECTION("registration status updates the cell info") {
+        CacheTest t;
+        CHECK(t.cache.parseRegistrationStatus("+CREG: 5,\"1A2B\",\"01C3D4E5\",0") == 5);
+        t.modem.reply("\r\n+COPS: 0,0,\"Carrier\",0\r\n\r\nOK\r\n");
+        t.modem.reply("\r\n+CSQ: 17,3\r\n\r\nOK\r\n");
+        REQUIRE(t.cache.refresh() == 0);
+        REQUIRE(t.cache.get(&info, MAX_AGE));
+        CHECK(info.lac == 0x1a2b);
+        CHECK(info.ci == 0x01c3d4e5);
+        // Information text response with the same access technology
+        CHECK(t.cache.parseRegistrationStatus("+CGREG: 2,1,\"00FF\",\"1234\",0") == 1);
+        REQUIRE(t.cache.get(&info, MAX_AGE));
+        CHECK(info.lac == 0xff);
+        CHECK(info.ci == 0x1234);
+        // A change of the access technology invalidates the signal quality
+        CHECK(t.cache.parseRegistrationStatus("+CEREG: 1,\"00FF\",\"1234\",7") == 1);
+        CHECK_FALSE(t.cache.get(&info, MAX_AGE));
+        // Deregistration clears the cell info
+        CHECK(t.cache.parseRegistrationStatus("+CEREG: 0") == 0);
+        t.modem.reply("\r\n+COPS: 0,0,\"Carrier\",7\r\n\r\nOK\r\n");
+        t.modem.reply("\r\n+CSQ: 17,3\r\n\r\nOK\r\n");
+        REQUIRE(t.cache.refresh() == 0);
+        REQUIRE(t.cache.get(&info, MAX_AGE));
+        CHECK(info.lac == -1);
+        CHECK(info.ci == -1);
+        CHECK(info.act == 7);
+    }
+
+    SECTION("malformed registration status is rejected") {
+        CacheTest t;
+        CHECK(t.cache.parseRegistrationStatus("+CREG") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(t.cache.parseRegistrationStatus("+CREG: \"1A2B\"") == SYSTEM_ERROR_BAD_DATA);
+        CHECK(t.cache.parseRegistrationStatus("+CREG: 1,\"1A2B") == SYSTEM_ERROR_BAD_DATA);
+    }
+
+    SECTION("a failed refresh keeps the cache empty") {
+        CacheTest t;
+        t.modem.reply("\r\n+COPS: 0\r\n\r\nOK\r\n");
+        CHECK(t.cache.refresh() == SYSTEM_ERROR_UNKNOWN);
+        CHECK_FALSE(t.cache.get(&info, MAX_AGE));
+        t.modem.reply("\r\n+COPS: 0,0,\"Carrier\",0\r\n\r\nOK\r\n");
+        t.modem.reply("\r\nERROR\r\n");
+        CHECK(t.cache.refresh() < 0);
+        CHECK_FALSE(t.cache.get(&info, MAX_AGE));
+    }
+}
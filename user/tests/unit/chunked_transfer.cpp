@@ -0,0 +1,364 @@
+#include "chunked_transfer.h"
+
+#include "tools/message_channel.h"
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+
+namespace {
+
+using namespace particle::protocol;
+
+using test::LoopbackChannel;
+
+const unsigned CHUNK_SIZE = 16;
+const unsigned CHUNK_COUNT = 40;
+const unsigned FILE_LENGTH = CHUNK_SIZE * CHUNK_COUNT - 8; // The last chunk is shorter
+const uint32_t IMAGE_ID = 0x12345678;
+const uint32_t OTA_ADDRESS = 0x80000; // Start of the staging area
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (unsigned j = 0; j < 8; ++j) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// Device-side storage: the staging area and the backup memory survive reboots
+class Device: public ChunkedTransfer::Callbacks {
+public:
+    std::vector<uint8_t> flash;
+    std::string backup;
+    std::vector<uint32_t> prepareFlags;
+    std::vector<uint32_t> finishFlags;
+    // Chunks reported as staged when the transfer was resumed
+    std::vector<unsigned> resumedChunks;
+    bool canRead = true;
+
+    int prepare_for_firmware_update(FileTransfer::Descriptor& file, uint32_t flags, void* reserved) override {
+        prepareFlags.push_back(flags);
+        // The address in UpdateBegin is relative to the staging area, like in the system
+        file.file_address = OTA_ADDRESS + file.chunk_address;
+        if (!(flags & 3)) {
+            flash.assign(file.file_length, 0xff); // Erase
+        }
+        if (flags & 2) {
+            const uint8_t* const bitmap = (const uint8_t*)reserved;
+            resumedChunks.clear();
+            for (unsigned i = 0; bitmap && i < file.chunk_count(file.chunk_size); ++i) {
+                if (bitmap[i / 8] & (1 << (i % 8))) {
+                    resumedChunks.push_back(i);
+                }
+            }
+        }
+        return 0;
+    }
+
+    int save_firmware_chunk(FileTransfer::Descriptor& file, const unsigned char* chunk, void*) override {
+        if (file.chunk_address < OTA_ADDRESS || file.chunk_address - OTA_ADDRESS + file.chunk_size > flash.size()) {
+            return -1;
+        }
+        memcpy(flash.data() + file.chunk_address - OTA_ADDRESS, chunk, file.chunk_size);
+        return 0;
+    }
+
+    int finish_firmware_update(FileTransfer::Descriptor& file, uint32_t flags, void*) override {
+        if (!(flags & UpdateFlag::VALIDATE_ONLY)) {
+            finishFlags.push_back(flags);
+        }
+        return 0;
+    }
+
+    uint32_t calculate_crc(const unsigned char* buf, uint32_t buflen) override {
+        return crc32(buf, buflen);
+    }
+
+    system_tick_t millis() override {
+        return 0;
+    }
+
+    int read_firmware_chunk(FileTransfer::Descriptor& file, unsigned char* chunk, void*) override {
+        if (!canRead || file.chunk_address < OTA_ADDRESS ||
+                file.chunk_address - OTA_ADDRESS + file.chunk_size > flash.size()) {
+            return -1;
+        }
+        memcpy(chunk, flash.data() + file.chunk_address - OTA_ADDRESS, file.chunk_size);
+        return 0;
+    }
+
+    int save_checkpoint(const void* data, size_t length) override {
+        backup.assign((const char*)data, length);
+        return 0;
+    }
+
+    int restore_checkpoint(void* data, size_t max_length) override {
+        const size_t n = std::min(max_length, backup.size());
+        memcpy(data, backup.data(), n);
+        return n;
+    }
+};
+
+void appendUint(std::string& s, uint32_t val, unsigned size) {
+    while (size--) {
+        s += (char)(val >> (size * 8));
+    }
+}
+
+// Plays the server side of the transfer
+class Server {
+public:
+    explicit Server(LoopbackChannel& channel) :
+            channel_(channel),
+            nextId_(0x100) {
+        for (unsigned i = 0; i < FILE_LENGTH; ++i) {
+            image_ += (char)(i * 7 + i / 13);
+        }
+    }
+
+    ProtocolError begin(ChunkedTransfer& transfer, uint32_t imageId = IMAGE_ID, uint8_t flags = 1) {
+        std::string s;
+        s += (char)0x41; // CON, one-byte token
+        s += (char)0x02; // POST
+        appendUint(s, nextId_++, 2);
+        s += (char)0x01; // Token
+        s += "\xb1" "u"; // Uri-Path
+        s += (char)0xff;
+        s += (char)flags;
+        appendUint(s, CHUNK_SIZE, 2);
+        appendUint(s, FILE_LENGTH, 4);
+        s += (char)FileTransfer::Store::FIRMWARE;
+        appendUint(s, 0, 4); // Address
+        if (imageId) {
+            appendUint(s, imageId, 4);
+        }
+        Message msg;
+        receive(s, msg);
+        return transfer.handle_update_begin(0x01, msg, channel_);
+    }
+
+    ProtocolError chunk(ChunkedTransfer& transfer, unsigned index) {
+        const std::string data = image_.substr(index * CHUNK_SIZE, CHUNK_SIZE);
+        std::string s;
+        s += (char)0x51; // NON, one-byte token
+        s += (char)0x02; // POST
+        appendUint(s, nextId_++, 2);
+        s += (char)0x02; // Token
+        s += "\xb1" "c"; // Uri-Path
+        s += (char)0x44; // Uri-Query: CRC
+        appendUint(s, crc32((const uint8_t*)data.data(), data.size()), 4);
+        s += (char)0x02; // Uri-Query: chunk index
+        appendUint(s, index, 2);
+        s += (char)0xff;
+        s += data;
+        ++chunksSent;
+        Message msg;
+        receive(s, msg);
+        return transfer.handle_chunk(0x02, msg, channel_);
+    }
+
+    ProtocolError chunks(ChunkedTransfer& transfer, const std::vector<unsigned>& indices) {
+        for (unsigned index: indices) {
+            const ProtocolError error = chunk(transfer, index);
+            if (error) {
+                return error;
+            }
+        }
+        return NO_ERROR;
+    }
+
+    ProtocolError done(ChunkedTransfer& transfer) {
+        std::string s;
+        s += (char)0x41; // CON, one-byte token
+        s += (char)0x03; // PUT
+        appendUint(s, nextId_++, 2);
+        s += (char)0x03; // Token
+        s += "\xb1" "u"; // Uri-Path
+        Message msg;
+        receive(s, msg);
+        return transfer.handle_update_done(0x03, msg, channel_);
+    }
+
+    // Returns the flags of the last UpdateReady message, or -1 if it wasn't sent
+    int updateReadyFlags() const {
+        for (auto it = channel_.sent().rbegin(); it != channel_.sent().rend(); ++it) {
+            const std::string& s = *it;
+            if (s.size() >= 2 && (uint8_t)s[1] == 0x44 && (uint8_t)s[s.size() - 2] == 0xff) {
+                return (uint8_t)s.back();
+            }
+        }
+        return -1;
+    }
+
+    // Returns the chunks requested by the device in its last missing chunks request
+    std::vector<unsigned> missingChunks() const {
+        std::vector<unsigned> indices;
+        for (auto it = channel_.sent().rbegin(); it != channel_.sent().rend(); ++it) {
+            const std::string& s = *it;
+            if (s.size() >= 7 && (uint8_t)s[1] == 0x01 && s[5] == 'c' && (uint8_t)s[6] == 0xff) {
+                for (size_t i = 7; i + 1 < s.size(); i += 2) {
+                    indices.push_back(((uint8_t)s[i] << 8) | (uint8_t)s[i + 1]);
+                }
+                break;
+            }
+        }
+        return indices;
+    }
+
+    const std::string& image() const {
+        return image_;
+    }
+
+    unsigned chunksSent = 0;
+
+private:
+    LoopbackChannel& channel_;
+    std::string image_;
+    message_id_t nextId_;
+
+    void receive(const std::string& data, Message& msg) {
+        channel_.push(data);
+        channel_.receive(msg);
+    }
+};
+
+std::vector<unsigned> range(unsigned begin, unsigned end, unsigned skip = CHUNK_COUNT) {
+    std::vector<unsigned> v;
+    for (unsigned i = begin; i < end; ++i) {
+        if (i != skip) {
+            v.push_back(i);
+        }
+    }
+    return v;
+}
+
+} // namespace
+
+TEST_CASE("ChunkedTransfer") {
+    Device device;
+    LoopbackChannel channel;
+    Server server(channel);
+    std::unique_ptr<ChunkedTransfer> transfer(new ChunkedTransfer);
+    transfer->init(&device);
+    transfer->reset();
+
+    SECTION("an uninterrupted transfer") {
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x01);
+        REQUIRE(server.chunks(*transfer, range(0, CHUNK_COUNT)) == NO_ERROR);
+        REQUIRE(server.done(*transfer) == NO_ERROR);
+        CHECK(device.finishFlags == std::vector<uint32_t>({ UpdateFlag::SUCCESS }));
+        CHECK(std::string(device.flash.begin(), device.flash.end()) == server.image());
+        CHECK_FALSE(transfer->is_updating());
+    }
+
+    SECTION("an interrupted transfer is resumed in the next session") {
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        REQUIRE(server.chunks(*transfer, range(0, 20, 3 /* lost */)) == NO_ERROR);
+        // The session is dropped
+        transfer->cancel();
+        CHECK(device.finishFlags == std::vector<uint32_t>({ UpdateFlag::ERROR }));
+        transfer->reset();
+        channel.clearSent();
+        server.chunksSent = 0;
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        CHECK(device.prepareFlags == std::vector<uint32_t>({ 1, 0, 1, 2 }));
+        CHECK(device.resumedChunks == range(0, 20, 3));
+        CHECK(server.updateReadyFlags() == 0x03);
+        std::vector<unsigned> missing = range(20, CHUNK_COUNT);
+        missing.insert(missing.begin(), 3);
+        REQUIRE(server.missingChunks() == missing);
+        REQUIRE(server.chunks(*transfer, missing) == NO_ERROR);
+        REQUIRE(server.done(*transfer) == NO_ERROR);
+        CHECK(server.chunksSent == missing.size());
+        CHECK(device.finishFlags == std::vector<uint32_t>({ UpdateFlag::ERROR, UpdateFlag::SUCCESS }));
+        CHECK(std::string(device.flash.begin(), device.flash.end()) == server.image());
+    }
+
+    SECTION("an interrupted transfer is resumed after a reboot from the last checkpoint") {
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        REQUIRE(server.chunks(*transfer, range(0, CHUNKS_PER_CHECKPOINT + 3)) == NO_ERROR);
+        // The device is reset without saving the transfer state
+        transfer.reset(new ChunkedTransfer);
+        transfer->init(&device);
+        transfer->reset();
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x03);
+        CHECK(device.resumedChunks == range(0, CHUNKS_PER_CHECKPOINT));
+        const std::vector<unsigned> missing = range(CHUNKS_PER_CHECKPOINT, CHUNK_COUNT);
+        REQUIRE(server.missingChunks() == missing);
+        REQUIRE(server.chunks(*transfer, missing) == NO_ERROR);
+        REQUIRE(server.done(*transfer) == NO_ERROR);
+        CHECK(device.finishFlags == std::vector<uint32_t>({ UpdateFlag::SUCCESS }));
+        CHECK(std::string(device.flash.begin(), device.flash.end()) == server.image());
+    }
+
+    SECTION("a completed transfer is not resumed") {
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        REQUIRE(server.chunks(*transfer, range(0, CHUNK_COUNT)) == NO_ERROR);
+        REQUIRE(server.done(*transfer) == NO_ERROR);
+        transfer.reset(new ChunkedTransfer);
+        transfer->init(&device);
+        transfer->reset();
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x01);
+        CHECK(device.prepareFlags.back() == 0);
+    }
+
+    SECTION("the transfer is restarted if the staged data was modified") {
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        REQUIRE(server.chunks(*transfer, range(0, 20)) == NO_ERROR);
+        transfer->cancel();
+        transfer->reset();
+        device.flash[CHUNK_SIZE * 5 + 1] ^= 0x01;
+        channel.clearSent();
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x01);
+        CHECK(device.prepareFlags.back() == 0);
+        CHECK(server.missingChunks().empty());
+        // The chunks received before the transfer was restarted are not resumed later
+        transfer->cancel();
+        transfer->reset();
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x03);
+        CHECK(server.missingChunks() == range(0, CHUNK_COUNT));
+    }
+
+    SECTION("the transfer is restarted if the staged data cannot be read") {
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        REQUIRE(server.chunks(*transfer, range(0, 20)) == NO_ERROR);
+        transfer->cancel();
+        transfer->reset();
+        device.canRead = false;
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x01);
+        CHECK(device.prepareFlags.back() == 0);
+    }
+
+    SECTION("the transfer is restarted if a different image is sent") {
+        REQUIRE(server.begin(*transfer) == NO_ERROR);
+        REQUIRE(server.chunks(*transfer, range(0, 20)) == NO_ERROR);
+        transfer->cancel();
+        transfer->reset();
+        REQUIRE(server.begin(*transfer, IMAGE_ID + 1) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x01);
+        CHECK(device.prepareFlags.back() == 0);
+    }
+
+    SECTION("transfers of images not identified by the server are not resumable") {
+        REQUIRE(server.begin(*transfer, 0 /* imageId */) == NO_ERROR);
+        REQUIRE(server.chunks(*transfer, range(0, 20)) == NO_ERROR);
+        transfer->cancel();
+        transfer->reset();
+        CHECK(device.backup.empty());
+        REQUIRE(server.begin(*transfer, 0 /* imageId */) == NO_ERROR);
+        CHECK(server.updateReadyFlags() == 0x01);
+        CHECK(device.prepareFlags.back() == 0);
+    }
+}
@@ -0,0 +1,47 @@
+#include "coap.h"
+
+#include "tools/catch.h"
+
+#include <string>
+
+using namespace particle::protocol;
+
+TEST_CASE("CoAP::find_option()") {
+    // CON GET, token 0x2A, Observe=0 (6), Uri-Path "v" (11), Uri-Path "temp" (11), payload "x"
+    const uint8_t msg[] = { 0x41, 0x01, 0x12, 0x34, 0x2a, 0x60, 0x51, 'v', 0x04, 't', 'e', 'm', 'p', 0xff, 'x' };
+    size_t size = 0;
+
+    SECTION("an option with an empty value is found") {
+        const uint8_t* val = CoAP::find_option(msg, sizeof(msg), CoAPOption::OBSERVE, &size);
+        CHECK(val == msg + 6);
+        CHECK(size == 0);
+        CHECK(CoAP::option_uint(val, size) == 0);
+    }
+
+    SECTION("repeated options are found by index") {
+        const uint8_t* val = CoAP::find_option(msg, sizeof(msg), CoAPOption::URI_PATH, &size, 1);
+        REQUIRE(val);
+        CHECK(std::string((const char*)val, size) == "temp");
+        CHECK(CoAP::find_option(msg, sizeof(msg), CoAPOption::URI_PATH, &size, 2) == nullptr);
+    }
+
+    SECTION("missing options are not found") {
+        CHECK(CoAP::find_option(msg, sizeof(msg), CoAPOption::URI_QUERY, &size) == nullptr);
+    }
+
+    SECTION("options of a truncated message are not found") {
+        CHECK(CoAP::find_option(msg, 11, CoAPOption::URI_PATH, &size, 1) == nullptr);
+    }
+}
+
+TEST_CASE("CoAP::encode_option_uint()") {
+    uint8_t buf[4] = {};
+
+    SECTION("values are encoded with the minimum number of bytes") {
+        CHECK(CoAP::encode_option_uint(buf, 0) == 0);
+        CHECK(CoAP::encode_option_uint(buf, 0x1234) == 2);
+        CHECK(CoAP::option_uint(buf, 2) == 0x1234);
+        CHECK(CoAP::encode_option_uint(buf, 0xffffff) == 3);
+        CHECK(CoAP::option_uint(buf, 3) == 0xffffff);
+    }
+}
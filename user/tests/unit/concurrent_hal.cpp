@@ -0,0 +1,79 @@
+#include "concurrent_hal.h"
+
+#include "tools/catch.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace {
+
+std::atomic<int> timerCount(0);
+
+void timerCallback(os_timer_t timer) {
+    ++timerCount;
+}
+
+} // namespace
+
+TEST_CASE("os_queue") {
+    os_queue_t q = nullptr;
+    REQUIRE(os_queue_create(&q, sizeof(int), 2, nullptr) == 0);
+
+    SECTION("items are taken in FIFO order") {
+        int v = 1;
+        REQUIRE(os_queue_put(q, &v, 0, nullptr) == 0);
+        v = 2;
+        REQUIRE(os_queue_put(q, &v, 0, nullptr) == 0);
+        v = 3;
+        CHECK(os_queue_put(q, &v, 0, nullptr) != 0); // Queue is full
+        REQUIRE(os_queue_take(q, &v, 0, nullptr) == 0);
+        CHECK(v == 1);
+        REQUIRE(os_queue_take(q, &v, 0, nullptr) == 0);
+        CHECK(v == 2);
+        CHECK(os_queue_take(q, &v, 10, nullptr) != 0); // Queue is empty
+    }
+
+    SECTION("take() blocks until an item is put by another thread") {
+        std::thread t([q]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            int v = 42;
+            os_queue_put(q, &v, CONCURRENT_WAIT_FOREVER, nullptr);
+        });
+        int v = 0;
+        CHECK(os_queue_take(q, &v, CONCURRENT_WAIT_FOREVER, nullptr) == 0);
+        CHECK(v == 42);
+        t.join();
+    }
+
+    os_queue_destroy(q, nullptr);
+}
+
+TEST_CASE("os_semaphore") {
+    os_semaphore_t s = nullptr;
+    REQUIRE(os_semaphore_create(&s, 2, 1) == 0);
+    CHECK(os_semaphore_take(s, 0, false) == 0);
+    CHECK(os_semaphore_take(s, 10, false) != 0);
+    CHECK(os_semaphore_give(s, false) == 0);
+    CHECK(os_semaphore_give(s, false) == 0);
+    CHECK(os_semaphore_give(s, false) != 0); // Maximum count reached
+    os_semaphore_destroy(s);
+}
+
+TEST_CASE("os_timer") {
+    timerCount = 0;
+    os_timer_t t = nullptr;
+    int id = 0;
+    REQUIRE(os_timer_create(&t, 5, timerCallback, &id, true /* one_shot */, nullptr) == 0);
+    void* p = nullptr;
+    REQUIRE(os_timer_get_id(t, &p) == 0);
+    CHECK(p == &id);
+    CHECK(!os_timer_is_active(t, nullptr));
+    REQUIRE(os_timer_change(t, OS_TIMER_CHANGE_START, false, 0, 0, nullptr) == 0);
+    for (int i = 0; i < 100 && timerCount == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(timerCount == 1);
+    CHECK(!os_timer_is_active(t, nullptr));
+    os_timer_destroy(t, nullptr);
+}
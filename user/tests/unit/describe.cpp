@@ -0,0 +1,219 @@
+#include "describe.h"
+
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace {
+
+using namespace particle::protocol;
+
+using particle::BufferAppender2;
+
+std::vector<std::string> g_functions;
+std::vector<std::pair<std::string, SparkReturnType::Enum>> g_variables;
+std::string g_systemHeader;
+std::vector<std::string> g_modules;
+
+int numFunctions() {
+    return g_functions.size();
+}
+
+const char* functionKey(int index) {
+    return g_functions.at(index).c_str();
+}
+
+int numVariables() {
+    return g_variables.size();
+}
+
+const char* variableKey(int index) {
+    return g_variables.at(index).first.c_str();
+}
+
+SparkReturnType::Enum variableType(const char* key) {
+    for (const auto& v: g_variables) {
+        if (v.first == key) {
+            return v.second;
+        }
+    }
+    return SparkReturnType::INT;
+}
+
+// Produces the system describe in the same format as system_module_info()
+bool appendSystemInfo(appender_fn append, void* data, void* reserved) {
+    std::string s = g_systemHeader + ",\"m\":[";
+    for (size_t i = 0; i < g_modules.size(); ++i) {
+        if (i) {
+            s += ',';
+        }
+        s += g_modules[i];
+    }
+    s += ']';
+    // Append in small pieces, like the actual implementation does
+    for (size_t i = 0; i < s.size(); i += 3) {
+        append(data, (const uint8_t*)s.data() + i, std::min<size_t>(3, s.size() - i));
+    }
+    return true;
+}
+
+SparkDescriptor descriptor() {
+    SparkDescriptor d = {};
+    d.size = sizeof(d);
+    d.num_functions = numFunctions;
+    d.get_function_key = functionKey;
+    d.num_variables = numVariables;
+    d.get_variable_key = variableKey;
+    d.variable_type = variableType;
+    d.append_system_info = appendSystemInfo;
+    return d;
+}
+
+DescribeSnapshot snapshot() {
+    DescribeSnapshot s;
+    DescribeState::snapshot(descriptor(), &s);
+    return s;
+}
+
+uint32_t moduleHash(const std::string& json) {
+    return describe_hash(describe_hash(DESCRIBE_HASH_INIT, 'm'), json.data(), json.size());
+}
+
+std::string num(uint32_t val) {
+    return std::to_string(val);
+}
+
+class Delta {
+public:
+    Delta(DescribeState& state, uint32_t base) {
+        const DescribeSnapshot s = snapshot();
+        BufferAppender2 appender(buf_, sizeof(buf_));
+        ok_ = state.build_delta(descriptor(), s, base, appender);
+        data_ = std::string(buf_, appender.dataSize());
+        if (ok_) {
+            state.sent_describe(s);
+        }
+    }
+
+    bool ok() const {
+        return ok_;
+    }
+
+    const std::string& data() const {
+        return data_;
+    }
+
+private:
+    char buf_[1024];
+    std::string data_;
+    bool ok_;
+};
+
+} // namespace
+
+TEST_CASE("DescribeState") {
+    g_functions = { "f1", "f2" };
+    g_variables = { { "v1", SparkReturnType::INT }, { "v2", SparkReturnType::STRING } };
+    g_systemHeader = "\"p\":6,\"imei\":\"[{x\\\"}]\"";
+    g_modules = { "{\"f\":\"b\",\"n\":\"0\",\"v\":7,\"d\":[]}", "{\"f\":\"s\",\"n\":\"1\",\"v\":1000,\"d\":[{\"f\":\"b\",\"n\":\"0\",\"v\":7}]}",
+            "{\"f\":\"u\",\"n\":\"1\",\"v\":5,\"d\":[]}" };
+    DescribeState state;
+    const DescribeSnapshot s0 = snapshot();
+
+    SECTION("entry hashes") {
+        REQUIRE(s0.count == 8); // 2 functions, 2 variables, 3 modules and the system data
+        CHECK(s0.entries[0] == DescribeState::function_hash("f1"));
+        CHECK(s0.entries[3] == DescribeState::variable_hash("v2", SparkReturnType::STRING));
+        REQUIRE(s0.module_count == 3);
+        for (unsigned i = 0; i < 3; ++i) {
+            CHECK(s0.module_hash(i) == moduleHash(g_modules[i]));
+        }
+    }
+
+    SECTION("the checksum doesn't depend on the order of entries") {
+        std::swap(g_functions[0], g_functions[1]);
+        std::swap(g_modules[0], g_modules[2]);
+        const DescribeSnapshot s = snapshot();
+        CHECK(s.checksum() == s0.checksum());
+        g_functions.push_back("f3");
+        CHECK(snapshot().checksum() != s0.checksum());
+    }
+
+    SECTION("a delta is not produced without a describe known to the server") {
+        CHECK_FALSE(Delta(state, s0.checksum()).ok());
+    }
+
+    SECTION("a delta is not produced if the base checksum doesn't match") {
+        state.sent_describe(s0);
+        CHECK_FALSE(Delta(state, s0.checksum() + 1).ok());
+    }
+
+    SECTION("an empty delta is produced if nothing has changed") {
+        state.sent_describe(s0);
+        const Delta d(state, s0.checksum());
+        REQUIRE(d.ok());
+        CHECK(d.data() == "{\"b\":" + num(s0.checksum()) + ",\"c\":" + num(s0.checksum()) + "}");
+    }
+
+    SECTION("added and removed functions and variables") {
+        state.sent_describe(s0);
+        g_functions = { "f1", "f3" };
+        g_variables = { { "v1", SparkReturnType::DOUBLE }, { "v2", SparkReturnType::STRING }, { "v3", SparkReturnType::BOOLEAN } };
+        const Delta d(state, s0.checksum());
+        REQUIRE(d.ok());
+        CHECK(d.data() == "{\"b\":" + num(s0.checksum()) + ",\"c\":" + num(snapshot().checksum()) +
+                ",\"f\":[\"f3\"],\"v\":{\"v1\":9,\"v3\":1},\"r\":[" + num(DescribeState::function_hash("f2")) + "," +
+                num(DescribeState::variable_hash("v1", SparkReturnType::INT)) + "]}");
+    }
+
+    SECTION("changed module entries") {
+        state.sent_describe(s0);
+        const std::string oldModule = g_modules[2];
+        g_modules[2] = "{\"f\":\"u\",\"n\":\"1\",\"v\":6,\"d\":[]}";
+        g_modules.push_back("{\"f\":\"u\",\"n\":\"2\",\"v\":1,\"d\":[]}");
+        const Delta d(state, s0.checksum());
+        REQUIRE(d.ok());
+        CHECK(d.data() == "{\"b\":" + num(s0.checksum()) + ",\"c\":" + num(snapshot().checksum()) +
+                ",\"m\":[" + g_modules[2] + "," + g_modules[3] + "],\"r\":[" + num(moduleHash(oldModule)) + "]}");
+    }
+
+    SECTION("a delta is not produced if the system data outside of the module entries has changed") {
+        state.sent_describe(s0);
+        g_systemHeader = "\"p\":8";
+        CHECK_FALSE(Delta(state, s0.checksum()).ok());
+    }
+
+    SECTION("the last sent describe becomes the base once the server confirms it") {
+        state.sent_describe(s0);
+        g_functions.push_back("f3");
+        const DescribeSnapshot s1 = snapshot();
+        REQUIRE(Delta(state, s0.checksum()).ok());
+        g_functions.push_back("f4");
+        const Delta d(state, s1.checksum());
+        REQUIRE(d.ok());
+        CHECK(d.data() == "{\"b\":" + num(s1.checksum()) + ",\"c\":" + num(snapshot().checksum()) + ",\"f\":[\"f4\"]}");
+        // The previous base is no longer available
+        CHECK_FALSE(Delta(state, s0.checksum()).ok());
+    }
+
+    SECTION("the confirmed describe remains the base if the server hasn't received the last delta") {
+        state.sent_describe(s0);
+        g_functions.push_back("f3");
+        REQUIRE(Delta(state, s0.checksum()).ok());
+        const Delta d(state, s0.checksum());
+        REQUIRE(d.ok());
+        CHECK(d.data() == "{\"b\":" + num(s0.checksum()) + ",\"c\":" + num(snapshot().checksum()) + ",\"f\":[\"f3\"]}");
+    }
+
+    SECTION("a delta is not produced if the number of entries exceeds the limit") {
+        state.sent_describe(s0);
+        for (unsigned i = 0; i < DescribeSnapshot::MAX_ENTRIES; ++i) {
+            g_functions.push_back("fn" + std::to_string(i));
+        }
+        const DescribeSnapshot s = snapshot();
+        CHECK(s.overflowed);
+        CHECK_FALSE(Delta(state, s0.checksum()).ok());
+    }
+}
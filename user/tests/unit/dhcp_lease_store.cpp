@@ -0,0 +1,158 @@
+#include "dhcp_lease_store.h"
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <cstring>
+
+using namespace particle::net;
+
+namespace {
+
+typedef DhcpLeaseStore::Lease Lease;
+
+const uint32_t NOW = 1550000000; // Unix time
+const uint64_t MILLIS = 60000;
+
+Lease lease(uint8_t ifIndex, const char* key, uint32_t addr, uint32_t leaseTime = 3600, uint32_t obtained = NOW) {
+    Lease l = {};
+    l.keySize = strlen(key);
+    memcpy(l.key, key, l.keySize);
+    l.ifIndex = ifIndex;
+    l.addr = addr;
+    l.netmask = 0xffffff00;
+    l.gateway = 0xc0a80001;
+    l.server = 0xc0a80001;
+    l.leaseTime = leaseTime;
+    l.obtained = obtained;
+    return l;
+}
+
+const Lease* find(const DhcpLeaseStore& store, uint8_t ifIndex, const char* key) {
+    return store.find(ifIndex, (const uint8_t*)key, strlen(key));
+}
+
+} // namespace
+
+TEST_CASE("DhcpLeaseStore") {
+    DhcpLeaseStore store;
+
+    SECTION("leases are found by interface and network") {
+        CHECK(store.update(lease(3, "home", 0xc0a80002), MILLIS));
+        CHECK(store.update(lease(3, "office", 0xc0a80003), MILLIS));
+        CHECK(store.update(lease(4, "home", 0xc0a80004), MILLIS));
+        REQUIRE(find(store, 3, "home"));
+        CHECK(find(store, 3, "home")->addr == 0xc0a80002);
+        CHECK(find(store, 3, "office")->addr == 0xc0a80003);
+        CHECK(find(store, 4, "home")->addr == 0xc0a80004);
+        CHECK_FALSE(find(store, 4, "office"));
+        CHECK_FALSE(find(store, 3, "hom"));
+    }
+
+    SECTION("a renewal of the same lease doesn't need to be saved") {
+        CHECK(store.update(lease(3, "home", 0xc0a80002), MILLIS));
+        CHECK_FALSE(store.update(lease(3, "home", 0xc0a80002), MILLIS + 1000));
+        CHECK(store.update(lease(3, "home", 0xc0a80005), MILLIS + 2000));
+        CHECK(find(store, 3, "home")->addr == 0xc0a80005);
+    }
+
+    SECTION("the least recently obtained lease is replaced") {
+        const char* keys[] = { "a", "b", "c", "d", "e" };
+        for (unsigned i = 0; i < 5; ++i) {
+            store.update(lease(3, keys[i], i), MILLIS);
+        }
+        CHECK_FALSE(find(store, 3, "a"));
+        for (unsigned i = 1; i < 5; ++i) {
+            CHECK(find(store, 3, keys[i]));
+        }
+        // Obtaining a new lease in a known network makes it the most recent one
+        store.update(lease(3, "b", 100), MILLIS);
+        store.update(lease(3, "f", 6), MILLIS);
+        CHECK(find(store, 3, "b"));
+        CHECK_FALSE(find(store, 3, "c"));
+    }
+
+    SECTION("serialized leases are restored") {
+        store.update(lease(3, "home", 0xc0a80002), MILLIS);
+        store.update(lease(4, "office", 0xc0a80003, 7200), MILLIS);
+        uint8_t data[DhcpLeaseStore::SERIALIZED_SIZE] = {};
+        CHECK(store.serialize(data, sizeof(data)) == (int)sizeof(data));
+        CHECK(store.serialize(data, sizeof(data) - 1) == SYSTEM_ERROR_TOO_LARGE);
+
+        DhcpLeaseStore restored;
+        CHECK(restored.deserialize(data, sizeof(data)) == 0);
+        const auto l = find(restored, 4, "office");
+        REQUIRE(l);
+        CHECK(l->addr == 0xc0a80003);
+        CHECK(l->netmask == 0xffffff00);
+        CHECK(l->leaseTime == 7200);
+        CHECK(l->obtained == NOW);
+        CHECK(find(restored, 3, "home"));
+        // The sequence numbers continue from the restored leases
+        const char* keys[] = { "a", "b", "c" };
+        for (unsigned i = 0; i < 3; ++i) {
+            restored.update(lease(3, keys[i], i), MILLIS);
+        }
+        CHECK_FALSE(find(restored, 3, "home"));
+        CHECK(find(restored, 4, "office"));
+    }
+
+    SECTION("incompatible or truncated data is not restored") {
+        store.update(lease(3, "home", 0xc0a80002), MILLIS);
+        uint8_t data[DhcpLeaseStore::SERIALIZED_SIZE] = {};
+        REQUIRE(store.serialize(data, sizeof(data)) > 0);
+
+        DhcpLeaseStore empty;
+        CHECK(empty.deserialize(data, 0) == 0);
+        CHECK(empty.deserialize(data, sizeof(data) - 1) == SYSTEM_ERROR_BAD_DATA);
+        CHECK_FALSE(find(empty, 3, "home"));
+        data[0] = DhcpLeaseStore::VERSION + 1;
+        CHECK(empty.deserialize(data, sizeof(data)) == 0);
+        CHECK_FALSE(find(empty, 3, "home"));
+    }
+
+    SECTION("the age of a lease is determined from the RTC if it's valid") {
+        store.update(lease(3, "home", 0xc0a80002, 3600), MILLIS);
+        const auto l = find(store, 3, "home");
+        CHECK_FALSE(store.isExpired(l, true, NOW + 3599, MILLIS));
+        CHECK(store.isExpired(l, true, NOW + 3600, MILLIS));
+    }
+
+    SECTION("the age of a lease obtained since the reset is known without the RTC") {
+        store.update(lease(3, "home", 0xc0a80002, 3600, 0 /* obtained */), MILLIS);
+        const auto l = find(store, 3, "home");
+        CHECK_FALSE(store.isExpired(l, false, 0, MILLIS + 3599999));
+        CHECK(store.isExpired(l, false, 0, MILLIS + 3600000));
+        CHECK(store.isExpired(l, true, NOW, MILLIS + 3600000));
+        // A renewal restarts the lease time
+        store.update(lease(3, "home", 0xc0a80002, 3600, 0), MILLIS + 1800000);
+        CHECK_FALSE(store.isExpired(l, false, 0, MILLIS + 3600000));
+    }
+
+    SECTION("a restored lease is discarded while the RTC is not valid") {
+        store.update(lease(3, "home", 0xc0a80002, 3600), MILLIS);
+        uint8_t data[DhcpLeaseStore::SERIALIZED_SIZE] = {};
+        REQUIRE(store.serialize(data, sizeof(data)) > 0);
+        DhcpLeaseStore restored;
+        REQUIRE(restored.deserialize(data, sizeof(data)) == 0);
+        const auto l = find(restored, 3, "home");
+        REQUIRE(l);
+        CHECK(restored.isExpired(l, false, 0, 1000));
+        CHECK_FALSE(restored.isExpired(l, true, NOW + 60, 1000));
+    }
+
+    SECTION("an infinite lease never expires") {
+        store.update(lease(3, "home", 0xc0a80002, DhcpLeaseStore::INFINITE_LEASE_TIME, 0), MILLIS);
+        uint8_t data[DhcpLeaseStore::SERIALIZED_SIZE] = {};
+        REQUIRE(store.serialize(data, sizeof(data)) > 0);
+        DhcpLeaseStore restored;
+        REQUIRE(restored.deserialize(data, sizeof(data)) == 0);
+        CHECK_FALSE(restored.isExpired(find(restored, 3, "home"), false, 0, 1000));
+    }
+
+    SECTION("clear() removes all leases") {
+        store.update(lease(3, "home", 0xc0a80002), MILLIS);
+        store.clear();
+        CHECK_FALSE(find(store, 3, "home"));
+    }
+}
@@ -0,0 +1,187 @@
+#include "flash_erase_map.h"
+#include "flash_storage.h"
+#include "system_error.h"
+
+#include "tools/catch.h"
+
+#include <string>
+#include <cstring>
+
+namespace {
+
+const unsigned SECTOR_SIZE = 4096;
+const unsigned SECTOR_COUNT = 8;
+const unsigned BASE = 0x10000;
+const unsigned ERASE_TIME = 50; // Simulated sector erase time in milliseconds
+
+typedef RAMFlashStorage<BASE, SECTOR_COUNT, SECTOR_SIZE> TestFlash;
+
+class TestStorage {
+public:
+    TestStorage() :
+            time_(0),
+            failAt_(0) {
+        flash_erase_map_init(&map_, bits_, SECTOR_COUNT, SECTOR_SIZE, erase, this);
+    }
+
+    int write(unsigned address, const std::string& data) {
+        const int ret = flash_erase_map_prepare(&map_, address, data.size());
+        if (ret < 0) {
+            return ret;
+        }
+        return flash_.write(address, data.data(), data.size());
+    }
+
+    std::string read(unsigned address, size_t size) {
+        std::string s(size, '\0');
+        flash_.read(address, &s[0], size);
+        return s;
+    }
+
+    flash_erase_map* map() {
+        return &map_;
+    }
+
+    int eraseCount() {
+        return flash_.getEraseCount();
+    }
+
+    unsigned time() const {
+        return time_;
+    }
+
+    void failEraseAt(unsigned address) {
+        failAt_ = address;
+    }
+
+private:
+    TestFlash flash_;
+    flash_erase_map map_;
+    uint32_t bits_[FLASH_ERASE_MAP_WORDS(SECTOR_COUNT)];
+    unsigned time_;
+    unsigned failAt_;
+
+    static int erase(uint32_t address, void* ctx) {
+        const auto self = static_cast<TestStorage*>(ctx);
+        if (self->failAt_ && self->failAt_ == address) {
+            return -1;
+        }
+        self->time_ += ERASE_TIME;
+        return self->flash_.eraseSector(address);
+    }
+};
+
+} // namespace
+
+TEST_CASE("flash_erase_map") {
+    TestStorage s;
+
+    SECTION("begin() doesn't erase anything") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, SECTOR_COUNT * SECTOR_SIZE, false) == 0);
+        CHECK(s.eraseCount() == 0);
+        CHECK(s.time() == 0);
+    }
+
+    SECTION("each sector is erased once, before the first write into it") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 3 * SECTOR_SIZE, false) == 0);
+        const std::string chunk(1024, 'a');
+        for (unsigned offs = 0; offs < 2 * SECTOR_SIZE; offs += chunk.size()) {
+            REQUIRE(s.write(BASE + offs, chunk) == 0);
+        }
+        CHECK(s.eraseCount() == 2);
+        CHECK(s.time() == 2 * ERASE_TIME);
+        CHECK(s.read(BASE + SECTOR_SIZE - 2, 4) == "aaaa");
+        CHECK(flash_erase_map_is_erased(s.map(), BASE + SECTOR_SIZE));
+        CHECK_FALSE(flash_erase_map_is_erased(s.map(), BASE + 2 * SECTOR_SIZE));
+    }
+
+    SECTION("a write spanning a sector boundary erases both sectors") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, false) == 0);
+        REQUIRE(s.write(BASE + SECTOR_SIZE - 2, "abcd") == 0);
+        CHECK(s.eraseCount() == 2);
+        CHECK(s.read(BASE + SECTOR_SIZE - 2, 4) == "abcd");
+    }
+
+    SECTION("an unaligned region covers all sectors it overlaps") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE + 100, SECTOR_SIZE, false) == 0);
+        CHECK(s.map()->start == BASE);
+        CHECK(s.map()->sectors == 2);
+        REQUIRE(s.write(BASE + 100 + SECTOR_SIZE - 4, "abcd") == 0);
+        CHECK(s.eraseCount() == 1);
+    }
+
+    SECTION("erase_ahead() erases sectors following the write position") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, false) == 0);
+        REQUIRE(s.write(BASE, "abcd") == 0);
+        CHECK(flash_erase_map_erase_ahead(s.map(), 2) == 2);
+        CHECK(s.eraseCount() == 3);
+        CHECK(flash_erase_map_erase_ahead(s.map(), 2) == 0);
+        // Writing into pre-erased sectors takes no erase time
+        const unsigned t = s.time();
+        REQUIRE(s.write(BASE + SECTOR_SIZE, std::string(SECTOR_SIZE, 'b')) == 0);
+        CHECK(s.time() == t);
+        CHECK(s.eraseCount() == 3);
+        // The remaining sector is never erased past the end of the region
+        CHECK(flash_erase_map_erase_ahead(s.map(), 10) == 1);
+        CHECK(flash_erase_map_erase_ahead(s.map(), 10) == 0);
+        CHECK(s.eraseCount() == 4);
+    }
+
+    SECTION("a resumed transfer doesn't erase the sectors again") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, false) == 0);
+        REQUIRE(s.write(BASE, std::string(SECTOR_SIZE + 10, 'a')) == 0);
+        CHECK(s.eraseCount() == 2);
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, true) == 0);
+        REQUIRE(s.write(BASE + SECTOR_SIZE + 10, "bcd") == 0);
+        CHECK(s.eraseCount() == 2);
+        CHECK(s.read(BASE + SECTOR_SIZE + 8, 5) == "aabcd");
+    }
+
+    SECTION("a transfer resumed after a reset keeps the sectors holding the written data") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, false) == 0);
+        REQUIRE(s.write(BASE, std::string(10, 'a')) == 0);
+        REQUIRE(s.write(BASE + 2 * SECTOR_SIZE, std::string(10, 'c')) == 0);
+        CHECK(s.eraseCount() == 2);
+        // The erase map is lost on reset, the written ranges are known to the caller
+        flash_erase_map_reset(s.map());
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, true) == 0);
+        REQUIRE(flash_erase_map_set_erased(s.map(), BASE, 10) == 0);
+        REQUIRE(flash_erase_map_set_erased(s.map(), BASE + 2 * SECTOR_SIZE, 10) == 0);
+        CHECK(s.map()->next == 3);
+        REQUIRE(s.write(BASE + 10, "bbbb") == 0);
+        REQUIRE(s.write(BASE + SECTOR_SIZE, "dddd") == 0);
+        CHECK(s.eraseCount() == 3);
+        CHECK(s.read(BASE + 8, 6) == "aabbbb");
+        CHECK(s.read(BASE + 2 * SECTOR_SIZE, 4) == "cccc");
+        CHECK(flash_erase_map_set_erased(s.map(), BASE + 4 * SECTOR_SIZE - 1, 2) == SYSTEM_ERROR_OUT_OF_RANGE);
+    }
+
+    SECTION("a new transfer erases the sectors again") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, false) == 0);
+        REQUIRE(s.write(BASE, "aaaa") == 0);
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 4 * SECTOR_SIZE, false) == 0);
+        REQUIRE(s.write(BASE, "bbbb") == 0);
+        CHECK(s.eraseCount() == 2);
+        CHECK(s.read(BASE, 4) == "bbbb");
+        // Resuming a different region also starts over
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 3 * SECTOR_SIZE, true) == 0);
+        CHECK_FALSE(flash_erase_map_is_erased(s.map(), BASE));
+    }
+
+    SECTION("a cancelled transfer doesn't erase the rest of the region") {
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, SECTOR_COUNT * SECTOR_SIZE, false) == 0);
+        REQUIRE(s.write(BASE, std::string(100, 'a')) == 0);
+        flash_erase_map_reset(s.map());
+        CHECK(s.eraseCount() == 1);
+    }
+
+    SECTION("errors") {
+        CHECK(flash_erase_map_begin(s.map(), BASE, 0, false) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(flash_erase_map_begin(s.map(), BASE, SECTOR_COUNT * SECTOR_SIZE + 1, false) == SYSTEM_ERROR_TOO_LARGE);
+        REQUIRE(flash_erase_map_begin(s.map(), BASE, 2 * SECTOR_SIZE, false) == 0);
+        CHECK(s.write(BASE + 2 * SECTOR_SIZE - 1, "ab") == SYSTEM_ERROR_OUT_OF_RANGE);
+        s.failEraseAt(BASE + SECTOR_SIZE);
+        CHECK(s.write(BASE + SECTOR_SIZE, "ab") == SYSTEM_ERROR_IO);
+        CHECK_FALSE(flash_erase_map_is_erased(s.map(), BASE + SECTOR_SIZE));
+    }
+}
@@ -0,0 +1,187 @@
+#include "functions.h"
+
+#include "tools/message_channel.h"
+#include "tools/catch.h"
+
+#include <string>
+#include <map>
+
+namespace {
+
+using namespace particle::protocol;
+
+using test::LoopbackChannel;
+
+// Registry of functions that either return immediately or complete later
+struct FunctionRegistry {
+    std::map<std::string, int> results;
+    std::string lastArg;
+    SparkDescriptor::FunctionResultCallback callback;
+    bool async = false;
+};
+
+FunctionRegistry g_registry;
+
+int callFunction(const char* key, const char* arg, SparkDescriptor::FunctionResultCallback callback, void* reserved) {
+    const auto it = g_registry.results.find(key);
+    if (it == g_registry.results.end()) {
+        return -1;
+    }
+    g_registry.lastArg = arg;
+    if (g_registry.async) {
+        g_registry.callback = callback;
+    } else {
+        callback((const void*)long(it->second), SparkReturnType::INT);
+    }
+    return 0;
+}
+
+// Function call request: CON POST /f/<key>?<arg>
+std::string functionCall(message_id_t id, token_t token, const std::string& key, const std::string& arg) {
+    std::string s;
+    s += (char)0x41; // CON, one-byte token
+    s += (char)0x02; // POST
+    s += (char)(id >> 8);
+    s += (char)(id & 0xff);
+    s += (char)token;
+    s += "\xb1" "f"; // Uri-Path
+    s += (char)key.size(); // Uri-Path
+    s += key;
+    s += (char)(0x40 | arg.size()); // Uri-Query
+    s += arg;
+    return s;
+}
+
+std::string piggybackedResult(message_id_t id, token_t token, int result) {
+    uint8_t buf[32];
+    uint8_t data[4] = { uint8_t(result >> 24), uint8_t(result >> 16), uint8_t(result >> 8), uint8_t(result) };
+    const size_t n = Messages::coded_ack(buf, token, CoAPCode::CHANGED, id >> 8, id & 0xff, data, sizeof(data));
+    return std::string((const char*)buf, n);
+}
+
+std::string separateResult(message_id_t id, token_t token, int result) {
+    uint8_t buf[32];
+    const size_t n = Messages::function_return(buf, id, token, result, true /* confirmable */);
+    return std::string((const char*)buf, n);
+}
+
+std::string emptyAck(message_id_t id) {
+    uint8_t buf[4];
+    const size_t n = Messages::empty_ack(buf, id >> 8, id & 0xff);
+    return std::string((const char*)buf, n);
+}
+
+class FunctionCaller {
+public:
+    explicit FunctionCaller(Functions& functions, LoopbackChannel& channel) :
+            functions_(functions),
+            channel_(channel) {
+    }
+
+    ProtocolError call(message_id_t id, token_t token, const std::string& key, const std::string& arg, system_tick_t now) {
+        channel_.push(functionCall(id, token, key, arg));
+        Message msg;
+        channel_.receive(msg);
+        return functions_.handle_function_call(token, id, msg, channel_, callFunction, now);
+    }
+
+private:
+    Functions& functions_;
+    LoopbackChannel& channel_;
+};
+
+} // namespace
+
+TEST_CASE("Functions") {
+    g_registry = FunctionRegistry();
+    g_registry.results["fast"] = 42;
+    g_registry.results["slow"] = -7;
+    Functions functions;
+    LoopbackChannel channel;
+    FunctionCaller caller(functions, channel);
+
+    SECTION("the result is sent in the ACK if the function completes immediately") {
+        CHECK(caller.call(0x1234, 0x55, "fast", "arg", 0) == NO_ERROR);
+        CHECK(g_registry.lastArg == "arg");
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == piggybackedResult(0x1234, 0x55, 42));
+        // Nothing else is sent later
+        functions.process(channel, 1000);
+        CHECK(channel.sent().size() == 1);
+    }
+
+    SECTION("the result is sent in the ACK if the function completes before the deadline") {
+        g_registry.async = true;
+        CHECK(caller.call(0x1234, 0x55, "slow", "", 0) == NO_ERROR);
+        CHECK(channel.sent().empty());
+        functions.process(channel, Functions::DEFAULT_RESPONSE_DEADLINE - 1);
+        CHECK(channel.sent().empty());
+        g_registry.callback((const void*)long(-7), SparkReturnType::INT);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == piggybackedResult(0x1234, 0x55, -7));
+    }
+
+    SECTION("the result is sent separately if the function doesn't complete before the deadline") {
+        g_registry.async = true;
+        CHECK(caller.call(0x1234, 0x55, "slow", "", 100) == NO_ERROR);
+        functions.process(channel, 100 + Functions::DEFAULT_RESPONSE_DEADLINE);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == emptyAck(0x1234));
+        g_registry.callback((const void*)long(-7), SparkReturnType::INT);
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(channel.sent()[1] == separateResult(1, 0x55, -7));
+    }
+
+    SECTION("the ACK is not deferred if the deadline is 0") {
+        functions.set_response_deadline(0);
+        g_registry.async = true;
+        CHECK(caller.call(0x1234, 0x55, "slow", "", 0) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == emptyAck(0x1234));
+        // Results available immediately are still piggybacked
+        g_registry.async = false;
+        CHECK(caller.call(0x1235, 0x56, "fast", "", 0) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(channel.sent()[1] == piggybackedResult(0x1235, 0x56, 42));
+    }
+
+    SECTION("the deadline is limited so that the server doesn't retransmit the request") {
+        const system_tick_t maxDeadline = Functions::MAX_RESPONSE_DEADLINE;
+        CHECK(maxDeadline < 2000); // CoAP's ACK timeout
+        functions.set_response_deadline(maxDeadline - 1);
+        CHECK(functions.get_response_deadline() == maxDeadline - 1);
+        functions.set_response_deadline(2000);
+        CHECK(functions.get_response_deadline() == maxDeadline);
+        functions.set_response_deadline(0xffffffff);
+        CHECK(functions.get_response_deadline() == maxDeadline);
+        g_registry.async = true;
+        CHECK(caller.call(0x1234, 0x55, "slow", "", 0) == NO_ERROR);
+        functions.process(channel, maxDeadline - 1);
+        CHECK(channel.sent().empty());
+        functions.process(channel, maxDeadline);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == emptyAck(0x1234));
+    }
+
+    SECTION("a deferred ACK is sent when another function call is received") {
+        g_registry.async = true;
+        CHECK(caller.call(0x1234, 0x55, "slow", "", 0) == NO_ERROR);
+        SparkDescriptor::FunctionResultCallback first = g_registry.callback;
+        CHECK(caller.call(0x1235, 0x56, "slow", "", 0) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == emptyAck(0x1234));
+        first((const void*)long(1), SparkReturnType::INT);
+        g_registry.callback((const void*)long(2), SparkReturnType::INT);
+        REQUIRE(channel.sent().size() == 3);
+        CHECK(channel.sent()[1] == separateResult(1, 0x55, 1));
+        CHECK(channel.sent()[2] == piggybackedResult(0x1235, 0x56, 2));
+    }
+
+    SECTION("a deferred ACK is discarded when the session is reset") {
+        g_registry.async = true;
+        CHECK(caller.call(0x1234, 0x55, "slow", "", 0) == NO_ERROR);
+        functions.reset();
+        functions.process(channel, 1000);
+        CHECK(channel.sent().empty());
+    }
+}
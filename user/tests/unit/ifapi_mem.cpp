@@ -0,0 +1,318 @@
+#include "ifapi.h"
+#include "system_error.h"
+
+#include <lwip/stats.h>
+#include <lwip/memp.h>
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <climits>
+#include <cstdlib>
+#include <cstddef>
+#include <iterator>
+
+// Pool descriptors and stats of lwIP, see stubs/lwip/priv/memp_std.h
+#define LWIP_MEMPOOL(name, num, size, desc) \
+        stats_mem memp_stats_##name = {}; \
+        const memp_desc memp_##name = { &memp_stats_##name, LWIP_MEM_ALIGN_SIZE(size) };
+#include <lwip/priv/memp_std.h>
+
+const memp_desc* const memp_pools[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name, num, size, desc) &memp_##name,
+#include <lwip/priv/memp_std.h>
+};
+
+struct stats_ lwip_stats = {};
+
+namespace {
+
+const size_t MEM_STATS_HEADER_SIZE = LWIP_MEM_ALIGN_SIZE(sizeof(mem_size_t));
+
+void updateStats(stats_mem* st, mem_size_t used) {
+    st->used = used;
+    if (st->used > st->max) {
+        st->max = st->used;
+    }
+}
+
+// mem_malloc() with MEM_LIBC_MALLOC and MEM_STATS
+void* memMalloc(size_t size) {
+    const auto p = (char*)lwip_hook_mem_malloc(size + MEM_STATS_HEADER_SIZE);
+    if (!p) {
+        ++lwip_stats.mem.err;
+        return nullptr;
+    }
+    *(mem_size_t*)p = size;
+    updateStats(&lwip_stats.mem, lwip_stats.mem.used + size);
+    return p + MEM_STATS_HEADER_SIZE;
+}
+
+void memFree(void* ptr) {
+    const auto p = (char*)ptr - MEM_STATS_HEADER_SIZE;
+    lwip_stats.mem.used -= *(mem_size_t*)p;
+    free(p);
+}
+
+// memp_malloc() with MEMP_MEM_MALLOC and MEMP_STATS
+void* mempMalloc(memp_t type) {
+    const auto desc = memp_pools[type];
+    const auto p = memMalloc(MEMP_SIZE + MEMP_ALIGN_SIZE(desc->size));
+    if (!p) {
+        ++desc->stats->err;
+        return nullptr;
+    }
+    updateStats(desc->stats, desc->stats->used + 1);
+    return p;
+}
+
+void mempFree(memp_t type, void* p) {
+    --memp_pools[type]->stats->used;
+    memFree(p);
+}
+
+class MemTest {
+public:
+    MemTest() {
+        lwip_stats.mem = {};
+        for (int i = 0; i < MEMP_MAX; ++i) {
+            *memp_pools[i]->stats = {};
+            lwip_stats.memp[i] = memp_pools[i]->stats;
+        }
+        defaultProfile.size = sizeof(defaultProfile);
+        REQUIRE(if_get_mem_profile(&defaultProfile, nullptr) == 0);
+    }
+
+    ~MemTest() {
+        for (const auto& a: allocs_) {
+            if (a.type == MEMP_MAX) {
+                memFree(a.ptr);
+            } else {
+                mempFree(a.type, a.ptr);
+            }
+        }
+        if_set_mem_profile(&defaultProfile, nullptr);
+    }
+
+    int alloc(memp_t type, int count) {
+        int n = 0;
+        for (int i = 0; i < count; ++i) {
+            const auto p = mempMalloc(type);
+            if (p) {
+                allocs_.push_back({ type, p });
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    bool allocHeap(size_t size) {
+        const auto p = memMalloc(size);
+        if (!p) {
+            return false;
+        }
+        allocs_.push_back({ MEMP_MAX, p });
+        return true;
+    }
+
+    // Releases the most recent allocation of the given type
+    void release(memp_t type) {
+        for (auto it = allocs_.rbegin(); it != allocs_.rend(); ++it) {
+            if (it->type == type) {
+                mempFree(type, it->ptr);
+                allocs_.erase(std::next(it).base());
+                return;
+            }
+        }
+    }
+
+    if_mem_profile defaultProfile = {};
+
+private:
+    struct Alloc {
+        memp_t type;
+        void* ptr;
+    };
+
+    std::vector<Alloc> allocs_;
+};
+
+if_mem_profile profileWithPoolLimit(const if_mem_profile& profile, int pool, uint16_t limit) {
+    if_mem_profile p = profile;
+    p.pool_limits[pool] = limit;
+    return p;
+}
+
+} // namespace
+
+TEST_CASE("if_set_mem_profile()") {
+    MemTest t;
+    if_mem_profile p = t.defaultProfile;
+
+    SECTION("the pool limits default to the compile-time pool sizes") {
+        CHECK(p.heap_limit == 0);
+        CHECK(p.pool_limits[IF_MEM_POOL_HEAP] == 0);
+        CHECK(p.pool_limits[IF_MEM_POOL_PBUF] == 16);
+        CHECK(p.pool_limits[IF_MEM_POOL_PBUF_REF] == 16);
+        CHECK(p.pool_limits[IF_MEM_POOL_TCP_PCB] == 5);
+        CHECK(p.pool_limits[IF_MEM_POOL_TCP_SEG] == 16);
+        CHECK(p.pool_limits[IF_MEM_POOL_UDP_PCB] == 8);
+    }
+
+    SECTION("the profile can be read back") {
+        p.heap_limit = 20000;
+        p.socket_recv_quota = 4096;
+        p.tcp_ooseq_quota = 4;
+        p.pool_limits[IF_MEM_POOL_PBUF] = 8;
+        p.pool_limits[IF_MEM_POOL_TCP_SEG] = 0;
+        REQUIRE(if_set_mem_profile(&p, nullptr) == 0);
+        if_mem_profile p2 = {};
+        p2.size = sizeof(p2);
+        REQUIRE(if_get_mem_profile(&p2, nullptr) == 0);
+        CHECK(p2.heap_limit == 20000);
+        CHECK(p2.socket_recv_quota == 4096);
+        CHECK(p2.tcp_ooseq_quota == 4);
+        CHECK(p2.pool_limits[IF_MEM_POOL_PBUF] == 8);
+        CHECK(p2.pool_limits[IF_MEM_POOL_TCP_SEG] == 0);
+        CHECK(p2.pool_limits[IF_MEM_POOL_TCP_PCB] == 5);
+        CHECK(lwip_hook_recv_bufsize_default() == 4096);
+        CHECK(lwip_hook_tcp_ooseq_pbufs_limit(nullptr) == 4);
+    }
+
+    SECTION("the quotas are not limited by default") {
+        CHECK(lwip_hook_recv_bufsize_default() == INT_MAX);
+        CHECK(lwip_hook_tcp_ooseq_pbufs_limit(nullptr) == 0xffff);
+    }
+
+    SECTION("invalid arguments are rejected") {
+        const int einval = SYSTEM_ERROR_INVALID_ARGUMENT;
+        CHECK(if_set_mem_profile(nullptr, nullptr) == einval);
+        CHECK(if_get_mem_profile(nullptr, nullptr) == einval);
+        p.size = offsetof(if_mem_profile, pool_limits);
+        CHECK(if_set_mem_profile(&p, nullptr) == einval);
+        CHECK(if_get_mem_profile(&p, nullptr) == einval);
+        p = t.defaultProfile;
+        p.socket_recv_quota = (uint32_t)INT_MAX + 1;
+        CHECK(if_set_mem_profile(&p, nullptr) == einval);
+        p = t.defaultProfile;
+        p.tcp_ooseq_quota = 0xffff;
+        CHECK(if_set_mem_profile(&p, nullptr) == einval);
+        p = profileWithPoolLimit(t.defaultProfile, IF_MEM_POOL_HEAP, 100);
+        CHECK(if_set_mem_profile(&p, nullptr) == einval);
+        // The profile is not changed
+        if_mem_profile p2 = {};
+        p2.size = sizeof(p2);
+        REQUIRE(if_get_mem_profile(&p2, nullptr) == 0);
+        CHECK(p2.pool_limits[IF_MEM_POOL_HEAP] == 0);
+        CHECK(p2.tcp_ooseq_quota == t.defaultProfile.tcp_ooseq_quota);
+    }
+}
+
+TEST_CASE("if_get_mem_pool_stats()") {
+    MemTest t;
+    if_mem_pool_stats st = {};
+    st.size = sizeof(st);
+
+    SECTION("the usage of a pool is reported") {
+        REQUIRE(t.alloc(MEMP_TCP_PCB, 3) == 3);
+        t.release(MEMP_TCP_PCB);
+        REQUIRE(if_get_mem_pool_stats(IF_MEM_POOL_TCP_PCB, &st, nullptr) == 0);
+        CHECK(st.avail == 5);
+        CHECK(st.used == 2);
+        CHECK(st.peak == 3);
+        CHECK(st.failures == 0);
+    }
+
+    SECTION("the usage of the heap includes the pools") {
+        REQUIRE(t.allocHeap(100));
+        REQUIRE(t.alloc(MEMP_UDP_PCB, 1) == 1);
+        REQUIRE(if_get_mem_pool_stats(IF_MEM_POOL_HEAP, &st, nullptr) == 0);
+        CHECK(st.avail == 0);
+        CHECK(st.used == 100 + 64);
+    }
+
+    SECTION("a smaller structure is filled in partially") {
+        REQUIRE(t.alloc(MEMP_TCP_SEG, 1) == 1);
+        st.size = offsetof(if_mem_pool_stats, used);
+        st.used = 1000;
+        REQUIRE(if_get_mem_pool_stats(IF_MEM_POOL_TCP_SEG, &st, nullptr) == 0);
+        CHECK(st.avail == 16);
+        CHECK(st.used == 1000);
+    }
+
+    SECTION("invalid arguments are rejected") {
+        CHECK(if_get_mem_pool_stats(IF_MEM_POOL_PBUF, nullptr, nullptr) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK(if_get_mem_pool_stats(IF_MEM_POOL_COUNT, &st, nullptr) == SYSTEM_ERROR_NOT_SUPPORTED);
+        CHECK(if_get_mem_pool_stats(-1, &st, nullptr) == SYSTEM_ERROR_NOT_SUPPORTED);
+    }
+}
+
+TEST_CASE("lwip_hook_mem_malloc()") {
+    MemTest t;
+    if_mem_pool_stats st = {};
+    st.size = sizeof(st);
+
+    SECTION("allocations fail once the heap limit is reached") {
+        if_mem_profile p = t.defaultProfile;
+        p.heap_limit = 1000;
+        REQUIRE(if_set_mem_profile(&p, nullptr) == 0);
+        CHECK(t.allocHeap(500));
+        CHECK(t.allocHeap(400));
+        CHECK_FALSE(t.allocHeap(200));
+        // The heap limit applies to the pools as well
+        CHECK(t.alloc(MEMP_UDP_PCB, 2) == 1);
+        REQUIRE(if_get_mem_pool_stats(IF_MEM_POOL_HEAP, &st, nullptr) == 0);
+        CHECK(st.avail == 1000);
+        CHECK(st.failures == 2);
+        REQUIRE(if_get_mem_pool_stats(IF_MEM_POOL_UDP_PCB, &st, nullptr) == 0);
+        CHECK(st.failures == 1);
+    }
+
+    SECTION("pool elements are limited to the compile-time pool sizes by default") {
+        CHECK(t.alloc(MEMP_TCP_PCB, 10) == 5);
+        REQUIRE(if_get_mem_pool_stats(IF_MEM_POOL_TCP_PCB, &st, nullptr) == 0);
+        CHECK(st.used == 5);
+        CHECK(st.failures == 5);
+        // Allocations of other sizes are not affected
+        CHECK(t.alloc(MEMP_TCP_SEG, 1) == 1);
+        CHECK(t.allocHeap(150));
+        t.release(MEMP_TCP_PCB);
+        CHECK(t.alloc(MEMP_TCP_PCB, 1) == 1);
+    }
+
+    SECTION("the split between the pools can be changed") {
+        auto p = profileWithPoolLimit(t.defaultProfile, IF_MEM_POOL_TCP_PCB, 8);
+        p.pool_limits[IF_MEM_POOL_PBUF] = 2;
+        REQUIRE(if_set_mem_profile(&p, nullptr) == 0);
+        CHECK(t.alloc(MEMP_TCP_PCB, 10) == 8);
+        CHECK(t.alloc(MEMP_PBUF_POOL, 10) == 2);
+        REQUIRE(if_get_mem_pool_stats(IF_MEM_POOL_PBUF, &st, nullptr) == 0);
+        CHECK(st.avail == 2);
+        CHECK(st.failures == 8);
+    }
+
+    SECTION("a pool with no limit is only limited by the heap") {
+        const auto p = profileWithPoolLimit(t.defaultProfile, IF_MEM_POOL_TCP_SEG, 0);
+        REQUIRE(if_set_mem_profile(&p, nullptr) == 0);
+        CHECK(t.alloc(MEMP_TCP_SEG, 100) == 100);
+    }
+
+    SECTION("a pool above its new limit is not shrunk") {
+        REQUIRE(t.alloc(MEMP_UDP_PCB, 4) == 4);
+        const auto p = profileWithPoolLimit(t.defaultProfile, IF_MEM_POOL_UDP_PCB, 2);
+        REQUIRE(if_set_mem_profile(&p, nullptr) == 0);
+        CHECK(t.alloc(MEMP_UDP_PCB, 1) == 0);
+        t.release(MEMP_UDP_PCB);
+        t.release(MEMP_UDP_PCB);
+        t.release(MEMP_UDP_PCB);
+        CHECK(t.alloc(MEMP_UDP_PCB, 2) == 1);
+    }
+
+    SECTION("pools with elements of the same size share the sum of their limits") {
+        // PBUF and SYS_TIMEOUT elements have the same size
+        const auto p = profileWithPoolLimit(t.defaultProfile, IF_MEM_POOL_PBUF_REF, 2);
+        REQUIRE(if_set_mem_profile(&p, nullptr) == 0);
+        CHECK(t.alloc(MEMP_SYS_TIMEOUT, 10) == 10);
+        CHECK(t.alloc(MEMP_PBUF, 10) == 2);
+    }
+}
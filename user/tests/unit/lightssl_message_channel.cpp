@@ -0,0 +1,261 @@
+// Logging is not needed here. Disabling it also keeps this file from instantiating the global
+// log category, which logging.cpp overrides with LOG_SOURCE_CATEGORY()
+#define LOG_DISABLE
+
+#include "lightssl_message_channel.h"
+#include "mbedtls/aes.h"
+
+#include "tools/catch.h"
+
+#include <deque>
+#include <string>
+
+namespace {
+
+using namespace particle::protocol;
+
+const size_t NONCE_SIZE = 40;
+const size_t KEY_MESSAGE_SIZE = 384;
+const size_t ENCRYPTED_NONCE_SIZE = 256;
+
+const char DEVICE_ID[] = "0123456789ab";
+
+// TCP peer that delivers scripted data, at most one fragment per receive() call. An empty
+// fragment makes receive() return no data, as a non-blocking socket would
+class ScriptedPeer {
+public:
+    ScriptedPeer() :
+            now_(1000) {
+        instance = this;
+    }
+
+    ~ScriptedPeer() {
+        instance = nullptr;
+    }
+
+    void deliver(const std::string& data) {
+        fragments_.push_back(data);
+    }
+
+    void wouldBlock() {
+        fragments_.push_back(std::string());
+    }
+
+    bool done() const {
+        return fragments_.empty();
+    }
+
+    const std::string& sent() const {
+        return sent_;
+    }
+
+    void advanceTime(system_tick_t ms) {
+        now_ += ms;
+    }
+
+    LightSSLMessageChannel::Callbacks callbacks() const {
+        LightSSLMessageChannel::Callbacks cb = {};
+        cb.millis = millis;
+        cb.send = send;
+        cb.receive = receive;
+        return cb;
+    }
+
+private:
+    std::deque<std::string> fragments_;
+    std::string sent_;
+    system_tick_t now_;
+
+    static ScriptedPeer* instance;
+
+    static system_tick_t millis() {
+        return instance->now_;
+    }
+
+    static int send(const unsigned char* buf, uint32_t len, void* handle) {
+        instance->sent_.append((const char*)buf, len);
+        return len;
+    }
+
+    static int receive(unsigned char* buf, uint32_t len, void* handle) {
+        auto& fragments = instance->fragments_;
+        if (fragments.empty()) {
+            return 0;
+        }
+        auto& f = fragments.front();
+        const size_t n = std::min((size_t)len, f.size());
+        memcpy(buf, f.data(), n);
+        f.erase(0, n);
+        if (f.empty()) {
+            fragments.pop_front();
+        }
+        return n;
+    }
+};
+
+ScriptedPeer* ScriptedPeer::instance = nullptr;
+
+// Session credentials: AES key, IV and salt
+std::string credentials() {
+    std::string s;
+    for (size_t i = 0; i < 40; ++i) {
+        s += (char)(i + 1);
+    }
+    return s;
+}
+
+std::string keyMessage(bool validSignature = true) {
+    std::string s = credentials();
+    s.resize(KEY_MESSAGE_SIZE, '\0');
+    s[128] = validSignature ? 0x00 : 0xff;
+    return s;
+}
+
+// Encrypts a record the way the server does: PKCS#7 padding, AES-CBC and a 2-byte length prefix
+std::string record(const std::string& data, unsigned char* iv) {
+    const auto creds = credentials();
+    std::string s = data;
+    const size_t pad = 16 - s.size() % 16;
+    s.append(pad, (char)pad);
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, (const unsigned char*)creds.data(), 128);
+    unsigned char cbc_iv[16];
+    memcpy(cbc_iv, iv, 16);
+    mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_ENCRYPT, s.size(), cbc_iv, (const unsigned char*)s.data(), (unsigned char*)&s[0]);
+    // The first block of a record is the IV of the next one
+    memcpy(iv, s.data(), 16);
+    std::string r;
+    r += (char)(s.size() >> 8);
+    r += (char)(s.size() & 0xff);
+    return r + s;
+}
+
+void init(LightSSLMessageChannel& channel, const ScriptedPeer& peer, message_id_t* counter) {
+    static uint8_t privateKey[MAX_DEVICE_PRIVATE_KEY_LENGTH] = {};
+    static uint8_t publicKey[MAX_SERVER_PUBLIC_KEY_LENGTH] = {};
+    auto cb = peer.callbacks();
+    channel.init(privateKey, publicKey, (const uint8_t*)DEVICE_ID, cb, counter);
+}
+
+ProtocolError establish(LightSSLMessageChannel& channel) {
+    uint32_t flags = 0;
+    return channel.establish(flags, 0);
+}
+
+} // namespace
+
+TEST_CASE("LightSSLMessageChannel") {
+    ScriptedPeer peer;
+    LightSSLMessageChannel channel;
+    message_id_t counter = 0;
+    init(channel, peer, &counter);
+    const std::string nonce(NONCE_SIZE, 'n');
+
+    SECTION("the handshake is performed in non-blocking steps") {
+        peer.wouldBlock();
+        peer.deliver(nonce.substr(0, 10));
+        peer.wouldBlock();
+        peer.deliver(nonce.substr(10));
+        peer.deliver(keyMessage().substr(0, 100));
+        peer.wouldBlock();
+        peer.deliver(keyMessage().substr(100));
+
+        CHECK(establish(channel) == HANDSHAKE_PENDING); // No data
+        CHECK(establish(channel) == HANDSHAKE_PENDING); // 10 bytes of the nonce
+        CHECK(establish(channel) == HANDSHAKE_PENDING); // No data
+        CHECK(peer.sent().empty());
+        // The rest of the nonce is received and the encrypted nonce is sent in the same step
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        CHECK(peer.sent().size() == ENCRYPTED_NONCE_SIZE);
+        CHECK(peer.sent().substr(0, NONCE_SIZE) == nonce);
+        CHECK(peer.sent().substr(NONCE_SIZE, 12) == DEVICE_ID);
+        CHECK(establish(channel) == HANDSHAKE_PENDING); // 100 bytes of the key
+        CHECK(establish(channel) == HANDSHAKE_PENDING); // No data
+        CHECK(establish(channel) == NO_ERROR);
+        CHECK(peer.done());
+        // The message ID counter is initialized from the salt
+        CHECK(counter == (message_id_t)(33 | 34 << 8));
+    }
+
+    SECTION("the handshake fails if the server doesn't respond in time") {
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        peer.advanceTime(10000);
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        peer.advanceTime(10001);
+        CHECK(establish(channel) == IO_ERROR_LIGHTSSL_HANDSHAKE_NONCE);
+        // The next call starts a new handshake
+        peer.deliver(nonce);
+        peer.deliver(keyMessage());
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        CHECK(establish(channel) == NO_ERROR);
+    }
+
+    SECTION("the handshake fails if the session key is not signed by the server") {
+        peer.deliver(nonce);
+        peer.deliver(keyMessage(false /* validSignature */));
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        CHECK(establish(channel) == AUTHENTICATION_ERROR);
+    }
+
+    SECTION("closing the channel discards an incomplete handshake") {
+        peer.deliver(nonce.substr(0, 20));
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        channel.command(MessageChannel::CLOSE);
+        peer.deliver(nonce);
+        peer.deliver(keyMessage());
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        CHECK(peer.sent().substr(0, NONCE_SIZE) == nonce);
+        CHECK(establish(channel) == NO_ERROR);
+    }
+
+    SECTION("records that arrive in fragments are reassembled") {
+        peer.deliver(nonce);
+        peer.deliver(keyMessage());
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        REQUIRE(establish(channel) == NO_ERROR);
+
+        unsigned char iv[16];
+        memcpy(iv, credentials().data() + 16, 16);
+        const auto r1 = record("hello, this record spans several fragments", iv);
+        const auto r2 = record("world", iv);
+        peer.deliver(r1.substr(0, 1));
+        peer.deliver(r1.substr(1, 1));
+        peer.wouldBlock();
+        peer.deliver(r1.substr(2, 7));
+        peer.deliver(r1.substr(9));
+        peer.deliver(r2);
+
+        std::string received;
+        unsigned calls = 0;
+        while (received.empty() && calls < 10) {
+            Message m;
+            REQUIRE(channel.receive(m) == NO_ERROR);
+            received = std::string((const char*)m.buf(), m.length());
+            ++calls;
+        }
+        CHECK(calls == 4);
+        CHECK(received == "hello, this record spans several fragments");
+
+        Message m;
+        REQUIRE(channel.receive(m) == NO_ERROR);
+        CHECK(std::string((const char*)m.buf(), m.length()) == "world");
+        CHECK(peer.done());
+    }
+
+    SECTION("an incomplete record times out") {
+        peer.deliver(nonce);
+        peer.deliver(keyMessage());
+        CHECK(establish(channel) == HANDSHAKE_PENDING);
+        REQUIRE(establish(channel) == NO_ERROR);
+
+        unsigned char iv[16];
+        memcpy(iv, credentials().data() + 16, 16);
+        peer.deliver(record("hello", iv).substr(0, 10));
+        Message m;
+        CHECK(channel.receive(m) == NO_ERROR);
+        CHECK(m.length() == 0);
+        peer.advanceTime(20001);
+        CHECK(channel.receive(m) == IO_ERROR_LIGHTSSL_BLOCKING_RECEIVE);
+    }
+}
@@ -0,0 +1,144 @@
+#include "module_integrity_cache.h"
+#include "module_info.h"
+
+#include "tools/catch.h"
+
+#include <vector>
+#include <cstring>
+
+namespace {
+
+typedef particle::ModuleIntegrityCache<4> IntegrityCache;
+
+// In-memory flash image containing a single module
+class FlashImage {
+public:
+    explicit FlashImage(size_t size) :
+            data_(sizeof(module_info_t) + size + sizeof(module_info_suffix_t) + sizeof(module_info_crc_t)),
+            verifyCount_(0) {
+        for (size_t i = 0; i < data_.size(); ++i) {
+            data_[i] = (uint8_t)i;
+        }
+    }
+
+    uint32_t length() const {
+        return data_.size() - sizeof(module_info_crc_t);
+    }
+
+    uint32_t fingerprint() const {
+        const size_t suffixOffs = length() - sizeof(module_info_suffix_t);
+        uint32_t fp = IntegrityCache::fingerprint(data_.data(), sizeof(module_info_t));
+        return IntegrityCache::fingerprint(data_.data() + suffixOffs, data_.size() - suffixOffs, fp);
+    }
+
+    // Simulates a full CRC check of the image
+    bool verify() {
+        ++verifyCount_;
+        return !corrupted_;
+    }
+
+    bool verifyCached(IntegrityCache& cache, uint32_t address) {
+        bool valid = false;
+        if (cache.find(address, length(), fingerprint(), &valid)) {
+            return valid;
+        }
+        const uint32_t gen = cache.generation();
+        valid = verify();
+        cache.add(address, length(), fingerprint(), valid, gen);
+        return valid;
+    }
+
+    void write(size_t offset, uint8_t value) {
+        data_.at(offset) = value;
+    }
+
+    void corrupt(bool corrupted) {
+        corrupted_ = corrupted;
+    }
+
+    unsigned verifyCount() const {
+        return verifyCount_;
+    }
+
+private:
+    std::vector<uint8_t> data_;
+    unsigned verifyCount_;
+    bool corrupted_ = false;
+};
+
+} // namespace
+
+TEST_CASE("ModuleIntegrityCache") {
+    IntegrityCache cache;
+    FlashImage flash(1024);
+
+    SECTION("the result of a check is reused") {
+        CHECK(flash.verifyCached(cache, 0x1000));
+        CHECK(flash.verifyCached(cache, 0x1000));
+        CHECK(flash.verifyCached(cache, 0x1000));
+        CHECK(flash.verifyCount() == 1);
+    }
+
+    SECTION("failed checks are cached too") {
+        flash.corrupt(true);
+        CHECK_FALSE(flash.verifyCached(cache, 0x1000));
+        CHECK_FALSE(flash.verifyCached(cache, 0x1000));
+        CHECK(flash.verifyCount() == 1);
+    }
+
+    SECTION("results are cached per module address") {
+        flash.verifyCached(cache, 0x1000);
+        flash.verifyCached(cache, 0x2000);
+        CHECK(flash.verifyCount() == 2);
+        flash.verifyCached(cache, 0x1000);
+        flash.verifyCached(cache, 0x2000);
+        CHECK(flash.verifyCount() == 2);
+    }
+
+    SECTION("a change in the module header or suffix discards the cached result") {
+        flash.verifyCached(cache, 0x1000);
+        flash.write(0, 0xff); // Header
+        flash.verifyCached(cache, 0x1000);
+        CHECK(flash.verifyCount() == 2);
+        flash.write(flash.length() - 1, 0xff); // Suffix
+        flash.verifyCached(cache, 0x1000);
+        CHECK(flash.verifyCount() == 3);
+        flash.write(flash.length(), 0xff); // CRC
+        flash.verifyCached(cache, 0x1000);
+        CHECK(flash.verifyCount() == 4);
+        // Changes in the module body are not detected without invalidating the cache
+        flash.write(sizeof(module_info_t), 0xff);
+        flash.verifyCached(cache, 0x1000);
+        CHECK(flash.verifyCount() == 4);
+    }
+
+    SECTION("invalidation discards all cached results") {
+        flash.verifyCached(cache, 0x1000);
+        flash.verifyCached(cache, 0x2000);
+        cache.invalidate();
+        flash.corrupt(true);
+        CHECK_FALSE(flash.verifyCached(cache, 0x1000));
+        CHECK_FALSE(flash.verifyCached(cache, 0x2000));
+        CHECK(flash.verifyCount() == 4);
+    }
+
+    SECTION("results of checks started before invalidation are discarded") {
+        const uint32_t gen = cache.generation();
+        cache.invalidate();
+        cache.add(0x1000, flash.length(), flash.fingerprint(), true, gen);
+        bool valid = false;
+        CHECK_FALSE(cache.find(0x1000, flash.length(), flash.fingerprint(), &valid));
+    }
+
+    SECTION("the oldest entry is replaced when the cache is full") {
+        for (uint32_t addr = 0x1000; addr <= 0x5000; addr += 0x1000) {
+            flash.verifyCached(cache, addr);
+        }
+        CHECK(flash.verifyCount() == 5);
+        flash.verifyCached(cache, 0x5000);
+        flash.verifyCached(cache, 0x2000);
+        CHECK(flash.verifyCount() == 5);
+        flash.verifyCached(cache, 0x1000);
+        CHECK(flash.verifyCount() == 6);
+    }
+}
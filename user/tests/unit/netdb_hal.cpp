@@ -0,0 +1,291 @@
+#include "netdb_hal.h"
+#include "system_threading.h"
+
+#include <lwip/dns.h>
+
+#include "tools/catch.h"
+
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <string>
+
+namespace {
+
+// TCP/IP core lock
+std::recursive_mutex g_lock;
+int g_lockDepth = 0;
+bool g_lockReentered = false;
+
+struct PendingQuery {
+    std::string name;
+    u8_t type;
+    dns_found_callback found;
+    void* arg;
+};
+
+// DNS resolver
+std::vector<PendingQuery> g_pending;
+std::map<std::string, std::string> g_ipv4;
+std::map<std::string, std::string> g_ipv6;
+bool g_cached = false;
+
+bool lookup(const std::string& name, u8_t type, ip_addr_t* addr) {
+    const auto& table = (type == LWIP_DNS_ADDRTYPE_IPV6) ? g_ipv6 : g_ipv4;
+    const auto it = table.find(name);
+    if (it == table.end()) {
+        return false;
+    }
+    memset(addr, 0, sizeof(ip_addr_t));
+    addr->type = (type == LWIP_DNS_ADDRTYPE_IPV6) ? IPADDR_TYPE_V6 : IPADDR_TYPE_V4;
+    return inet_pton(IP_IS_V6(addr) ? AF_INET6 : AF_INET, it->second.c_str(), &addr->u_addr) == 1;
+}
+
+// Completes the pending DNS queries the way the TCP/IP thread does
+void resolvePendingQueries() {
+    std::vector<PendingQuery> pending;
+    {
+        std::lock_guard<std::recursive_mutex> lk(g_lock);
+        pending.swap(g_pending);
+    }
+    for (const auto& q: pending) {
+        sys_lock_tcpip_core();
+        ip_addr_t addr = {};
+        const bool found = lookup(q.name, q.type, &addr);
+        q.found(q.name.c_str(), found ? &addr : nullptr, q.arg);
+        sys_unlock_tcpip_core();
+    }
+}
+
+size_t pendingQueryCount() {
+    std::lock_guard<std::recursive_mutex> lk(g_lock);
+    return g_pending.size();
+}
+
+bool processSystemTasks() {
+    bool ok = false;
+    while (SystemISRTaskQueue.process()) {
+        ok = true;
+    }
+    return ok;
+}
+
+struct Result {
+    int calls = 0;
+    int error = -1;
+    bool locked = false;
+    std::vector<std::string> addrs;
+    netdb_getaddrinfo_request_t cancelId = 0;
+    int cancelResult = 0;
+};
+
+void resultCallback(int error, struct addrinfo* res, void* ctx) {
+    const auto r = static_cast<Result*>(ctx);
+    ++r->calls;
+    r->error = error;
+    r->locked = (g_lockDepth > 0);
+    for (auto ai = res; ai; ai = ai->ai_next) {
+        char s[INET6_ADDRSTRLEN] = {};
+        if (ai->ai_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6*)ai->ai_addr)->sin6_addr, s, sizeof(s));
+        } else {
+            inet_ntop(AF_INET, &((struct sockaddr_in*)ai->ai_addr)->sin_addr, s, sizeof(s));
+        }
+        r->addrs.push_back(s);
+    }
+    netdb_freeaddrinfo(res);
+    if (r->cancelId) {
+        // Calls into the netdb HAL from the callback
+        r->cancelResult = netdb_getaddrinfo_cancel(r->cancelId);
+    }
+}
+
+struct addrinfo makeHints(int family) {
+    struct addrinfo hints = {};
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_STREAM;
+    return hints;
+}
+
+void reset() {
+    processSystemTasks();
+    g_pending.clear();
+    g_ipv4.clear();
+    g_ipv6.clear();
+    g_cached = false;
+    g_lockReentered = false;
+    g_ipv4["a.test"] = "10.0.0.1";
+    g_ipv6["a.test"] = "2001:db8::1";
+    g_ipv4["b.test"] = "10.0.0.2";
+}
+
+} // namespace
+
+extern "C" {
+
+void sys_lock_tcpip_core() {
+    g_lock.lock();
+    if (++g_lockDepth > 1) {
+        g_lockReentered = true;
+    }
+}
+
+void sys_unlock_tcpip_core() {
+    --g_lockDepth;
+    g_lock.unlock();
+}
+
+err_t dns_gethostbyname_addrtype(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* arg,
+        u8_t dns_addrtype) {
+    if (g_cached) {
+        return lookup(hostname, dns_addrtype, addr) ? ERR_OK : ERR_ARG;
+    }
+    g_pending.push_back({ hostname, dns_addrtype, found, arg });
+    return ERR_INPROGRESS;
+}
+
+} // extern "C"
+
+TEST_CASE("netdb_getaddrinfo_async()") {
+    reset();
+    Result r;
+    netdb_getaddrinfo_request_t id = -1;
+    auto hints = makeHints(AF_UNSPEC);
+
+    SECTION("IPv6 and IPv4 queries run concurrently") {
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        CHECK(id > 0);
+        CHECK(pendingQueryCount() == 2);
+        CHECK(r.calls == 0);
+        resolvePendingQueries();
+        // The callback is not invoked in the TCP/IP thread
+        CHECK(r.calls == 0);
+        CHECK(processSystemTasks());
+        REQUIRE(r.calls == 1);
+        CHECK(r.error == 0);
+        CHECK_FALSE(r.locked);
+        REQUIRE(r.addrs.size() == 2);
+        CHECK(r.addrs[0] == "2001:db8::1");
+        CHECK(r.addrs[1] == "10.0.0.1");
+    }
+
+    SECTION("a single family is resolved if requested") {
+        hints = makeHints(AF_INET);
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        CHECK(pendingQueryCount() == 1);
+        resolvePendingQueries();
+        processSystemTasks();
+        REQUIRE(r.addrs.size() == 1);
+        CHECK(r.addrs[0] == "10.0.0.1");
+    }
+
+    SECTION("a failed query doesn't fail the request") {
+        REQUIRE(netdb_getaddrinfo_async("b.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        resolvePendingQueries();
+        processSystemTasks();
+        CHECK(r.error == 0);
+        REQUIRE(r.addrs.size() == 1);
+        CHECK(r.addrs[0] == "10.0.0.2");
+    }
+
+    SECTION("an unknown host is reported as an error") {
+        REQUIRE(netdb_getaddrinfo_async("c.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        resolvePendingQueries();
+        processSystemTasks();
+        CHECK(r.calls == 1);
+        CHECK(r.error != 0);
+        CHECK(r.addrs.empty());
+    }
+
+    SECTION("results available immediately are reported in the calling thread without the lock held") {
+        g_cached = true;
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        CHECK(id == 0);
+        REQUIRE(r.calls == 1);
+        CHECK_FALSE(r.locked);
+        CHECK(r.addrs.size() == 2);
+        CHECK_FALSE(processSystemTasks());
+    }
+
+    SECTION("the callback can call the netdb functions") {
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        r.cancelId = id;
+        resolvePendingQueries();
+        processSystemTasks();
+        CHECK(r.calls == 1);
+        // The request has completed by the time its callback is invoked
+        CHECK(r.cancelResult != 0);
+        CHECK_FALSE(g_lockReentered);
+    }
+
+    SECTION("a cancelled request doesn't invoke the callback") {
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        CHECK(netdb_getaddrinfo_cancel(id) == 0);
+        CHECK(netdb_getaddrinfo_cancel(id) != 0);
+        resolvePendingQueries();
+        processSystemTasks();
+        CHECK(r.calls == 0);
+    }
+
+    SECTION("a request can be cancelled until its callback is invoked") {
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        resolvePendingQueries();
+        CHECK(netdb_getaddrinfo_cancel(id) == 0);
+        processSystemTasks();
+        CHECK(r.calls == 0);
+    }
+
+    SECTION("the ID of a completed request doesn't refer to a newer request") {
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == 0);
+        resolvePendingQueries();
+        processSystemTasks();
+        CHECK(netdb_getaddrinfo_cancel(id) != 0);
+        Result r2;
+        netdb_getaddrinfo_request_t id2 = 0;
+        REQUIRE(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r2, &id2) == 0);
+        CHECK(id2 != id);
+        CHECK(netdb_getaddrinfo_cancel(id) != 0);
+        resolvePendingQueries();
+        processSystemTasks();
+        CHECK(r2.calls == 1);
+    }
+
+    SECTION("invalid arguments are rejected") {
+        CHECK(netdb_getaddrinfo_async(nullptr, nullptr, &hints, resultCallback, &r, &id) == EAI_NONAME);
+        CHECK(netdb_getaddrinfo_async("a.test", nullptr, &hints, nullptr, &r, &id) == EAI_NONAME);
+        hints.ai_family = AF_UNIX;
+        CHECK(netdb_getaddrinfo_async("a.test", nullptr, &hints, resultCallback, &r, &id) == EAI_FAMILY);
+        CHECK(netdb_getaddrinfo_cancel(0) != 0);
+        CHECK(r.calls == 0);
+    }
+
+    processSystemTasks();
+}
+
+TEST_CASE("netdb_getaddrinfo()") {
+    reset();
+    auto hints = makeHints(AF_UNSPEC);
+
+    SECTION("IPv6 and IPv4 queries run concurrently") {
+        // The queries are completed by another thread while the caller is blocked
+        std::thread resolver([]() {
+            while (pendingQueryCount() < 2) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            resolvePendingQueries();
+        });
+        struct addrinfo* res = nullptr;
+        const int ret = netdb_getaddrinfo("a.test", nullptr, &hints, &res);
+        resolver.join();
+        REQUIRE(ret == 0);
+        REQUIRE(res);
+        CHECK(res->ai_family == AF_INET6);
+        REQUIRE(res->ai_next);
+        CHECK(res->ai_next->ai_family == AF_INET);
+        netdb_freeaddrinfo(res);
+        // The result is not delivered via the system thread
+        CHECK_FALSE(processSystemTasks());
+    }
+}
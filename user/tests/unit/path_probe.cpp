@@ -0,0 +1,310 @@
+#define HAL_USE_SOCKET_HAL_POSIX 1
+
+#include "system_path_probe.h"
+#include "system_error.h"
+#include "rng_hal.h"
+
+#include "tools/catch.h"
+
+#include <unistd.h>
+#include <cstdarg>
+#include <map>
+#include <string>
+
+using namespace particle::system;
+
+namespace {
+
+const uint16_t CLOUD_PORT = 5684;
+
+// Loopback UDP socket standing in for the cloud server as seen via one of the interfaces
+class UdpServer {
+public:
+    UdpServer() {
+        sock_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(sock_, (const sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        ::getsockname(sock_, (sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+        timeval tv = { 1, 0 };
+        ::setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    ~UdpServer() {
+        ::close(sock_);
+    }
+
+    // Receives a datagram and optionally responds to it
+    std::string receive(bool respond) {
+        char buf[512];
+        sockaddr_in peer = {};
+        socklen_t len = sizeof(peer);
+        const ssize_t n = ::recvfrom(sock_, buf, sizeof(buf), 0, (sockaddr*)&peer, &len);
+        if (n < 0) {
+            return std::string();
+        }
+        if (respond) {
+            // Not a real HelloVerifyRequest, any response will do
+            const char resp[] = "\x16\xfe\xff";
+            ::sendto(sock_, resp, sizeof(resp) - 1, 0, (const sockaddr*)&peer, len);
+        }
+        return std::string(buf, n);
+    }
+
+    uint16_t port() const {
+        return port_;
+    }
+
+private:
+    int sock_;
+    uint16_t port_;
+};
+
+// Network path via an interface: datagrams sent to the cloud are delivered to `udpPort`
+// on the loopback interface, TCP connections go to `tcpPort` unless SYNs are dropped
+struct Path {
+    uint16_t udpPort = 0;
+    uint16_t tcpPort = 0;
+    bool dropTcp = false;
+};
+
+std::map<std::string, Path> paths;
+std::map<int, std::string> boundTo;
+std::string lastBoundIface;
+
+sockaddr_in cloudAddress() {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(CLOUD_PORT);
+    inet_pton(AF_INET, "192.0.2.1", &addr.sin_addr);
+    return addr;
+}
+
+uint16_t closedTcpPort() {
+    const int s = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(s, (const sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    ::getsockname(s, (sockaddr*)&addr, &len);
+    ::close(s);
+    return ntohs(addr.sin_port);
+}
+
+int start(PathProbe& probe, const char* ifName, int protocol, system_tick_t now) {
+    const auto addr = cloudAddress();
+    return probe.start((const sockaddr*)&addr, sizeof(addr), protocol, ifName, now);
+}
+
+// Polls a probe until it completes
+int wait(PathProbe& probe, system_tick_t start) {
+    for (system_tick_t t = start; t <= start + PathProbe::TIMEOUT; t += 100) {
+        const int r = probe.poll(t);
+        if (r != 0) {
+            return r;
+        }
+        usleep(1000);
+    }
+    return 0;
+}
+
+} // namespace
+
+uint32_t HAL_RNG_GetRandomNumber() {
+    return 0x12345678;
+}
+
+int sock_socket(int domain, int type, int protocol) {
+    return ::socket(domain, type, protocol);
+}
+
+int sock_close(int s) {
+    boundTo.erase(s);
+    return ::close(s);
+}
+
+int sock_setsockopt(int s, int level, int optname, const void* optval, socklen_t optlen) {
+    if (level == SOL_SOCKET && optname == SO_BINDTODEVICE) {
+        boundTo[s] = lastBoundIface = std::string((const char*)optval);
+        return 0;
+    }
+    return ::setsockopt(s, level, optname, optval, optlen);
+}
+
+int sock_getsockopt(int s, int level, int optname, void* optval, socklen_t* optlen) {
+    return ::getsockopt(s, level, optname, optval, optlen);
+}
+
+int sock_fcntl(int s, int cmd, ...) {
+    va_list args;
+    va_start(args, cmd);
+    const int val = va_arg(args, int);
+    va_end(args);
+    return ::fcntl(s, cmd, val);
+}
+
+int sock_connect(int s, const struct sockaddr* name, socklen_t namelen) {
+    const auto it = boundTo.find(s);
+    if (it == boundTo.end() || !paths.count(it->second)) {
+        errno = ENETUNREACH;
+        return -1;
+    }
+    const Path& path = paths[it->second];
+    int type = 0;
+    socklen_t len = sizeof(type);
+    ::getsockopt(s, SOL_SOCKET, SO_TYPE, &type, &len);
+    if (type == SOCK_STREAM && path.dropTcp) {
+        errno = EINPROGRESS;
+        return -1;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((type == SOCK_STREAM) ? path.tcpPort : path.udpPort);
+    return ::connect(s, (const sockaddr*)&addr, sizeof(addr));
+}
+
+ssize_t sock_send(int s, const void* dataptr, size_t size, int flags) {
+    return ::send(s, dataptr, size, flags);
+}
+
+ssize_t sock_recv(int s, void* mem, size_t len, int flags) {
+    return ::recv(s, mem, len, flags);
+}
+
+TEST_CASE("PathProbe") {
+    UdpServer en2Server;
+    UdpServer wl3Server;
+    paths.clear();
+    paths["en2"].udpPort = en2Server.port();
+    paths["wl3"].udpPort = wl3Server.port();
+    PathProbe probe;
+
+    SECTION("the UDP probe is a DTLS ClientHello sent via the given interface") {
+        REQUIRE(start(probe, "wl3", IPPROTO_UDP, 1000) == 0);
+        CHECK(lastBoundIface == "wl3");
+        const auto hello = wl3Server.receive(false /* respond */);
+        REQUIRE(hello.size() == 83);
+        CHECK(hello[0] == 22); // Handshake
+        CHECK((uint8_t)hello[1] == 0xfe); // DTLS 1.2
+        CHECK((uint8_t)hello[2] == 0xfd);
+        CHECK(hello.substr(3, 8) == std::string(8, '\0')); // Epoch and sequence number
+        CHECK((((uint8_t)hello[11] << 8) | (uint8_t)hello[12]) == 70);
+        CHECK(hello[13] == 1); // ClientHello
+        CHECK(hello.substr(14, 3) == std::string("\x00\x00\x3a", 3));
+        CHECK(hello.substr(22, 3) == std::string("\x00\x00\x3a", 3));
+        CHECK(hello.substr(59, 6) == std::string("\x00\x00\x00\x02\xc0\xae", 6));
+        CHECK(en2Server.receive(false).empty());
+    }
+
+    SECTION("the UDP probe succeeds when the server responds") {
+        REQUIRE(start(probe, "en2", IPPROTO_UDP, 1000) == 0);
+        CHECK(probe.poll(1000) == 0);
+        CHECK_FALSE(en2Server.receive(true /* respond */).empty());
+        CHECK(wait(probe, 1000) == 1);
+        CHECK_FALSE(probe.isActive());
+    }
+
+    SECTION("the UDP probe times out when the path drops datagrams") {
+        REQUIRE(start(probe, "en2", IPPROTO_UDP, 1000) == 0);
+        CHECK_FALSE(en2Server.receive(false).empty());
+        CHECK(probe.poll(1000 + PathProbe::TIMEOUT - 1) == 0);
+        CHECK(probe.poll(1000 + PathProbe::TIMEOUT) == SYSTEM_ERROR_TIMEOUT);
+        CHECK_FALSE(probe.isActive());
+    }
+
+    SECTION("the TCP probe treats a refused connection as reachable") {
+        paths["en2"].tcpPort = closedTcpPort();
+        const int r = start(probe, "en2", IPPROTO_TCP, 1000);
+        if (r == 0) {
+            CHECK(wait(probe, 1000) == 1);
+        } else {
+            CHECK(r == 1);
+        }
+    }
+
+    SECTION("the TCP probe times out when SYNs are dropped") {
+        paths["en2"].dropTcp = true;
+        REQUIRE(start(probe, "en2", IPPROTO_TCP, 1000) == 0);
+        CHECK(probe.poll(2000) == 0);
+        CHECK(probe.poll(1000 + PathProbe::TIMEOUT) == SYSTEM_ERROR_TIMEOUT);
+    }
+
+    SECTION("a network that drops TCP SYNs doesn't make UDP interfaces unhealthy") {
+        // Both interfaces drop TCP SYNs, only wl3 loses its UDP upstream
+        paths["en2"].dropTcp = true;
+        paths["wl3"].dropTcp = true;
+        PathProbe wl3Probe;
+        PathHealth en2Health;
+        PathHealth wl3Health;
+        system_tick_t now = 1000;
+        for (unsigned i = 0; i < PathHealth::FAILURE_THRESHOLD; ++i) {
+            REQUIRE(start(probe, "en2", IPPROTO_UDP, now) == 0);
+            REQUIRE(start(wl3Probe, "wl3", IPPROTO_UDP, now) == 0);
+            CHECK_FALSE(en2Server.receive(true).empty());
+            CHECK_FALSE(wl3Server.receive(false).empty());
+            en2Health.update(wait(probe, now) > 0, now);
+            wl3Health.update(wait(wl3Probe, now) > 0, now);
+            now += 2000;
+        }
+        CHECK(en2Health.isHealthy());
+        CHECK_FALSE(en2Health.isSuspect());
+        CHECK_FALSE(wl3Health.isHealthy());
+
+        // wl3 needs several consecutive successful probes to recover
+        for (unsigned i = 0; i < PathHealth::RECOVERY_THRESHOLD; ++i) {
+            CHECK_FALSE(wl3Health.isHealthy());
+            REQUIRE(start(wl3Probe, "wl3", IPPROTO_UDP, now) == 0);
+            CHECK_FALSE(wl3Server.receive(true).empty());
+            wl3Health.update(wait(wl3Probe, now) > 0, now);
+            now += 2000;
+        }
+        CHECK(wl3Health.isHealthy());
+        CHECK(wl3Health.healthySince() == now - 2000);
+    }
+
+    SECTION("start() rejects an interface name that doesn't fit the socket option") {
+        CHECK(start(probe, "a_very_long_interface_name", IPPROTO_UDP, 1000) == SYSTEM_ERROR_INVALID_ARGUMENT);
+        CHECK_FALSE(probe.isActive());
+    }
+}
+
+TEST_CASE("PathHealth") {
+    PathHealth health;
+    CHECK(health.isHealthy());
+
+    SECTION("a single failed probe makes the interface suspect but not unhealthy") {
+        CHECK_FALSE(health.update(false, 1000));
+        CHECK(health.isHealthy());
+        CHECK(health.isSuspect());
+        CHECK_FALSE(health.update(true, 2000));
+        CHECK_FALSE(health.isSuspect());
+    }
+
+    SECTION("a successful probe resets the count of failures") {
+        health.update(false, 1000);
+        health.update(true, 2000);
+        CHECK_FALSE(health.update(false, 3000));
+        CHECK(health.isHealthy());
+        CHECK(health.update(false, 4000));
+        CHECK_FALSE(health.isHealthy());
+    }
+
+    SECTION("a failed probe restarts the recovery") {
+        health.update(false, 1000);
+        health.update(false, 2000);
+        health.update(true, 3000);
+        health.update(true, 4000);
+        health.update(false, 5000);
+        health.update(true, 6000);
+        health.update(true, 7000);
+        CHECK_FALSE(health.isHealthy());
+        CHECK(health.update(true, 8000));
+        CHECK(health.isHealthy());
+        CHECK(health.healthySince() == 8000);
+    }
+}
@@ -0,0 +1,267 @@
+#include "protocol.h"
+#include "messages.h"
+
+#include "tools/message_channel.h"
+#include "tools/catch.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace particle::protocol;
+
+using test::LoopbackChannel;
+
+system_tick_t now = 0;
+// Time it takes to handle a message
+system_tick_t handleTime = 0;
+
+system_tick_t millis() {
+    // The clock advances each time the protocol reads it while handling a message
+    return now += handleTime;
+}
+
+class TestProtocol: public Protocol {
+public:
+    explicit TestProtocol(MessageChannel& channel) :
+            Protocol(channel) {
+        SparkDescriptor descriptor = {};
+        descriptor.size = sizeof(descriptor);
+        init(descriptor);
+    }
+
+    TestProtocol(MessageChannel& channel, const SparkDescriptor& descriptor) :
+            Protocol(channel) {
+        init(descriptor);
+    }
+
+    void init(const char* id, const SparkKeys& keys, const SparkCallbacks& callbacks,
+            const SparkDescriptor& descriptor) override {
+    }
+
+    int command(ProtocolCommands::Enum command, uint32_t data) override {
+        return 0;
+    }
+
+protected:
+    size_t build_hello(Message& message, uint8_t flags) override {
+        return 0;
+    }
+
+private:
+    void init(const SparkDescriptor& descriptor) {
+        SparkCallbacks callbacks = {};
+        callbacks.size = sizeof(callbacks);
+        callbacks.millis = ::millis;
+        Protocol::init(callbacks, descriptor);
+    }
+};
+
+std::string ping(message_id_t id) {
+    uint8_t buf[4];
+    const size_t n = Messages::ping(buf, id);
+    return std::string((const char*)buf, n);
+}
+
+// Server floods the device with pings, each of which is acknowledged
+void flood(LoopbackChannel& channel, unsigned count) {
+    for (unsigned i = 0; i < count; ++i) {
+        channel.push(ping(i + 1));
+    }
+}
+
+std::vector<std::string> g_functions;
+std::string g_systemInfo;
+
+int numFunctions() {
+    return g_functions.size();
+}
+
+const char* functionKey(int index) {
+    return g_functions.at(index).c_str();
+}
+
+int numVariables() {
+    return 0;
+}
+
+bool appendSystemInfo(appender_fn append, void* data, void* reserved) {
+    return append(data, (const uint8_t*)g_systemInfo.data(), g_systemInfo.size());
+}
+
+SparkDescriptor describeDescriptor() {
+    SparkDescriptor d = {};
+    d.size = sizeof(d);
+    d.num_functions = numFunctions;
+    d.get_function_key = functionKey;
+    d.num_variables = numVariables;
+    d.append_system_info = appendSystemInfo;
+    return d;
+}
+
+// Describe request: CON GET /d/<flags>, followed by the base checksum for a delta describe
+std::string describeRequest(message_id_t id, uint8_t flags, uint32_t base = 0) {
+    std::string s;
+    s += (char)0x41; // CON, one-byte token
+    s += (char)0x01; // GET
+    s += (char)(id >> 8);
+    s += (char)(id & 0xff);
+    s += (char)0x01; // Token
+    s += "\xb1" "d"; // Uri-Path
+    s += (char)0x01; // Uri-Path
+    s += (char)flags;
+    if (flags & DESCRIBE_DELTA) {
+        s += (char)0xff;
+        s += (char)(base >> 24);
+        s += (char)((base >> 16) & 0xff);
+        s += (char)((base >> 8) & 0xff);
+        s += (char)(base & 0xff);
+    }
+    return s;
+}
+
+// Returns the payload of a describe response
+std::string describePayload(const std::string& msg) {
+    REQUIRE(msg.size() > 6);
+    REQUIRE((uint8_t)msg[5] == 0xff); // 4 bytes header, 1 byte token
+    return msg.substr(6);
+}
+
+// Returns the checksum reported in the "c" field of a describe
+uint32_t describeChecksum(const std::string& payload) {
+    const auto pos = payload.find("\"c\":");
+    REQUIRE(pos != std::string::npos);
+    return std::stoul(payload.substr(pos + 4));
+}
+
+} // namespace
+
+TEST_CASE("Protocol event loop") {
+    LoopbackChannel channel;
+    TestProtocol protocol(channel);
+    now = 0;
+    handleTime = 0;
+
+    SECTION("buffered messages are handled up to the message budget in a single call") {
+        flood(channel, 20);
+        CHECK(protocol.event_loop());
+        CHECK(channel.sent().size() == 8); // Default budget
+        protocol.set_event_loop_message_budget(20);
+        CHECK(protocol.event_loop());
+        CHECK(channel.sent().size() == 20);
+    }
+
+    SECTION("the time budget limits the messages handled in a single call") {
+        handleTime = 5;
+        protocol.set_event_loop_message_budget(100);
+        protocol.set_event_loop_time_budget(20);
+        flood(channel, 20);
+        CHECK(protocol.event_loop());
+        const size_t handled = channel.sent().size();
+        CHECK(handled > 1);
+        CHECK(handled < 20);
+    }
+
+    SECTION("a zero message budget still handles one message per call") {
+        protocol.set_event_loop_message_budget(0);
+        flood(channel, 2);
+        CHECK(protocol.event_loop());
+        CHECK(channel.sent().size() == 1);
+    }
+
+    SECTION("a flood is drained in a fraction of the calls needed to handle one message per call") {
+        const unsigned count = 100;
+        flood(channel, count);
+        unsigned calls = 0;
+        while (channel.sent().size() < count && calls < count) {
+            CHECK(protocol.event_loop());
+            ++calls;
+        }
+        CHECK(channel.sent().size() == count);
+        CHECK(calls == (count + 7) / 8);
+        // The acknowledgements are sent in order
+        for (unsigned i = 0; i < count; ++i) {
+            const std::string& ack = channel.sent()[i];
+            REQUIRE(ack.size() == 4);
+            CHECK((((uint8_t)ack[2] << 8) | (uint8_t)ack[3]) == i + 1);
+        }
+    }
+}
+
+TEST_CASE("Protocol describe") {
+    LoopbackChannel channel;
+    TestProtocol protocol(channel, describeDescriptor());
+    now = 0;
+    handleTime = 0;
+    g_functions = { "f1", "f2" };
+    g_systemInfo = "\"p\":6,\"m\":[{\"f\":\"s\",\"n\":\"1\",\"v\":1000,\"d\":[]}]";
+    const uint8_t deltaFlags = DESCRIBE_DEFAULT | DESCRIBE_DELTA;
+
+    // Server requests a delta describe against an unknown base
+    channel.push(describeRequest(1, deltaFlags, 0x12345678));
+    REQUIRE(protocol.event_loop());
+    REQUIRE(channel.sent().size() == 1);
+    const std::string full = describePayload(channel.sent()[0]);
+    const uint32_t checksum = describeChecksum(full);
+
+    SECTION("a full describe is sent with its checksum if the base is unknown") {
+        CHECK(full == "{\"c\":" + std::to_string(checksum) + ",\"f\":[\"f1\",\"f2\"],\"v\":{}," + g_systemInfo + "}");
+    }
+
+    SECTION("a describe without the delta flag has the original format") {
+        channel.push(describeRequest(2, DESCRIBE_DEFAULT));
+        REQUIRE(protocol.event_loop());
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(describePayload(channel.sent()[1]) == "{\"f\":[\"f1\",\"f2\"],\"v\":{}," + g_systemInfo + "}");
+    }
+
+    SECTION("an empty delta is sent if nothing has changed since the base") {
+        channel.push(describeRequest(2, deltaFlags, checksum));
+        REQUIRE(protocol.event_loop());
+        REQUIRE(channel.sent().size() == 2);
+        const std::string c = std::to_string(checksum);
+        CHECK(describePayload(channel.sent()[1]) == "{\"b\":" + c + ",\"c\":" + c + "}");
+    }
+
+    SECTION("a delta contains the entries added since the base") {
+        g_functions.push_back("f3");
+        channel.push(describeRequest(2, deltaFlags, checksum));
+        REQUIRE(protocol.event_loop());
+        REQUIRE(channel.sent().size() == 2);
+        const std::string delta = describePayload(channel.sent()[1]);
+        const uint32_t newChecksum = describeChecksum(delta);
+        CHECK(newChecksum != checksum);
+        CHECK(delta == "{\"b\":" + std::to_string(checksum) + ",\"c\":" + std::to_string(newChecksum) +
+                ",\"f\":[\"f3\"]}");
+
+        // The server confirms the delta by using its checksum as the next base
+        g_functions.push_back("f4");
+        channel.push(describeRequest(3, deltaFlags, newChecksum));
+        REQUIRE(protocol.event_loop());
+        REQUIRE(channel.sent().size() == 3);
+        const std::string delta2 = describePayload(channel.sent()[2]);
+        CHECK(delta2 == "{\"b\":" + std::to_string(newChecksum) + ",\"c\":" +
+                std::to_string(describeChecksum(delta2)) + ",\"f\":[\"f4\"]}");
+    }
+
+    SECTION("a full describe is sent if the server has a different base") {
+        g_functions.push_back("f3");
+        channel.push(describeRequest(2, deltaFlags, checksum + 1));
+        REQUIRE(protocol.event_loop());
+        REQUIRE(channel.sent().size() == 2);
+        const std::string payload = describePayload(channel.sent()[1]);
+        CHECK(payload == "{\"c\":" + std::to_string(describeChecksum(payload)) +
+                ",\"f\":[\"f1\",\"f2\",\"f3\"],\"v\":{}," + g_systemInfo + "}");
+    }
+
+    SECTION("a full describe is sent if the system data has changed") {
+        g_systemInfo = "\"p\":8,\"m\":[{\"f\":\"s\",\"n\":\"1\",\"v\":1000,\"d\":[]}]";
+        channel.push(describeRequest(2, deltaFlags, checksum));
+        REQUIRE(protocol.event_loop());
+        REQUIRE(channel.sent().size() == 2);
+        const std::string payload = describePayload(channel.sent()[1]);
+        CHECK(payload.find("\"b\":") == std::string::npos);
+        CHECK(payload.find(g_systemInfo) != std::string::npos);
+    }
+}
@@ -0,0 +1,97 @@
+#include "publisher.h"
+
+#include "tools/message_channel.h"
+#include "tools/catch.h"
+
+#include <string>
+
+namespace particle {
+
+namespace protocol {
+
+// Acknowledgements are handled by the Protocol class
+void Publisher::add_ack_handler(message_id_t msg_id, CompletionHandler handler) {
+}
+
+} // namespace protocol
+
+} // namespace particle
+
+namespace {
+
+using namespace particle::protocol;
+
+using particle::CompletionHandler;
+
+using test::LoopbackChannel;
+
+std::string event(const char* name, const char* data, message_id_t id) {
+    uint8_t buf[256];
+    const size_t n = Messages::event(buf, id, name, data, 60, EventType::PRIVATE, true /* confirmable */);
+    return std::string((const char*)buf, n);
+}
+
+ProtocolError publish(Publisher& pub, LoopbackChannel& channel, const char* name, const char* data, system_tick_t time) {
+    return pub.send_event(channel, name, data, 60, EventType::PRIVATE, 0 /* flags */, time, CompletionHandler());
+}
+
+} // namespace
+
+TEST_CASE("Publisher") {
+    Publisher pub(nullptr);
+    LoopbackChannel channel;
+    pub.set_online(true);
+
+    SECTION("events are sent immediately while the session is active") {
+        CHECK(publish(pub, channel, "a", "1", 0) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == event("a", "1", 1));
+    }
+
+    SECTION("events are queued while the session is inactive") {
+        pub.set_queue_limit(2);
+        pub.set_online(false);
+        CHECK(publish(pub, channel, "a", "1", 0) == NO_ERROR);
+        CHECK(publish(pub, channel, "b", "2", 0) == NO_ERROR);
+        CHECK(publish(pub, channel, "c", "3", 0) == BANDWIDTH_EXCEEDED); // Queue is full
+        CHECK(pub.queued_events() == 2);
+        CHECK(pub.process(channel, 1000) == NO_ERROR);
+        CHECK(channel.sent().empty());
+        // The queued events are sent in order once the session is resumed
+        pub.set_online(true);
+        CHECK(pub.process(channel, 1000) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(channel.sent()[0] == event("a", "1", 1));
+        CHECK(channel.sent()[1] == event("b", "2", 2));
+        CHECK(pub.queued_events() == 0);
+    }
+
+    SECTION("events published after the session is resumed are sent after the queued events") {
+        pub.set_queue_limit(4);
+        pub.set_online(false);
+        publish(pub, channel, "a", "1", 0);
+        pub.set_online(true);
+        CHECK(publish(pub, channel, "b", "2", 0) == NO_ERROR);
+        CHECK(channel.sent().empty());
+        pub.process(channel, 0);
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(channel.sent()[0] == event("a", "1", 1));
+        CHECK(channel.sent()[1] == event("b", "2", 2));
+    }
+
+    SECTION("events are not queued while the session is inactive if the queue is disabled") {
+        pub.set_online(false);
+        // The channel is responsible for reporting an error
+        channel.sendError(IO_ERROR_GENERIC_SEND);
+        CHECK(publish(pub, channel, "a", "1", 0) == IO_ERROR_GENERIC_SEND);
+        CHECK(pub.queued_events() == 0);
+    }
+
+    SECTION("system events are not queued") {
+        pub.set_queue_limit(2);
+        pub.set_online(false);
+        CHECK(publish(pub, channel, "spark/a", nullptr, 0) == NO_ERROR);
+        CHECK(channel.sent().size() == 1);
+        CHECK(pub.queued_events() == 0);
+    }
+}
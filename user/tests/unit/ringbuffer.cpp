@@ -0,0 +1,59 @@
+#include "ringbuffer.h"
+
+#include "tools/catch.h"
+
+#include <string>
+
+using particle::services::RingBuffer;
+
+TEST_CASE("RingBuffer") {
+    char data[8] = {};
+    RingBuffer<char> rb(data, sizeof(data));
+
+    SECTION("put() and get() preserve data across the buffer boundary") {
+        char out[8] = {};
+        for (int i = 0; i < 16; ++i) {
+            const std::string s = std::to_string(10000 + i).substr(0, 5); // 5 bytes
+            REQUIRE(rb.put(s.data(), s.size()) == 5);
+            CHECK(rb.data() == 5);
+            REQUIRE(rb.get(out, 5) == 5);
+            CHECK(std::string(out, 5) == s);
+            CHECK(rb.empty());
+        }
+    }
+
+    SECTION("peek() doesn't consume data") {
+        char out[8] = {};
+        REQUIRE(rb.put("abcdef", 6) == 6);
+        REQUIRE(rb.get(out, 4) == 4);
+        REQUIRE(rb.put("ghijk", 5) == 5); // Wraps around
+        REQUIRE(rb.peek(out, 7) == 7);
+        CHECK(std::string(out, 7) == "efghijk");
+        CHECK(rb.data() == 7);
+        REQUIRE(rb.get(out, 7) == 7);
+        CHECK(std::string(out, 7) == "efghijk");
+    }
+
+    SECTION("put() fails if there's not enough space") {
+        REQUIRE(rb.put("abcdefg", 7) == 7);
+        CHECK(rb.put("hi", 2) == SYSTEM_ERROR_TOO_LARGE);
+        CHECK(rb.put("h", 1) == 1);
+        CHECK(rb.full());
+    }
+
+    SECTION("consume() provides zero-copy access to contiguous data") {
+        char out[8] = {};
+        REQUIRE(rb.put("abcdef", 6) == 6);
+        REQUIRE(rb.get(out, 6) == 6);
+        REQUIRE(rb.put("ghijk", 5) == 5);
+        CHECK(rb.consumable() == 2);
+        const char* p = rb.consume(2);
+        CHECK(std::string(p, 2) == "gh");
+        REQUIRE(rb.consumeCommit(2) == 2);
+        CHECK(rb.consumable() == 3);
+        p = rb.consume(3);
+        CHECK(std::string(p, 3) == "ijk");
+        REQUIRE(rb.consumeCommit(1, 2) == 1);
+        CHECK(rb.data() == 2);
+    }
+}
@@ -77,3 +77,67 @@ TEST_CASE("Can format a string using printf like syntax") {
 TEST_CASE("Can convert a string to lowercase") {
     REQUIRE(String("In LOWERCAse").toLowerCase()==String("in lowercase"));
 }
+
+TEST_CASE("Can replace a substring with a longer string") {
+    String s("a,b,,c,");
+    REQUIRE(s.replace(",", "\\,") == String("a\\,b\\,\\,c\\,"));
+    REQUIRE(s.length() == 11);
+}
+
+TEST_CASE("Can replace a substring with a shorter string") {
+    String s("a::b::::c");
+    REQUIRE(s.replace("::", ":") == String("a:b::c"));
+    REQUIRE(s.length() == 6);
+}
+
+TEST_CASE("Can replace a substring with a string of the same length") {
+    String s("abcabcab");
+    REQUIRE(s.replace("ab", "xy") == String("xycxycxy"));
+}
+
+TEST_CASE("Replaces non-overlapping matches from left to right") {
+    String s("aaaaa");
+    REQUIRE(s.replace("aa", "bbb") == String("bbbbbba"));
+    String s2("aaaaa");
+    REQUIRE(s2.replace("aa", "b") == String("bba"));
+}
+
+TEST_CASE("Can replace many occurrences in a long string") {
+    String s;
+    String expected;
+    for (int i = 0; i < 20000; ++i) {
+        s += "x\"";
+        expected += "x\\\"";
+    }
+    REQUIRE(s.length() == 40000);
+    REQUIRE(s.replace("\"", "\\\"") == expected);
+    REQUIRE(s.replace("x", "").length() == 40000);
+    REQUIRE(s.indexOf('x') == -1);
+}
+
+TEST_CASE("Can remove characters from a string") {
+    String s("0123456789");
+    REQUIRE(s.remove(2, 3) == String("0156789"));
+    REQUIRE(s.remove(5) == String("01567"));
+    REQUIRE(s.remove(3, 100) == String("015"));
+    REQUIRE(s.remove(3) == String("015"));
+}
+
+TEST_CASE("Can concatenate a string with itself") {
+    String s("abc");
+    for (int i = 0; i < 10; ++i) {
+        s += s;
+    }
+    REQUIRE(s.length() == 3 * 1024);
+    REQUIRE(s.substring(3069) == String("abcabc").substring(3));
+    REQUIRE(s.indexOf("cc") == -1);
+}
+
+TEST_CASE("Can concatenate many characters") {
+    String s;
+    for (int i = 0; i < 100000; ++i) {
+        REQUIRE(s.concat((char)('a' + i % 26)));
+    }
+    REQUIRE(s.length() == 100000);
+    REQUIRE(s.charAt(99999) == 'a' + 99999 % 26);
+}
@@ -0,0 +1,84 @@
+#include "handshake.h"
+#include "mbedtls/aes.h"
+#include "mbedtls_util.h"
+
+// Replaces the RSA handshake primitives and the AES cipher used by the LightSSL channel. The
+// "ciphertext" of the session key message is the plaintext credentials, and a signature that
+// starts with 0xff fails verification
+
+int decipher_aes_credentials(const unsigned char* private_key, const unsigned char* ciphertext,
+        unsigned char* aes_credentials) {
+    memcpy(aes_credentials, ciphertext, 40);
+    return 0;
+}
+
+void calculate_ciphertext_hmac(const unsigned char* ciphertext, const unsigned char* hmac_key, unsigned char* hmac) {
+    memset(hmac, 0, 20);
+}
+
+int verify_signature(const unsigned char* signature, const unsigned char* pubkey, const unsigned char* expected_hmac) {
+    return (signature[0] == 0xff) ? 1 : 0;
+}
+
+void init_rsa_context_with_public_key(mbedtls_rsa_context* rsa, const unsigned char* pubkey) {
+    rsa->len = 256;
+}
+
+void extract_public_rsa_key(uint8_t* device_pubkey, const uint8_t* device_privkey) {
+}
+
+int mbedtls_rsa_pkcs1_encrypt(mbedtls_rsa_context* ctx, int (*f_rng)(void*, unsigned char*, size_t), void* p_rng,
+        int mode, size_t ilen, const unsigned char* input, unsigned char* output) {
+    if (ilen > ctx->len) {
+        return -1;
+    }
+    memmove(output, input, ilen);
+    memset(output + ilen, 0, ctx->len - ilen);
+    return 0;
+}
+
+void mbedtls_rsa_free(mbedtls_rsa_context* ctx) {
+}
+
+int mbedtls_default_rng(void*, unsigned char* data, size_t size) {
+    memset(data, 0, size);
+    return 0;
+}
+
+void mbedtls_aes_init(mbedtls_aes_context* ctx) {
+    memset(ctx, 0, sizeof(mbedtls_aes_context));
+}
+
+void mbedtls_aes_free(mbedtls_aes_context* ctx) {
+}
+
+int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits) {
+    memcpy(ctx->key, key, sizeof(ctx->key));
+    return 0;
+}
+
+int mbedtls_aes_setkey_dec(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits) {
+    memcpy(ctx->key, key, sizeof(ctx->key));
+    return 0;
+}
+
+int mbedtls_aes_crypt_cbc(mbedtls_aes_context* ctx, int mode, size_t length, unsigned char iv[16],
+        const unsigned char* input, unsigned char* output) {
+    if (length % 16) {
+        return -1;
+    }
+    for (size_t i = 0; i < length; i += 16) {
+        unsigned char block[16];
+        memcpy(block, input + i, 16);
+        for (size_t j = 0; j < 16; ++j) {
+            if (mode == MBEDTLS_AES_ENCRYPT) {
+                output[i + j] = block[j] ^ iv[j] ^ ctx->key[j];
+                iv[j] = output[i + j];
+            } else {
+                output[i + j] = block[j] ^ ctx->key[j] ^ iv[j];
+                iv[j] = block[j];
+            }
+        }
+    }
+    return 0;
+}
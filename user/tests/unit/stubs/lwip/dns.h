@@ -0,0 +1,45 @@
+#ifndef TEST_STUBS_LWIP_DNS_H
+#define TEST_STUBS_LWIP_DNS_H
+
+#include "lwip/sockets.h"
+
+#include <string.h>
+
+#define IPADDR_TYPE_V4 0
+#define IPADDR_TYPE_V6 6
+
+#define LWIP_DNS_ADDRTYPE_IPV4 0
+#define LWIP_DNS_ADDRTYPE_IPV6 1
+
+#define IPADDR_STRLEN_MAX INET6_ADDRSTRLEN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ip_addr {
+    union {
+        struct in_addr ip4;
+        struct in6_addr ip6;
+    } u_addr;
+    u8_t type;
+} ip_addr_t;
+
+#define IP_IS_V6(addr) ((addr)->type == IPADDR_TYPE_V6)
+#define ip_addr_copy(dest, src) ((dest) = (src))
+
+static inline char* ipaddr_ntoa_r(const ip_addr_t* addr, char* buf, int buflen) {
+    const int af = IP_IS_V6(addr) ? AF_INET6 : AF_INET;
+    return (char*)inet_ntop(af, &addr->u_addr, buf, buflen);
+}
+
+typedef void (*dns_found_callback)(const char* name, const ip_addr_t* addr, void* arg);
+
+err_t dns_gethostbyname_addrtype(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* arg,
+        u8_t dns_addrtype);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_STUBS_LWIP_DNS_H
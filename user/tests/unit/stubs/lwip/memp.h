@@ -0,0 +1,42 @@
+#ifndef TEST_STUBS_LWIP_MEMP_H
+#define TEST_STUBS_LWIP_MEMP_H
+
+#include "lwip/opt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LWIP_MEM_ALIGN_SIZE(size) (((size) + MEM_ALIGNMENT - 1U) & ~(MEM_ALIGNMENT - 1U))
+
+#define MEMP_SIZE 0
+#define MEMP_ALIGN_SIZE(x) (LWIP_MEM_ALIGN_SIZE(x))
+
+typedef size_t mem_size_t;
+
+struct stats_mem {
+    mem_size_t avail;
+    mem_size_t used;
+    mem_size_t max;
+    uint16_t err;
+};
+
+typedef enum {
+#define LWIP_MEMPOOL(name, num, size, desc) MEMP_##name,
+#include "lwip/priv/memp_std.h"
+    MEMP_MAX
+} memp_t;
+
+struct memp_desc {
+    struct stats_mem* stats;
+    u16_t size;
+};
+
+// Defined by the tests
+extern const struct memp_desc* const memp_pools[MEMP_MAX];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_STUBS_LWIP_MEMP_H
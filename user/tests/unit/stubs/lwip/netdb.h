@@ -0,0 +1,14 @@
+#ifndef TEST_STUBS_LWIP_NETDB_H
+#define TEST_STUBS_LWIP_NETDB_H
+
+#include "lwip/sockets.h"
+
+// Host resolver, which is only used with numeric addresses by the tests
+#include <netdb.h>
+
+#define lwip_getaddrinfo getaddrinfo
+#define lwip_freeaddrinfo freeaddrinfo
+#define lwip_gethostbyname gethostbyname
+#define lwip_gethostbyname_r gethostbyname_r
+
+#endif // TEST_STUBS_LWIP_NETDB_H
@@ -0,0 +1,8 @@
+#ifndef TEST_STUBS_LWIP_NETIF_H
+#define TEST_STUBS_LWIP_NETIF_H
+
+#include "lwip/opt.h"
+
+struct netif;
+
+#endif // TEST_STUBS_LWIP_NETIF_H
@@ -0,0 +1,51 @@
+#ifndef TEST_STUBS_LWIP_OPT_H
+#define TEST_STUBS_LWIP_OPT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Minimal replacement for the parts of lwIP used by the network HAL. The TCP/IP core lock and
+// the DNS resolver are provided by the tests
+
+// Memory options of the Gen 3 lwipopts.h
+#define LWIP_STATS 1
+#define LWIP_TCP 1
+#define LWIP_UDP 1
+#define LWIP_SO_RCVBUF 1
+#define TCP_QUEUE_OOSEQ 1
+#define MEM_LIBC_MALLOC 1
+#define MEM_STATS 1
+#define MEMP_MEM_MALLOC 1
+#define MEMP_STATS 1
+#define MEM_ALIGNMENT 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+void sys_lock_tcpip_core(void);
+void sys_unlock_tcpip_core(void);
+
+#define LOCK_TCPIP_CORE() sys_lock_tcpip_core()
+#define UNLOCK_TCPIP_CORE() sys_unlock_tcpip_core()
+
+struct tcp_pcb;
+
+void* lwip_hook_mem_malloc(size_t size);
+int lwip_hook_recv_bufsize_default(void);
+uint16_t lwip_hook_tcp_ooseq_pbufs_limit(struct tcp_pcb* pcb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_STUBS_LWIP_OPT_H
@@ -0,0 +1,15 @@
+// Pools of the tests. PBUF and SYS_TIMEOUT have elements of the same size
+
+#ifndef LWIP_PBUF_MEMPOOL
+#define LWIP_PBUF_MEMPOOL(name, num, payload, desc) LWIP_MEMPOOL(name, num, (16 + LWIP_MEM_ALIGN_SIZE(payload)), desc)
+#endif
+
+LWIP_MEMPOOL(UDP_PCB, 8, 64, "UDP_PCB")
+LWIP_MEMPOOL(TCP_PCB, 5, 160, "TCP_PCB")
+LWIP_MEMPOOL(TCP_SEG, 16, 20, "TCP_SEG")
+LWIP_MEMPOOL(SYS_TIMEOUT, 10, 16, "SYS_TIMEOUT")
+LWIP_MEMPOOL(PBUF, 16, 16, "PBUF_REF/ROM")
+LWIP_PBUF_MEMPOOL(PBUF_POOL, 16, 1536, "PBUF_POOL")
+
+#undef LWIP_MEMPOOL
+#undef LWIP_PBUF_MEMPOOL
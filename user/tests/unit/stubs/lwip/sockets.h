@@ -0,0 +1,14 @@
+#ifndef TEST_STUBS_LWIP_SOCKETS_H
+#define TEST_STUBS_LWIP_SOCKETS_H
+
+#include "lwip/opt.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define lwip_inet_ntop inet_ntop
+#define lwip_ntohs ntohs
+
+#endif // TEST_STUBS_LWIP_SOCKETS_H
@@ -0,0 +1,22 @@
+#ifndef TEST_STUBS_LWIP_STATS_H
+#define TEST_STUBS_LWIP_STATS_H
+
+#include "lwip/memp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct stats_ {
+    struct stats_mem mem;
+    struct stats_mem* memp[MEMP_MAX];
+};
+
+// Defined by the tests
+extern struct stats_ lwip_stats;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_STUBS_LWIP_STATS_H
@@ -0,0 +1,11 @@
+#ifndef TEST_STUBS_LWIP_SYS_H
+#define TEST_STUBS_LWIP_SYS_H
+
+#include "lwip/opt.h"
+
+// The stats are only accessed by the test thread
+#define SYS_ARCH_DECL_PROTECT(lev) int lev = 0
+#define SYS_ARCH_PROTECT(lev) (void)lev
+#define SYS_ARCH_UNPROTECT(lev) (void)lev
+
+#endif // TEST_STUBS_LWIP_SYS_H
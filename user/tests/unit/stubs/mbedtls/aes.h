@@ -0,0 +1,31 @@
+#ifndef TEST_STUBS_MBEDTLS_AES_H
+#define TEST_STUBS_MBEDTLS_AES_H
+
+#include <stddef.h>
+
+// Minimal replacement for the mbedTLS AES API. The block cipher is a XOR with the key, which
+// is enough to test the framing and the CBC chaining of the LightSSL records
+
+#define MBEDTLS_AES_ENCRYPT 1
+#define MBEDTLS_AES_DECRYPT 0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mbedtls_aes_context {
+    unsigned char key[16];
+} mbedtls_aes_context;
+
+void mbedtls_aes_init(mbedtls_aes_context* ctx);
+void mbedtls_aes_free(mbedtls_aes_context* ctx);
+int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits);
+int mbedtls_aes_setkey_dec(mbedtls_aes_context* ctx, const unsigned char* key, unsigned int keybits);
+int mbedtls_aes_crypt_cbc(mbedtls_aes_context* ctx, int mode, size_t length, unsigned char iv[16],
+        const unsigned char* input, unsigned char* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_STUBS_MBEDTLS_AES_H
@@ -0,0 +1,10 @@
+#ifndef TEST_STUBS_MBEDTLS_MD_H
+#define TEST_STUBS_MBEDTLS_MD_H
+
+typedef enum {
+    MBEDTLS_MD_NONE = 0
+} mbedtls_md_type_t;
+
+typedef struct mbedtls_md_info_t mbedtls_md_info_t;
+
+#endif // TEST_STUBS_MBEDTLS_MD_H
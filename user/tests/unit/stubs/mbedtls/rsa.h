@@ -0,0 +1,28 @@
+#ifndef TEST_STUBS_MBEDTLS_RSA_H
+#define TEST_STUBS_MBEDTLS_RSA_H
+
+#include <stddef.h>
+
+// Minimal replacement for the mbedTLS RSA API. Encryption copies the plaintext to the
+// ciphertext buffer
+
+#define MBEDTLS_RSA_PUBLIC 0
+#define MBEDTLS_RSA_PRIVATE 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mbedtls_rsa_context {
+    size_t len;
+} mbedtls_rsa_context;
+
+int mbedtls_rsa_pkcs1_encrypt(mbedtls_rsa_context* ctx, int (*f_rng)(void*, unsigned char*, size_t), void* p_rng,
+        int mode, size_t ilen, const unsigned char* input, unsigned char* output);
+void mbedtls_rsa_free(mbedtls_rsa_context* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEST_STUBS_MBEDTLS_RSA_H
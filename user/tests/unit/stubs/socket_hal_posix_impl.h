@@ -0,0 +1,10 @@
+#pragma once
+
+// Host sockets for code that uses the POSIX-compatible socket HAL. The sock_*() functions
+// themselves are provided by the tests
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <cerrno>
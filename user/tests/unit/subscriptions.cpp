@@ -0,0 +1,208 @@
+#include "protocol_defs.h"
+#include "events.h"
+#include "messages.h"
+#include "message_channel.h"
+#include "subscriptions.h"
+
+#include "tools/message_channel.h"
+#include "tools/catch.h"
+
+#include <string>
+
+namespace {
+
+using namespace particle::protocol;
+
+using test::LoopbackChannel;
+
+void handler1(const char* name, const char* data) {
+}
+
+void handler2(const char* name, const char* data) {
+}
+
+// Header of a bulk subscription request with the given message ID
+std::string bulkHeader(message_id_t id) {
+    return std::string("\x40\x01", 2) + (char)(id >> 8) + (char)(id & 0xff) + "\xb1" "e" "\x41" "b" "\xff";
+}
+
+std::string entry(uint8_t flags, const std::string& filter, const std::string& deviceId = std::string()) {
+    std::string s;
+    s += (char)flags;
+    s += (char)filter.size();
+    s += filter;
+    if (!deviceId.empty()) {
+        s += (char)deviceId.size();
+        s += deviceId;
+    }
+    return s;
+}
+
+// Single subscription request
+std::string subscription(const std::string& filter, message_id_t id, bool myDevices) {
+    uint8_t buf[128];
+    size_t n = ::subscription(buf, id, filter.c_str(), myDevices ? SubscriptionScope::MY_DEVICES :
+            SubscriptionScope::FIREHOSE);
+    return std::string((const char*)buf, n);
+}
+
+} // namespace
+
+TEST_CASE("bulk_subscription_entry()") {
+    uint8_t buf[BULK_SUBSCRIPTION_MAX_ENTRY_SIZE];
+
+    SECTION("encodes the scope and the device ID") {
+        size_t n = bulk_subscription_entry(buf, "abc", nullptr, SubscriptionScope::MY_DEVICES);
+        CHECK(std::string((const char*)buf, n) == entry(BulkSubscriptionFlag::MY_DEVICES, "abc"));
+        n = bulk_subscription_entry(buf, "abc", nullptr, SubscriptionScope::FIREHOSE);
+        CHECK(std::string((const char*)buf, n) == entry(0, "abc"));
+        n = bulk_subscription_entry(buf, "abc", "0123456789ab", SubscriptionScope::MY_DEVICES);
+        CHECK(std::string((const char*)buf, n) == entry(BulkSubscriptionFlag::DEVICE_ID, "abc", "0123456789ab"));
+    }
+
+    SECTION("unfiltered firehose subscriptions are not allowed") {
+        CHECK(bulk_subscription_entry(buf, "", nullptr, SubscriptionScope::FIREHOSE) == 0);
+        CHECK(bulk_subscription_entry(buf, "", nullptr, SubscriptionScope::MY_DEVICES) == 2);
+    }
+
+    SECTION("long filters are truncated") {
+        const std::string filter(100, 'x');
+        const size_t n = bulk_subscription_entry(buf, filter.c_str(), nullptr, SubscriptionScope::MY_DEVICES);
+        CHECK(n == 2 + 63);
+    }
+}
+
+TEST_CASE("Subscriptions") {
+    Subscriptions subs;
+    LoopbackChannel channel;
+
+    SECTION("all subscriptions are sent in a single message") {
+        REQUIRE(subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr) == NO_ERROR);
+        REQUIRE(subs.add_event_handler("def", handler1, nullptr, SubscriptionScope::FIREHOSE, nullptr) == NO_ERROR);
+        REQUIRE(subs.add_event_handler("ghi", handler1, nullptr, SubscriptionScope::MY_DEVICES, "0123456789ab") == NO_ERROR);
+        CHECK(subs.send_subscriptions(channel) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == bulkHeader(1) + entry(BulkSubscriptionFlag::MY_DEVICES, "abc") + entry(0, "def") +
+                entry(BulkSubscriptionFlag::DEVICE_ID, "ghi", "0123456789ab"));
+    }
+
+    SECTION("duplicate subscriptions are sent once") {
+        REQUIRE(subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr) == NO_ERROR);
+        REQUIRE(subs.add_event_handler("abc", handler2, nullptr, SubscriptionScope::MY_DEVICES, nullptr) == NO_ERROR);
+        CHECK(subs.send_subscriptions(channel) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == bulkHeader(1) + entry(BulkSubscriptionFlag::MY_DEVICES, "abc"));
+    }
+
+    SECTION("the request is split if it doesn't fit the channel's message size") {
+        LoopbackChannel small(9 /* header */ + 2 * (2 + 40));
+        const std::string f1(40, 'a'), f2(40, 'b'), f3(40, 'c');
+        subs.add_event_handler(f1.c_str(), handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.add_event_handler(f2.c_str(), handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.add_event_handler(f3.c_str(), handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        CHECK(subs.send_subscriptions(small) == NO_ERROR);
+        REQUIRE(small.sent().size() == 2);
+        CHECK(small.sent()[0] == bulkHeader(1) + entry(BulkSubscriptionFlag::MY_DEVICES, f1) +
+                entry(BulkSubscriptionFlag::MY_DEVICES, f2));
+        CHECK(small.sent()[1] == bulkHeader(2) + entry(BulkSubscriptionFlag::MY_DEVICES, f3));
+    }
+
+    SECTION("nothing is sent if there are no subscriptions") {
+        CHECK(subs.send_subscriptions(channel) == NO_ERROR);
+        CHECK(channel.sent().empty());
+    }
+
+    SECTION("a successful response doesn't trigger any retransmissions") {
+        subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.add_event_handler("def", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.send_subscriptions(channel);
+        channel.clearSent();
+        channel.push(LoopbackChannel::ack(1, CoAPCode::CONTENT, std::string("\x00\x05", 2)));
+        Message msg;
+        REQUIRE(channel.receive(msg) == NO_ERROR);
+        CHECK(subs.handle_response(1, CoAPCode::CONTENT, msg, channel) == NO_ERROR);
+        CHECK(channel.sent().empty());
+        CHECK(subs.bulk_enabled());
+    }
+
+    SECTION("unsupported bulk requests fall back to one message per subscription") {
+        subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.add_event_handler("def", handler1, nullptr, SubscriptionScope::FIREHOSE, nullptr);
+        subs.send_subscriptions(channel);
+        channel.clearSent();
+        channel.push(LoopbackChannel::ack(1, CoAPCode::NOT_FOUND));
+        Message msg;
+        REQUIRE(channel.receive(msg) == NO_ERROR);
+        CHECK(subs.handle_response(1, CoAPCode::NOT_FOUND, msg, channel) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(channel.sent()[0] == subscription("abc", 2, true));
+        CHECK(channel.sent()[1] == subscription("def", 3, false));
+        CHECK_FALSE(subs.bulk_enabled());
+        // Subsequent sessions don't use bulk requests
+        channel.clearSent();
+        subs.send_subscriptions(channel);
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(channel.sent()[0] == subscription("abc", 4, true));
+    }
+
+    SECTION("a reset in reply to a bulk request disables bulk requests for subsequent sessions") {
+        subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.send_subscriptions(channel);
+        channel.clearSent();
+        // Resets of other messages don't affect bulk requests
+        subs.handle_reset(2);
+        CHECK(subs.bulk_enabled());
+        // The protocol reports a reset as a server error
+        subs.handle_reset(1);
+        Message msg;
+        CHECK(subs.handle_response(1, CoAPCode::INTERNAL_SERVER_ERROR, msg, channel) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == subscription("abc", 2, true));
+        CHECK_FALSE(subs.bulk_enabled());
+        // A new session doesn't send a bulk request that would be reset again
+        subs.cancel_bulk_requests();
+        channel.clearSent();
+        subs.send_subscriptions(channel);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == subscription("abc", 3, true));
+    }
+
+    SECTION("server errors fall back to one message per subscription for the current session only") {
+        subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.send_subscriptions(channel);
+        channel.clearSent();
+        Message msg;
+        CHECK(subs.handle_response(1, CoAPCode::INTERNAL_SERVER_ERROR, msg, channel) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK(channel.sent()[0] == subscription("abc", 2, true));
+        CHECK(subs.bulk_enabled());
+    }
+
+    SECTION("responses to other messages are ignored") {
+        subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.send_subscriptions(channel);
+        channel.clearSent();
+        Message msg;
+        CHECK(subs.handle_response(2, CoAPCode::NOT_FOUND, msg, channel) == NO_ERROR);
+        CHECK(channel.sent().empty());
+        // A request is handled once
+        CHECK(subs.handle_response(1, CoAPCode::NOT_FOUND, msg, channel) == NO_ERROR);
+        CHECK(subs.handle_response(1, CoAPCode::NOT_FOUND, msg, channel) == NO_ERROR);
+        CHECK(channel.sent().size() == 1);
+    }
+
+    SECTION("bulk requests can be disabled") {
+        subs.set_bulk_enabled(false);
+        subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.add_event_handler("def", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        subs.send_subscriptions(channel);
+        REQUIRE(channel.sent().size() == 2);
+        CHECK(channel.sent()[0] == subscription("abc", 1, true));
+    }
+
+    SECTION("send errors are reported") {
+        subs.add_event_handler("abc", handler1, nullptr, SubscriptionScope::MY_DEVICES, nullptr);
+        channel.sendError(IO_ERROR_GENERIC_SEND);
+        CHECK(subs.send_subscriptions(channel) == IO_ERROR_GENERIC_SEND);
+    }
+}
@@ -0,0 +1,87 @@
+#include "token_bucket.h"
+
+#include "tools/catch.h"
+
+using particle::protocol::TokenBucket;
+
+namespace {
+
+unsigned consumeAll(TokenBucket& bucket, system_tick_t now) {
+    unsigned n = 0;
+    while (bucket.consume(now)) {
+        ++n;
+    }
+    return n;
+}
+
+} // namespace
+
+TEST_CASE("TokenBucket") {
+    TokenBucket bucket(250 /* interval */, 4 /* burst */);
+
+    SECTION("a full bucket allows a burst of operations") {
+        CHECK(consumeAll(bucket, 1000) == 4);
+        CHECK(bucket.available(1000) == 0);
+    }
+
+    SECTION("tokens are added at a fixed interval") {
+        consumeAll(bucket, 1000);
+        CHECK_FALSE(bucket.consume(1249));
+        CHECK(bucket.wait_time(1249) == 1);
+        CHECK(bucket.consume(1250));
+        CHECK_FALSE(bucket.consume(1250));
+        CHECK(bucket.wait_time(1250) == 250);
+        // The fractional part of the interval is not lost
+        CHECK(bucket.consume(1500));
+        CHECK(bucket.available(1999) == 1);
+        CHECK(bucket.available(2000) == 2);
+    }
+
+    SECTION("the sustained rate is limited to one operation per interval") {
+        unsigned n = 0;
+        for (system_tick_t t = 0; t < 10000; t += 10) {
+            if (bucket.consume(t)) {
+                ++n;
+            }
+        }
+        // Initial burst plus one token per interval
+        CHECK(n == 4 + 39);
+    }
+
+    SECTION("the number of tokens doesn't exceed the capacity") {
+        consumeAll(bucket, 1000);
+        CHECK(bucket.available(100000) == 4);
+        CHECK(consumeAll(bucket, 100000) == 4);
+    }
+
+    SECTION("the refill period starts when a token is taken from a full bucket") {
+        CHECK(bucket.available(1000) == 4);
+        CHECK(bucket.consume(5000));
+        CHECK(bucket.available(5249) == 3);
+        CHECK(bucket.available(5250) == 4);
+    }
+
+    SECTION("the tick counter is allowed to overflow") {
+        const system_tick_t t = (system_tick_t)-100;
+        CHECK(consumeAll(bucket, t) == 4);
+        CHECK(bucket.wait_time(t + 50) == 200);
+        CHECK(bucket.consume(t + 250));
+        CHECK(bucket.available(t + 1250) == 4);
+    }
+
+    SECTION("the bucket can be reconfigured") {
+        bucket.configure(1000, 2);
+        CHECK(bucket.capacity() == 2);
+        CHECK(bucket.refill_interval() == 1000);
+        CHECK(consumeAll(bucket, 0) == 2);
+        CHECK(bucket.wait_time(0) == 1000);
+        bucket.reset();
+        CHECK(consumeAll(bucket, 0) == 2);
+    }
+
+    SECTION("zero interval and capacity are adjusted") {
+        bucket.configure(0, 0);
+        CHECK(bucket.capacity() == 1);
+        CHECK(bucket.refill_interval() == 1);
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef TEST_TOOLS_AT_MODEM_H
+#define TEST_TOOLS_AT_MODEM_H
+
+#include <stream.h> // particle::Stream, not tools/stream.h
+#include "system_error.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+
+namespace test {
+
+// Stream emulating a DCE that echoes each command line and replies to it with a scripted response
+class ScriptedModem: public particle::Stream {
+public:
+    // Adds a response to the next command
+    void reply(const std::string& resp);
+    // Makes the data available for reading immediately, e.g. an URC
+    void push(const std::string& data);
+
+    const std::vector<std::string>& commands() const;
+    void clearCommands();
+
+    int read(char* data, size_t size) override;
+    int peek(char* data, size_t size) override;
+    int skip(size_t size) override;
+    int availForRead() override;
+    int write(const char* data, size_t size) override;
+    int flush() override;
+    int availForWrite() override;
+    int waitEvent(unsigned flags, unsigned timeout) override;
+
+private:
+    std::deque<std::string> replies_;
+    std::vector<std::string> cmds_;
+    std::string out_;
+    std::string in_;
+};
+
+} // namespace test
+
+inline void test::ScriptedModem::reply(const std::string& resp) {
+    replies_.push_back(resp);
+}
+
+inline void test::ScriptedModem::push(const std::string& data) {
+    in_ += data;
+}
+
+inline const std::vector<std::string>& test::ScriptedModem::commands() const {
+    return cmds_;
+}
+
+inline void test::ScriptedModem::clearCommands() {
+    cmds_.clear();
+}
+
+inline int test::ScriptedModem::read(char* data, size_t size) {
+    const int n = peek(data, size);
+    in_.erase(0, n);
+    return n;
+}
+
+inline int test::ScriptedModem::peek(char* data, size_t size) {
+    const size_t n = std::min(size, in_.size());
+    memcpy(data, in_.data(), n);
+    return n;
+}
+
+inline int test::ScriptedModem::skip(size_t size) {
+    const size_t n = std::min(size, in_.size());
+    in_.erase(0, n);
+    return n;
+}
+
+inline int test::ScriptedModem::availForRead() {
+    return in_.size();
+}
+
+inline int test::ScriptedModem::write(const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == '\r') {
+            cmds_.push_back(out_);
+            in_ += out_ + "\r"; // Echo
+            out_.clear();
+            if (!replies_.empty()) {
+                in_ += replies_.front();
+                replies_.pop_front();
+            }
+        } else if (data[i] != '\n') {
+            out_ += data[i];
+        }
+    }
+    return size;
+}
+
+inline int test::ScriptedModem::flush() {
+    return 0;
+}
+
+inline int test::ScriptedModem::availForWrite() {
+    return 1024;
+}
+
+inline int test::ScriptedModem::waitEvent(unsigned flags, unsigned timeout) {
+    unsigned f = flags & WRITABLE;
+    if ((flags & READABLE) && !in_.empty()) {
+        f |= READABLE;
+    }
+    if (!f) {
+        return SYSTEM_ERROR_TIMEOUT;
+    }
+    return f;
+}
+
+#endif // TEST_TOOLS_AT_MODEM_H
@@ -4,7 +4,11 @@
 #define CATCH_CONFIG_PREFIX_ALL
 #include <catch.hpp>
 
-// Non-prefixed aliases for some typical macros that don't clash with the firmware
+// Non-prefixed aliases for some typical macros. The firmware's check.h defines CHECK() and
+// CHECK_FALSE() as well, so the tests include the firmware headers first and get Catch's macros
+#undef CHECK
+#undef CHECK_FALSE
+
 #define CHECK(...) CATCH_CHECK(__VA_ARGS__)
 #define CHECK_FALSE(...) CATCH_CHECK_FALSE(__VA_ARGS__)
 #define REQUIRE(...) CATCH_REQUIRE(__VA_ARGS__)
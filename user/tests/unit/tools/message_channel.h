@@ -0,0 +1,152 @@
+#ifndef TEST_TOOLS_MESSAGE_CHANNEL_H
+#define TEST_TOOLS_MESSAGE_CHANNEL_H
+
+#include "message_channel.h"
+#include "coap.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+
+namespace test {
+
+// Message channel that records the sent messages and lets the test act as the server peer
+class LoopbackChannel: public particle::protocol::MessageChannel {
+public:
+    typedef particle::protocol::Message Message;
+    typedef particle::protocol::ProtocolError ProtocolError;
+
+    explicit LoopbackChannel(size_t mtu = 512);
+
+    // Queues a message for receive()
+    void push(const std::string& data);
+    // Builds a piggybacked ACK with the given response code and payload
+    static std::string ack(particle::protocol::message_id_t id, particle::protocol::CoAPCode::Enum code,
+            const std::string& payload = std::string());
+
+    const std::vector<std::string>& sent() const;
+    void clearSent();
+    // Makes the next send() calls fail
+    void sendError(ProtocolError error);
+
+    bool is_unreliable() override;
+    ProtocolError establish(uint32_t& flags, uint32_t app_state_crc) override;
+    ProtocolError create(Message& message, size_t minimum_size = 0) override;
+    ProtocolError response(Message& original, Message& response, size_t required) override;
+    ProtocolError notify_established() override;
+    ProtocolError receive(Message& message) override;
+    ProtocolError send(Message& msg) override;
+    ProtocolError command(Command cmd, void* arg = nullptr) override;
+
+private:
+    std::vector<uint8_t> buf_;
+    std::vector<uint8_t> resp_;
+    std::deque<std::string> in_;
+    std::vector<std::string> sent_;
+    particle::protocol::message_id_t nextId_;
+    ProtocolError sendError_;
+};
+
+inline LoopbackChannel::LoopbackChannel(size_t mtu) :
+        buf_(mtu),
+        resp_(mtu),
+        nextId_(1),
+        sendError_(particle::protocol::NO_ERROR) {
+}
+
+inline void LoopbackChannel::push(const std::string& data) {
+    in_.push_back(data);
+}
+
+inline std::string LoopbackChannel::ack(particle::protocol::message_id_t id, particle::protocol::CoAPCode::Enum code,
+        const std::string& payload) {
+    std::string s;
+    s += (char)0x60; // ACK, no token
+    s += (char)code;
+    s += (char)(id >> 8);
+    s += (char)(id & 0xff);
+    if (!payload.empty()) {
+        s += (char)0xff;
+        s += payload;
+    }
+    return s;
+}
+
+inline const std::vector<std::string>& LoopbackChannel::sent() const {
+    return sent_;
+}
+
+inline void LoopbackChannel::clearSent() {
+    sent_.clear();
+}
+
+inline void LoopbackChannel::sendError(ProtocolError error) {
+    sendError_ = error;
+}
+
+inline bool LoopbackChannel::is_unreliable() {
+    return true;
+}
+
+inline particle::protocol::ProtocolError LoopbackChannel::establish(uint32_t& flags, uint32_t app_state_crc) {
+    return particle::protocol::NO_ERROR;
+}
+
+inline particle::protocol::ProtocolError LoopbackChannel::create(Message& message, size_t minimum_size) {
+    if (minimum_size > buf_.size()) {
+        return particle::protocol::INSUFFICIENT_STORAGE;
+    }
+    message.clear();
+    message.set_buffer(buf_.data(), buf_.size());
+    return particle::protocol::NO_ERROR;
+}
+
+inline particle::protocol::ProtocolError LoopbackChannel::response(Message& original, Message& response, size_t required) {
+    if (required > resp_.size()) {
+        return particle::protocol::INSUFFICIENT_STORAGE;
+    }
+    response.set_buffer(resp_.data(), resp_.size());
+    return particle::protocol::NO_ERROR;
+}
+
+inline particle::protocol::ProtocolError LoopbackChannel::notify_established() {
+    return particle::protocol::NO_ERROR;
+}
+
+inline particle::protocol::ProtocolError LoopbackChannel::receive(Message& message) {
+    message.set_buffer(buf_.data(), buf_.size());
+    if (!in_.empty()) {
+        const std::string data = in_.front();
+        in_.pop_front();
+        memcpy(buf_.data(), data.data(), std::min(data.size(), buf_.size()));
+        message.set_length(std::min(data.size(), buf_.size()));
+        message.decode_id();
+    }
+    return particle::protocol::NO_ERROR;
+}
+
+inline particle::protocol::ProtocolError LoopbackChannel::send(Message& msg) {
+    if (sendError_ != particle::protocol::NO_ERROR) {
+        return sendError_;
+    }
+    uint8_t* const buf = msg.buf();
+    if (msg.length() >= 4 && !msg.has_id()) {
+        // Assign a message ID, similarly to the CoAP channel
+        const auto id = nextId_++;
+        buf[2] = id >> 8;
+        buf[3] = id & 0xff;
+        msg.set_id(id);
+    }
+    sent_.push_back(std::string((const char*)buf, msg.length()));
+    return particle::protocol::NO_ERROR;
+}
+
+inline particle::protocol::ProtocolError LoopbackChannel::command(Command cmd, void* arg) {
+    return particle::protocol::NO_ERROR;
+}
+
+} // namespace test
+
+#endif // TEST_TOOLS_MESSAGE_CHANNEL_H
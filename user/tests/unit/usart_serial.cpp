@@ -0,0 +1,131 @@
+#include "spark_wiring_usartserial.h"
+#include "socket_hal.h"
+
+#include "tools/catch.h"
+
+#include <string>
+
+namespace {
+
+// The gcc USART HAL moves data through a TCP socket: the stubs below stand in for its peer
+const sock_handle_t PEER_SOCKET = 1;
+
+std::string peerRx; // Data sent by the USART
+std::string peerTx; // Data to be received by the USART
+
+class Peer {
+public:
+    Peer() {
+        peerRx.clear();
+        peerTx.clear();
+    }
+
+    void send(const std::string& data) {
+        peerTx += data;
+    }
+
+    std::string received() const {
+        return peerRx;
+    }
+};
+
+std::string pattern(size_t size) {
+    std::string s;
+    for (size_t i = 0; i < size; ++i) {
+        s += (char)('a' + i % 26);
+    }
+    return s;
+}
+
+} // namespace
+
+sock_handle_t socket_create(uint8_t family, uint8_t type, uint8_t protocol, uint16_t port, network_interface_t nif) {
+    return PEER_SOCKET;
+}
+
+sock_result_t socket_connect(sock_handle_t sd, const sockaddr_t* addr, long addrlen) {
+    return 0;
+}
+
+sock_result_t socket_receive(sock_handle_t sd, void* buffer, socklen_t len, system_tick_t timeout) {
+    const size_t n = std::min((size_t)len, peerTx.size());
+    memcpy(buffer, peerTx.data(), n);
+    peerTx.erase(0, n);
+    return n;
+}
+
+sock_result_t socket_send(sock_handle_t sd, const void* buffer, socklen_t len) {
+    peerRx.append((const char*)buffer, len);
+    return len;
+}
+
+sock_result_t socket_close(sock_handle_t sd) {
+    return 0;
+}
+
+TEST_CASE("USARTSerial") {
+    Ring_Buffer rxRing = {};
+    Ring_Buffer txRing = {};
+    USARTSerial serial(HAL_USART_SERIAL2, &rxRing, &txRing);
+    serial.setTimeout(10);
+    Peer peer;
+
+    SECTION("begin() with buffer sizes enables the port") {
+        CHECK(serial.begin(460800, SERIAL_8N1, 1024, 512));
+        CHECK(serial.isEnabled());
+        CHECK(serial.availableForWrite() == 512);
+    }
+
+    SECTION("begin() rejects invalid buffer sizes") {
+        CHECK_FALSE(serial.begin(460800, SERIAL_8N1, 0, 512));
+        CHECK_FALSE(serial.begin(460800, SERIAL_8N1, 1024, 0));
+        CHECK_FALSE(serial.begin(460800, SERIAL_8N1, 70000, 512));
+    }
+
+    SECTION("the RX buffer holds as many bytes as requested") {
+        REQUIRE(serial.begin(460800, SERIAL_8N1, 1000, 100));
+        const auto data = pattern(1500);
+        peer.send(data);
+        CHECK(serial.available() == 1000);
+        char buf[1500] = {};
+        CHECK(serial.readBytes(buf, sizeof(buf)) == 1500);
+        CHECK(std::string(buf, sizeof(buf)) == data);
+    }
+
+    SECTION("the port keeps working after the buffers are replaced") {
+        REQUIRE(serial.begin(460800, SERIAL_8N1, 16, 16));
+        peer.send("abc");
+        CHECK(serial.read() == 'a');
+        REQUIRE(serial.begin(460800, SERIAL_8N1, 256, 256));
+        peer.send(pattern(200));
+        CHECK(serial.available() == 200);
+        CHECK(serial.write((const uint8_t*)"hello", 5) == 5);
+        CHECK(peer.received() == "hello");
+    }
+
+    SECTION("write() sends a block larger than the TX buffer") {
+        REQUIRE(serial.begin(460800, SERIAL_8N1, 64, 32));
+        const auto data = pattern(1000);
+        CHECK(serial.write((const uint8_t*)data.data(), data.size()) == 1000);
+        CHECK(peer.received() == data);
+    }
+
+    SECTION("readBytes() returns what was received before the timeout") {
+        REQUIRE(serial.begin(460800, SERIAL_8N1, 64, 64));
+        peer.send("12345");
+        char buf[10] = {};
+        CHECK(serial.readBytes(buf, sizeof(buf)) == 5);
+        CHECK(std::string(buf) == "12345");
+    }
+
+    SECTION("the port is disabled after end()") {
+        REQUIRE(serial.begin(460800, SERIAL_8N1, 64, 64));
+        serial.end();
+        CHECK_FALSE(serial.isEnabled());
+        CHECK(serial.write((const uint8_t*)"x", 1) == 0);
+        char c = 0;
+        CHECK(serial.readBytes(&c, 1) == 0);
+    }
+
+    serial.end();
+}
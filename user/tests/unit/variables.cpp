@@ -0,0 +1,308 @@
+#include "variables.h"
+
+#include "tools/message_channel.h"
+#include "tools/catch.h"
+
+#include <string>
+#include <map>
+
+namespace {
+
+using namespace particle::protocol;
+
+using test::LoopbackChannel;
+
+const token_t TOKEN = 0x2a;
+
+std::map<std::string, int> g_vars;
+
+SparkReturnType::Enum variableType(const char* key) {
+    return SparkReturnType::INT;
+}
+
+const void* getVariable(const char* key) {
+    const auto it = g_vars.find(key);
+    return (it != g_vars.end()) ? &it->second : nullptr;
+}
+
+uint32_t calculateCrc(const unsigned char* buf, uint32_t size) {
+    uint32_t crc = 0;
+    while (size--) {
+        crc = crc * 31 + *buf++;
+    }
+    return crc;
+}
+
+// Variable request: CON GET /v/<key>, optionally with the Observe option
+std::string variableRequest(message_id_t id, const std::string& key, int32_t observe) {
+    uint8_t buf[64];
+    size_t size = CoAP::header(buf, CoAPType::CON, CoAPCode::GET, sizeof(TOKEN), &TOKEN, id);
+    CoAPOption::Enum prev = CoAPOption::NONE;
+    if (observe != Variables::OBSERVE_NONE) {
+        uint8_t val[4];
+        size += CoAP::add_option(buf + size, prev, CoAPOption::OBSERVE, val, CoAP::encode_option_uint(val, observe));
+        prev = CoAPOption::OBSERVE;
+    }
+    size += CoAP::uri_path(buf + size, prev, "v");
+    size += CoAP::uri_path(buf + size, CoAPOption::URI_PATH, key.c_str());
+    return std::string((const char*)buf, size);
+}
+
+bool hasObserveOption(const std::string& msg, uint32_t* value = nullptr) {
+    size_t size = 0;
+    const auto opt = CoAP::find_option((const uint8_t*)msg.data(), msg.size(), CoAPOption::OBSERVE, &size);
+    if (opt && value) {
+        *value = CoAP::option_uint(opt, size);
+    }
+    return opt;
+}
+
+CoAPType::Enum messageType(const std::string& msg) {
+    return CoAP::type((const uint8_t*)msg.data());
+}
+
+message_id_t messageId(const std::string& msg) {
+    return (message_id_t)((uint8_t)msg[2] << 8 | (uint8_t)msg[3]);
+}
+
+// The value is encoded as a 32-bit big-endian integer at the end of the message
+int payloadValue(const std::string& msg) {
+    REQUIRE(msg.size() >= 4);
+    const auto p = (const uint8_t*)msg.data() + msg.size() - 4;
+    return (int)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]);
+}
+
+class VariableServer {
+public:
+    explicit VariableServer(Variables& vars, LoopbackChannel& channel) :
+            vars_(vars),
+            channel_(channel) {
+    }
+
+    ProtocolError request(message_id_t id, const std::string& key, int32_t observe, system_tick_t now) {
+        const std::string req = variableRequest(id, key, observe);
+        uint8_t buf[128] = {};
+        memcpy(buf, req.data(), req.size());
+        Message msg(buf, sizeof(buf), req.size());
+        if (Messages::decodeType(buf, msg.length()) != CoAPMessageType::VARIABLE_REQUEST) {
+            return UNKNOWN;
+        }
+        char decodedKey[MAX_VARIABLE_KEY_LENGTH + 1] = {};
+        int32_t decodedObserve = 0;
+        vars_.decode_variable_request(decodedKey, msg, &decodedObserve);
+        if (decodedKey != key || decodedObserve != observe) {
+            return UNKNOWN;
+        }
+        return vars_.handle_variable_request(decodedKey, msg, channel_, TOKEN, id, variableType, getVariable,
+                decodedObserve, now, calculateCrc);
+    }
+
+    ProtocolError process(system_tick_t now) {
+        return vars_.process(channel_, now, variableType, getVariable, calculateCrc);
+    }
+
+private:
+    Variables& vars_;
+    LoopbackChannel& channel_;
+};
+
+} // namespace
+
+TEST_CASE("Variables") {
+    Variables vars;
+    LoopbackChannel channel;
+    VariableServer server(vars, channel);
+    g_vars.clear();
+    g_vars["temp"] = 21;
+    const int32_t observeNone = Variables::OBSERVE_NONE;
+    const int32_t observeRegister = Variables::OBSERVE_REGISTER;
+    const int32_t observeDeregister = Variables::OBSERVE_DEREGISTER;
+
+    SECTION("a request without the Observe option doesn't register an observer") {
+        REQUIRE(server.request(0x1234, "temp", observeNone, 0) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        CHECK_FALSE(hasObserveOption(channel.sent()[0]));
+        CHECK(payloadValue(channel.sent()[0]) == 21);
+        CHECK(vars.observed_count() == 0);
+    }
+
+    SECTION("the response to a registration request carries the current value") {
+        REQUIRE(server.request(0x1234, "temp", observeRegister, 0) == NO_ERROR);
+        CHECK(vars.observed_count() == 1);
+        REQUIRE(channel.sent().size() == 1);
+        const auto& ack = channel.sent()[0];
+        CHECK(messageType(ack) == CoAPType::ACK);
+        CHECK(CoAP::code((const uint8_t*)ack.data()) == CoAPCode::CONTENT);
+        CHECK(messageId(ack) == 0x1234);
+        uint32_t seq = 1000;
+        CHECK(hasObserveOption(ack, &seq));
+        CHECK(seq == 0);
+        CHECK(payloadValue(ack) == 21);
+    }
+
+    SECTION("the observer table") {
+        const unsigned maxObservers = Variables::MAX_VARIABLE_OBSERVERS;
+        for (unsigned i = 0; i <= maxObservers; ++i) {
+            g_vars["var" + std::to_string(i)] = i;
+        }
+
+        SECTION("a repeated registration doesn't add another observer") {
+            REQUIRE(server.request(1, "temp", observeRegister, 0) == NO_ERROR);
+            REQUIRE(server.request(2, "temp", observeRegister, 0) == NO_ERROR);
+            CHECK(vars.observed_count() == 1);
+        }
+
+        SECTION("a variable that doesn't fit the table is returned as a regular response") {
+            for (unsigned i = 0; i < maxObservers; ++i) {
+                REQUIRE(server.request(i + 1, "var" + std::to_string(i), observeRegister, 0) == NO_ERROR);
+            }
+            CHECK(vars.observed_count() == maxObservers);
+            channel.clearSent();
+            REQUIRE(server.request(100, "temp", observeRegister, 0) == NO_ERROR);
+            CHECK(vars.observed_count() == maxObservers);
+            REQUIRE(channel.sent().size() == 1);
+            CHECK_FALSE(hasObserveOption(channel.sent()[0]));
+            CHECK(payloadValue(channel.sent()[0]) == 21);
+            // A deregistration frees an entry
+            REQUIRE(server.request(101, "var0", observeDeregister, 0) == NO_ERROR);
+            CHECK(vars.observed_count() == maxObservers - 1);
+            REQUIRE(server.request(102, "temp", observeRegister, 0) == NO_ERROR);
+            CHECK(vars.observed_count() == maxObservers);
+            CHECK(hasObserveOption(channel.sent().back()));
+        }
+
+        SECTION("an unknown variable is not observed") {
+            REQUIRE(server.request(1, "other", observeRegister, 0) != NO_ERROR);
+            CHECK(vars.observed_count() == 0);
+        }
+
+        SECTION("a session reset removes all observers") {
+            REQUIRE(server.request(1, "temp", observeRegister, 0) == NO_ERROR);
+            REQUIRE(server.request(2, "var0", observeRegister, 0) == NO_ERROR);
+            vars.reset();
+            CHECK(vars.observed_count() == 0);
+            g_vars["temp"] = 22;
+            channel.clearSent();
+            REQUIRE(server.process(5000) == NO_ERROR);
+            CHECK(channel.sent().empty());
+        }
+    }
+
+    SECTION("notification pacing") {
+        REQUIRE(server.request(0x1234, "temp", observeRegister, 0) == NO_ERROR);
+        channel.clearSent();
+
+        SECTION("no notification is sent if the value doesn't change") {
+            REQUIRE(server.process(5000) == NO_ERROR);
+            CHECK(channel.sent().empty());
+        }
+
+        SECTION("a changed value is notified after the minimum interval") {
+            g_vars["temp"] = 22;
+            REQUIRE(server.process(500) == NO_ERROR);
+            CHECK(channel.sent().empty());
+            REQUIRE(server.process(1000) == NO_ERROR);
+            REQUIRE(channel.sent().size() == 1);
+            const auto& msg = channel.sent()[0];
+            CHECK(messageType(msg) == CoAPType::NON);
+            CHECK(msg[4] == (char)TOKEN);
+            uint32_t seq = 0;
+            CHECK(hasObserveOption(msg, &seq));
+            CHECK(seq == 1);
+            CHECK(payloadValue(msg) == 22);
+        }
+
+        SECTION("consecutive changes are not notified more often than the minimum interval") {
+            vars.set_min_interval(2000);
+            g_vars["temp"] = 22;
+            REQUIRE(server.process(2000) == NO_ERROR);
+            CHECK(channel.sent().size() == 1);
+            g_vars["temp"] = 23;
+            REQUIRE(server.process(3000) == NO_ERROR);
+            CHECK(channel.sent().size() == 1);
+            REQUIRE(server.process(4000) == NO_ERROR);
+            REQUIRE(channel.sent().size() == 2);
+            CHECK(payloadValue(channel.sent()[1]) == 23);
+        }
+
+        SECTION("an explicitly notified variable is sent even if its value is unchanged") {
+            CHECK(vars.notify("temp"));
+            CHECK_FALSE(vars.notify("other"));
+            REQUIRE(server.process(500) == NO_ERROR);
+            CHECK(channel.sent().empty());
+            REQUIRE(server.process(1000) == NO_ERROR);
+            CHECK(channel.sent().size() == 1);
+        }
+
+        SECTION("an unchanged value is refreshed after the maximum interval") {
+            vars.set_max_interval(10000);
+            REQUIRE(server.process(9999) == NO_ERROR);
+            CHECK(channel.sent().empty());
+            REQUIRE(server.process(10000) == NO_ERROR);
+            CHECK(channel.sent().size() == 1);
+        }
+
+        SECTION("every Nth notification is confirmable") {
+            vars.set_confirmable_ratio(2);
+            for (int i = 1; i <= 3; ++i) {
+                g_vars["temp"] = 21 + i;
+                REQUIRE(server.process(i * 1000) == NO_ERROR);
+            }
+            REQUIRE(channel.sent().size() == 3);
+            CHECK(messageType(channel.sent()[0]) == CoAPType::CON);
+            CHECK(messageType(channel.sent()[1]) == CoAPType::NON);
+            CHECK(messageType(channel.sent()[2]) == CoAPType::CON);
+            uint32_t seq = 0;
+            CHECK(hasObserveOption(channel.sent()[2], &seq));
+            CHECK(seq == 3);
+        }
+
+        SECTION("a failed notification is retried when the value is checked next time") {
+            g_vars["temp"] = 22;
+            channel.sendError(IO_ERROR_GENERIC_SEND);
+            CHECK(server.process(1000) != NO_ERROR);
+            channel.sendError(NO_ERROR);
+            REQUIRE(server.process(1500) == NO_ERROR);
+            CHECK(channel.sent().empty());
+            REQUIRE(server.process(2000) == NO_ERROR);
+            REQUIRE(channel.sent().size() == 1);
+            CHECK(payloadValue(channel.sent()[0]) == 22);
+        }
+    }
+
+    SECTION("reset handling") {
+        REQUIRE(server.request(0x1234, "temp", observeRegister, 0) == NO_ERROR);
+        g_vars["temp"] = 30;
+        channel.clearSent();
+        REQUIRE(server.process(1000) == NO_ERROR);
+        REQUIRE(channel.sent().size() == 1);
+        const message_id_t id = messageId(channel.sent()[0]);
+
+        SECTION("a reset for another message doesn't remove the observer") {
+            CHECK_FALSE(vars.handle_reset(id + 1));
+            CHECK(vars.observed_count() == 1);
+        }
+
+        SECTION("a reset for a notification removes the observer") {
+            CHECK(vars.handle_reset(id));
+            CHECK(vars.observed_count() == 0);
+            g_vars["temp"] = 31;
+            REQUIRE(server.process(2000) == NO_ERROR);
+            CHECK(channel.sent().size() == 1);
+            CHECK_FALSE(vars.handle_reset(id));
+        }
+
+        SECTION("a reset for the registration response doesn't remove the observer") {
+            CHECK_FALSE(vars.handle_reset(0x1234));
+            CHECK(vars.observed_count() == 1);
+        }
+
+        SECTION("a deregistration request removes the observer and gets a regular response") {
+            REQUIRE(server.request(0x1235, "temp", observeDeregister, 1000) == NO_ERROR);
+            CHECK(vars.observed_count() == 0);
+            REQUIRE(channel.sent().size() == 2);
+            CHECK_FALSE(hasObserveOption(channel.sent()[1]));
+            CHECK(payloadValue(channel.sent()[1]) == 30);
+        }
+    }
+}
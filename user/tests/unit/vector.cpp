@@ -146,11 +146,59 @@ private:
 
 size_t NonTrivialInt::s_count = 0;
 
+// Non-trivially copyable type that can be relocated via memcpy()
+class RelocatableInt: public NonTrivialInt {
+public:
+    using NonTrivialInt::NonTrivialInt;
+
+    RelocatableInt(const RelocatableInt& value) :
+            NonTrivialInt(value) {
+        ++s_copyCount;
+    }
+
+    RelocatableInt(RelocatableInt&& value) :
+            NonTrivialInt(std::move(value)) {
+        ++s_copyCount;
+    }
+
+    RelocatableInt& operator=(const RelocatableInt&) = default;
+
+    static size_t s_copyCount;
+};
+
+size_t RelocatableInt::s_copyCount = 0;
+
+// Allocator counting the number of allocations
+struct CountingAllocator {
+    static void* malloc(size_t size) {
+        ++s_allocCount;
+        return test::DefaultAllocator::malloc(size);
+    }
+
+    static void* realloc(void* ptr, size_t size) {
+        ++s_allocCount;
+        return test::DefaultAllocator::realloc(ptr, size);
+    }
+
+    static void free(void* ptr) {
+        test::DefaultAllocator::free(ptr);
+    }
+
+    static size_t s_allocCount;
+};
+
+size_t CountingAllocator::s_allocCount = 0;
+
 static_assert(!PARTICLE_VECTOR_TRIVIALLY_COPYABLE_TRAIT<NonTrivialInt>::value, "NonTrivialInt is too trivial!");
 
-template<typename T, typename AllocatorT>
-inline Checker<spark::Vector<T, AllocatorT>> check(const spark::Vector<T, AllocatorT> &vector) {
-    return Checker<spark::Vector<T, AllocatorT>>(vector);
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline Checker<spark::Vector<T, AllocatorT, GrowthPolicyT>> check(const spark::Vector<T, AllocatorT, GrowthPolicyT> &vector) {
+    return Checker<spark::Vector<T, AllocatorT, GrowthPolicyT>>(vector);
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline Checker<spark::Vector<T, AllocatorT, GrowthPolicyT>> check(const spark::SmallVector<T, N, AllocatorT, GrowthPolicyT> &vector) {
+    return Checker<spark::Vector<T, AllocatorT, GrowthPolicyT>>(vector);
 }
 
 template<typename VectorT>
@@ -314,7 +362,7 @@ void testVector() {
             REQUIRE(a.insert(0, 1)); // i = 0
             check(a).values(1, 2, 4, 5).capacity(4);
             REQUIRE(a.insert(4, 6)); // i = size()
-            check(a).values(1, 2, 4, 5, 6).capacity(5);
+            check(a).values(1, 2, 4, 5, 6).capacity(6); // grows by a factor of 1.5
             REQUIRE(a.insert(2, 3)); // i = size() / 2
             check(a).values(1, 2, 3, 4, 5, 6).capacity(6);
             Vector b;
@@ -652,6 +700,14 @@ void testVector() {
 
 } // namespace
 
+namespace spark {
+
+template<>
+struct IsTriviallyRelocatable<RelocatableInt>: std::true_type {
+};
+
+} // namespace spark
+
 TEST_CASE("Vector<int>") {
     test::DefaultAllocator::reset();
 
@@ -670,3 +726,108 @@ TEST_CASE("Vector<NonTrivialInt>") {
     test::DefaultAllocator::check();
     CHECK(NonTrivialInt::instanceCount() == 0);
 }
+
+TEST_CASE("Vector growth") {
+    test::DefaultAllocator::reset();
+
+    SECTION("append() allocates memory an amortized O(1) number of times") {
+        CountingAllocator::s_allocCount = 0;
+        spark::Vector<int, CountingAllocator> a;
+        for (int i = 0; i < 10000; ++i) {
+            REQUIRE(a.append(i));
+        }
+        check(a).size(10000);
+        CHECK(CountingAllocator::s_allocCount < 30);
+        REQUIRE(a.trimToSize());
+        check(a).size(10000).capacity(10000);
+    }
+
+    SECTION("ExactGrowthPolicy allocates memory for each appended element") {
+        CountingAllocator::s_allocCount = 0;
+        spark::Vector<int, CountingAllocator, spark::ExactGrowthPolicy> a;
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(a.append(i));
+            check(a).size(i + 1).capacity(i + 1);
+        }
+        CHECK(CountingAllocator::s_allocCount == 100);
+    }
+
+    SECTION("trivially relocatable elements are not copied on reallocation") {
+        RelocatableInt::s_copyCount = 0;
+        {
+            spark::Vector<RelocatableInt, test::DefaultAllocator> a;
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(a.append(RelocatableInt(i)));
+            }
+            REQUIRE(a.prepend(RelocatableInt(-1)));
+            REQUIRE(a.size() == 101);
+            for (int i = 0; i < 101; ++i) {
+                REQUIRE(a.at(i) == i - 1);
+            }
+        }
+        CHECK(RelocatableInt::s_copyCount == 202); // Only the inserted values are moved
+        CHECK(NonTrivialInt::instanceCount() == 0);
+    }
+
+    test::DefaultAllocator::check();
+}
+
+TEST_CASE("SmallVector") {
+    test::DefaultAllocator::reset();
+
+    using Vector = spark::Vector<NonTrivialInt, CountingAllocator>;
+    using SmallVector = spark::SmallVector<NonTrivialInt, 4, CountingAllocator>;
+
+    CountingAllocator::s_allocCount = 0;
+
+    SECTION("elements are stored inline while they fit into the buffer") {
+        SmallVector a;
+        check(a).size(0).capacity(4);
+        REQUIRE(a.append(1));
+        const NonTrivialInt values[] = { 2, 3, 4 };
+        REQUIRE(a.append(values, 3));
+        check(a).values(1, 2, 3, 4).capacity(4);
+        CHECK(CountingAllocator::s_allocCount == 0);
+        REQUIRE(a.append(5)); // Moves elements to the heap
+        check(a).values(1, 2, 3, 4, 5).capacity(6);
+        CHECK(CountingAllocator::s_allocCount == 1);
+        a.removeAt(0, 3);
+        REQUIRE(a.trimToSize());
+        check(a).values(4, 5).capacity(2);
+    }
+
+    SECTION("copy and move") {
+        SmallVector a({ 1, 2, 3 });
+        SmallVector b(a);
+        check(b).values(1, 2, 3).capacity(4);
+        check(a).values(1, 2, 3).capacity(4);
+        SmallVector c(std::move(a));
+        check(c).values(1, 2, 3).capacity(4);
+        check(a).size(0).capacity(4);
+        Vector d(std::move(c)); // Inline elements are moved to the heap
+        check(d).values(1, 2, 3).capacity(3);
+        check(c).size(0).capacity(4);
+        c = d;
+        check(c).values(1, 2, 3).capacity(4);
+        CHECK(CountingAllocator::s_allocCount == 1);
+        SmallVector e(std::move(d)); // Takes the ownership of the heap buffer
+        check(e).values(1, 2, 3).capacity(3);
+        check(d).size(0).capacity(0);
+        CHECK(CountingAllocator::s_allocCount == 1);
+    }
+
+    SECTION("swap()") {
+        SmallVector a({ 1, 2 });
+        Vector b({ 3, 4, 5 });
+        swap(a, b);
+        check(a).values(3, 4, 5);
+        check(b).values(1, 2);
+        SmallVector c({ 6 });
+        swap(a, c);
+        check(a).values(6);
+        check(c).values(3, 4, 5);
+    }
+
+    test::DefaultAllocator::check();
+    CHECK(NonTrivialInt::instanceCount() == 0);
+}
@@ -0,0 +1,124 @@
+#include "virtual_clock.h"
+#include "concurrent_hal.h"
+#include "delay_hal.h"
+#include "timer_hal.h"
+#include "rtc_hal.h"
+
+#include "tools/catch.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+using particle::VirtualClock;
+
+namespace {
+
+std::atomic<int> timerCount(0);
+
+void timerCallback(os_timer_t timer) {
+    ++timerCount;
+}
+
+// Restores the real-time mode when a test case finishes
+class ClockModeGuard {
+public:
+    explicit ClockModeGuard(VirtualClock::Mode mode, double scale = 1.0) {
+        VirtualClock::instance()->mode(mode, scale);
+    }
+
+    ~ClockModeGuard() {
+        VirtualClock::instance()->autoAdvance(true);
+        VirtualClock::instance()->mode(VirtualClock::REAL_TIME);
+    }
+};
+
+} // namespace
+
+TEST_CASE("VirtualClock") {
+    VirtualClock* const clock = VirtualClock::instance();
+
+    SECTION("the time is continuous when the mode changes") {
+        const uint64_t t1 = clock->micros();
+        ClockModeGuard g(VirtualClock::DISCRETE);
+        const uint64_t t2 = clock->micros();
+        CHECK(t2 >= t1);
+        const uint64_t dt = t2 - t1;
+        CHECK(dt < 100000);
+        clock->mode(VirtualClock::REAL_TIME);
+        CHECK(clock->micros() >= t2);
+    }
+
+    SECTION("the time runs faster in the accelerated mode") {
+        ClockModeGuard g(VirtualClock::ACCELERATED, 100.0);
+        CHECK(clock->scale() == 100.0);
+        const auto real1 = std::chrono::steady_clock::now();
+        const uint64_t t1 = clock->millis();
+        HAL_Delay_Milliseconds(1000); // Virtual milliseconds
+        const uint64_t t2 = clock->millis();
+        const auto real2 = std::chrono::steady_clock::now();
+        const uint64_t dt = t2 - t1;
+        CHECK(dt >= 1000);
+        CHECK(std::chrono::duration_cast<std::chrono::milliseconds>(real2 - real1).count() < 500);
+    }
+
+    SECTION("the time only changes when advanced explicitly in the discrete mode") {
+        ClockModeGuard g(VirtualClock::DISCRETE);
+        clock->autoAdvance(false);
+        const uint64_t t = clock->micros();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        CHECK(clock->micros() == t);
+        CHECK(clock->advance(1500));
+        CHECK(clock->micros() == t + 1500);
+        CHECK(HAL_Timer_Get_Micro_Seconds() == (system_tick_t)(t + 1500));
+        clock->mode(VirtualClock::REAL_TIME);
+        CHECK_FALSE(clock->advance(1000));
+    }
+
+    SECTION("advanceToNextDeadline() wakes up a sleeping thread") {
+        ClockModeGuard g(VirtualClock::DISCRETE);
+        clock->autoAdvance(false);
+        const uint64_t t = clock->micros();
+        std::atomic<bool> done(false);
+        std::thread th([&]() {
+            clock->sleepUntil(t + 60000000);
+            done = true;
+        });
+        while (!clock->advanceToNextDeadline()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        th.join();
+        CHECK(done);
+        CHECK(clock->micros() == t + 60000000);
+    }
+
+    SECTION("the time jumps to the nearest deadline when all threads are blocked") {
+        ClockModeGuard g(VirtualClock::DISCRETE);
+        const uint64_t t = clock->millis();
+        const auto real1 = std::chrono::steady_clock::now();
+        HAL_Delay_Milliseconds(3600000); // 1 hour
+        const auto real2 = std::chrono::steady_clock::now();
+        CHECK(clock->millis() == t + 3600000);
+        CHECK(std::chrono::duration_cast<std::chrono::milliseconds>(real2 - real1).count() < 1000);
+    }
+
+    SECTION("software timers are driven by the virtual time") {
+        ClockModeGuard g(VirtualClock::DISCRETE);
+        timerCount = 0;
+        os_timer_t timer = nullptr;
+        REQUIRE(os_timer_create(&timer, 1000, timerCallback, nullptr, false /* one_shot */, nullptr) == 0);
+        REQUIRE(os_timer_change(timer, OS_TIMER_CHANGE_START, false, 0, 0, nullptr) == 0);
+        HAL_Delay_Milliseconds(10500);
+        CHECK(timerCount == 10);
+        os_timer_destroy(timer, nullptr);
+    }
+
+    SECTION("the RTC follows the virtual time") {
+        ClockModeGuard g(VirtualClock::DISCRETE);
+        clock->autoAdvance(false);
+        HAL_RTC_Set_UnixTime(1000000000);
+        CHECK(HAL_RTC_Get_UnixTime() == 1000000000);
+        clock->advance(90 * 1000000ULL);
+        CHECK(HAL_RTC_Get_UnixTime() == 1000000090);
+    }
+}
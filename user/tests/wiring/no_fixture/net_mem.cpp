@@ -0,0 +1,183 @@
+#include "application.h"
+#include "unit-test/unit-test.h"
+
+#if HAL_PLATFORM_IFAPI
+
+#include "ifapi.h"
+#include "socket_hal.h"
+
+#include <climits>
+
+namespace {
+
+const uint16_t BULK_UDP_PORT = 40001;
+const uint16_t CLOUD_UDP_PORT = 40002;
+const uint16_t BULK_TCP_PORT = 40003;
+const size_t DATAGRAM_SIZE = 512;
+const unsigned FLOOD_COUNT = 200;
+
+sockaddr_in loopbackAddr(uint16_t port) {
+    sockaddr_in addr = {};
+    addr.sin_len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+int bindUdp(uint16_t port) {
+    const int s = sock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    const auto addr = loopbackAddr(port);
+    if (s >= 0 && sock_bind(s, (const sockaddr*)&addr, sizeof(addr))) {
+        sock_close(s);
+        return -1;
+    }
+    return s;
+}
+
+void flood(int s, uint16_t port) {
+    uint8_t buf[DATAGRAM_SIZE] = {};
+    const auto addr = loopbackAddr(port);
+    for (unsigned i = 0; i < FLOOD_COUNT; ++i) {
+        // Errors are expected once the stack is short on buffers
+        sock_sendto(s, buf, sizeof(buf), MSG_DONTWAIT, (const sockaddr*)&addr, sizeof(addr));
+        if (i % 10 == 0) {
+            delay(1);
+        }
+    }
+}
+
+// Returns the number of bytes queued on a socket
+size_t drain(int s) {
+    uint8_t buf[DATAGRAM_SIZE];
+    size_t total = 0;
+    ssize_t n = 0;
+    while ((n = sock_recv(s, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        total += n;
+    }
+    return total;
+}
+
+bool receiveWithin(int s, system_tick_t timeout) {
+    uint8_t buf[DATAGRAM_SIZE];
+    for (const auto start = millis(); millis() - start < timeout; delay(10)) {
+        if (sock_recv(s, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Socket that opts out of the default quota, like the cloud session socket
+int bindExemptUdp(uint16_t port) {
+    const int s = bindUdp(port);
+    const int rcvbuf = INT_MAX;
+    if (s >= 0 && sock_setsockopt(s, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf))) {
+        sock_close(s);
+        return -1;
+    }
+    return s;
+}
+
+if_mem_profile savedProfile = {};
+
+void setProfile(uint32_t socketRecvQuota, uint32_t tcpOoseqQuota) {
+    savedProfile.size = sizeof(savedProfile);
+    if_get_mem_profile(&savedProfile, nullptr);
+    if_mem_profile p = savedProfile;
+    p.socket_recv_quota = socketRecvQuota;
+    p.tcp_ooseq_quota = tcpOoseqQuota;
+    if_set_mem_profile(&p, nullptr);
+}
+
+void restoreProfile() {
+    if_set_mem_profile(&savedProfile, nullptr);
+}
+
+} // namespace
+
+test(NET_MEM_01_mem_profile_can_be_read_back) {
+    if_mem_profile p = {};
+    p.size = sizeof(p);
+    assertEqual(if_get_mem_profile(&p, nullptr), 0);
+    const if_mem_profile saved = p;
+    p.socket_recv_quota = 2048;
+    p.tcp_ooseq_quota = 2;
+    assertEqual(if_set_mem_profile(&p, nullptr), 0);
+    if_mem_profile p2 = {};
+    p2.size = sizeof(p2);
+    assertEqual(if_get_mem_profile(&p2, nullptr), 0);
+    assertEqual(p2.socket_recv_quota, 2048);
+    assertEqual(p2.tcp_ooseq_quota, 2);
+    assertEqual(if_set_mem_profile(&saved, nullptr), 0);
+}
+
+test(NET_MEM_02_udp_flood_is_limited_by_the_default_quota) {
+    const uint32_t quota = 2 * DATAGRAM_SIZE;
+    setProfile(quota, 0);
+    const int bulk = bindUdp(BULK_UDP_PORT);
+    const int cloud = bindExemptUdp(CLOUD_UDP_PORT);
+    const int sender = sock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    restoreProfile();
+    assertMoreOrEqual(bulk, 0);
+    assertMoreOrEqual(cloud, 0);
+    assertMoreOrEqual(sender, 0);
+
+    // The bulk socket is never read while it is being flooded
+    flood(sender, BULK_UDP_PORT);
+    uint8_t buf[DATAGRAM_SIZE] = {};
+    const auto addr = loopbackAddr(CLOUD_UDP_PORT);
+    sock_sendto(sender, buf, sizeof(buf), 0, (const sockaddr*)&addr, sizeof(addr));
+    const bool received = receiveWithin(cloud, 1000);
+    const size_t queued = drain(bulk);
+
+    sock_close(sender);
+    sock_close(cloud);
+    sock_close(bulk);
+    assertTrue(received);
+    // lwIP admits a datagram while the queued data is below the quota
+    assertLessOrEqual(queued, quota + DATAGRAM_SIZE);
+}
+
+test(NET_MEM_03_unread_tcp_bulk_flow_does_not_starve_the_cloud_socket) {
+    const int listener = sock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    const int client = sock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    const int cloud = bindExemptUdp(CLOUD_UDP_PORT);
+    const int sender = sock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    assertMoreOrEqual(listener, 0);
+    assertMoreOrEqual(client, 0);
+    assertMoreOrEqual(cloud, 0);
+    assertMoreOrEqual(sender, 0);
+    const auto tcpAddr = loopbackAddr(BULK_TCP_PORT);
+    assertEqual(sock_bind(listener, (const sockaddr*)&tcpAddr, sizeof(tcpAddr)), 0);
+    assertEqual(sock_listen(listener, 1), 0);
+    assertEqual(sock_connect(client, (const sockaddr*)&tcpAddr, sizeof(tcpAddr)), 0);
+    const int server = sock_accept(listener, nullptr, nullptr);
+    assertMoreOrEqual(server, 0);
+    setProfile(0, 2);
+
+    // Send until the receive window of the accepted connection, which is never read, is full
+    uint8_t buf[DATAGRAM_SIZE] = {};
+    for (const auto start = millis(); millis() - start < 3000; delay(1)) {
+        sock_send(client, buf, sizeof(buf), MSG_DONTWAIT);
+    }
+    const auto addr = loopbackAddr(CLOUD_UDP_PORT);
+    sock_sendto(sender, buf, sizeof(buf), 0, (const sockaddr*)&addr, sizeof(addr));
+    const bool received = receiveWithin(cloud, 1000);
+    if_mem_pool_stats stats = {};
+    stats.size = sizeof(stats);
+    const int r = if_get_mem_pool_stats(IF_MEM_POOL_PBUF, &stats, nullptr);
+
+    sock_close(server);
+    sock_close(client);
+    sock_close(listener);
+    sock_close(sender);
+    sock_close(cloud);
+    restoreProfile();
+    assertTrue(received);
+    if (r == 0) {
+        assertLess(stats.used, stats.avail);
+    }
+}
+
+#endif // HAL_PLATFORM_IFAPI
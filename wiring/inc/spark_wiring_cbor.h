@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARK_WIRING_CBOR_H
+#define SPARK_WIRING_CBOR_H
+
+#include "spark_wiring_print.h"
+#include "spark_wiring_string.h"
+
+#include <cstring>
+#include <cstdint>
+
+namespace spark {
+
+enum CBORType {
+    CBOR_TYPE_INVALID,
+    CBOR_TYPE_NULL,
+    CBOR_TYPE_BOOL,
+    CBOR_TYPE_INT,
+    CBOR_TYPE_FLOAT,
+    CBOR_TYPE_STRING, // Text string
+    CBOR_TYPE_BYTES, // Byte string
+    CBOR_TYPE_ARRAY,
+    CBOR_TYPE_OBJECT // Map
+};
+
+class CBORString;
+class CBORArrayIterator;
+class CBORObjectIterator;
+
+/*
+ * Immutable CBOR value (RFC 8949).
+ *
+ * Values reference the original buffer passed to parse() and don't copy any data, so the buffer
+ * needs to stay valid while the values or iterators derived from it are in use. Tags are skipped
+ * transparently. Indefinite-length arrays and maps are supported, while indefinite-length
+ * strings are not, since they can't be accessed without copying their chunks.
+ */
+class CBORValue {
+public:
+    CBORValue(); // Constructs invalid value
+
+    bool toBool() const;
+    int toInt() const;
+    double toDouble() const;
+    CBORString toString() const; // Returns contents of a text or byte string
+
+    CBORType type() const;
+
+    bool isNull() const;
+    bool isBool() const;
+    bool isInt() const;
+    bool isFloat() const;
+    bool isNumber() const; // Integer or floating point number
+    bool isString() const;
+    bool isBytes() const;
+    bool isArray() const;
+    bool isObject() const;
+
+    bool isValid() const;
+
+    // Validates the data and returns the top-level value, or an invalid value if the data is
+    // malformed, nested too deeply or has trailing bytes
+    static CBORValue parse(const char *data, size_t size);
+
+private:
+    const uint8_t *p_; // Head of this value
+    const uint8_t *end_; // End of the buffer
+
+    CBORValue(const uint8_t *p, const uint8_t *end);
+
+    friend class CBORString;
+    friend class CBORArrayIterator;
+    friend class CBORObjectIterator;
+};
+
+// Contents of a text or byte string. The data is not null-terminated
+class CBORString {
+public:
+    CBORString();
+    explicit CBORString(const CBORValue &value);
+
+    const char* data() const;
+
+    size_t size() const;
+    bool isEmpty() const;
+
+    bool operator==(const char *str) const;
+    bool operator!=(const char *str) const;
+    bool operator==(const String &str) const;
+    bool operator!=(const String &str) const;
+    bool operator==(const CBORString &str) const;
+    bool operator!=(const CBORString &str) const;
+
+    explicit operator String() const;
+
+private:
+    const char *s_;
+    size_t n_;
+
+    CBORString(const uint8_t *p, const uint8_t *end);
+
+    friend class CBORValue;
+    friend class CBORObjectIterator;
+};
+
+class CBORArrayIterator {
+public:
+    CBORArrayIterator();
+    explicit CBORArrayIterator(const CBORValue &value);
+
+    bool next();
+
+    CBORValue value() const;
+
+    size_t count() const; // Returns number of remaining elements
+
+private:
+    const uint8_t *p_, *v_, *end_;
+    size_t n_;
+
+    CBORArrayIterator(const uint8_t *p, const uint8_t *end);
+};
+
+class CBORObjectIterator {
+public:
+    CBORObjectIterator();
+    explicit CBORObjectIterator(const CBORValue &value);
+
+    bool next();
+
+    CBORString name() const; // Returns an empty string if the key is not a string
+    CBORValue key() const;
+    CBORValue value() const;
+
+    size_t count() const; // Returns number of remaining elements
+
+private:
+    const uint8_t *p_, *k_, *v_, *end_;
+    size_t n_;
+
+    CBORObjectIterator(const uint8_t *p, const uint8_t *end);
+};
+
+/*
+ * Abstract CBOR document writer.
+ *
+ * Arrays and objects started with beginArray() and beginObject() are encoded with indefinite
+ * length, so that the writer doesn't need to buffer their contents. If the number of elements is
+ * known in advance, passing it to beginArray(size_t) or beginObject(size_t) saves a byte per
+ * container. Floating point numbers are encoded in the shortest form that preserves their value.
+ * Nesting depth is limited to 32 levels.
+ */
+class CBORWriter {
+public:
+    CBORWriter();
+    virtual ~CBORWriter() = default;
+
+    CBORWriter& beginArray();
+    CBORWriter& beginArray(size_t count);
+    CBORWriter& endArray();
+    CBORWriter& beginObject();
+    CBORWriter& beginObject(size_t count); // Number of name/value pairs
+    CBORWriter& endObject();
+    CBORWriter& name(const char *name);
+    CBORWriter& name(const char *name, size_t size);
+    CBORWriter& name(const String &name);
+    CBORWriter& value(bool val);
+    CBORWriter& value(int val);
+    CBORWriter& value(unsigned val);
+    CBORWriter& value(double val);
+    CBORWriter& value(const char *val);
+    CBORWriter& value(const char *val, size_t size);
+    CBORWriter& value(const String &val);
+    CBORWriter& bytes(const void *data, size_t size);
+    CBORWriter& nullValue();
+
+protected:
+    virtual void write(const char *data, size_t size) = 0;
+
+private:
+    uint32_t indef_; // Bit stack of indefinite-length containers
+    unsigned depth_;
+
+    void writeHead(unsigned type, uint64_t arg);
+    void beginContainer(unsigned type);
+    void endContainer();
+    void write(char c);
+};
+
+class CBORStreamWriter: public CBORWriter {
+public:
+    explicit CBORStreamWriter(Print &stream);
+
+    Print* stream() const;
+
+protected:
+    virtual void write(const char *data, size_t size) override;
+
+private:
+    Print &strm_;
+};
+
+class CBORBufferWriter: public CBORWriter {
+public:
+    CBORBufferWriter(char *buf, size_t size);
+
+    char* buffer() const;
+    size_t bufferSize() const;
+
+    size_t dataSize() const; // Returned value can be greater than buffer size
+
+protected:
+    virtual void write(const char *data, size_t size) override;
+
+private:
+    char *buf_;
+    size_t bufSize_, n_;
+};
+
+bool operator==(const char *str1, const CBORString &str2);
+bool operator!=(const char *str1, const CBORString &str2);
+bool operator==(const String &str1, const CBORString &str2);
+bool operator!=(const String &str1, const CBORString &str2);
+
+} // namespace spark
+
+// spark::CBORValue
+inline spark::CBORValue::CBORValue() :
+        p_(nullptr),
+        end_(nullptr) {
+}
+
+inline spark::CBORValue::CBORValue(const uint8_t *p, const uint8_t *end) :
+        p_(p),
+        end_(end) {
+}
+
+inline spark::CBORString spark::CBORValue::toString() const {
+    return CBORString(p_, end_);
+}
+
+inline bool spark::CBORValue::isNull() const {
+    return type() == CBOR_TYPE_NULL;
+}
+
+inline bool spark::CBORValue::isBool() const {
+    return type() == CBOR_TYPE_BOOL;
+}
+
+inline bool spark::CBORValue::isInt() const {
+    return type() == CBOR_TYPE_INT;
+}
+
+inline bool spark::CBORValue::isFloat() const {
+    return type() == CBOR_TYPE_FLOAT;
+}
+
+inline bool spark::CBORValue::isNumber() const {
+    const CBORType t = type();
+    return t == CBOR_TYPE_INT || t == CBOR_TYPE_FLOAT;
+}
+
+inline bool spark::CBORValue::isString() const {
+    return type() == CBOR_TYPE_STRING;
+}
+
+inline bool spark::CBORValue::isBytes() const {
+    return type() == CBOR_TYPE_BYTES;
+}
+
+inline bool spark::CBORValue::isArray() const {
+    return type() == CBOR_TYPE_ARRAY;
+}
+
+inline bool spark::CBORValue::isObject() const {
+    return type() == CBOR_TYPE_OBJECT;
+}
+
+inline bool spark::CBORValue::isValid() const {
+    return type() != CBOR_TYPE_INVALID;
+}
+
+// spark::CBORString
+inline spark::CBORString::CBORString() :
+        s_(""),
+        n_(0) {
+}
+
+inline spark::CBORString::CBORString(const CBORValue &value) :
+        CBORString(value.p_, value.end_) {
+}
+
+inline const char* spark::CBORString::data() const {
+    return s_;
+}
+
+inline size_t spark::CBORString::size() const {
+    return n_;
+}
+
+inline bool spark::CBORString::isEmpty() const {
+    return !n_;
+}
+
+inline bool spark::CBORString::operator==(const char *str) const {
+    return strlen(str) == n_ && memcmp(s_, str, n_) == 0;
+}
+
+inline bool spark::CBORString::operator!=(const char *str) const {
+    return !operator==(str);
+}
+
+inline bool spark::CBORString::operator==(const String &str) const {
+    return str.length() == n_ && memcmp(s_, str.c_str(), n_) == 0;
+}
+
+inline bool spark::CBORString::operator!=(const String &str) const {
+    return !operator==(str);
+}
+
+inline bool spark::CBORString::operator==(const CBORString &str) const {
+    return str.n_ == n_ && memcmp(s_, str.s_, n_) == 0;
+}
+
+inline bool spark::CBORString::operator!=(const CBORString &str) const {
+    return !operator==(str);
+}
+
+inline spark::CBORString::operator String() const {
+    return String(s_, n_);
+}
+
+// spark::CBORArrayIterator
+inline spark::CBORArrayIterator::CBORArrayIterator() :
+        p_(nullptr),
+        v_(nullptr),
+        end_(nullptr),
+        n_(0) {
+}
+
+inline spark::CBORArrayIterator::CBORArrayIterator(const CBORValue &value) :
+        CBORArrayIterator(value.p_, value.end_) {
+}
+
+inline spark::CBORValue spark::CBORArrayIterator::value() const {
+    return CBORValue(v_, end_);
+}
+
+inline size_t spark::CBORArrayIterator::count() const {
+    return n_;
+}
+
+// spark::CBORObjectIterator
+inline spark::CBORObjectIterator::CBORObjectIterator() :
+        p_(nullptr),
+        k_(nullptr),
+        v_(nullptr),
+        end_(nullptr),
+        n_(0) {
+}
+
+inline spark::CBORObjectIterator::CBORObjectIterator(const CBORValue &value) :
+        CBORObjectIterator(value.p_, value.end_) {
+}
+
+inline spark::CBORString spark::CBORObjectIterator::name() const {
+    return CBORString(k_, end_);
+}
+
+inline spark::CBORValue spark::CBORObjectIterator::key() const {
+    return CBORValue(k_, end_);
+}
+
+inline spark::CBORValue spark::CBORObjectIterator::value() const {
+    return CBORValue(v_, end_);
+}
+
+inline size_t spark::CBORObjectIterator::count() const {
+    return n_;
+}
+
+// spark::CBORWriter
+inline spark::CBORWriter::CBORWriter() :
+        indef_(0),
+        depth_(0) {
+}
+
+inline spark::CBORWriter& spark::CBORWriter::name(const char *name) {
+    return this->name(name, strlen(name));
+}
+
+inline spark::CBORWriter& spark::CBORWriter::name(const String &name) {
+    return this->name(name.c_str(), name.length());
+}
+
+inline spark::CBORWriter& spark::CBORWriter::value(const char *val) {
+    return value(val, strlen(val));
+}
+
+inline spark::CBORWriter& spark::CBORWriter::value(const String &val) {
+    return value(val.c_str(), val.length());
+}
+
+inline void spark::CBORWriter::write(char c) {
+    write(&c, 1);
+}
+
+// spark::CBORStreamWriter
+inline spark::CBORStreamWriter::CBORStreamWriter(Print &stream) :
+        strm_(stream) {
+}
+
+inline Print* spark::CBORStreamWriter::stream() const {
+    return &strm_;
+}
+
+inline void spark::CBORStreamWriter::write(const char *data, size_t size) {
+    strm_.write((const uint8_t*)data, size);
+}
+
+// spark::CBORBufferWriter
+inline spark::CBORBufferWriter::CBORBufferWriter(char *buf, size_t size) :
+        buf_(buf),
+        bufSize_(size),
+        n_(0) {
+}
+
+inline char* spark::CBORBufferWriter::buffer() const {
+    return buf_;
+}
+
+inline size_t spark::CBORBufferWriter::bufferSize() const {
+    return bufSize_;
+}
+
+inline size_t spark::CBORBufferWriter::dataSize() const {
+    return n_;
+}
+
+// spark::
+inline bool spark::operator==(const char *str1, const CBORString &str2) {
+    return str2 == str1;
+}
+
+inline bool spark::operator!=(const char *str1, const CBORString &str2) {
+    return str2 != str1;
+}
+
+inline bool spark::operator==(const String &str1, const CBORString &str2) {
+    return str2 == str1;
+}
+
+inline bool spark::operator!=(const String &str1, const CBORString &str2) {
+    return str2 != str1;
+}
+
+#endif // SPARK_WIRING_CBOR_H
@@ -100,6 +100,11 @@ public:
     }
 
     CellularSignal RSSI();
+    /**
+     * Returns the signal strength info. If `refresh` is `true`, the modem is queried for the current
+     * values instead of returning the cached ones.
+     */
+    CellularSignal RSSI(bool refresh);
 
     bool getDataUsage(CellularData &data_get);
     bool setDataUsage(CellularData &data_set);
@@ -136,6 +141,28 @@ public:
         return cellular_command((_CALLBACKPTR_MDM)cb, (void*)param, timeout_ms, format, Fargs...);
     }
 
+    /**
+     * Queues an AT command and returns without waiting for the response.
+     *
+     * `lineFn` is invoked for each line of the response and `doneFn` is invoked with the final
+     * result code. The callbacks are invoked by the networking thread and should not block.
+     *
+     * @return Command ID, or a negative result code in case of an error.
+     */
+    template<typename T, typename... Targs>
+    inline int commandAsync(int (*lineFn)(const char* line, size_t size, T* param),
+            void (*doneFn)(int result, int errorCode, T* param), T* param, system_tick_t timeout_ms,
+            const char* format, Targs... Fargs)
+    {
+        return cellular_command_async(CELLULAR_COMMAND_PRIORITY_NORMAL, (cellular_command_line_fn)lineFn,
+                (cellular_command_done_fn)doneFn, (void*)param, timeout_ms, format, Fargs...);
+    }
+
+    int cancelCommand(int id)
+    {
+        return cellular_command_cancel(id, nullptr);
+    }
+
 #if !HAL_USE_INET_HAL_POSIX
     IPAddress resolve(const char* name)
     {
@@ -185,6 +185,107 @@ public:
         return false;
     }
 
+    /**
+     * Notifies the cloud that the value of a variable has changed. Observed variables are pushed
+     * to the cloud without waiting for it to poll them.
+     *
+     * @return `true` if the variable is being observed.
+     */
+    static inline bool notifyVariable(const char* varKey)
+    {
+        return CLOUD_FN(spark_notify_variable(varKey, nullptr), false);
+    }
+
+    /**
+     * Sets the minimum and maximum intervals between two notifications sent for an observed
+     * variable. A maximum interval of 0 disables periodic notifications of unchanged values.
+     */
+    static void setVariableObserveInterval(system_tick_t minInterval, system_tick_t maxInterval = 0)
+    {
+        particle::protocol::connection_properties_t conn_prop = {0};
+        conn_prop.size = sizeof(conn_prop);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::VARIABLE_OBSERVE_MIN_INTERVAL,
+                                               minInterval, &conn_prop, nullptr),
+                 (void)0);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::VARIABLE_OBSERVE_MAX_INTERVAL,
+                                               maxInterval, &conn_prop, nullptr),
+                 (void)0);
+    }
+
+    /**
+     * Sends every Nth variable notification as a confirmable message. 0 disables confirmable notifications.
+     */
+    static void setVariableObserveConfirmableRatio(unsigned ratio)
+    {
+        particle::protocol::connection_properties_t conn_prop = {0};
+        conn_prop.size = sizeof(conn_prop);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::VARIABLE_OBSERVE_CONFIRMABLE_RATIO,
+                                               ratio, &conn_prop, nullptr),
+                 (void)0);
+    }
+
+    /**
+     * Sets the maximum number of received cloud messages and the maximum time in milliseconds
+     * spent handling them in a single pass of the system loop. A time limit of 0 disables
+     * the time limit.
+     */
+    static void setEventLoopBudget(unsigned maxMessages, system_tick_t maxTime)
+    {
+        particle::protocol::connection_properties_t conn_prop = {0};
+        conn_prop.size = sizeof(conn_prop);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::EVENT_LOOP_MESSAGE_BUDGET,
+                                               maxMessages, &conn_prop, nullptr),
+                 (void)0);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::EVENT_LOOP_TIME_BUDGET,
+                                               maxTime, &conn_prop, nullptr),
+                 (void)0);
+    }
+
+    /**
+     * Sets the rate limit for published events: one event per `interval` milliseconds on average,
+     * with bursts of up to `burst` events. The default is 4 events per second with a burst of 4.
+     */
+    static void setPublishRate(system_tick_t interval, unsigned burst)
+    {
+        particle::protocol::connection_properties_t conn_prop = {0};
+        conn_prop.size = sizeof(conn_prop);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::PUBLISH_RATE_INTERVAL,
+                                               interval, &conn_prop, nullptr),
+                 (void)0);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::PUBLISH_RATE_BURST,
+                                               burst, &conn_prop, nullptr),
+                 (void)0);
+    }
+
+    /**
+     * Sets the maximum number of published events that are held in RAM and sent later when they
+     * exceed the rate limit. The completion of a deferred event is reported when it's actually
+     * sent. 0 (the default) disables the queue, in which case such events fail immediately.
+     */
+    static void setPublishQueueSize(unsigned size)
+    {
+        particle::protocol::connection_properties_t conn_prop = {0};
+        conn_prop.size = sizeof(conn_prop);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::PUBLISH_QUEUE_SIZE,
+                                               size, &conn_prop, nullptr),
+                 (void)0);
+    }
+
+    /**
+     * Sets the maximum time in milliseconds the acknowledgement of a function call is deferred
+     * waiting for the function to complete. The result of a function that completes in time is
+     * sent in the acknowledgement, saving a round trip. The default is 50 milliseconds, and larger
+     * values are limited to 500 milliseconds so that the cloud doesn't retransmit the call.
+     */
+    static void setFunctionResponseDeadline(system_tick_t deadline)
+    {
+        particle::protocol::connection_properties_t conn_prop = {0};
+        conn_prop.size = sizeof(conn_prop);
+        CLOUD_FN(spark_set_connection_property(particle::protocol::Connection::FUNCTION_RESPONSE_DEADLINE,
+                                               deadline, &conn_prop, nullptr),
+                 (void)0);
+    }
+
     template <typename T, class ... Types>
     static inline bool function(const T &name, Types ... args)
     {
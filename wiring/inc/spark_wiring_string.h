@@ -208,6 +208,7 @@ protected:
 	void init(void);
 	void invalidate(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
+	unsigned char grow(unsigned int size);
 	unsigned char concat(const char *cstr, unsigned int length);
 
 	// copy and move
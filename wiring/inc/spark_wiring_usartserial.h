@@ -30,17 +30,30 @@
 #include "spark_wiring_stream.h"
 #include "usart_hal.h"
 #include "spark_wiring_platform.h"
+#if HAL_PLATFORM_USART_BULK
+#include <memory>
+#endif // HAL_PLATFORM_USART_BULK
 
 class USARTSerial : public Stream
 {
 private:
   HAL_USART_Serial _serial;
   bool _blocking;
+#if HAL_PLATFORM_USART_BULK
+  std::unique_ptr<uint8_t[]> _rxBuffer;
+  std::unique_ptr<uint8_t[]> _txBuffer;
+  size_t _rxBufferSize;
+  size_t _txBufferSize;
+#endif // HAL_PLATFORM_USART_BULK
 public:
   USARTSerial(HAL_USART_Serial serial, Ring_Buffer *rx_buffer, Ring_Buffer *tx_buffer);
   virtual ~USARTSerial() {};
   void begin(unsigned long);
   void begin(unsigned long, uint32_t);
+#if HAL_PLATFORM_USART_BULK
+  // Allocates RX and TX buffers of the specified size in bytes
+  bool begin(unsigned long baud, uint32_t config, size_t rxBufferSize, size_t txBufferSize);
+#endif // HAL_PLATFORM_USART_BULK
   void halfduplex(bool);
   void end();
 
@@ -53,6 +66,9 @@ public:
   virtual void flush(void);
   size_t write(uint16_t);
   virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t* buffer, size_t size) override;
+
+  size_t readBytes(char* buffer, size_t length); // Hides Stream::readBytes()
 
   // LIN
   void breakTx(void);
@@ -38,6 +38,12 @@
 #define PARTICLE_VECTOR_ENABLE_IF_NOT_TRIVIALLY_COPYABLE(T) \
         typename EnableT = T, typename std::enable_if<!PARTICLE_VECTOR_TRIVIALLY_COPYABLE_TRAIT<EnableT>::value, int>::type = 0
 
+#define PARTICLE_VECTOR_ENABLE_IF_TRIVIALLY_RELOCATABLE(T) \
+        typename EnableT = T, typename std::enable_if<::spark::IsTriviallyRelocatable<EnableT>::value, int>::type = 0
+
+#define PARTICLE_VECTOR_ENABLE_IF_NOT_TRIVIALLY_RELOCATABLE(T) \
+        typename EnableT = T, typename std::enable_if<!::spark::IsTriviallyRelocatable<EnableT>::value, int>::type = 0
+
 namespace spark {
 
 struct DefaultAllocator {
@@ -46,35 +52,52 @@ struct DefaultAllocator {
     static void free(void* ptr);
 };
 
-template<typename T, typename AllocatorT = DefaultAllocator>
+// Grows the capacity by a factor of 1.5, which makes appending elements an amortized O(1) operation
+struct DefaultGrowthPolicy {
+    static int capacity(int current, int required);
+};
+
+// Allocates exactly as much memory as necessary
+struct ExactGrowthPolicy {
+    static int capacity(int current, int required);
+};
+
+// Types that can be moved to a different memory location via memcpy(). This trait can be
+// specialized for types that are not trivially copyable but don't hold pointers to themselves
+template<typename T>
+struct IsTriviallyRelocatable: PARTICLE_VECTOR_TRIVIALLY_COPYABLE_TRAIT<T> {
+};
+
+template<typename T, typename AllocatorT = DefaultAllocator, typename GrowthPolicyT = DefaultGrowthPolicy>
 class Vector {
 public:
     typedef T ValueType;
     typedef AllocatorT AllocatorType;
+    typedef GrowthPolicyT GrowthPolicyType;
 
     Vector();
     explicit Vector(int n);
     Vector(int n, const T& value);
     Vector(const T* values, int n);
     Vector(std::initializer_list<T> values);
-    Vector(const Vector<T, AllocatorT>& vector);
-    Vector(Vector<T, AllocatorT>&& vector);
+    Vector(const Vector<T, AllocatorT, GrowthPolicyT>& vector);
+    Vector(Vector<T, AllocatorT, GrowthPolicyT>&& vector);
     ~Vector();
 
     bool append(T value);
     bool append(int n, const T& value);
     bool append(const T* values, int n);
-    bool append(const Vector<T, AllocatorT>& vector);
+    bool append(const Vector<T, AllocatorT, GrowthPolicyT>& vector);
 
     bool prepend(T value);
     bool prepend(int n, const T& value);
     bool prepend(const T* values, int n);
-    bool prepend(const Vector<T, AllocatorT>& vector);
+    bool prepend(const Vector<T, AllocatorT, GrowthPolicyT>& vector);
 
     bool insert(int i, T value);
     bool insert(int i, int n, const T& value);
     bool insert(int i, const T* values, int n);
-    bool insert(int i, const Vector<T, AllocatorT>& vector);
+    bool insert(int i, const Vector<T, AllocatorT, GrowthPolicyT>& vector);
 
     void removeAt(int i, int n = 1);
     bool removeOne(const T& value);
@@ -91,7 +114,7 @@ public:
     T& at(int i);
     const T& at(int i) const;
 
-    Vector<T, AllocatorT> copy(int i, int n) const;
+    Vector<T, AllocatorT, GrowthPolicyT> copy(int i, int n) const;
 
     int indexOf(const T& value, int i = 0) const;
     int lastIndexOf(const T& value) const;
@@ -99,7 +122,7 @@ public:
 
     bool contains(const T& value) const;
 
-    Vector<T, AllocatorT>& fill(const T& value);
+    Vector<T, AllocatorT, GrowthPolicyT>& fill(const T& value);
 
     bool resize(int n);
     int size() const;
@@ -122,33 +145,57 @@ public:
     T& operator[](int i);
     const T& operator[](int i) const;
 
-    bool operator==(const Vector<T, AllocatorT> &vector) const;
-    bool operator!=(const Vector<T, AllocatorT> &vector) const;
+    bool operator==(const Vector<T, AllocatorT, GrowthPolicyT> &vector) const;
+    bool operator!=(const Vector<T, AllocatorT, GrowthPolicyT> &vector) const;
+
+    Vector<T, AllocatorT, GrowthPolicyT>& operator=(Vector<T, AllocatorT, GrowthPolicyT> vector);
 
-    Vector<T, AllocatorT>& operator=(Vector<T, AllocatorT> vector);
+protected:
+    // Constructs an empty vector that uses the provided buffer until more capacity is needed.
+    // The buffer is not owned by the vector
+    Vector(T* buffer, int capacity);
+
+    // Moves the contents of another vector to this vector, which is expected to be empty
+    bool moveFrom(Vector<T, AllocatorT, GrowthPolicyT>& vector);
 
 private:
     T* data_;
     int size_, capacity_;
+    bool inline_;
 
-    template<PARTICLE_VECTOR_ENABLE_IF_TRIVIALLY_COPYABLE(T)>
+    bool grow(int n) {
+        if (n <= capacity_) {
+            return true;
+        }
+        const int c = GrowthPolicyT::capacity(capacity_, n);
+        // Fall back to the exact capacity if a bigger buffer cannot be allocated
+        return (c > n && realloc(c)) || realloc(n);
+    }
+
+    template<PARTICLE_VECTOR_ENABLE_IF_TRIVIALLY_RELOCATABLE(T)>
     bool realloc(int n) {
+        if (inline_) {
+            return reallocInline(n);
+        }
         T* d = nullptr;
         if (n > 0) {
-            d = (T*)AllocatorT::realloc(data_, n * sizeof(T));
+            d = (T*)AllocatorT::realloc((void*)data_, n * sizeof(T));
             if (!d) {
                 return false;
             }
         } else {
-            AllocatorT::free(data_);
+            AllocatorT::free((void*)data_);
         }
         data_ = d;
         capacity_ = n;
         return true;
     }
 
-    template<PARTICLE_VECTOR_ENABLE_IF_NOT_TRIVIALLY_COPYABLE(T)>
+    template<PARTICLE_VECTOR_ENABLE_IF_NOT_TRIVIALLY_RELOCATABLE(T)>
     bool realloc(int n) {
+        if (inline_) {
+            return reallocInline(n);
+        }
         T* d = nullptr;
         if (n > 0) {
             d = (T*)AllocatorT::malloc(n * sizeof(T));
@@ -163,6 +210,21 @@ private:
         return true;
     }
 
+    bool reallocInline(int n) {
+        if (n <= capacity_) {
+            return true; // The inline buffer is never shrunk
+        }
+        T* const d = (T*)AllocatorT::malloc(n * sizeof(T));
+        if (!d) {
+            return false;
+        }
+        move(d, data_, data_ + size_);
+        data_ = d;
+        capacity_ = n;
+        inline_ = false;
+        return true;
+    }
+
     // TODO: Use standard algorithms like std::uninitialized_copy() and std::uninitialized_move()
     // instead of custom implementations
     template<PARTICLE_VECTOR_ENABLE_IF_TRIVIALLY_COPYABLE(T)>
@@ -184,12 +246,12 @@ private:
         }
     }
 
-    template<PARTICLE_VECTOR_ENABLE_IF_TRIVIALLY_COPYABLE(T)>
+    template<PARTICLE_VECTOR_ENABLE_IF_TRIVIALLY_RELOCATABLE(T)>
     static void move(T* dest, const T* p, const T* end) {
-        ::memmove(dest, p, (end - p) * sizeof(T));
+        ::memmove((void*)dest, (const void*)p, (end - p) * sizeof(T));
     }
 
-    template<PARTICLE_VECTOR_ENABLE_IF_NOT_TRIVIALLY_COPYABLE(T)>
+    template<PARTICLE_VECTOR_ENABLE_IF_NOT_TRIVIALLY_RELOCATABLE(T)>
     static void move(T* dest, T* p, T* end) {
         if (dest > p && dest < end) {
             // Move elements in reverse order
@@ -239,18 +301,43 @@ private:
         }
     }
 
-    template<typename V, typename A>
-    friend void swap(Vector<V, A>& vector, Vector<V, A>& vector2);
+    template<typename V, typename A, typename G>
+    friend void swap(Vector<V, A, G>& vector, Vector<V, A, G>& vector2);
 };
 
-template<typename T, typename AllocatorT>
-void swap(Vector<T, AllocatorT>& vector, Vector<T, AllocatorT>& vector2);
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+void swap(Vector<T, AllocatorT, GrowthPolicyT>& vector, Vector<T, AllocatorT, GrowthPolicyT>& vector2);
+
+// Vector that stores up to N elements in an inline buffer without allocating memory on the heap
+template<typename T, int N, typename AllocatorT = DefaultAllocator, typename GrowthPolicyT = DefaultGrowthPolicy>
+class SmallVector: public Vector<T, AllocatorT, GrowthPolicyT> {
+public:
+    typedef Vector<T, AllocatorT, GrowthPolicyT> VectorType;
+
+    SmallVector();
+    SmallVector(std::initializer_list<T> values);
+    SmallVector(const VectorType& vector);
+    SmallVector(const SmallVector<T, N, AllocatorT, GrowthPolicyT>& vector);
+    SmallVector(VectorType&& vector);
+    SmallVector(SmallVector<T, N, AllocatorT, GrowthPolicyT>&& vector);
+
+    SmallVector<T, N, AllocatorT, GrowthPolicyT>& operator=(const VectorType& vector);
+    SmallVector<T, N, AllocatorT, GrowthPolicyT>& operator=(const SmallVector<T, N, AllocatorT, GrowthPolicyT>& vector);
+    SmallVector<T, N, AllocatorT, GrowthPolicyT>& operator=(VectorType&& vector);
+    SmallVector<T, N, AllocatorT, GrowthPolicyT>& operator=(SmallVector<T, N, AllocatorT, GrowthPolicyT>&& vector);
+
+private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type buf_[N];
+
+    static_assert(N > 0, "Size of the inline buffer should be greater than 0");
+};
 
 } // spark
 
 namespace particle {
 
 using ::spark::Vector;
+using ::spark::SmallVector;
 
 } // particle
 
@@ -267,40 +354,60 @@ inline void spark::DefaultAllocator::free(void* ptr) {
     ::free(ptr);
 }
 
+// spark::DefaultGrowthPolicy
+inline int spark::DefaultGrowthPolicy::capacity(int current, int required) {
+    const int n = current + current / 2;
+    return (n > required) ? n : required;
+}
+
+// spark::ExactGrowthPolicy
+inline int spark::ExactGrowthPolicy::capacity(int current, int required) {
+    return required;
+}
+
 // spark::Vector
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::Vector() :
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector() :
         data_(nullptr),
         size_(0),
-        capacity_(0) {
+        capacity_(0),
+        inline_(false) {
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::Vector(int n) : Vector() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector(T* buffer, int capacity) :
+        data_(buffer),
+        size_(0),
+        capacity_(capacity),
+        inline_(true) {
+}
+
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector(int n) : Vector() {
     if (n > 0 && realloc(n)) {
         construct(data_, data_ + n);
         size_ = n;
     }
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::Vector(int n, const T& value) : Vector() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector(int n, const T& value) : Vector() {
     if (n > 0 && realloc(n)) {
         construct(data_, data_ + n, value);
         size_ = n;
     }
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::Vector(const T* values, int n) : Vector() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector(const T* values, int n) : Vector() {
     if (n > 0 && realloc(n)) {
         copy(data_, values, values + n);
         size_ = n;
     }
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::Vector(std::initializer_list<T> values) : Vector() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector(std::initializer_list<T> values) : Vector() {
     const size_t n = values.size();
     if (n > 0 && realloc(n)) {
         copy(data_, values.begin(), values.end());
@@ -308,68 +415,70 @@ inline spark::Vector<T, AllocatorT>::Vector(std::initializer_list<T> values) : V
     }
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::Vector(const Vector<T, AllocatorT>& vector) : Vector() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector(const Vector<T, AllocatorT, GrowthPolicyT>& vector) : Vector() {
     if (vector.size_ > 0 && realloc(vector.size_)) {
         copy(data_, vector.data_, vector.data_ + vector.size_);
         size_ = vector.size_;
     }
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::Vector(Vector<T, AllocatorT>&& vector) : Vector() {
-    swap(*this, vector);
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::Vector(Vector<T, AllocatorT, GrowthPolicyT>&& vector) : Vector() {
+    moveFrom(vector);
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>::~Vector() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>::~Vector() {
     destruct(data_, data_ + size_);
-    AllocatorT::free(data_);
+    if (!inline_) {
+        AllocatorT::free(data_);
+    }
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::append(T value) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::append(T value) {
     return insert(size_, std::move(value));
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::append(int n, const T& value) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::append(int n, const T& value) {
     return insert(size_, n, value);
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::append(const T* values, int n) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::append(const T* values, int n) {
     return insert(size_, values, n);
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::append(const Vector<T, AllocatorT> &vector) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::append(const Vector<T, AllocatorT, GrowthPolicyT> &vector) {
     return insert(size_, vector);
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::prepend(T value) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::prepend(T value) {
     return insert(0, std::move(value));
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::prepend(int n, const T& value) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::prepend(int n, const T& value) {
     return insert(0, n, value);
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::prepend(const T* values, int n) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::prepend(const T* values, int n) {
     return insert(0, values, n);
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::prepend(const Vector<T, AllocatorT> &vector) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::prepend(const Vector<T, AllocatorT, GrowthPolicyT> &vector) {
     return insert(0, vector);
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::insert(int i, T value) {
-    if (size_ + 1 > capacity_ && !realloc(size_ + 1)) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::insert(int i, T value) {
+    if (!grow(size_ + 1)) {
         return false;
     }
     T* const p = data_ + i;
@@ -379,9 +488,9 @@ inline bool spark::Vector<T, AllocatorT>::insert(int i, T value) {
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::insert(int i, int n, const T& value) {
-    if (size_ + n > capacity_ && !realloc(size_ + n)) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::insert(int i, int n, const T& value) {
+    if (!grow(size_ + n)) {
         return false;
     }
     T* const p = data_ + i;
@@ -391,9 +500,9 @@ inline bool spark::Vector<T, AllocatorT>::insert(int i, int n, const T& value) {
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::insert(int i, const T* values, int n) {
-    if (size_ + n > capacity_ && !realloc(size_ + n)) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::insert(int i, const T* values, int n) {
+    if (!grow(size_ + n)) {
         return false;
     }
     T* const p = data_ + i;
@@ -403,13 +512,13 @@ inline bool spark::Vector<T, AllocatorT>::insert(int i, const T* values, int n)
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::insert(int i, const Vector<T, AllocatorT> &vector) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::insert(int i, const Vector<T, AllocatorT, GrowthPolicyT> &vector) {
     return insert(i, vector.data_, vector.size_);
 }
 
-template<typename T, typename AllocatorT>
-inline void spark::Vector<T, AllocatorT>::removeAt(int i, int n) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline void spark::Vector<T, AllocatorT, GrowthPolicyT>::removeAt(int i, int n) {
     if (n < 0 || i + n > size_) {
         n = size_ - i;
     }
@@ -419,8 +528,8 @@ inline void spark::Vector<T, AllocatorT>::removeAt(int i, int n) {
     size_ -= n;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::removeOne(const T &value) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::removeOne(const T &value) {
     T* const p = find(data_, data_ + size_, value);
     if (!p) {
         return false;
@@ -431,8 +540,8 @@ inline bool spark::Vector<T, AllocatorT>::removeOne(const T &value) {
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline int spark::Vector<T, AllocatorT>::removeAll(const T &value) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline int spark::Vector<T, AllocatorT, GrowthPolicyT>::removeAll(const T &value) {
     T* p = data_;
     T* end = p + size_;
     while ((p = find(p, end, value))) {
@@ -445,18 +554,18 @@ inline int spark::Vector<T, AllocatorT>::removeAll(const T &value) {
     return n;
 }
 
-template<typename T, typename AllocatorT>
-inline T spark::Vector<T, AllocatorT>::takeFirst() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T spark::Vector<T, AllocatorT, GrowthPolicyT>::takeFirst() {
     return takeAt(0);
 }
 
-template<typename T, typename AllocatorT>
-inline T spark::Vector<T, AllocatorT>::takeLast() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T spark::Vector<T, AllocatorT, GrowthPolicyT>::takeLast() {
     return takeAt(size_ - 1);
 }
 
-template<typename T, typename AllocatorT>
-inline T spark::Vector<T, AllocatorT>::takeAt(int i) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T spark::Vector<T, AllocatorT, GrowthPolicyT>::takeAt(int i) {
     T* const p = data_ + i;
     T v(std::move(*p));
     p->~T();
@@ -465,42 +574,42 @@ inline T spark::Vector<T, AllocatorT>::takeAt(int i) {
     return std::move(v);
 }
 
-template<typename T, typename AllocatorT>
-inline T& spark::Vector<T, AllocatorT>::first() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T& spark::Vector<T, AllocatorT, GrowthPolicyT>::first() {
     return data_[0];
 }
 
-template<typename T, typename AllocatorT>
-inline const T& spark::Vector<T, AllocatorT>::first() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline const T& spark::Vector<T, AllocatorT, GrowthPolicyT>::first() const {
     return data_[0];
 }
 
-template<typename T, typename AllocatorT>
-inline T& spark::Vector<T, AllocatorT>::last() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T& spark::Vector<T, AllocatorT, GrowthPolicyT>::last() {
     return data_[size_ - 1];
 }
 
-template<typename T, typename AllocatorT>
-inline const T& spark::Vector<T, AllocatorT>::last() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline const T& spark::Vector<T, AllocatorT, GrowthPolicyT>::last() const {
     return data_[size_ - 1];
 }
 
-template<typename T, typename AllocatorT>
-inline T& spark::Vector<T, AllocatorT>::at(int i) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T& spark::Vector<T, AllocatorT, GrowthPolicyT>::at(int i) {
     return data_[i];
 }
 
-template<typename T, typename AllocatorT>
-inline const T& spark::Vector<T, AllocatorT>::at(int i) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline const T& spark::Vector<T, AllocatorT, GrowthPolicyT>::at(int i) const {
     return data_[i];
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT> spark::Vector<T, AllocatorT>::copy(int i, int n) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT> spark::Vector<T, AllocatorT, GrowthPolicyT>::copy(int i, int n) const {
     if (n < 0 || i + n > size_) {
         n = size_ - i;
     }
-    Vector<T, AllocatorT> v;
+    Vector<T, AllocatorT, GrowthPolicyT> v;
     if (n > 0 && v.realloc(n)) {
         const T* const p = data_ + i;
         copy(v.data_, p, p + n);
@@ -509,8 +618,8 @@ inline spark::Vector<T, AllocatorT> spark::Vector<T, AllocatorT>::copy(int i, in
     return v;
 }
 
-template<typename T, typename AllocatorT>
-inline int spark::Vector<T, AllocatorT>::indexOf(const T &value, int i) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline int spark::Vector<T, AllocatorT, GrowthPolicyT>::indexOf(const T &value, int i) const {
     const T* const p = find(data_ + i, data_ + size_, value);
     if (!p) {
         return -1;
@@ -518,13 +627,13 @@ inline int spark::Vector<T, AllocatorT>::indexOf(const T &value, int i) const {
     return p - data_;
 }
 
-template<typename T, typename AllocatorT>
-inline int spark::Vector<T, AllocatorT>::lastIndexOf(const T &value) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline int spark::Vector<T, AllocatorT, GrowthPolicyT>::lastIndexOf(const T &value) const {
     return lastIndexOf(value, size_ - 1);
 }
 
-template<typename T, typename AllocatorT>
-inline int spark::Vector<T, AllocatorT>::lastIndexOf(const T &value, int i) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline int spark::Vector<T, AllocatorT, GrowthPolicyT>::lastIndexOf(const T &value, int i) const {
     const T* const p = rfind(data_ + i, data_ - 1, value);
     if (!p) {
         return -1;
@@ -532,20 +641,20 @@ inline int spark::Vector<T, AllocatorT>::lastIndexOf(const T &value, int i) cons
     return p - data_;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::contains(const T &value) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::contains(const T &value) const {
     return find(data_, data_ + size_, value);
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>& spark::Vector<T, AllocatorT>::fill(const T& value) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>& spark::Vector<T, AllocatorT, GrowthPolicyT>::fill(const T& value) {
     destruct(data_, data_ + size_);
     construct(data_, data_ + size_, value);
     return *this;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::resize(int n) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::resize(int n) {
     if (n > size_) {
         if (n > capacity_ && !realloc(n)) {
             return false;
@@ -559,85 +668,85 @@ inline bool spark::Vector<T, AllocatorT>::resize(int n) {
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline int spark::Vector<T, AllocatorT>::size() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline int spark::Vector<T, AllocatorT, GrowthPolicyT>::size() const {
     return size_;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::isEmpty() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::isEmpty() const {
     return size_ == 0;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::reserve(int n) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::reserve(int n) {
     if (n > capacity_ && !realloc(n)) {
         return false;
     }
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline int spark::Vector<T, AllocatorT>::capacity() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline int spark::Vector<T, AllocatorT, GrowthPolicyT>::capacity() const {
     return capacity_;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::trimToSize() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::trimToSize() {
     if (capacity_ > size_ && !realloc(size_)) {
         return false;
     }
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline void spark::Vector<T, AllocatorT>::clear() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline void spark::Vector<T, AllocatorT, GrowthPolicyT>::clear() {
     destruct(data_, data_ + size_);
     size_ = 0;
 }
 
-template<typename T, typename AllocatorT>
-inline T* spark::Vector<T, AllocatorT>::data() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T* spark::Vector<T, AllocatorT, GrowthPolicyT>::data() {
     return data_;
 }
 
-template<typename T, typename AllocatorT>
-inline const T* spark::Vector<T, AllocatorT>::data() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline const T* spark::Vector<T, AllocatorT, GrowthPolicyT>::data() const {
     return data_;
 }
 
-template<typename T, typename AllocatorT>
-inline T* spark::Vector<T, AllocatorT>::begin() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T* spark::Vector<T, AllocatorT, GrowthPolicyT>::begin() {
     return data_;
 }
 
-template<typename T, typename AllocatorT>
-const T* spark::Vector<T, AllocatorT>::begin() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+const T* spark::Vector<T, AllocatorT, GrowthPolicyT>::begin() const {
     return data_;
 }
 
-template<typename T, typename AllocatorT>
-T* spark::Vector<T, AllocatorT>::end() {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+T* spark::Vector<T, AllocatorT, GrowthPolicyT>::end() {
     return data_ + size_;
 }
 
-template<typename T, typename AllocatorT>
-const T* spark::Vector<T, AllocatorT>::end() const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+const T* spark::Vector<T, AllocatorT, GrowthPolicyT>::end() const {
     return data_ + size_;
 }
 
-template<typename T, typename AllocatorT>
-inline T& spark::Vector<T, AllocatorT>::operator[](int i) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline T& spark::Vector<T, AllocatorT, GrowthPolicyT>::operator[](int i) {
     return data_[i];
 }
 
-template<typename T, typename AllocatorT>
-inline const T& spark::Vector<T, AllocatorT>::operator[](int i) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline const T& spark::Vector<T, AllocatorT, GrowthPolicyT>::operator[](int i) const {
     return data_[i];
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::operator==(const Vector<T, AllocatorT> &vector) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::operator==(const Vector<T, AllocatorT, GrowthPolicyT> &vector) const {
     if (size_ != vector.size_) {
         return false;
     }
@@ -652,24 +761,114 @@ inline bool spark::Vector<T, AllocatorT>::operator==(const Vector<T, AllocatorT>
     return true;
 }
 
-template<typename T, typename AllocatorT>
-inline bool spark::Vector<T, AllocatorT>::operator!=(const Vector<T, AllocatorT> &vector) const {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::operator!=(const Vector<T, AllocatorT, GrowthPolicyT> &vector) const {
     return !(*this == vector);
 }
 
-template<typename T, typename AllocatorT>
-inline spark::Vector<T, AllocatorT>& spark::Vector<T, AllocatorT>::operator=(Vector<T, AllocatorT> vector) {
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline spark::Vector<T, AllocatorT, GrowthPolicyT>& spark::Vector<T, AllocatorT, GrowthPolicyT>::operator=(Vector<T, AllocatorT, GrowthPolicyT> vector) {
     swap(*this, vector);
     return *this;
 }
 
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline bool spark::Vector<T, AllocatorT, GrowthPolicyT>::moveFrom(Vector<T, AllocatorT, GrowthPolicyT>& vector) {
+    if (!vector.inline_) {
+        if (!inline_) {
+            AllocatorT::free(data_);
+        }
+        data_ = vector.data_;
+        size_ = vector.size_;
+        capacity_ = vector.capacity_;
+        inline_ = false;
+        vector.data_ = nullptr;
+        vector.size_ = 0;
+        vector.capacity_ = 0;
+    } else {
+        // Elements stored in an inline buffer have to be moved one by one
+        if (!reserve(vector.size_)) {
+            return false;
+        }
+        move(data_, vector.data_, vector.data_ + vector.size_);
+        size_ = vector.size_;
+        vector.size_ = 0;
+    }
+    return true;
+}
+
+// spark::SmallVector
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::SmallVector() :
+        VectorType((T*)buf_, N) {
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::SmallVector(std::initializer_list<T> values) : SmallVector() {
+    this->append(values.begin(), values.size());
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::SmallVector(const VectorType& vector) : SmallVector() {
+    this->append(vector);
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::SmallVector(const SmallVector<T, N, AllocatorT, GrowthPolicyT>& vector) : SmallVector() {
+    this->append(vector);
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::SmallVector(VectorType&& vector) : SmallVector() {
+    this->moveFrom(vector);
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::SmallVector(SmallVector<T, N, AllocatorT, GrowthPolicyT>&& vector) : SmallVector() {
+    this->moveFrom(vector);
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>& spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::operator=(const VectorType& vector) {
+    if (this != &vector) {
+        this->clear();
+        this->append(vector);
+    }
+    return *this;
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>& spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::operator=(const SmallVector<T, N, AllocatorT, GrowthPolicyT>& vector) {
+    return *this = static_cast<const VectorType&>(vector);
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>& spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::operator=(VectorType&& vector) {
+    if (this != &vector) {
+        this->clear();
+        this->moveFrom(vector);
+    }
+    return *this;
+}
+
+template<typename T, int N, typename AllocatorT, typename GrowthPolicyT>
+inline spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>& spark::SmallVector<T, N, AllocatorT, GrowthPolicyT>::operator=(SmallVector<T, N, AllocatorT, GrowthPolicyT>&& vector) {
+    return *this = static_cast<VectorType&&>(vector);
+}
+
 // spark::
-template<typename T, typename AllocatorT>
-inline void spark::swap(Vector<T, AllocatorT>& vector, Vector<T, AllocatorT>& vector2) {
-    using std::swap;
-    swap(vector.data_, vector2.data_);
-    swap(vector.size_, vector2.size_);
-    swap(vector.capacity_, vector2.capacity_);
+template<typename T, typename AllocatorT, typename GrowthPolicyT>
+inline void spark::swap(Vector<T, AllocatorT, GrowthPolicyT>& vector, Vector<T, AllocatorT, GrowthPolicyT>& vector2) {
+    if (!vector.inline_ && !vector2.inline_) {
+        using std::swap;
+        swap(vector.data_, vector2.data_);
+        swap(vector.size_, vector2.size_);
+        swap(vector.capacity_, vector2.capacity_);
+    } else {
+        Vector<T, AllocatorT, GrowthPolicyT> tmp(std::move(vector));
+        vector.moveFrom(vector2);
+        vector2.moveFrom(tmp);
+    }
 }
 
 #endif // SPARK_WIRING_VECTOR_H
@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2019 Particle Industries, Inc.  All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spark_wiring_cbor.h"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cfloat>
+#include <climits>
+
+namespace {
+
+// Major types
+enum {
+    CBOR_UINT = 0,
+    CBOR_NEGINT = 1,
+    CBOR_BYTES = 2,
+    CBOR_TEXT = 3,
+    CBOR_ARRAY = 4,
+    CBOR_MAP = 5,
+    CBOR_TAG = 6,
+    CBOR_SIMPLE = 7
+};
+
+// Additional information values
+enum {
+    CBOR_ARG_1 = 24,
+    CBOR_ARG_2 = 25,
+    CBOR_ARG_4 = 26,
+    CBOR_ARG_8 = 27,
+    CBOR_INDEFINITE = 31
+};
+
+// Simple values
+enum {
+    CBOR_FALSE = 20,
+    CBOR_TRUE = 21,
+    CBOR_NULL = 22,
+    CBOR_UNDEFINED = 23,
+    CBOR_HALF = 25,
+    CBOR_FLOAT = 26,
+    CBOR_DOUBLE = 27
+};
+
+const uint8_t CBOR_BREAK = 0xff;
+
+const unsigned MAX_NESTING_DEPTH = 32;
+
+struct Head {
+    unsigned type;
+    unsigned info;
+    uint64_t arg;
+};
+
+// Decodes the head of a data item. Returns a pointer to the data following the head, or null if
+// the head is malformed or truncated
+const uint8_t* readHead(const uint8_t *p, const uint8_t *end, Head *h) {
+    if (p >= end) {
+        return nullptr;
+    }
+    const uint8_t b = *p++;
+    h->type = b >> 5;
+    h->info = b & 0x1f;
+    size_t n = 0;
+    switch (h->info) {
+    case CBOR_ARG_1:
+        n = 1;
+        break;
+    case CBOR_ARG_2:
+        n = 2;
+        break;
+    case CBOR_ARG_4:
+        n = 4;
+        break;
+    case CBOR_ARG_8:
+        n = 8;
+        break;
+    case CBOR_INDEFINITE:
+        h->arg = 0;
+        return p;
+    default:
+        if (h->info > CBOR_ARG_8) {
+            return nullptr; // Reserved value
+        }
+        h->arg = h->info;
+        return p;
+    }
+    if ((size_t)(end - p) < n) {
+        return nullptr;
+    }
+    uint64_t arg = 0;
+    for (size_t i = 0; i < n; ++i) {
+        arg = (arg << 8) | p[i];
+    }
+    h->arg = arg;
+    return p + n;
+}
+
+// Skips a data item and all its children items if any. Returns null if the item is malformed
+const uint8_t* skipItem(const uint8_t *p, const uint8_t *end, unsigned depth) {
+    Head h;
+    p = readHead(p, end, &h);
+    if (!p) {
+        return nullptr;
+    }
+    switch (h.type) {
+    case CBOR_UINT:
+    case CBOR_NEGINT:
+        return (h.info != CBOR_INDEFINITE) ? p : nullptr;
+    case CBOR_BYTES:
+    case CBOR_TEXT:
+        // Indefinite-length strings are not supported
+        if (h.info == CBOR_INDEFINITE || h.arg > (uint64_t)(end - p)) {
+            return nullptr;
+        }
+        return p + h.arg;
+    case CBOR_ARRAY:
+    case CBOR_MAP: {
+        if (depth >= MAX_NESTING_DEPTH) {
+            return nullptr;
+        }
+        const unsigned itemsPerElem = (h.type == CBOR_MAP) ? 2 : 1;
+        if (h.info == CBOR_INDEFINITE) {
+            for (;;) {
+                if (p >= end) {
+                    return nullptr;
+                }
+                if (*p == CBOR_BREAK) {
+                    return p + 1;
+                }
+                for (unsigned i = 0; i < itemsPerElem; ++i) {
+                    p = skipItem(p, end, depth + 1);
+                    if (!p) {
+                        return nullptr;
+                    }
+                }
+            }
+        }
+        // Every item takes at least one byte
+        if (h.arg > (uint64_t)(end - p)) {
+            return nullptr;
+        }
+        const uint64_t count = h.arg * itemsPerElem;
+        for (uint64_t i = 0; i < count; ++i) {
+            p = skipItem(p, end, depth + 1);
+            if (!p) {
+                return nullptr;
+            }
+        }
+        return p;
+    }
+    case CBOR_TAG:
+        if (h.info == CBOR_INDEFINITE || depth >= MAX_NESTING_DEPTH) {
+            return nullptr;
+        }
+        return skipItem(p, end, depth + 1);
+    default: // CBOR_SIMPLE
+        switch (h.info) {
+        case CBOR_FALSE:
+        case CBOR_TRUE:
+        case CBOR_NULL:
+        case CBOR_UNDEFINED:
+        case CBOR_HALF:
+        case CBOR_FLOAT:
+        case CBOR_DOUBLE:
+            return p;
+        default:
+            return nullptr; // Unsupported simple value or unexpected break
+        }
+    }
+}
+
+const uint8_t* skipTags(const uint8_t *p, const uint8_t *end) {
+    Head h;
+    const uint8_t *next = nullptr;
+    while ((next = readHead(p, end, &h)) && h.type == CBOR_TAG) {
+        p = next;
+    }
+    return p;
+}
+
+// Counts items of an indefinite-length container
+size_t countItems(const uint8_t *p, const uint8_t *end) {
+    size_t n = 0;
+    while (p && p < end && *p != CBOR_BREAK) {
+        p = skipItem(p, end, 0);
+        ++n;
+    }
+    return n;
+}
+
+double halfToDouble(uint16_t half) {
+    const unsigned exp = (half >> 10) & 0x1f;
+    const unsigned mant = half & 0x3ff;
+    double val = 0.0;
+    if (exp == 0) {
+        val = std::ldexp(mant, -24); // Subnormal
+    } else if (exp != 31) {
+        val = std::ldexp(mant + 1024, exp - 25);
+    } else {
+        val = mant ? NAN : INFINITY;
+    }
+    return (half & 0x8000) ? -val : val;
+}
+
+// Converts a single precision number to half precision if that can be done without losing
+// precision
+bool floatToHalf(uint32_t bits, uint16_t *half) {
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const int exp = (bits >> 23) & 0xff;
+    const uint32_t mant = bits & 0x7fffff;
+    if (exp == 0xff) {
+        *half = mant ? 0x7e00 : (sign | 0x7c00); // NaN or infinity
+        return true;
+    }
+    if (exp == 0) {
+        if (mant) {
+            return false; // Subnormal numbers are out of range
+        }
+        *half = sign; // Zero
+        return true;
+    }
+    const int e = exp - 127;
+    if (e >= -14 && e <= 15) {
+        if (mant & 0x1fff) {
+            return false;
+        }
+        *half = sign | ((e + 15) << 10) | (mant >> 13);
+        return true;
+    }
+    if (e >= -24 && e < -14) {
+        // Subnormal half precision number
+        const uint32_t m = mant | 0x800000;
+        const unsigned shift = -(e + 1);
+        if (m & ((1u << shift) - 1)) {
+            return false;
+        }
+        *half = sign | (m >> shift);
+        return true;
+    }
+    return false;
+}
+
+int saturate(double val) {
+    if (val >= INT_MAX) {
+        return INT_MAX;
+    }
+    if (val <= INT_MIN) {
+        return INT_MIN;
+    }
+    if (std::isnan(val)) {
+        return 0;
+    }
+    return (int)val;
+}
+
+} // namespace
+
+// spark::CBORValue
+bool spark::CBORValue::toBool() const {
+    switch (type()) {
+    case CBOR_TYPE_BOOL:
+        return (*p_ & 0x1f) == CBOR_TRUE;
+    case CBOR_TYPE_INT:
+    case CBOR_TYPE_FLOAT:
+        return toDouble() != 0.0;
+    default:
+        return false;
+    }
+}
+
+int spark::CBORValue::toInt() const {
+    switch (type()) {
+    case CBOR_TYPE_BOOL:
+        return (*p_ & 0x1f) == CBOR_TRUE;
+    case CBOR_TYPE_INT: {
+        Head h;
+        readHead(p_, end_, &h);
+        if (h.type == CBOR_UINT) {
+            return (h.arg > INT_MAX) ? INT_MAX : (int)h.arg;
+        }
+        return (h.arg > (uint64_t)INT_MAX) ? INT_MIN : -1 - (int)h.arg;
+    }
+    case CBOR_TYPE_FLOAT:
+        return saturate(toDouble());
+    default:
+        return 0;
+    }
+}
+
+double spark::CBORValue::toDouble() const {
+    switch (type()) {
+    case CBOR_TYPE_BOOL:
+        return (*p_ & 0x1f) == CBOR_TRUE;
+    case CBOR_TYPE_INT: {
+        Head h;
+        readHead(p_, end_, &h);
+        return (h.type == CBOR_UINT) ? (double)h.arg : -1.0 - (double)h.arg;
+    }
+    case CBOR_TYPE_FLOAT: {
+        Head h;
+        readHead(p_, end_, &h);
+        if (h.info == CBOR_HALF) {
+            return halfToDouble(h.arg);
+        }
+        if (h.info == CBOR_FLOAT) {
+            const uint32_t bits = h.arg;
+            float val = 0;
+            memcpy(&val, &bits, sizeof(val));
+            return val;
+        }
+        double val = 0;
+        memcpy(&val, &h.arg, sizeof(val));
+        return val;
+    }
+    default:
+        return 0.0;
+    }
+}
+
+spark::CBORType spark::CBORValue::type() const {
+    if (!p_) {
+        return CBOR_TYPE_INVALID;
+    }
+    switch (*p_ >> 5) {
+    case CBOR_UINT:
+    case CBOR_NEGINT:
+        return CBOR_TYPE_INT;
+    case CBOR_BYTES:
+        return CBOR_TYPE_BYTES;
+    case CBOR_TEXT:
+        return CBOR_TYPE_STRING;
+    case CBOR_ARRAY:
+        return CBOR_TYPE_ARRAY;
+    case CBOR_MAP:
+        return CBOR_TYPE_OBJECT;
+    case CBOR_SIMPLE:
+        switch (*p_ & 0x1f) {
+        case CBOR_FALSE:
+        case CBOR_TRUE:
+            return CBOR_TYPE_BOOL;
+        case CBOR_NULL:
+        case CBOR_UNDEFINED:
+            return CBOR_TYPE_NULL;
+        case CBOR_HALF:
+        case CBOR_FLOAT:
+        case CBOR_DOUBLE:
+            return CBOR_TYPE_FLOAT;
+        default:
+            return CBOR_TYPE_INVALID;
+        }
+    default:
+        return CBOR_TYPE_INVALID;
+    }
+}
+
+spark::CBORValue spark::CBORValue::parse(const char *data, size_t size) {
+    if (!data) {
+        return CBORValue();
+    }
+    const uint8_t* const p = (const uint8_t*)data;
+    const uint8_t* const end = p + size;
+    if (skipItem(p, end, 0) != end) {
+        return CBORValue(); // Malformed data or trailing bytes
+    }
+    return CBORValue(skipTags(p, end), end);
+}
+
+// spark::CBORString
+spark::CBORString::CBORString(const uint8_t *p, const uint8_t *end) :
+        CBORString() {
+    if (p && ((*p >> 5) == CBOR_TEXT || (*p >> 5) == CBOR_BYTES)) {
+        Head h;
+        s_ = (const char*)readHead(p, end, &h);
+        n_ = h.arg;
+    }
+}
+
+// spark::CBORArrayIterator
+spark::CBORArrayIterator::CBORArrayIterator(const uint8_t *p, const uint8_t *end) :
+        CBORArrayIterator() {
+    if (p && (*p >> 5) == CBOR_ARRAY) {
+        Head h;
+        p_ = readHead(p, end, &h); // First element
+        end_ = end;
+        n_ = (h.info == CBOR_INDEFINITE) ? countItems(p_, end) : h.arg; // Number of elements
+    }
+}
+
+bool spark::CBORArrayIterator::next() {
+    if (!n_) {
+        return false;
+    }
+    v_ = skipTags(p_, end_);
+    --n_;
+    if (n_) {
+        p_ = skipItem(p_, end_, 0);
+    }
+    return true;
+}
+
+// spark::CBORObjectIterator
+spark::CBORObjectIterator::CBORObjectIterator(const uint8_t *p, const uint8_t *end) :
+        CBORObjectIterator() {
+    if (p && (*p >> 5) == CBOR_MAP) {
+        Head h;
+        p_ = readHead(p, end, &h); // First key
+        end_ = end;
+        n_ = (h.info == CBOR_INDEFINITE) ? countItems(p_, end) / 2 : h.arg; // Number of elements
+    }
+}
+
+bool spark::CBORObjectIterator::next() {
+    if (!n_) {
+        return false;
+    }
+    k_ = skipTags(p_, end_);
+    const uint8_t* const v = skipItem(p_, end_, 0);
+    v_ = skipTags(v, end_);
+    --n_;
+    if (n_) {
+        p_ = skipItem(v, end_, 0);
+    }
+    return true;
+}
+
+// spark::CBORWriter
+spark::CBORWriter& spark::CBORWriter::beginArray() {
+    beginContainer(CBOR_ARRAY);
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::beginArray(size_t count) {
+    writeHead(CBOR_ARRAY, count);
+    indef_ <<= 1;
+    ++depth_;
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::endArray() {
+    endContainer();
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::beginObject() {
+    beginContainer(CBOR_MAP);
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::beginObject(size_t count) {
+    writeHead(CBOR_MAP, count);
+    indef_ <<= 1;
+    ++depth_;
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::endObject() {
+    endContainer();
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::name(const char *name, size_t size) {
+    return value(name, size);
+}
+
+spark::CBORWriter& spark::CBORWriter::value(bool val) {
+    write((char)((CBOR_SIMPLE << 5) | (val ? CBOR_TRUE : CBOR_FALSE)));
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::value(int val) {
+    if (val < 0) {
+        writeHead(CBOR_NEGINT, -1 - (int64_t)val);
+    } else {
+        writeHead(CBOR_UINT, val);
+    }
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::value(unsigned val) {
+    writeHead(CBOR_UINT, val);
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::value(double val) {
+    char buf[9];
+    size_t n = 0;
+    uint64_t bits = 0;
+    const bool fitsFloat = std::isnan(val) || std::isinf(val) || std::fabs(val) <= FLT_MAX;
+    const float f = fitsFloat ? (float)val : 0.0f;
+    if (fitsFloat && (std::isnan(val) || (double)f == val)) {
+        uint32_t fbits = 0;
+        memcpy(&fbits, &f, sizeof(fbits));
+        uint16_t half = 0;
+        if (floatToHalf(fbits, &half)) {
+            buf[0] = (CBOR_SIMPLE << 5) | CBOR_HALF;
+            bits = half;
+            n = 3;
+        } else {
+            buf[0] = (CBOR_SIMPLE << 5) | CBOR_FLOAT;
+            bits = fbits;
+            n = 5;
+        }
+    } else {
+        buf[0] = (CBOR_SIMPLE << 5) | CBOR_DOUBLE;
+        memcpy(&bits, &val, sizeof(bits));
+        n = 9;
+    }
+    for (size_t i = n - 1; i > 0; --i) {
+        buf[i] = bits & 0xff;
+        bits >>= 8;
+    }
+    write(buf, n);
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::value(const char *val, size_t size) {
+    writeHead(CBOR_TEXT, size);
+    write(val, size);
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::bytes(const void *data, size_t size) {
+    writeHead(CBOR_BYTES, size);
+    write((const char*)data, size);
+    return *this;
+}
+
+spark::CBORWriter& spark::CBORWriter::nullValue() {
+    write((char)((CBOR_SIMPLE << 5) | CBOR_NULL));
+    return *this;
+}
+
+void spark::CBORWriter::writeHead(unsigned type, uint64_t arg) {
+    char buf[9];
+    size_t n = 0;
+    if (arg < CBOR_ARG_1) {
+        buf[0] = (type << 5) | arg;
+        n = 1;
+    } else if (arg <= 0xff) {
+        buf[0] = (type << 5) | CBOR_ARG_1;
+        n = 2;
+    } else if (arg <= 0xffff) {
+        buf[0] = (type << 5) | CBOR_ARG_2;
+        n = 3;
+    } else if (arg <= 0xffffffff) {
+        buf[0] = (type << 5) | CBOR_ARG_4;
+        n = 5;
+    } else {
+        buf[0] = (type << 5) | CBOR_ARG_8;
+        n = 9;
+    }
+    for (size_t i = n - 1; i > 0; --i) {
+        buf[i] = arg & 0xff;
+        arg >>= 8;
+    }
+    write(buf, n);
+}
+
+void spark::CBORWriter::beginContainer(unsigned type) {
+    write((char)((type << 5) | CBOR_INDEFINITE));
+    indef_ = (indef_ << 1) | 1;
+    ++depth_;
+}
+
+void spark::CBORWriter::endContainer() {
+    if (!depth_) {
+        return;
+    }
+    if (indef_ & 1) {
+        write((char)CBOR_BREAK);
+    }
+    indef_ >>= 1;
+    --depth_;
+}
+
+// spark::CBORBufferWriter
+void spark::CBORBufferWriter::write(const char *data, size_t size) {
+    if (n_ < bufSize_) {
+        memcpy(buf_ + n_, data, std::min(size, bufSize_ - n_));
+    }
+    n_ += size;
+}
@@ -48,6 +48,13 @@ namespace spark {
         return sig;
     }
 
+    CellularSignal CellularClass::RSSI(bool refresh) {
+        if (refresh && network_ready(*this, 0, NULL)) {
+            cellular_signal_refresh(NULL); // Ignore errors, RSSI() reports them
+        }
+        return RSSI();
+    }
+
     CellularDataHal data_hal;
 
     bool CellularClass::getDataUsage(CellularData &data_get) {
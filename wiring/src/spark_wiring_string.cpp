@@ -202,6 +202,15 @@ unsigned char String::reserve(unsigned int size)
 	return 0;
 }
 
+unsigned char String::grow(unsigned int size)
+{
+	// Grow the buffer by a factor of 1.5 so that repeated concatenation takes amortized
+	// linear time. Fall back to the exact size if the bigger buffer cannot be allocated
+	unsigned int n = capacity + capacity / 2;
+	if (n < size) n = size;
+	return reserve(n) || reserve(size);
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
 	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
@@ -309,9 +318,16 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
-	strcpy(buffer + len, cstr);
+	if (newlen > capacity) {
+		// The source string may reside in the buffer that is about to be reallocated
+		const bool self = buffer && cstr >= buffer && cstr < buffer + len;
+		const unsigned int offset = self ? cstr - buffer : 0;
+		if (!grow(newlen)) return 0;
+		if (self) cstr = buffer + offset;
+	}
+	memcpy(buffer + len, cstr, length);
 	len = newlen;
+	buffer[len] = 0;
 	return 1;
 }
 
@@ -680,41 +696,30 @@ String& String::replace(const String& find, const String& replace)
 	int diff = replace.len - find.len;
 	char *readFrom = buffer;
 	char *foundAt;
-	if (diff == 0) {
-		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
-			memcpy(foundAt, replace.buffer, replace.len);
-			readFrom = foundAt + replace.len;
-		}
-	} else if (diff < 0) {
-		char *writeTo = buffer;
-		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
-			unsigned int n = foundAt - readFrom;
-			memcpy(writeTo, readFrom, n);
-			writeTo += n;
-			memcpy(writeTo, replace.buffer, replace.len);
-			writeTo += replace.len;
-			readFrom = foundAt + find.len;
-			len += diff;
-		}
-		strcpy(writeTo, readFrom);
-	} else {
+	if (diff > 0) {
 		unsigned int size = len; // compute size needed for result
 		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
 			readFrom = foundAt + find.len;
 			size += diff;
 		}
-		if (size == len) return *this;;
+		if (size == len) return *this;
 		if (size > capacity && !changeBuffer(size)) return *this; // XXX: tell user!
-		int index = len - 1;
-		while (index >= 0 && (index = lastIndexOf(find, index)) >= 0) {
-			readFrom = buffer + index + find.len;
-			memmove(readFrom + diff, readFrom, len - (readFrom - buffer));
-			len += diff;
-			buffer[len] = 0;
-			memcpy(buffer + index, replace.buffer, replace.len);
-			index--;
-		}
+		// Move the original string to the end of the buffer and build the result in a single
+		// pass from the beginning of the buffer. The output never overtakes the input
+		readFrom = buffer + (size - len);
+		memmove(readFrom, buffer, len + 1);
+	}
+	char *writeTo = buffer;
+	while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+		unsigned int n = foundAt - readFrom;
+		memmove(writeTo, readFrom, n);
+		writeTo += n;
+		memcpy(writeTo, replace.buffer, replace.len);
+		writeTo += replace.len;
+		readFrom = foundAt + find.len;
+		len += diff;
 	}
+	memmove(writeTo, readFrom, strlen(readFrom) + 1);
         return *this;
 }
 
@@ -729,7 +734,7 @@ String& String::remove(unsigned int index, unsigned int count){
 	if (index + count > len) { count = len - index; }
 	char *writeTo = buffer + index;
 	len = len - count;
-	strncpy(writeTo, buffer + index + count,len - index);
+	memmove(writeTo, writeTo + count, len - index);
 	buffer[len] = 0;
         return *this;
 }
@@ -27,6 +27,8 @@
 #include "spark_wiring_usartserial.h"
 #include "spark_wiring_constants.h"
 #include "module_info.h"
+#include "spark_wiring_ticks.h"
+#include "system_error.h"
 
 // Constructors ////////////////////////////////////////////////////////////////
 
@@ -35,6 +37,10 @@ USARTSerial::USARTSerial(HAL_USART_Serial serial, Ring_Buffer *rx_buffer, Ring_B
   _serial = serial;
   // Default is blocking mode
   _blocking = true;
+#if HAL_PLATFORM_USART_BULK
+  _rxBufferSize = 0;
+  _txBufferSize = 0;
+#endif // HAL_PLATFORM_USART_BULK
   HAL_USART_Init(serial, rx_buffer, tx_buffer);
 }
 // Public Methods //////////////////////////////////////////////////////////////
@@ -49,6 +55,38 @@ void USARTSerial::begin(unsigned long baud, uint32_t config)
   HAL_USART_BeginConfig(_serial, baud, config, 0);
 }
 
+#if HAL_PLATFORM_USART_BULK
+bool USARTSerial::begin(unsigned long baud, uint32_t config, size_t rxBufferSize, size_t txBufferSize)
+{
+  if (rxBufferSize == 0 || txBufferSize == 0 || rxBufferSize > UINT16_MAX || txBufferSize > UINT16_MAX) {
+    return false;
+  }
+  // The HAL may still be using the current buffers, so they are replaced only after it has
+  // been stopped and reinitialized with the new ones
+  std::unique_ptr<uint8_t[]> rxBuffer(new (std::nothrow) uint8_t[rxBufferSize]);
+  std::unique_ptr<uint8_t[]> txBuffer(new (std::nothrow) uint8_t[txBufferSize]);
+  if (!rxBuffer || !txBuffer) {
+    return false;
+  }
+  end();
+  HAL_USART_Buffer_Config conf = {};
+  conf.size = sizeof(HAL_USART_Buffer_Config);
+  conf.rx_buffer = rxBuffer.get();
+  conf.rx_buffer_size = rxBufferSize;
+  conf.tx_buffer = txBuffer.get();
+  conf.tx_buffer_size = txBufferSize;
+  if (HAL_USART_Init_Ex(_serial, &conf, nullptr) != 0) {
+    return false;
+  }
+  _rxBuffer.swap(rxBuffer);
+  _txBuffer.swap(txBuffer);
+  _rxBufferSize = rxBufferSize;
+  _txBufferSize = txBufferSize;
+  begin(baud, config);
+  return isEnabled();
+}
+#endif // HAL_PLATFORM_USART_BULK
+
 void USARTSerial::end()
 {
   HAL_USART_End(_serial);
@@ -100,6 +138,46 @@ size_t USARTSerial::write(uint8_t c)
   return 0;
 }
 
+size_t USARTSerial::write(const uint8_t* buffer, size_t size)
+{
+#if HAL_PLATFORM_USART_BULK
+  size_t written = 0;
+  while (written < size) {
+    const ssize_t r = HAL_USART_Write(_serial, buffer + written, size - written, sizeof(uint8_t));
+    if (r > 0) {
+      written += r;
+    } else if (r != SYSTEM_ERROR_NO_MEMORY || !_blocking) {
+      // The TX buffer is full in non-blocking mode or the USART is not enabled
+      break;
+    }
+  }
+  return written;
+#else
+  return Print::write(buffer, size);
+#endif // HAL_PLATFORM_USART_BULK
+}
+
+size_t USARTSerial::readBytes(char* buffer, size_t length)
+{
+#if HAL_PLATFORM_USART_BULK
+  size_t count = 0;
+  _startMillis = millis();
+  while (count < length) {
+    const ssize_t r = HAL_USART_Read(_serial, buffer + count, length - count, sizeof(char));
+    if (r > 0) {
+      count += r;
+      _startMillis = millis();
+    } else if (r != SYSTEM_ERROR_NO_MEMORY || millis() - _startMillis >= _timeout) {
+      // Timeout or the USART is not enabled
+      break;
+    }
+  }
+  return count;
+#else
+  return Stream::readBytes(buffer, length);
+#endif // HAL_PLATFORM_USART_BULK
+}
+
 size_t USARTSerial::write(uint16_t c)
 {
   return HAL_USART_Write_NineBitData(_serial, c);